@@ -93,6 +93,7 @@ const UserDef U_default = {
 
     .keyconfigstr = "Blender",
     .undosteps = 32,
+    .sculpt_undo_memory = 0,
     .undomemory = 0,
     .gp_manhattandist = 1,
     .gp_euclideandist = 2,
@@ -549,6 +549,9 @@ class DATA_PT_remesh(MeshButtonsPanel, Panel):
         if mesh.remesh_mode == 'VOXEL':
             col.prop(mesh, "remesh_voxel_size")
             col.prop(mesh, "remesh_voxel_adaptivity")
+            sub = col.column()
+            sub.active = mesh.remesh_voxel_adaptivity > 0.0
+            sub.prop(mesh, "remesh_voxel_detail", text="Detail")
             col.prop(mesh, "use_remesh_fix_poles")
 
             col = layout.column(heading="Preserve")
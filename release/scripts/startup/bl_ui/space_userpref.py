@@ -617,6 +617,7 @@ class USERPREF_PT_system_memory(SystemPanel, CenterAlignMixIn, Panel):
         col = layout.column()
         col.prop(edit, "undo_steps", text="Undo Steps")
         col.prop(edit, "undo_memory_limit", text="Undo Memory Limit")
+        col.prop(edit, "sculpt_undo_memory_limit", text="Sculpt Undo Memory Limit")
         col.prop(edit, "use_global_undo")
 
         layout.separator()
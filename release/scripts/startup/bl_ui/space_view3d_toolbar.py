@@ -1265,6 +1265,9 @@ class VIEW3D_PT_sculpt_voxel_remesh(Panel, View3DPaintPanel):
         props = row.operator("sculpt.sample_detail_size", text="", icon='EYEDROPPER')
         props.mode = 'VOXEL'
         col.prop(mesh, "remesh_voxel_adaptivity")
+        sub = col.column()
+        sub.active = mesh.remesh_voxel_adaptivity > 0.0
+        sub.prop(mesh, "remesh_voxel_detail", text="Detail")
         col.prop(mesh, "use_remesh_fix_poles")
 
         col = layout.column(heading="Preserve", align=True)
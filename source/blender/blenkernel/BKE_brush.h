@@ -229,6 +229,17 @@ float BKE_brush_curve_strength_ex(int curve_preset,
                                   const struct CurveMapping *curve,
                                   float p,
                                   const float len);
+/**
+ * #BKE_brush_curve_strength_ex for \a count distances at once, using SIMD where available.
+ * Results are bit identical to the single value version. \a dist and \a r_strength may be the
+ * same array.
+ */
+void BKE_brush_curve_strength_array(int curve_preset,
+                                    const struct CurveMapping *curve,
+                                    const float *dist,
+                                    float len,
+                                    int count,
+                                    float *r_strength);
 
 #ifdef __cplusplus
 }
@@ -18,6 +18,15 @@ struct Mesh *BKE_mesh_remesh_voxel(const struct Mesh *mesh,
                                    float voxel_size,
                                    float adaptivity,
                                    float isovalue);
+/**
+ * Voxel remesh where the adaptivity is only applied away from the areas selected by
+ * `detail_mode` (a #Mesh.remesh_voxel_detail value), which keep the full voxel resolution.
+ */
+struct Mesh *BKE_mesh_remesh_voxel_adaptive(const struct Mesh *mesh,
+                                            float voxel_size,
+                                            float adaptivity,
+                                            float isovalue,
+                                            int detail_mode);
 struct Mesh *BKE_mesh_remesh_quadriflow(const struct Mesh *mesh,
                                         int target_faces,
                                         int seed,
@@ -34,10 +43,12 @@ struct Mesh *BKE_mesh_remesh_instant_meshes(const Mesh *input_mesh,
                                             void *update_cb_data);
 
 /* Data reprojection functions */
-void BKE_mesh_remesh_reproject_paint_mask(struct Mesh *target, struct Mesh *source);
-void BKE_remesh_reproject_vertex_paint(struct Mesh *target, const struct Mesh *source);
-void BKE_remesh_reproject_sculpt_face_sets(struct Mesh *target, struct Mesh *source);
-void BKE_remesh_reproject_materials(struct Mesh *target, struct Mesh *source);
+/**
+ * Transfer the paint mask, vertex colors, face sets and materials enabled in `flag`
+ * (#Mesh.flag `ME_REMESH_REPROJECT_*` bits) from `source` in a single parallel pass over a
+ * shared BVH tree of the source surface.
+ */
+void BKE_mesh_remesh_reproject_attributes(struct Mesh *target, struct Mesh *source, int flag);
 void BKE_mesh_remesh_sculpt_array_update(struct Object *ob,
                                          struct Mesh *target,
                                          struct Mesh *source);
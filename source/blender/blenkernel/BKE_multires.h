@@ -8,6 +8,7 @@
  */
 
 #include "BKE_subsurf.h"
+#include "BLI_bitmap.h"
 #include "BLI_compiler_compat.h"
 
 #ifdef __cplusplus
@@ -123,6 +124,18 @@ void multiresModifier_sync_levels_ex(struct Object *ob_dst,
 
 void multires_stitch_grids(struct Object *);
 
+/**
+ * Re-evaluate the sculpt grids of the base faces affected by the given moved base vertices,
+ * re-using the #SubdivCCG of the sculpt session. The subdiv is expected to be refined to the new
+ * base mesh coordinates already.
+ *
+ * Faces all of whose grids are enabled in `skip_grids` (which can be NULL) are left untouched.
+ * Returns true when grids of any face were re-evaluated.
+ */
+bool multires_update_grids_from_base_verts(struct Object *object,
+                                           const BLI_bitmap *moved_verts,
+                                           const char *skip_grids);
+
 void multiresModifier_scale_disp(struct Depsgraph *depsgraph,
                                  struct Scene *scene,
                                  struct Object *ob);
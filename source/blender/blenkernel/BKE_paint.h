@@ -23,6 +23,7 @@ extern "C" {
 
 struct SculptCustomLayer;
 struct MSculptVert;
+struct MSculptVertCold;
 struct BMFace;
 struct BMesh;
 struct BlendDataReader;
@@ -50,6 +51,7 @@ struct PaintCurve;
 struct Palette;
 struct PaletteColor;
 struct Scene;
+struct SmallHash;
 struct StrokeCache;
 struct SubdivCCG;
 struct Tex;
@@ -290,6 +292,8 @@ typedef struct SculptPoseIKChainSegment {
   float trans_mat[PAINT_SYMM_AREAS][4][4];
   float pivot_mat[PAINT_SYMM_AREAS][4][4];
   float pivot_mat_inv[PAINT_SYMM_AREAS][4][4];
+  /* The three above combined, `pivot_mat * trans_mat * pivot_mat_inv`. */
+  float deform_mat[PAINT_SYMM_AREAS][4][4];
 } SculptPoseIKChainSegment;
 
 typedef struct SculptPoseIKChain {
@@ -333,7 +337,7 @@ typedef enum eSculptClothConstraintType {
 #define CLOTH_NO_POS_PTR
 
 typedef struct SculptClothConstraint {
-  signed char ctype, thread_nr;
+  signed char ctype;
 
   /* Index in #SculptClothSimulation.node_state of the node from where this constraint was
    * created. This constraints will only be used by the solver if the state is active. */
@@ -366,7 +370,7 @@ typedef struct SculptClothConstraint {
 
 #ifndef CLOTH_NO_POS_PTR
 #  define MAKE_CONSTRAINT_STRUCT(totelem) \
-    signed char ctype, thread_nr; \
+    signed char ctype; \
     short node; \
     float strength; \
     struct { \
@@ -375,7 +379,7 @@ typedef struct SculptClothConstraint {
     } elems[totelem]
 #else
 #  define MAKE_CONSTRAINT_STRUCT(totelem) \
-    signed char ctype, thread_nr; \
+    signed char ctype; \
     short node; \
     float strength; \
     struct { \
@@ -396,7 +400,7 @@ typedef struct SculptClothBendConstraint {
   float rest_angle, stiffness;
 } SculptClothBendConstraint;
 
-struct SculptClothTaskData;
+struct SculptClothSolver;
 
 typedef struct SculptClothSimulation {
   SculptClothConstraint *constraints[2];
@@ -410,12 +414,8 @@ typedef struct SculptClothSimulation {
   SculptClothBendConstraint *bend_constraints;
   int tot_bend_constraints, capacity_bend_constraints;
 
-  struct SculptClothTaskData *constraint_tasks;
-
-  /* final task always run in main thread, after all the others
-   * have completed
-   */
-  int tot_constraint_tasks;
+  /* Constraints grouped by graph color for the solver, rebuilt when constraints are added. */
+  struct SculptClothSolver *solver;
 
   float mass;
   float damping;
@@ -471,7 +471,8 @@ typedef struct SculptVertexInfo {
 } SculptVertexInfo;
 
 typedef struct SculptBoundaryEditInfo {
-  /* Vertex index from where the topology propagation reached this vertex. */
+  /* Vertex from where the topology propagation reached this vertex and its position in the
+   * boundary region. */
   SculptVertRef original_vertex;
   int original_vertex_i;
 
@@ -496,6 +497,33 @@ typedef struct StoredCotangentW {
   int length;
 } StoredCotangentW;
 
+/* Region positions of the vertices a PBVH leaf node iterates over. */
+typedef struct SculptBoundaryNodeRegion {
+  struct PBVHNode *node;
+  /* Indexed by #PBVHVertexIter.i, -1 for vertices outside of the region. */
+  int *indices;
+  int totindices;
+} SculptBoundaryNodeRegion;
+
+/* Vertices reached by a boundary deformation. */
+typedef struct SculptBoundaryRegion {
+  SculptVertRef *verts;
+  /* PBVH table index of each vertex. */
+  int *indices;
+
+  int totvert;
+  int capacity;
+
+  /* PBVH table index to position in the region plus one. */
+  struct SmallHash *map;
+
+  /* Leaf nodes with vertices in the region, only for strokes. */
+  SculptBoundaryNodeRegion *nodes;
+  int totnode;
+  /* PBVH node to position in #nodes plus one. */
+  struct SmallHash *node_map;
+} SculptBoundaryRegion;
+
 typedef struct SculptBoundary {
   /* Vertex indices of the active boundary. */
   SculptVertRef *vertices;
@@ -504,9 +532,12 @@ typedef struct SculptBoundary {
   int vertices_capacity;
   int num_vertices;
 
-  /* Distance from a vertex in the boundary to initial vertex indexed by vertex index, taking into
-   * account the length of all edges between them. Any vertex that is not in the boundary will have
-   * a distance of 0. */
+  /* The per-vertex data below only covers the vertices in the region and is indexed by their
+   * position in it. The boundary vertices come first, in the same order as #vertices. */
+  SculptBoundaryRegion region;
+
+  /* Distance from a vertex in the boundary to initial vertex, taking into account the length of
+   * all edges between them. Any vertex that is not in the boundary will have a distance of 0. */
   float *distance;
 
   float (*smoothco)[3];
@@ -515,7 +546,6 @@ typedef struct SculptBoundary {
 
   StoredCotangentW *boundary_cotangents;
   SculptVertRef *boundary_closest;
-  int sculpt_totvert;
 
   /* Data for drawing the preview. */
   SculptBoundaryPreviewEdge *edges;
@@ -542,8 +572,7 @@ typedef struct SculptBoundary {
   /* Maximum number of topology steps that were calculated from the boundary. */
   int max_propagation_steps;
 
-  /* Indexed by vertex index, contains the topology information needed for boundary deformations.
-   */
+  /* Contains the topology information needed for boundary deformations. */
   struct SculptBoundaryEditInfo *edit_info;
 
   /* Bend Deform type. */
@@ -578,6 +607,9 @@ typedef struct SculptArrayCopy {
   int symm_pass;
   float mat[4][4];
   float imat[4][4];
+  /* Transform from the shared source geometry to this copy, including the source origin of its
+   * symmetry pass. */
+  float deform_mat[4][4];
   float origin[3];
 } SculptArrayCopy;
 
@@ -612,11 +644,17 @@ typedef struct SculptArray {
   float source_imat[4][4];
   float (*orco)[3];
 
+  /* Positions of the source geometry, shared by all copies. Copy vertices index into it with
+   * source_index, so updating the array only needs the transform of each copy. */
+  float (*source_co)[3];
+  int source_totvert;
+
   int *copy_index;
   int *symmetry_pass;
+  int *source_index;
 
   float *smooth_strength;
-  struct SculptCustomLayer *scl_inst, *scl_sym;
+  struct SculptCustomLayer *scl_inst, *scl_sym, *scl_src;
 } SculptArray;
 
 typedef struct SculptFakeNeighbors {
@@ -682,6 +720,35 @@ typedef enum {
 
 #define SCULPT_SCL_GET_NAME(stdattr) ("__" #stdattr)
 
+/* Automasking settings and mesh state the persistent automasking factors depend on, see
+ * #SCULPT_automasking_cache_init. */
+typedef struct SculptAutomaskingFactorsKey {
+  int flags;
+  int face_set;
+  int propagation_steps;
+  float concave_factor;
+  int topology_generation;
+  unsigned int face_sets_hash;
+  bool valid;
+} SculptAutomaskingFactorsKey;
+
+/* Brush settings and mesh state a pose brush IK chain depends on, see
+ * #SCULPT_pose_ik_chain_init. */
+typedef struct SculptPoseIKChainKey {
+  int origin_type;
+  SculptVertRef active_vertex;
+  int face_set;
+  int tot_segments;
+  int smooth_iterations;
+  float radius;
+  float pose_offset;
+  float disconnected_distance_max;
+  bool use_fake_neighbors;
+  int topology_generation;
+  int face_sets_stamp;
+  bool valid;
+} SculptPoseIKChainKey;
+
 typedef struct SculptSession {
   /* Mesh data (not copied) can come either directly from a Mesh, or from a MultiresDM */
   struct { /* Special handling for multires meshes */
@@ -747,6 +814,7 @@ typedef struct SculptSession {
   /* BMesh for dynamic topology sculpting */
   struct BMesh *bm;
   int cd_sculpt_vert;
+  int cd_sculpt_vert_cold;
   int cd_vert_node_offset;
   int cd_face_node_offset;
   int cd_vcol_offset;
@@ -890,8 +958,25 @@ typedef struct SculptSession {
   // if vertex original data needs to be updated
   int stroke_id, boundary_symmetry;
 
+  /* Incremented when the PBVH is freed, which every change of the mesh topology goes through.
+   * Data kept between strokes stores the generation it was built for. */
+  int topology_generation;
+
+  /* Incremented when face sets are changed by an operation with an undo step, or restored by
+   * undo. */
+  int face_sets_stamp;
+
+  /* What the factors in #SCULPT_SCL_AUTOMASKING were computed with. */
+  SculptAutomaskingFactorsKey automasking_factors_key;
+
+  /* Last pose brush IK chain, reused by the cursor preview and strokes with the same key. */
+  SculptPoseIKChain *pose_ik_chain_cache;
+  SculptPoseIKChainKey pose_ik_chain_cache_key;
+
   bool fast_draw;  // hides facesets/masks and forces smooth to save GPU bandwidth
   struct MSculptVert *mdyntopo_verts;  // for non-bmesh
+  /* Rarely read sculpt vertex data (original color, curvature direction), same size. */
+  struct MSculptVertCold *mdyntopo_verts_cold;
   int mdyntopo_verts_size;
 
   /*list of up to date custom layer references,
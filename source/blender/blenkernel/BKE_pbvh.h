@@ -239,7 +239,12 @@ typedef enum {
   /* tri areas are not guaranteed to be up to date, tools should
      update all nodes on first step of brush*/
   PBVH_UpdateTriAreas = 1 << 19,
-  PBVH_UpdateOtherVerts = 1 << 20
+  PBVH_UpdateOtherVerts = 1 << 20,
+
+  /* Vertex data changed since the automasking factors kept between strokes were computed. */
+  PBVH_UpdateAutomasking = 1 << 21,
+  /* Vertex data changed since the cached pose brush IK chain was computed. */
+  PBVH_UpdatePoseIKChain = 1 << 22
 } PBVHNodeFlags;
 
 typedef struct PBVHFrustumPlanes {
@@ -530,6 +535,26 @@ bool BKE_pbvh_bmesh_update_topology_nodes(PBVH *pbvh,
                                           void *mask_cb_data,
                                           bool disable_surface_relax,
                                           bool is_snake_hook);
+
+typedef void (*DyntopoProgressCB)(float progress, void *userdata);
+
+/**
+ * Remesh the whole mesh to the current detail size, for detail flood fill.
+ *
+ * Every pass evaluates all edge lengths in parallel, then splits long edges longest first and
+ * collapses short edges shortest first from one global queue. Passes stop once a pass leaves
+ * the topology unchanged or after \a max_passes, then valence 3/4 vertices are cleaned up.
+ * Hidden edges are left alone. \a progress_cb (optional) is called with values in [0, 1].
+ *
+ * \return The number of split/collapse passes that changed the topology.
+ */
+int BKE_pbvh_bmesh_remesh_all(PBVH *pbvh,
+                              DyntopoMaskCB mask_cb,
+                              void *mask_cb_data,
+                              int max_passes,
+                              bool updatePBVH,
+                              DyntopoProgressCB progress_cb,
+                              void *progress_data);
 /* Node Access */
 
 void BKE_pbvh_check_tri_areas(PBVH *pbvh, PBVHNode *node);
@@ -692,6 +717,8 @@ typedef struct PBVHVertexIter {
 
 #define BKE_PBVH_SCULPTVERT(cd_sculpt_vert, v) \
   ((MSculptVert *)BM_ELEM_CD_GET_VOID_P(v, cd_sculpt_vert))
+#define BKE_PBVH_SCULPTVERT_COLD(cd_sculpt_vert_cold, v) \
+  ((MSculptVertCold *)BM_ELEM_CD_GET_VOID_P(v, cd_sculpt_vert_cold))
 
 void pbvh_vertex_iter_init(PBVH *pbvh, PBVHNode *node, PBVHVertexIter *vi, int mode);
 
@@ -848,6 +875,10 @@ void SCULPT_update_flat_vcol_shading(struct Object *ob, struct Scene *scene);
 
 void BKE_pbvh_curvature_update_set(PBVHNode *node, bool state);
 bool BKE_pbvh_curvature_update_get(PBVHNode *node);
+void BKE_pbvh_automasking_update_set(PBVHNode *node, bool state);
+bool BKE_pbvh_automasking_update_get(PBVHNode *node);
+void BKE_pbvh_pose_ik_chain_update_set(PBVHNode *node, bool state);
+bool BKE_pbvh_pose_ik_chain_update_get(PBVHNode *node);
 
 int BKE_pbvh_get_totnodes(PBVH *pbvh);
 
@@ -220,6 +220,16 @@ struct SubdivCCG *BKE_subdiv_to_ccg(struct Subdiv *subdiv,
                                     SubdivCCGMaskEvaluator *mask_evaluator,
                                     SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator);
 
+/* Re-evaluate the grids of the given faces only, followed by the normals and the stitching
+ * around them. The subdiv evaluator is expected to be refined from the new coarse mesh already,
+ * and the given faces should include every face whose limit surface has changed
+ * (see #BKE_subdiv_ccg_faces_from_coarse_verts). */
+void BKE_subdiv_ccg_eval_faces(SubdivCCG *subdiv_ccg,
+                               SubdivCCGMaskEvaluator *mask_evaluator,
+                               SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator,
+                               struct CCGFace **effected_faces,
+                               int num_effected_faces);
+
 /* Destroy CCG representation of subdivision surface. */
 void BKE_subdiv_ccg_destroy(SubdivCCG *subdiv_ccg);
 
@@ -250,6 +260,12 @@ void BKE_subdiv_ccg_average_stitch_faces(SubdivCCG *subdiv_ccg,
                                          struct CCGFace **effected_faces,
                                          int num_effected_faces);
 
+/* Collect faces whose limit surface depends on any of the given coarse vertices.
+ * Returns NULL when there are none, otherwise the array is to be freed by the caller. */
+struct CCGFace **BKE_subdiv_ccg_faces_from_coarse_verts(SubdivCCG *subdiv_ccg,
+                                                        const BLI_bitmap *coarse_verts,
+                                                        int *r_num_faces);
+
 /* Get geometry counters at the current subdivision level. */
 void BKE_subdiv_ccg_topology_counters(const SubdivCCG *subdiv_ccg,
                                       int *r_num_vertices,
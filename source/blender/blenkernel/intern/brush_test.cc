@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#include "testing/testing.h"
+
+#include <cstring>
+
+#include "BKE_brush.h"
+#include "BKE_colortools.h"
+
+#include "DNA_brush_enums.h"
+#include "DNA_color_types.h"
+
+#include "BLI_rand.hh"
+#include "BLI_vector.hh"
+
+namespace blender::bke::tests {
+
+static const int curve_presets[] = {BRUSH_CURVE_CUSTOM,
+                                    BRUSH_CURVE_SMOOTH,
+                                    BRUSH_CURVE_SPHERE,
+                                    BRUSH_CURVE_ROOT,
+                                    BRUSH_CURVE_SHARP,
+                                    BRUSH_CURVE_LIN,
+                                    BRUSH_CURVE_POW4,
+                                    BRUSH_CURVE_INVSQUARE,
+                                    BRUSH_CURVE_CONSTANT,
+                                    BRUSH_CURVE_SMOOTHER};
+
+/* Distances inside, on and outside of the brush radius, with a count that leaves a tail for
+ * the scalar fallback. */
+static Vector<float> test_distances(const float len)
+{
+  RandomNumberGenerator rng(42);
+  Vector<float> dist = {0.0f, len, len * 2.0f, len * (1.0f - FLT_EPSILON), 1e-20f};
+
+  for (int i = 0; i < 1000; i++) {
+    dist.append(rng.get_float() * len * 1.2f);
+  }
+
+  return dist;
+}
+
+/* Exact as long as the compiler doesn't contract the scalar multiply-adds into FMA instructions,
+ * which it can't for the default x86-64 and SSE2 targets. */
+TEST(brush, curve_strength_array_bit_identical)
+{
+  CurveMapping *curve = BKE_curvemapping_add(1, 0.0f, 0.0f, 1.0f, 1.0f);
+  BKE_curvemapping_init(curve);
+
+  for (const float len : {1.0f, 0.37f, 250.0f}) {
+    const Vector<float> dist = test_distances(len);
+    Vector<float> strength(dist.size());
+
+    for (const int preset : curve_presets) {
+      BKE_brush_curve_strength_array(
+          preset, curve, dist.data(), len, int(dist.size()), strength.data());
+
+      for (const int i : dist.index_range()) {
+        const float expected = BKE_brush_curve_strength_ex(preset, curve, dist[i], len);
+        EXPECT_EQ(memcmp(&strength[i], &expected, sizeof(float)), 0)
+            << "preset " << preset << ", distance " << dist[i] << ", radius " << len;
+      }
+    }
+  }
+
+  BKE_curvemapping_free(curve);
+}
+
+TEST(brush, curve_strength_array_in_place)
+{
+  const float len = 2.0f;
+  const Vector<float> dist = test_distances(len);
+  Vector<float> strength = dist;
+
+  BKE_brush_curve_strength_array(
+      BRUSH_CURVE_SMOOTH, nullptr, strength.data(), len, int(strength.size()), strength.data());
+
+  for (const int i : dist.index_range()) {
+    EXPECT_EQ(strength[i], BKE_brush_curve_strength_ex(BRUSH_CURVE_SMOOTH, nullptr, dist[i], len));
+  }
+}
+
+}  // namespace blender::bke::tests
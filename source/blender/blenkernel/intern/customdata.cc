@@ -1489,7 +1489,7 @@ static void layerDynTopoVert_copy(const void *source, void *dest, int count)
 static void layerDynTopoVert_interp(
     const void **sources, const float *weights, const float *sub_weights, int count, void *dest)
 {
-  float co[3], no[3], origmask, color[4], curv;
+  float co[3], no[3], origmask, curv;
   MSculptVert *mv = (MSculptVert *)dest;
 
   // float totweight = 0.0f;
@@ -1503,7 +1503,6 @@ static void layerDynTopoVert_interp(
   zero_v3(no);
   origmask = 0.0f;
   curv = 0.0f;
-  zero_v4(color);
 
   for (int i = 0; i < count; i++) {
     MSculptVert *mv2 = (MSculptVert *)sources[i];
@@ -1518,7 +1517,6 @@ static void layerDynTopoVert_interp(
 
     madd_v3_v3fl(co, mv2->origco, w);
     madd_v3_v3fl(no, mv2->origno, w);
-    madd_v4_v4fl(color, mv2->origcolor, w);
     origmask += (float)mv2->origmask * w;
     curv += (float)mv2->curv * w;
 
@@ -1535,18 +1533,49 @@ static void layerDynTopoVert_interp(
 
   mul_v3_fl(co, mul);
 
-  mul_v4_fl(color, mul);
   origmask *= mul;
 #endif
 
   copy_v3_v3(mv->origco, co);
   copy_v3_v3(mv->origno, no);
-  copy_v4_v4(mv->origcolor, color);
 
   mv->curv = (short)curv;
   mv->origmask = (short)origmask;
 }
 
+static void layerDynTopoVertCold_copy(const void *source, void *dest, int count)
+{
+  memcpy(dest, source, count * sizeof(MSculptVertCold));
+}
+
+static void layerDynTopoVertCold_interp(const void **sources,
+                                        const float *weights,
+                                        const float *UNUSED(sub_weights),
+                                        int count,
+                                        void *dest)
+{
+  MSculptVertCold *mv = (MSculptVertCold *)dest;
+  float color[4], dir[3];
+
+  if (count == 0) {
+    memset(mv, 0, sizeof(*mv));
+    return;
+  }
+
+  zero_v4(color);
+  zero_v3(dir);
+
+  for (int i = 0; i < count; i++) {
+    const MSculptVertCold *mv2 = (const MSculptVertCold *)sources[i];
+
+    madd_v4_v4fl(color, mv2->origcolor, weights[i]);
+    madd_v3_v3fl(dir, mv2->curvature_dir, weights[i]);
+  }
+
+  copy_v4_v4(mv->origcolor, color);
+  normalize_v3_v3(mv->curvature_dir, dir);
+}
+
 static void layerInterp_noop(const void **UNUSED(sources),
                              const float *UNUSED(weights),
                              const float *UNUSED(sub_weights),
@@ -1990,6 +2019,14 @@ static const LayerTypeInfo LAYERTYPEINFO[CD_NUMTYPES] = {
      NULL,
      NULL,
      layerInterp_noop},
+    /* 55 CD_DYNTOPO_VERT_COLD */
+    {sizeof(MSculptVertCold),
+     "MSculptVertCold",
+     1,
+     NULL,  // flag singleton layer
+     layerDynTopoVertCold_copy,
+     NULL,
+     layerDynTopoVertCold_interp},
 };
 
 static const char *LAYERTYPENAMES[CD_NUMTYPES] = {
@@ -2062,7 +2099,9 @@ static const char *LAYERTYPENAMES[CD_NUMTYPES] = {
     "CDHairLength",
     "CDMeshID",
     "CDDyntopoVert",
-    "CDPropInt16"
+    "CDPropInt16",
+    /* 55 */
+    "CDDyntopoVertCold",
 };
 
 const CustomData_MeshMasks CD_MASK_BAREMESH = {
@@ -2109,7 +2148,8 @@ const CustomData_MeshMasks CD_MASK_DERIVEDMESH = {
 const CustomData_MeshMasks CD_MASK_BMESH = {
     /* vmask */ (CD_MASK_MDEFORMVERT | CD_MASK_BWEIGHT | CD_MASK_MVERT_SKIN | CD_MASK_SHAPEKEY |
                  CD_MASK_SHAPE_KEYINDEX | CD_MASK_PAINT_MASK | CD_MASK_PROP_ALL |
-                 CD_MASK_PROP_COLOR | CD_MASK_CREASE | CD_MASK_MESH_ID | CD_MASK_DYNTOPO_VERT),
+                 CD_MASK_PROP_COLOR | CD_MASK_CREASE | CD_MASK_MESH_ID | CD_MASK_DYNTOPO_VERT |
+                 CD_MASK_DYNTOPO_VERT_COLD),
     /* emask */
     (CD_MASK_BWEIGHT | CD_MASK_CREASE | CD_MASK_FREESTYLE_EDGE | CD_MASK_PROP_ALL |
      CD_MASK_MESH_ID),
@@ -4555,6 +4555,9 @@ ATTR_NO_OPT bool BKE_pbvh_bmesh_update_topology(PBVH *pbvh,
   SmallHash subd_edges;
   BLI_smallhash_init(&subd_edges);
 
+  /* Splits and collapses run on a single thread. BMesh element and CustomData pools, BMLog and
+   * the element ID map aren't thread safe, and the order edges leave the queue decides the
+   * resulting topology. */
   while (totop > 0 && !BLI_mm_heap_is_empty(eq_ctx.heap_mm) && i < max_steps) {
     BMEdge *e = NULL;
 
@@ -4723,6 +4726,328 @@ ATTR_NO_OPT bool BKE_pbvh_bmesh_update_topology(PBVH *pbvh,
   return modified;
 }
 
+/*************************** Whole mesh remesh **************************/
+
+/* Edges per length evaluation task. */
+#define REMESH_ALL_CHUNK_SIZE 4096
+/* Edges handed to #pbvh_split_edges at once. */
+#define REMESH_ALL_SPLIT_BATCH 2048
+
+typedef struct RemeshAllData {
+  EdgeQueueContext *eq_ctx;
+  BMesh *bm;
+  float limit_len_sqr;
+  bool is_subdivide;
+
+  /* Candidates of chunk n start at n * REMESH_ALL_CHUNK_SIZE. */
+  BMEdge **edges;
+  float *lengths;
+  int *chunk_len;
+} RemeshAllData;
+
+static void remesh_all_edge_lengths_task_cb(void *__restrict userdata,
+                                            const int n,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  RemeshAllData *data = (RemeshAllData *)userdata;
+  BMesh *bm = data->bm;
+  const int start = n * REMESH_ALL_CHUNK_SIZE;
+  const int end = min_ii(start + REMESH_ALL_CHUNK_SIZE, bm->totedge);
+  const float sign = data->is_subdivide ? -1.0f : 1.0f;
+  int totedge = 0;
+
+  for (int i = start; i < end; i++) {
+    BMEdge *e = bm->etable[i];
+
+    if (BM_elem_flag_test(e, BM_ELEM_HIDDEN)) {
+      continue;
+    }
+
+    const float len = calc_weighted_length(data->eq_ctx, e->v1, e->v2, sign);
+
+    if (data->is_subdivide ? len > data->limit_len_sqr : len < data->limit_len_sqr) {
+      data->edges[start + totedge] = e;
+      data->lengths[start + totedge] = len;
+      totedge++;
+    }
+  }
+
+  data->chunk_len[n] = totedge;
+}
+
+/* Fill eq_ctx->heap_mm with every edge that is too long (or too short) for the detail size.
+ * Returns true if non-manifold fins were removed on the way. */
+static bool remesh_all_queue_create(EdgeQueueContext *eq_ctx, PBVH *pbvh, bool is_subdivide)
+{
+  BMesh *bm = pbvh->bm;
+  const float limit = is_subdivide ? pbvh->bm_max_edge_len : pbvh->bm_min_edge_len;
+  bool removed_fins = false;
+
+  BLI_mm_heap_clear(eq_ctx->heap_mm, NULL);
+
+  /* Topology edits don't always tag the table dirty. */
+  bm->elem_table_dirty |= BM_EDGE;
+  BM_mesh_elem_table_ensure(bm, BM_EDGE);
+
+  if (bm->totedge == 0) {
+    return false;
+  }
+
+  const int totchunk = (bm->totedge + REMESH_ALL_CHUNK_SIZE - 1) / REMESH_ALL_CHUNK_SIZE;
+
+  RemeshAllData data = {
+      .eq_ctx = eq_ctx,
+      .bm = bm,
+      .limit_len_sqr = limit * limit,
+      .is_subdivide = is_subdivide,
+      .edges = MEM_malloc_arrayN(bm->totedge, sizeof(BMEdge *), __func__),
+      .lengths = MEM_malloc_arrayN(bm->totedge, sizeof(float), __func__),
+      .chunk_len = MEM_malloc_arrayN(totchunk, sizeof(int), __func__),
+  };
+
+  TaskParallelSettings settings;
+
+  BLI_parallel_range_settings_defaults(&settings);
+#ifdef DYNTOPO_NO_THREADING
+  settings.use_threading = false;
+#endif
+
+  BLI_task_parallel_range(0, totchunk, &data, remesh_all_edge_lengths_task_cb, &settings);
+
+  /* Removing fins may free other candidates, so queue only once all of them are checked. */
+  for (int n = 0; n < totchunk; n++) {
+    BMEdge **edges = data.edges + n * REMESH_ALL_CHUNK_SIZE;
+
+    for (int i = 0; i < data.chunk_len[n]; i++) {
+      BMEdge *e = edges[i];
+
+      if (!bm_elem_is_free((BMElem *)e, BM_EDGE) && e->l &&
+          e->l != e->l->radial_next->radial_next) {
+        removed_fins |= destroy_nonmanifold_fins(pbvh, e);
+      }
+    }
+  }
+
+  for (int n = 0; n < totchunk; n++) {
+    const int start = n * REMESH_ALL_CHUNK_SIZE;
+
+    for (int i = start; i < start + data.chunk_len[n]; i++) {
+      BMEdge *e = data.edges[i];
+
+      if (!bm_elem_is_free((BMElem *)e, BM_EDGE)) {
+        BLI_mm_heap_insert(eq_ctx->heap_mm, data.lengths[i], e);
+      }
+    }
+  }
+
+  MEM_freeN(data.edges);
+  MEM_freeN(data.lengths);
+  MEM_freeN(data.chunk_len);
+
+  return removed_fins;
+}
+
+/* Split queued edges longest first. Returns the number of edges split. */
+static int remesh_all_subdivide(EdgeQueueContext *eq_ctx, PBVH *pbvh)
+{
+  const float limit_len_sqr = pbvh->bm_max_edge_len * pbvh->bm_max_edge_len;
+  const int cd_sculpt_vert = pbvh->cd_sculpt_vert;
+  BMEdge **edges = MEM_malloc_arrayN(REMESH_ALL_SPLIT_BATCH, sizeof(BMEdge *), __func__);
+  int etot = 0;
+  int totsplit = 0;
+
+  while (!BLI_mm_heap_is_empty(eq_ctx->heap_mm)) {
+    BMEdge *e = BLI_mm_heap_pop_max(eq_ctx->heap_mm);
+
+    /* Earlier batches may have freed or shortened it. */
+    if (bm_elem_is_free((BMElem *)e, BM_EDGE) ||
+        calc_weighted_length(eq_ctx, e->v1, e->v2, -1.0f) <= limit_len_sqr) {
+      continue;
+    }
+
+    for (int i = 0; i < 2; i++) {
+      BMVert *v = i ? e->v2 : e->v1;
+      MSculptVert *mv = BKE_PBVH_SCULPTVERT(cd_sculpt_vert, v);
+
+      if (mv->flag & SCULPTVERT_NEED_VALENCE) {
+        BKE_pbvh_bmesh_update_valence(cd_sculpt_vert, (SculptVertRef){.i = (intptr_t)v});
+      }
+    }
+
+    edges[etot++] = e;
+
+    if (etot == REMESH_ALL_SPLIT_BATCH) {
+      pbvh_split_edges(eq_ctx, pbvh, pbvh->bm, edges, etot, false);
+      VALIDATE_LOG(pbvh->bm_log);
+
+      totsplit += etot;
+      etot = 0;
+    }
+  }
+
+  if (etot > 0) {
+    pbvh_split_edges(eq_ctx, pbvh, pbvh->bm, edges, etot, false);
+    VALIDATE_LOG(pbvh->bm_log);
+
+    totsplit += etot;
+  }
+
+  MEM_freeN(edges);
+
+  return totsplit;
+}
+
+/* Collapse queued edges shortest first. Returns the number of edges collapsed. */
+static int remesh_all_collapse(EdgeQueueContext *eq_ctx, PBVH *pbvh)
+{
+  const float limit_len_sqr = pbvh->bm_min_edge_len * pbvh->bm_min_edge_len;
+  int totcollapse = 0;
+
+  while (!BLI_mm_heap_is_empty(eq_ctx->heap_mm) && !pbvh->dyntopo_stop) {
+    BMEdge *e = BLI_mm_heap_pop_min(eq_ctx->heap_mm);
+
+    if (bm_elem_is_free((BMElem *)e, BM_EDGE) ||
+        calc_weighted_length(eq_ctx, e->v1, e->v2, 1.0f) >= limit_len_sqr) {
+      continue;
+    }
+
+    if (pbvh_bmesh_collapse_edge(pbvh, e, e->v1, e->v2, NULL, NULL, eq_ctx)) {
+      VALIDATE_LOG(pbvh->bm_log);
+      totcollapse++;
+    }
+  }
+
+  return totcollapse;
+}
+
+int BKE_pbvh_bmesh_remesh_all(PBVH *pbvh,
+                              DyntopoMaskCB mask_cb,
+                              void *mask_cb_data,
+                              int max_passes,
+                              bool updatePBVH,
+                              DyntopoProgressCB progress_cb,
+                              void *progress_data)
+{
+  /* Everything is in range of the cleanup pass, same as #BKE_dyntopo_remesh. */
+  const float center[3] = {0.0f, 0.0f, 0.0f};
+  const float view_normal[3] = {0.0f, 0.0f, 1.0f};
+  const float radius = 1e17f;
+
+  /* Push a subentry. */
+  BM_log_entry_add_ex(pbvh->bm, pbvh->bm_log, true);
+
+  for (int i = 0; i < pbvh->totnode; i++) {
+    PBVHNode *node = pbvh->nodes + i;
+
+    if ((node->flag & PBVH_Leaf) && !(node->flag & PBVH_FullyHidden)) {
+      node->flag |= PBVH_UpdateTopology;
+    }
+  }
+
+  EdgeQueueContext eq_ctx = {.pool = NULL,
+                             .bm = pbvh->bm,
+                             .mask_cb = mask_cb ? mask_cb : mask_cb_nop,
+                             .mask_cb_data = mask_cb_data,
+
+                             .cd_sculpt_vert = pbvh->cd_sculpt_vert,
+                             .cd_vert_mask_offset = CustomData_get_offset(&pbvh->bm->vdata,
+                                                                          CD_PAINT_MASK),
+                             .cd_vert_node_offset = pbvh->cd_vert_node_offset,
+                             .cd_face_node_offset = pbvh->cd_face_node_offset,
+                             .avg_elen = 0.0f,
+                             .max_elen = -1e17,
+                             .min_elen = 1e17,
+                             .totedge = 0.0f,
+                             .local_mode = false,
+                             .surface_smooth_fac = 0.0f,
+                             .mode = PBVH_Subdivide | PBVH_Collapse | PBVH_Cleanup};
+
+  eq_ctx.heap_mm = BLI_mm_heap_new_ex(DYNTOPO_MAX_ITER);
+  eq_ctx.used_verts = BLI_table_gset_new(__func__);
+  eq_ctx.max_heap_mm = DYNTOPO_MAX_ITER << 8;
+  eq_ctx.limit_min = pbvh->bm_min_edge_len;
+  eq_ctx.limit_max = pbvh->bm_max_edge_len;
+  eq_ctx.limit_mid = eq_ctx.limit_max * 0.5f + eq_ctx.limit_min * 0.5f;
+
+  edge_queue_init(&eq_ctx, false, false, center, view_normal, radius);
+
+  /* Two phases per pass and the cleanup at the end. */
+  const float progress_step = 1.0f / (float)(max_passes * 2 + 1);
+  float progress = 0.0f;
+  bool modified = false;
+  int totpass = 0;
+
+  for (int pass = 0; pass < max_passes && !pbvh->dyntopo_stop; pass++) {
+    if (remesh_all_queue_create(&eq_ctx, pbvh, true)) {
+      BM_log_entry_add_ex(pbvh->bm, pbvh->bm_log, true);
+      modified = true;
+    }
+    const int totsplit = remesh_all_subdivide(&eq_ctx, pbvh);
+
+    progress += progress_step;
+    if (progress_cb) {
+      progress_cb(progress, progress_data);
+    }
+
+    if (remesh_all_queue_create(&eq_ctx, pbvh, false)) {
+      BM_log_entry_add_ex(pbvh->bm, pbvh->bm_log, true);
+      modified = true;
+    }
+    const int totcollapse = remesh_all_collapse(&eq_ctx, pbvh);
+
+    progress += progress_step;
+    if (progress_cb) {
+      progress_cb(progress, progress_data);
+    }
+
+    if (totsplit == 0 && totcollapse == 0) {
+      break;
+    }
+
+    modified = true;
+    totpass++;
+  }
+
+  /* Only the cleanup's own vertices, not every vertex created by splits. */
+  BLI_table_gset_free(eq_ctx.used_verts, NULL);
+  eq_ctx.used_verts = BLI_table_gset_new(__func__);
+
+  modified |= do_cleanup_3_4(&eq_ctx, pbvh, center, view_normal, radius, false, false);
+  VALIDATE_LOG(pbvh->bm_log);
+
+  if (progress_cb) {
+    progress_cb(1.0f, progress_data);
+  }
+
+  if (modified && updatePBVH) {
+    const int totnode = pbvh->totnode;
+
+    for (int i = 0; i < totnode; i++) {
+      PBVHNode *node = pbvh->nodes + i;
+
+      if ((node->flag & PBVH_Leaf) && (node->flag & PBVH_UpdateTopology)) {
+        pbvh_bmesh_node_limit_ensure(pbvh, i);
+      }
+    }
+  }
+
+  for (int i = 0; i < pbvh->totnode; i++) {
+    PBVHNode *node = pbvh->nodes + i;
+
+    if (node->flag & PBVH_Leaf) {
+      node->flag &= ~PBVH_UpdateTopology;
+    }
+  }
+
+  BLI_mm_heap_free(eq_ctx.heap_mm, NULL);
+  BLI_table_gset_free(eq_ctx.used_verts, NULL);
+
+  /* Push a subentry. */
+  BM_log_entry_add_ex(pbvh->bm, pbvh->bm_log, true);
+
+  return totpass;
+}
+
 #define SPLIT_TAG BM_ELEM_TAG_ALT
 
 /*
@@ -5441,6 +5766,7 @@ DynTopoState *BKE_dyntopo_init(BMesh *bm, PBVH *existing_pbvh)
   BMCustomLayerReq vlayers[] = {
       {CD_PAINT_MASK, NULL, 0},
       {CD_DYNTOPO_VERT, NULL, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY},
+      {CD_DYNTOPO_VERT_COLD, NULL, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY},
       {CD_PROP_INT32, dyntopop_node_idx_layer_id, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY}};
 
   BMCustomLayerReq flayers[] = {
@@ -5448,7 +5774,7 @@ DynTopoState *BKE_dyntopo_init(BMesh *bm, PBVH *existing_pbvh)
       {CD_SCULPT_FACE_SETS, NULL, 0},
       {CD_PROP_INT32, dyntopop_node_idx_layer_id, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY}};
 
-  BM_data_layers_ensure(bm, &bm->vdata, vlayers, 3);
+  BM_data_layers_ensure(bm, &bm->vdata, vlayers, ARRAY_SIZE(vlayers));
   BM_data_layers_ensure(bm, &bm->pdata, flayers, 3);
 
   int CustomData_get_named_offset(const CustomData *data, int type, const char *name);
@@ -5465,6 +5791,7 @@ DynTopoState *BKE_dyntopo_init(BMesh *bm, PBVH *existing_pbvh)
       &bm->pdata, CD_PROP_FLOAT2, dyntopop_faces_areas_layer_id);
 
   pbvh->cd_sculpt_vert = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT);
+  pbvh->cd_sculpt_vert_cold = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT_COLD);
   pbvh->cd_vert_mask_offset = CustomData_get_offset(&bm->vdata, CD_PAINT_MASK);
   pbvh->cd_faceset_offset = CustomData_get_offset(&bm->pdata, CD_SCULPT_FACE_SETS);
   pbvh->cd_vcol_offset = -1;
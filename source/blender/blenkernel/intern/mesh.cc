@@ -1041,6 +1041,7 @@ void BKE_mesh_copy_parameters(Mesh *me_dst, const Mesh *me_src)
   me_dst->smoothresh = me_src->smoothresh;
   me_dst->remesh_voxel_size = me_src->remesh_voxel_size;
   me_dst->remesh_voxel_adaptivity = me_src->remesh_voxel_adaptivity;
+  me_dst->remesh_voxel_detail = me_src->remesh_voxel_detail;
   me_dst->remesh_mode = me_src->remesh_mode;
   me_dst->symmetry = me_src->symmetry;
 
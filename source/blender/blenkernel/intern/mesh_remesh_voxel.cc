@@ -14,6 +14,7 @@
 #include <functional>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "MEM_guardedalloc.h"
@@ -23,7 +24,9 @@
 #include "BLI_math_vec_types.hh"
 #include "BLI_math_vector.h"
 #include "BLI_span.hh"
+#include "BLI_task.hh"
 #include "BLI_threads.h"
+#include "BLI_vector.hh"
 
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -558,47 +561,147 @@ static openvdb::FloatGrid::Ptr remesh_voxel_level_set_create(const Mesh *mesh,
   return grid;
 }
 
+/* Bending of the surface per voxel, in radians, above which the curvature detail mode keeps the
+ * full voxel resolution. */
+#define REMESH_VOXEL_DETAIL_ANGLE 0.2f
+
+/**
+ * Amount of detail to keep around each vertex of the input mesh, in [0, 1].
+ * Curvature is estimated from the normal deviation along the edges relative to the voxel size.
+ */
+static Array<float> remesh_voxel_detail_factors(const Mesh *mesh,
+                                                const float voxel_size,
+                                                const int detail_mode)
+{
+  Array<float> detail(mesh->totvert, 0.0f);
+
+  if (detail_mode == REMESH_VOXEL_DETAIL_MASK) {
+    const float *mask = (const float *)CustomData_get_layer(&mesh->vdata, CD_PAINT_MASK);
+    if (mask) {
+      for (const int i : IndexRange(mesh->totvert)) {
+        detail[i] = mask[i];
+      }
+    }
+    return detail;
+  }
+
+  const float(*vert_normals)[3] = BKE_mesh_vertex_normals_ensure(mesh);
+  for (const MEdge &edge : Span<MEdge>(mesh->medge, mesh->totedge)) {
+    const float len = len_v3v3(mesh->mvert[edge.v1].co, mesh->mvert[edge.v2].co);
+    if (len <= FLT_EPSILON) {
+      continue;
+    }
+    const float angle = angle_normalized_v3v3(vert_normals[edge.v1], vert_normals[edge.v2]);
+    const float factor = min_ff(angle * voxel_size / (len * REMESH_VOXEL_DETAIL_ANGLE), 1.0f);
+    detail[edge.v1] = max_ff(detail[edge.v1], factor);
+    detail[edge.v2] = max_ff(detail[edge.v2], factor);
+  }
+  return detail;
+}
+
+/**
+ * Per voxel scale of the mesher adaptivity. The background keeps the full adaptivity, voxels
+ * around detailed vertices of the input mesh lower it so they keep the level set resolution.
+ */
+static openvdb::FloatGrid::Ptr remesh_voxel_adaptivity_grid_create(
+    const Mesh *mesh,
+    const openvdb::FloatGrid::Ptr level_set_grid,
+    const float voxel_size,
+    const int detail_mode)
+{
+  const Array<float> detail = remesh_voxel_detail_factors(mesh, voxel_size, detail_mode);
+
+  openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create(1.0f);
+  grid->setTransform(level_set_grid->transform().copy());
+  openvdb::FloatGrid::Accessor accessor = grid->getAccessor();
+  const openvdb::math::Transform &transform = grid->transform();
+
+  for (const int i : IndexRange(mesh->totvert)) {
+    if (detail[i] <= 0.0f) {
+      continue;
+    }
+    const float3 co = mesh->mvert[i].co;
+    const openvdb::Coord center = transform.worldToIndexCellCentered(
+        openvdb::Vec3d(co.x, co.y, co.z));
+    const float scale = 1.0f - detail[i];
+
+    /* Cover the neighbor cells as well, the iso-surface may cross any of them. */
+    for (int x = -1; x <= 1; x++) {
+      for (int y = -1; y <= 1; y++) {
+        for (int z = -1; z <= 1; z++) {
+          const openvdb::Coord ijk = center.offsetBy(x, y, z);
+          if (scale < accessor.getValue(ijk)) {
+            accessor.setValue(ijk, scale);
+          }
+        }
+      }
+    }
+  }
+
+  return grid;
+}
+
 static Mesh *remesh_voxel_volume_to_mesh(const openvdb::FloatGrid::Ptr level_set_grid,
+                                         const openvdb::FloatGrid::Ptr adaptivity_grid,
                                          const float isovalue,
                                          const float adaptivity,
                                          const bool relax_disoriented_triangles)
 {
-  std::vector<openvdb::Vec3s> vertices;
-  std::vector<openvdb::Vec4I> quads;
-  std::vector<openvdb::Vec3I> tris;
-  openvdb::tools::volumeToMesh<openvdb::FloatGrid>(
-      *level_set_grid, vertices, tris, quads, isovalue, adaptivity, relax_disoriented_triangles);
+  openvdb::tools::VolumeToMesh mesher(isovalue, adaptivity, relax_disoriented_triangles);
+  if (adaptivity_grid) {
+    mesher.setSpatialAdaptivity(adaptivity_grid);
+  }
+  mesher(*level_set_grid);
+
+  const openvdb::tools::PolygonPoolList &polygon_pools = mesher.polygonPoolList();
+  int totquad = 0;
+  int tottri = 0;
+  for (const int i : IndexRange(mesher.polygonPoolListSize())) {
+    totquad += polygon_pools[i].numQuads();
+    tottri += polygon_pools[i].numTriangles();
+  }
 
   Mesh *mesh = BKE_mesh_new_nomain(
-      vertices.size(), 0, 0, quads.size() * 4 + tris.size() * 3, quads.size() + tris.size());
+      mesher.pointListSize(), 0, 0, totquad * 4 + tottri * 3, totquad + tottri);
   MutableSpan<MVert> mverts{mesh->mvert, mesh->totvert};
   MutableSpan<MLoop> mloops{mesh->mloop, mesh->totloop};
   MutableSpan<MPoly> mpolys{mesh->mpoly, mesh->totpoly};
 
+  const openvdb::tools::PointList &vertices = mesher.pointList();
   for (const int i : mverts.index_range()) {
     copy_v3_v3(mverts[i].co, float3(vertices[i].x(), vertices[i].y(), vertices[i].z()));
   }
 
-  for (const int i : IndexRange(quads.size())) {
-    MPoly &poly = mpolys[i];
-    const int loopstart = i * 4;
-    poly.loopstart = loopstart;
-    poly.totloop = 4;
-    mloops[loopstart].v = quads[i][0];
-    mloops[loopstart + 1].v = quads[i][3];
-    mloops[loopstart + 2].v = quads[i][2];
-    mloops[loopstart + 3].v = quads[i][1];
+  /* Quads first, then triangles, the same layout #openvdb::tools::volumeToMesh gives. */
+  int poly_index = 0;
+  int loopstart = 0;
+  for (const int i : IndexRange(mesher.polygonPoolListSize())) {
+    const openvdb::tools::PolygonPool &pool = polygon_pools[i];
+    for (const int j : IndexRange(pool.numQuads())) {
+      const openvdb::Vec4I &quad = pool.quad(j);
+      MPoly &poly = mpolys[poly_index++];
+      poly.loopstart = loopstart;
+      poly.totloop = 4;
+      mloops[loopstart].v = quad[0];
+      mloops[loopstart + 1].v = quad[3];
+      mloops[loopstart + 2].v = quad[2];
+      mloops[loopstart + 3].v = quad[1];
+      loopstart += 4;
+    }
   }
 
-  const int triangle_loop_start = quads.size() * 4;
-  for (const int i : IndexRange(tris.size())) {
-    MPoly &poly = mpolys[quads.size() + i];
-    const int loopstart = triangle_loop_start + i * 3;
-    poly.loopstart = loopstart;
-    poly.totloop = 3;
-    mloops[loopstart].v = tris[i][2];
-    mloops[loopstart + 1].v = tris[i][1];
-    mloops[loopstart + 2].v = tris[i][0];
+  for (const int i : IndexRange(mesher.polygonPoolListSize())) {
+    const openvdb::tools::PolygonPool &pool = polygon_pools[i];
+    for (const int j : IndexRange(pool.numTriangles())) {
+      const openvdb::Vec3I &tri = pool.triangle(j);
+      MPoly &poly = mpolys[poly_index++];
+      poly.loopstart = loopstart;
+      poly.totloop = 3;
+      mloops[loopstart].v = tri[2];
+      mloops[loopstart + 1].v = tri[1];
+      mloops[loopstart + 2].v = tri[0];
+      loopstart += 3;
+    }
   }
 
   BKE_mesh_calc_edges(mesh, false, false);
@@ -608,55 +711,166 @@ static Mesh *remesh_voxel_volume_to_mesh(const openvdb::FloatGrid::Ptr level_set
 }
 #endif
 
-Mesh *BKE_mesh_remesh_voxel(const Mesh *mesh,
-                            const float voxel_size,
-                            const float adaptivity,
-                            const float isovalue)
+Mesh *BKE_mesh_remesh_voxel_adaptive(const Mesh *mesh,
+                                     const float voxel_size,
+                                     const float adaptivity,
+                                     const float isovalue,
+                                     const int detail_mode)
 {
 #ifdef WITH_OPENVDB
   openvdb::FloatGrid::Ptr level_set = remesh_voxel_level_set_create(mesh, voxel_size);
-  return remesh_voxel_volume_to_mesh(level_set, isovalue, adaptivity, false);
+  openvdb::FloatGrid::Ptr adaptivity_grid;
+  if (adaptivity > 0.0f && detail_mode != REMESH_VOXEL_DETAIL_UNIFORM) {
+    adaptivity_grid = remesh_voxel_adaptivity_grid_create(
+        mesh, level_set, voxel_size, detail_mode);
+  }
+  return remesh_voxel_volume_to_mesh(level_set, adaptivity_grid, isovalue, adaptivity, false);
 #else
-  UNUSED_VARS(mesh, voxel_size, adaptivity, isovalue);
+  UNUSED_VARS(mesh, voxel_size, adaptivity, isovalue, detail_mode);
   return nullptr;
 #endif
 }
 
-void BKE_mesh_remesh_reproject_paint_mask(Mesh *target, Mesh *source)
+Mesh *BKE_mesh_remesh_voxel(const Mesh *mesh,
+                            const float voxel_size,
+                            const float adaptivity,
+                            const float isovalue)
 {
-  BVHTreeFromMesh bvhtree = {nullptr};
-  BKE_bvhtree_from_mesh_get(&bvhtree, source, BVHTREE_FROM_VERTS, 2);
-  MVert *target_verts = (MVert *)CustomData_get_layer(&target->vdata, CD_MVERT);
+  return BKE_mesh_remesh_voxel_adaptive(
+      mesh, voxel_size, adaptivity, isovalue, REMESH_VOXEL_DETAIL_UNIFORM);
+}
 
-  float *target_mask;
-  if (CustomData_has_layer(&target->vdata, CD_PAINT_MASK)) {
-    target_mask = (float *)CustomData_get_layer(&target->vdata, CD_PAINT_MASK);
+/* Index of the corner of the nearest source triangle that is closest to `co`. */
+static int remesh_reproject_nearest_vert(const Mesh *source,
+                                         const MLoopTri *looptri,
+                                         const BVHTreeFromMesh *bvhtree,
+                                         const float co[3])
+{
+  BVHTreeNearest nearest;
+  nearest.index = -1;
+  nearest.dist_sq = FLT_MAX;
+  BLI_bvhtree_find_nearest(
+      bvhtree->tree, co, &nearest, bvhtree->nearest_callback, (void *)bvhtree);
+  if (nearest.index == -1) {
+    return -1;
   }
-  else {
-    target_mask = (float *)CustomData_add_layer(
-        &target->vdata, CD_PAINT_MASK, CD_CALLOC, nullptr, target->totvert);
+
+  const MLoopTri &lt = looptri[nearest.index];
+  int r_vert = -1;
+  float dist_sq_min = FLT_MAX;
+  for (int i = 0; i < 3; i++) {
+    const int vert = source->mloop[lt.tri[i]].v;
+    const float dist_sq = len_squared_v3v3(co, source->mvert[vert].co);
+    if (dist_sq < dist_sq_min) {
+      dist_sq_min = dist_sq;
+      r_vert = vert;
+    }
   }
+  return r_vert;
+}
 
-  float *source_mask;
-  if (CustomData_has_layer(&source->vdata, CD_PAINT_MASK)) {
-    source_mask = (float *)CustomData_get_layer(&source->vdata, CD_PAINT_MASK);
+void BKE_mesh_remesh_reproject_attributes(Mesh *target, Mesh *source, const int flag)
+{
+  using namespace blender;
+
+  const bool use_mask = flag & ME_REMESH_REPROJECT_PAINT_MASK;
+  const bool use_colors = flag & ME_REMESH_REPROJECT_VERTEX_COLORS;
+  const bool use_face_sets = flag & ME_REMESH_REPROJECT_SCULPT_FACE_SETS;
+  const bool use_materials = flag & ME_REMESH_REPROJECT_MATERIALS;
+
+  if (!(use_mask || use_colors || use_face_sets || use_materials)) {
+    return;
   }
-  else {
-    source_mask = (float *)CustomData_add_layer(
-        &source->vdata, CD_PAINT_MASK, CD_CALLOC, nullptr, source->totvert);
+
+  /* Vertex attributes. */
+  float *target_mask = nullptr;
+  const float *source_mask = nullptr;
+  if (use_mask) {
+    target_mask = (float *)CustomData_get_layer(&target->vdata, CD_PAINT_MASK);
+    if (!target_mask) {
+      target_mask = (float *)CustomData_add_layer(
+          &target->vdata, CD_PAINT_MASK, CD_CALLOC, nullptr, target->totvert);
+    }
+    source_mask = (const float *)CustomData_get_layer(&source->vdata, CD_PAINT_MASK);
   }
 
-  for (int i = 0; i < target->totvert; i++) {
-    float from_co[3];
-    BVHTreeNearest nearest;
-    nearest.index = -1;
-    nearest.dist_sq = FLT_MAX;
-    copy_v3_v3(from_co, target_verts[i].co);
-    BLI_bvhtree_find_nearest(bvhtree.tree, from_co, &nearest, bvhtree.nearest_callback, &bvhtree);
-    if (nearest.index != -1) {
-      target_mask[i] = source_mask[nearest.index];
+  Vector<std::pair<const MPropCol *, MPropCol *>> color_layers;
+  if (use_colors) {
+    const int tot_color_layer = CustomData_number_of_layers(&source->vdata, CD_PROP_COLOR);
+    for (const int layer_n : IndexRange(tot_color_layer)) {
+      const char *layer_name = CustomData_get_layer_name(&source->vdata, CD_PROP_COLOR, layer_n);
+      CustomData_add_layer_named(
+          &target->vdata, CD_PROP_COLOR, CD_CALLOC, nullptr, target->totvert, layer_name);
+    }
+    for (const int layer_n : IndexRange(tot_color_layer)) {
+      color_layers.append(
+          {(const MPropCol *)CustomData_get_layer_n(&source->vdata, CD_PROP_COLOR, layer_n),
+           (MPropCol *)CustomData_get_layer_n(&target->vdata, CD_PROP_COLOR, layer_n)});
+    }
+  }
+
+  /* Face attributes. */
+  int *target_face_sets = nullptr;
+  const int *source_face_sets = nullptr;
+  if (use_face_sets) {
+    target_face_sets = (int *)CustomData_get_layer(&target->pdata, CD_SCULPT_FACE_SETS);
+    if (!target_face_sets) {
+      target_face_sets = (int *)CustomData_add_layer(
+          &target->pdata, CD_SCULPT_FACE_SETS, CD_CALLOC, nullptr, target->totpoly);
     }
+    source_face_sets = (const int *)CustomData_get_layer(&source->pdata, CD_SCULPT_FACE_SETS);
   }
+
+  /* A single tree over the source surface serves every attribute, vertex attributes are read
+   * from the closest corner of the nearest triangle. */
+  const MLoopTri *looptri = BKE_mesh_runtime_looptri_ensure(source);
+  BVHTreeFromMesh bvhtree = {nullptr};
+  BKE_bvhtree_from_mesh_get(&bvhtree, source, BVHTREE_FROM_LOOPTRI, 2);
+
+  if (target_mask || !color_layers.is_empty()) {
+    threading::parallel_for(IndexRange(target->totvert), 1024, [&](const IndexRange range) {
+      for (const int i : range) {
+        const int vert = remesh_reproject_nearest_vert(
+            source, looptri, &bvhtree, target->mvert[i].co);
+        if (vert == -1) {
+          continue;
+        }
+        if (target_mask) {
+          target_mask[i] = source_mask ? source_mask[vert] : 0.0f;
+        }
+        for (const std::pair<const MPropCol *, MPropCol *> &layer : color_layers) {
+          copy_v4_v4(layer.second[i].color, layer.first[vert].color);
+        }
+      }
+    });
+  }
+
+  if (use_face_sets || use_materials) {
+    threading::parallel_for(IndexRange(target->totpoly), 1024, [&](const IndexRange range) {
+      for (const int i : range) {
+        MPoly *mpoly = &target->mpoly[i];
+        float from_co[3];
+        BVHTreeNearest nearest;
+        nearest.index = -1;
+        nearest.dist_sq = FLT_MAX;
+        BKE_mesh_calc_poly_center(
+            mpoly, &target->mloop[mpoly->loopstart], target->mvert, from_co);
+        BLI_bvhtree_find_nearest(
+            bvhtree.tree, from_co, &nearest, bvhtree.nearest_callback, &bvhtree);
+
+        const int source_poly = nearest.index != -1 ? looptri[nearest.index].poly : -1;
+        if (target_face_sets) {
+          target_face_sets[i] = (source_poly != -1 && source_face_sets) ?
+                                    source_face_sets[source_poly] :
+                                    1;
+        }
+        if (use_materials && source_poly != -1) {
+          mpoly->mat_nr = source->mpoly[source_poly].mat_nr;
+        }
+      }
+    });
+  }
+
   free_bvhtree_from_mesh(&bvhtree);
 }
 
@@ -735,111 +949,6 @@ void BKE_mesh_remesh_sculpt_array_update(Object *ob, Mesh *target, Mesh *source)
   }
 }
 
-void BKE_remesh_reproject_sculpt_face_sets(Mesh *target, Mesh *source)
-{
-  BVHTreeFromMesh bvhtree = {nullptr};
-
-  const MPoly *target_polys = (const MPoly *)CustomData_get_layer(&target->pdata, CD_MPOLY);
-  const MVert *target_verts = (const MVert *)CustomData_get_layer(&target->vdata, CD_MVERT);
-  const MLoop *target_loops = (const MLoop *)CustomData_get_layer(&target->ldata, CD_MLOOP);
-
-  int *target_face_sets;
-  if (CustomData_has_layer(&target->pdata, CD_SCULPT_FACE_SETS)) {
-    target_face_sets = (int *)CustomData_get_layer(&target->pdata, CD_SCULPT_FACE_SETS);
-  }
-  else {
-    target_face_sets = (int *)CustomData_add_layer(
-        &target->pdata, CD_SCULPT_FACE_SETS, CD_CALLOC, nullptr, target->totpoly);
-  }
-
-  const int *source_face_sets;
-  if (CustomData_has_layer(&source->pdata, CD_SCULPT_FACE_SETS)) {
-    source_face_sets = (const int *)CustomData_get_layer(&source->pdata, CD_SCULPT_FACE_SETS);
-  }
-  else {
-    source_face_sets = (const int *)CustomData_add_layer(
-        &source->pdata, CD_SCULPT_FACE_SETS, CD_CALLOC, nullptr, source->totpoly);
-  }
-
-  const MLoopTri *looptri = BKE_mesh_runtime_looptri_ensure(source);
-  BKE_bvhtree_from_mesh_get(&bvhtree, source, BVHTREE_FROM_LOOPTRI, 2);
-
-  for (int i = 0; i < target->totpoly; i++) {
-    float from_co[3];
-    BVHTreeNearest nearest;
-    nearest.index = -1;
-    nearest.dist_sq = FLT_MAX;
-    const MPoly *mpoly = &target_polys[i];
-    BKE_mesh_calc_poly_center(mpoly, &target_loops[mpoly->loopstart], target_verts, from_co);
-    BLI_bvhtree_find_nearest(bvhtree.tree, from_co, &nearest, bvhtree.nearest_callback, &bvhtree);
-    if (nearest.index != -1) {
-      target_face_sets[i] = source_face_sets[looptri[nearest.index].poly];
-    }
-    else {
-      target_face_sets[i] = 1;
-    }
-  }
-  free_bvhtree_from_mesh(&bvhtree);
-}
-
-void BKE_remesh_reproject_materials(Mesh *target, Mesh *source)
-{
-  BVHTreeFromMesh bvhtree = {nullptr};
-  bvhtree.nearest_callback = nullptr;
-
-  const MPoly *target_polys = (MPoly *)CustomData_get_layer(&target->pdata, CD_MPOLY);
-  const MVert *target_verts = (MVert *)CustomData_get_layer(&target->vdata, CD_MVERT);
-  const MLoop *target_loops = (MLoop *)CustomData_get_layer(&target->ldata, CD_MLOOP);
-
-  const MLoopTri *looptri = BKE_mesh_runtime_looptri_ensure(source);
-  BKE_bvhtree_from_mesh_get(&bvhtree, source, BVHTREE_FROM_LOOPTRI, 2);
-
-  for (int i = 0; i < target->totpoly; i++) {
-    float from_co[3];
-    BVHTreeNearest nearest;
-    nearest.index = -1;
-    nearest.dist_sq = FLT_MAX;
-    const MPoly *mpoly = &target_polys[i];
-    BKE_mesh_calc_poly_center(mpoly, &target_loops[mpoly->loopstart], target_verts, from_co);
-    BLI_bvhtree_find_nearest(bvhtree.tree, from_co, &nearest, bvhtree.nearest_callback, &bvhtree);
-    if (nearest.index != -1) {
-      target->mpoly[i].mat_nr = source->mpoly[looptri[nearest.index].poly].mat_nr;
-    }
-  }
-  free_bvhtree_from_mesh(&bvhtree);
-}
-
-void BKE_remesh_reproject_vertex_paint(Mesh *target, const Mesh *source)
-{
-  BVHTreeFromMesh bvhtree = {nullptr};
-  BKE_bvhtree_from_mesh_get(&bvhtree, source, BVHTREE_FROM_VERTS, 2);
-
-  int tot_color_layer = CustomData_number_of_layers(&source->vdata, CD_PROP_COLOR);
-
-  for (int layer_n = 0; layer_n < tot_color_layer; layer_n++) {
-    const char *layer_name = CustomData_get_layer_name(&source->vdata, CD_PROP_COLOR, layer_n);
-    CustomData_add_layer_named(
-        &target->vdata, CD_PROP_COLOR, CD_CALLOC, nullptr, target->totvert, layer_name);
-
-    MPropCol *target_color = (MPropCol *)CustomData_get_layer_n(
-        &target->vdata, CD_PROP_COLOR, layer_n);
-    MVert *target_verts = (MVert *)CustomData_get_layer(&target->vdata, CD_MVERT);
-    const MPropCol *source_color = (const MPropCol *)CustomData_get_layer_n(
-        &source->vdata, CD_PROP_COLOR, layer_n);
-    for (int i = 0; i < target->totvert; i++) {
-      BVHTreeNearest nearest;
-      nearest.index = -1;
-      nearest.dist_sq = FLT_MAX;
-      BLI_bvhtree_find_nearest(
-          bvhtree.tree, target_verts[i].co, &nearest, bvhtree.nearest_callback, &bvhtree);
-      if (nearest.index != -1) {
-        copy_v4_v4(target_color[i].color, source_color[nearest.index].color);
-      }
-    }
-  }
-  free_bvhtree_from_mesh(&bvhtree);
-}
-
 struct Mesh *BKE_mesh_remesh_voxel_fix_poles(const Mesh *mesh)
 {
   const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_ME(mesh);
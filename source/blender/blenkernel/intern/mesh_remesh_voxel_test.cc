@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_map.hh"
+#include "BLI_math_vec_types.hh"
+#include "BLI_math_vector.h"
+#include "BLI_vector.hh"
+
+#include "BKE_customdata.h"
+#include "BKE_idtype.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_remesh_voxel.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+
+namespace blender::bke::tests {
+
+/* Quad grid of `size` by `size` faces in the XY plane, spanning -1 to 1. */
+static Mesh *test_grid_mesh_create(const int size, const float z)
+{
+  const int verts_num = (size + 1) * (size + 1);
+  Mesh *mesh = BKE_mesh_new_nomain(verts_num, 0, 0, size * size * 4, size * size);
+  for (const int y : IndexRange(size + 1)) {
+    for (const int x : IndexRange(size + 1)) {
+      const float3 co(2.0f * x / size - 1.0f, 2.0f * y / size - 1.0f, z);
+      copy_v3_v3(mesh->mvert[y * (size + 1) + x].co, co);
+    }
+  }
+  for (const int y : IndexRange(size)) {
+    for (const int x : IndexRange(size)) {
+      const int poly_index = y * size + x;
+      const int v = y * (size + 1) + x;
+      const int quad[4] = {v, v + 1, v + size + 2, v + size + 1};
+      mesh->mpoly[poly_index].loopstart = poly_index * 4;
+      mesh->mpoly[poly_index].totloop = 4;
+      for (const int i : IndexRange(4)) {
+        mesh->mloop[poly_index * 4 + i].v = quad[i];
+      }
+    }
+  }
+  BKE_mesh_calc_edges(mesh, false, false);
+  return mesh;
+}
+
+static float test_poly_center_x(const Mesh *mesh, const int poly_index)
+{
+  float center[3];
+  const MPoly *mpoly = &mesh->mpoly[poly_index];
+  BKE_mesh_calc_poly_center(mpoly, &mesh->mloop[mpoly->loopstart], mesh->mvert, center);
+  return center[0];
+}
+
+/* Every attribute is taken from the side of the source surface the target element is on. */
+TEST(mesh_remesh_voxel, reproject_attributes)
+{
+  BKE_idtype_init();
+
+  Mesh *source = test_grid_mesh_create(8, 0.0f);
+  float *source_mask = static_cast<float *>(
+      CustomData_add_layer(&source->vdata, CD_PAINT_MASK, CD_CALLOC, nullptr, source->totvert));
+  MPropCol *source_colors = static_cast<MPropCol *>(CustomData_add_layer_named(
+      &source->vdata, CD_PROP_COLOR, CD_CALLOC, nullptr, source->totvert, "Col"));
+  for (const int i : IndexRange(source->totvert)) {
+    const bool is_right = source->mvert[i].co[0] > 0.0f;
+    source_mask[i] = is_right ? 1.0f : 0.0f;
+    copy_v4_fl4(source_colors[i].color, is_right ? 1.0f : 0.0f, 0.0f, 0.0f, 1.0f);
+  }
+  int *source_face_sets = static_cast<int *>(CustomData_add_layer(
+      &source->pdata, CD_SCULPT_FACE_SETS, CD_CALLOC, nullptr, source->totpoly));
+  for (const int i : IndexRange(source->totpoly)) {
+    const bool is_right = test_poly_center_x(source, i) > 0.0f;
+    source_face_sets[i] = is_right ? 2 : 3;
+    source->mpoly[i].mat_nr = is_right ? 1 : 0;
+  }
+
+  /* Different resolution and slightly off the source surface, like a remeshed result. */
+  Mesh *target = test_grid_mesh_create(13, 0.05f);
+  BKE_mesh_remesh_reproject_attributes(target,
+                                       source,
+                                       ME_REMESH_REPROJECT_PAINT_MASK |
+                                           ME_REMESH_REPROJECT_VERTEX_COLORS |
+                                           ME_REMESH_REPROJECT_SCULPT_FACE_SETS |
+                                           ME_REMESH_REPROJECT_MATERIALS);
+
+  const float *target_mask = static_cast<const float *>(
+      CustomData_get_layer(&target->vdata, CD_PAINT_MASK));
+  const MPropCol *target_colors = static_cast<const MPropCol *>(
+      CustomData_get_layer_named(&target->vdata, CD_PROP_COLOR, "Col"));
+  const int *target_face_sets = static_cast<const int *>(
+      CustomData_get_layer(&target->pdata, CD_SCULPT_FACE_SETS));
+  ASSERT_NE(target_mask, nullptr);
+  ASSERT_NE(target_colors, nullptr);
+  ASSERT_NE(target_face_sets, nullptr);
+
+  /* Vertices close to the middle may pick a source vertex from either side. */
+  for (const int i : IndexRange(target->totvert)) {
+    const float x = target->mvert[i].co[0];
+    if (fabsf(x) < 0.2f) {
+      continue;
+    }
+    const float expected = x > 0.0f ? 1.0f : 0.0f;
+    EXPECT_EQ(target_mask[i], expected);
+    EXPECT_EQ(target_colors[i].color[0], expected);
+    EXPECT_EQ(target_colors[i].color[3], 1.0f);
+  }
+  for (const int i : IndexRange(target->totpoly)) {
+    const float x = test_poly_center_x(target, i);
+    if (fabsf(x) < 0.01f) {
+      continue;
+    }
+    EXPECT_EQ(target_face_sets[i], x > 0.0f ? 2 : 3);
+    EXPECT_EQ(target->mpoly[i].mat_nr, x > 0.0f ? 1 : 0);
+  }
+
+  BKE_id_free(nullptr, target);
+  BKE_id_free(nullptr, source);
+}
+
+#ifdef WITH_OPENVDB
+
+/* Closed cube of `size` by `size` quads on every side, spanning -0.5 to 0.5. */
+static Mesh *test_cube_mesh_create(const int size)
+{
+  Map<int64_t, int> vert_indices;
+  Vector<float3> verts;
+  Vector<int> loops;
+
+  auto vert_index = [&](const int co[3]) {
+    const int64_t key = ((int64_t)co[0] * (size + 1) + co[1]) * (size + 1) + co[2];
+    return vert_indices.lookup_or_add_cb(key, [&]() {
+      verts.append(float3(co[0], co[1], co[2]) / (float)size - float3(0.5f));
+      return int(verts.size()) - 1;
+    });
+  };
+
+  for (int axis = 0; axis < 3; axis++) {
+    const int axis_u = (axis + 1) % 3;
+    const int axis_v = (axis + 2) % 3;
+    for (const int side : {0, size}) {
+      for (int v = 0; v < size; v++) {
+        for (int u = 0; u < size; u++) {
+          const int quad_uv[4][2] = {{u, v}, {u + 1, v}, {u + 1, v + 1}, {u, v + 1}};
+          int quad[4];
+          for (int i = 0; i < 4; i++) {
+            int co[3];
+            co[axis] = side;
+            co[axis_u] = quad_uv[i][0];
+            co[axis_v] = quad_uv[i][1];
+            quad[i] = vert_index(co);
+          }
+          for (int i = 0; i < 4; i++) {
+            loops.append(side == 0 ? quad[3 - i] : quad[i]);
+          }
+        }
+      }
+    }
+  }
+
+  Mesh *mesh = BKE_mesh_new_nomain(verts.size(), 0, 0, loops.size(), loops.size() / 4);
+  for (const int i : verts.index_range()) {
+    copy_v3_v3(mesh->mvert[i].co, verts[i]);
+  }
+  for (const int i : loops.index_range()) {
+    mesh->mloop[i].v = loops[i];
+  }
+  for (const int i : IndexRange(mesh->totpoly)) {
+    mesh->mpoly[i].loopstart = i * 4;
+    mesh->mpoly[i].totloop = 4;
+  }
+  BKE_mesh_calc_edges(mesh, false, false);
+  return mesh;
+}
+
+static int test_remesh_voxel_adaptive_totpoly(const Mesh *mesh,
+                                              const float adaptivity,
+                                              const int detail_mode)
+{
+  const float voxel_size = 1.0f / 16.0f;
+  Mesh *result = BKE_mesh_remesh_voxel_adaptive(mesh, voxel_size, adaptivity, 0.0f, detail_mode);
+  if (result == nullptr) {
+    return 0;
+  }
+  const int totpoly = result->totpoly;
+  BKE_id_free(nullptr, result);
+  return totpoly;
+}
+
+/* The flat sides of the cube are simplified by the adaptivity, unless they are detailed. */
+TEST(mesh_remesh_voxel, adaptive_detail)
+{
+  BKE_idtype_init();
+
+  Mesh *mesh = test_cube_mesh_create(8);
+
+  const int full_totpoly = test_remesh_voxel_adaptive_totpoly(
+      mesh, 0.0f, REMESH_VOXEL_DETAIL_UNIFORM);
+  const int uniform_totpoly = test_remesh_voxel_adaptive_totpoly(
+      mesh, 0.5f, REMESH_VOXEL_DETAIL_UNIFORM);
+  ASSERT_GT(uniform_totpoly, 0);
+  EXPECT_LT(uniform_totpoly, full_totpoly);
+
+  /* Uniform detail is the regular voxel remesher. */
+  Mesh *result = BKE_mesh_remesh_voxel(mesh, 1.0f / 16.0f, 0.5f, 0.0f);
+  ASSERT_NE(result, nullptr);
+  EXPECT_EQ(result->totpoly, uniform_totpoly);
+  BKE_id_free(nullptr, result);
+
+  /* Without a mask there is nothing to keep detailed. */
+  EXPECT_EQ(test_remesh_voxel_adaptive_totpoly(mesh, 0.5f, REMESH_VOXEL_DETAIL_MASK),
+            uniform_totpoly);
+
+  /* The cube edges and corners keep more detail than the flat sides. */
+  const int curvature_totpoly = test_remesh_voxel_adaptive_totpoly(
+      mesh, 0.5f, REMESH_VOXEL_DETAIL_CURVATURE);
+  EXPECT_GT(curvature_totpoly, uniform_totpoly);
+  EXPECT_LE(curvature_totpoly, full_totpoly);
+
+  /* A fully masked surface keeps the full resolution everywhere. */
+  float *mask = static_cast<float *>(
+      CustomData_add_layer(&mesh->vdata, CD_PAINT_MASK, CD_CALLOC, nullptr, mesh->totvert));
+  for (const int i : IndexRange(mesh->totvert)) {
+    mask[i] = 1.0f;
+  }
+  const int masked_totpoly = test_remesh_voxel_adaptive_totpoly(
+      mesh, 0.5f, REMESH_VOXEL_DETAIL_MASK);
+  EXPECT_GE(masked_totpoly, curvature_totpoly);
+  EXPECT_LE(masked_totpoly, full_totpoly);
+
+  BKE_id_free(nullptr, mesh);
+}
+
+#endif
+
+}  // namespace blender::bke::tests
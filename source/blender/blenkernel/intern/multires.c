@@ -54,6 +54,8 @@
 #include "multires_inline.h"
 #include "multires_reshape.h"
 
+#include "opensubdiv_topology_refiner_capi.h"
+
 #include <math.h>
 #include <string.h>
 
@@ -1652,11 +1654,81 @@ void multires_stitch_grids(Object *ob)
   int num_faces;
   BKE_pbvh_get_grid_updates(pbvh, false, (void ***)&faces, &num_faces);
   if (num_faces) {
-    // XXX BKE_subdiv_ccg_average_stitch_faces(subdiv_ccg, faces, num_faces);
+    BKE_subdiv_ccg_average_stitch_faces(subdiv_ccg, faces, num_faces);
     MEM_freeN(faces);
   }
 }
 
+bool multires_update_grids_from_base_verts(Object *object,
+                                           const BLI_bitmap *moved_verts,
+                                           const char *skip_grids)
+{
+  SculptSession *sculpt_session = object->sculpt;
+  if (sculpt_session == NULL || sculpt_session->multires.modifier == NULL) {
+    return false;
+  }
+  SubdivCCG *subdiv_ccg = sculpt_session->subdiv_ccg;
+  if (subdiv_ccg == NULL) {
+    return false;
+  }
+  Mesh *mesh = object->data;
+  Subdiv *subdiv = subdiv_ccg->subdiv;
+  OpenSubdiv_TopologyRefiner *topology_refiner = subdiv->topology_refiner;
+  if (mesh->totpoly != subdiv_ccg->num_faces ||
+      mesh->totvert != topology_refiner->getNumVertices(topology_refiner)) {
+    /* Topology changed, the grids are to be rebuilt from scratch. */
+    return false;
+  }
+
+  int num_faces;
+  CCGFace **faces = BKE_subdiv_ccg_faces_from_coarse_verts(subdiv_ccg, moved_verts, &num_faces);
+  if (faces == NULL) {
+    return false;
+  }
+
+  if (skip_grids != NULL) {
+    int num_kept_faces = 0;
+    for (int i = 0; i < num_faces; i++) {
+      const SubdivCCGFace *face = (const SubdivCCGFace *)faces[i];
+      for (int corner = 0; corner < face->num_grids; corner++) {
+        if (!skip_grids[face->start_grid_index + corner]) {
+          faces[num_kept_faces++] = faces[i];
+          break;
+        }
+      }
+    }
+    num_faces = num_kept_faces;
+  }
+
+  if (num_faces != 0) {
+    /* The displacement attached by the modifier points to the evaluated mesh, which is not
+     * updated yet. Evaluate from the original mesh, and detach afterwards so that the subdiv does
+     * not keep pointers to its data. */
+    BKE_subdiv_displacement_attach_from_multires(subdiv, mesh, sculpt_session->multires.modifier);
+
+    SubdivCCGMaskEvaluator mask_evaluator;
+    const bool has_mask = BKE_subdiv_ccg_mask_init_from_paint(&mask_evaluator, mesh);
+    SubdivCCGMaterialFlagsEvaluator material_flags_evaluator;
+    BKE_subdiv_ccg_material_flags_init_from_mesh(&material_flags_evaluator, mesh);
+
+    BKE_subdiv_ccg_eval_faces(subdiv_ccg,
+                              has_mask ? &mask_evaluator : NULL,
+                              &material_flags_evaluator,
+                              faces,
+                              num_faces);
+
+    if (has_mask) {
+      mask_evaluator.free(&mask_evaluator);
+    }
+    material_flags_evaluator.free(&material_flags_evaluator);
+    BKE_subdiv_displacement_detach(subdiv);
+  }
+
+  MEM_freeN(faces);
+
+  return num_faces != 0;
+}
+
 DerivedMesh *multires_make_derived_from_derived(
     DerivedMesh *dm, MultiresModifierData *mmd, Scene *scene, Object *ob, MultiresFlags flags)
 {
@@ -0,0 +1,275 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_map.hh"
+#include "BLI_math_vec_types.hh"
+#include "BLI_vector.hh"
+
+#include "BKE_ccg.h"
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_multires.h"
+#include "BKE_paint.h"
+#include "BKE_subdiv.h"
+#include "BKE_subdiv_ccg.h"
+#include "BKE_subdiv_eval.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
+
+extern "C" {
+#include "multires_reshape.h"
+#include "multires_unsubdivide.h"
+}
+
+namespace blender::bke::tests {
+
+#ifdef WITH_OPENSUBDIV
+
+/* Cube made of `size` by `size` quads on every side, which is what linearly subdividing the
+ * default cube gives. The corners are the only poles, so it can be fully un-subdivided. */
+static Mesh *test_cube_mesh_create(const int size)
+{
+  Map<int64_t, int> vert_indices;
+  Vector<float3> verts;
+  Vector<int> loops;
+
+  auto vert_index = [&](const int co[3]) {
+    const int64_t key = ((int64_t)co[0] * (size + 1) + co[1]) * (size + 1) + co[2];
+    return vert_indices.lookup_or_add_cb(key, [&]() {
+      verts.append(float3(co[0], co[1], co[2]) / (float)size - float3(0.5f));
+      return int(verts.size()) - 1;
+    });
+  };
+
+  for (int axis = 0; axis < 3; axis++) {
+    const int axis_u = (axis + 1) % 3;
+    const int axis_v = (axis + 2) % 3;
+    for (const int side : {0, size}) {
+      for (int v = 0; v < size; v++) {
+        for (int u = 0; u < size; u++) {
+          const int quad_uv[4][2] = {{u, v}, {u + 1, v}, {u + 1, v + 1}, {u, v + 1}};
+          int quad[4];
+          for (int i = 0; i < 4; i++) {
+            int co[3];
+            co[axis] = side;
+            co[axis_u] = quad_uv[i][0];
+            co[axis_v] = quad_uv[i][1];
+            quad[i] = vert_index(co);
+          }
+          /* Wind the faces so their normals point outwards. */
+          for (int i = 0; i < 4; i++) {
+            loops.append(side == 0 ? quad[3 - i] : quad[i]);
+          }
+        }
+      }
+    }
+  }
+
+  Mesh *mesh = BKE_mesh_new_nomain(verts.size(), 0, 0, loops.size(), loops.size() / 4);
+  for (const int i : verts.index_range()) {
+    copy_v3_v3(mesh->mvert[i].co, verts[i]);
+  }
+  for (const int i : loops.index_range()) {
+    mesh->mloop[i].v = loops[i];
+  }
+  for (const int i : IndexRange(mesh->totpoly)) {
+    mesh->mpoly[i].loopstart = i * 4;
+    mesh->mpoly[i].totloop = 4;
+  }
+  BKE_mesh_calc_edges(mesh, false, false);
+
+  return mesh;
+}
+
+static void test_multires_modifier_init(MultiresModifierData *mmd, const int level)
+{
+  memset(mmd, 0, sizeof(*mmd));
+  mmd->quality = 4;
+  mmd->lvl = mmd->sculptlvl = mmd->renderlvl = mmd->totlvl = level;
+}
+
+/* Same steps as #multiresModifier_base_apply, without deform modifiers before the multires. */
+static void test_multires_apply_base(const int cube_size, const int level)
+{
+  BKE_subdiv_init();
+
+  Mesh *mesh = test_cube_mesh_create(cube_size);
+  Object object = {{nullptr}};
+  object.type = OB_MESH;
+  object.data = mesh;
+  MultiresModifierData mmd;
+  test_multires_modifier_init(&mmd, level);
+
+  CustomData_add_layer(&mesh->ldata, CD_MDISPS, CD_CALLOC, nullptr, mesh->totloop);
+  multires_reshape_ensure_grids(mesh, level);
+
+  MultiresReshapeContext reshape_context;
+  ASSERT_TRUE(
+      multires_reshape_context_create_from_modifier(&reshape_context, &object, &mmd, level));
+
+  multires_reshape_store_original_grids(&reshape_context);
+  multires_reshape_assign_final_coords_from_mdisps(&reshape_context);
+  multires_reshape_apply_base_refine_from_base(&reshape_context);
+  multires_reshape_apply_base_update_mesh_coords(&reshape_context);
+  multires_reshape_apply_base_refit_base_mesh(&reshape_context);
+  multires_reshape_apply_base_refine_from_base(&reshape_context);
+  multires_reshape_object_grids_to_tangent_displacement(&reshape_context);
+  multires_reshape_context_free(&reshape_context);
+
+  BKE_id_free(nullptr, mesh);
+  BKE_subdiv_exit();
+}
+
+static void test_multires_unsubdivide(const int levels)
+{
+  Mesh *mesh = test_cube_mesh_create(1 << levels);
+  MultiresModifierData mmd;
+  test_multires_modifier_init(&mmd, 0);
+
+  MultiresUnsubdivideContext unsubdiv_context = {nullptr};
+  multires_unsubdivide_context_init(&unsubdiv_context, mesh, &mmd);
+  unsubdiv_context.max_new_levels = levels;
+
+  EXPECT_TRUE(multires_unsubdivide_to_basemesh(&unsubdiv_context));
+  EXPECT_GT(unsubdiv_context.num_new_levels, 0);
+
+  if (unsubdiv_context.base_mesh) {
+    BKE_id_free(nullptr, unsubdiv_context.base_mesh);
+  }
+  multires_unsubdivide_context_free(&unsubdiv_context);
+  BKE_id_free(nullptr, mesh);
+}
+
+static Mesh *test_multires_ccg_mesh_create(Mesh *mesh, const MultiresModifierData *mmd)
+{
+  SubdivSettings subdiv_settings;
+  BKE_multires_subdiv_settings_init(&subdiv_settings, mmd);
+  Subdiv *subdiv = BKE_subdiv_new_from_mesh(&subdiv_settings, mesh);
+  BKE_subdiv_displacement_attach_from_multires(subdiv, mesh, mmd);
+
+  SubdivToCCGSettings ccg_settings;
+  ccg_settings.resolution = (1 << mmd->sculptlvl) + 1;
+  ccg_settings.need_normal = true;
+  ccg_settings.need_mask = false;
+  /* NOTE: CCG takes ownership over Subdiv. */
+  return BKE_subdiv_to_ccg_mesh(subdiv, &ccg_settings, mesh);
+}
+
+/* Moving base vertices and re-evaluating the affected faces of an existing CCG is to give the same
+ * grids as evaluating the CCG from scratch. */
+static void test_multires_update_grids_from_base_verts(const bool use_displacement)
+{
+  const int level = 3;
+  BKE_subdiv_init();
+
+  Mesh *mesh = test_cube_mesh_create(4);
+  Object object = {{nullptr}};
+  object.type = OB_MESH;
+  object.data = mesh;
+  MultiresModifierData mmd;
+  test_multires_modifier_init(&mmd, level);
+
+  if (use_displacement) {
+    CustomData_add_layer(&mesh->ldata, CD_MDISPS, CD_CALLOC, nullptr, mesh->totloop);
+    multires_reshape_ensure_grids(mesh, level);
+    MDisps *mdisps = static_cast<MDisps *>(CustomData_get_layer(&mesh->ldata, CD_MDISPS));
+    for (const int loop_index : IndexRange(mesh->totloop)) {
+      for (const int i : IndexRange(mdisps[loop_index].totdisp)) {
+        const float t = float(loop_index * 31 + i);
+        mdisps[loop_index].disps[i][0] = 0.01f * sinf(t);
+        mdisps[loop_index].disps[i][1] = 0.01f * cosf(t);
+        mdisps[loop_index].disps[i][2] = 0.02f * sinf(t * 0.5f);
+      }
+    }
+  }
+
+  Mesh *partial_mesh = test_multires_ccg_mesh_create(mesh, &mmd);
+  ASSERT_NE(partial_mesh, nullptr);
+  SubdivCCG *partial_ccg = partial_mesh->runtime.subdiv_ccg;
+
+  /* Move a corner of the cube, which is an extraordinary vertex, and a regular vertex. */
+  BLI_bitmap *moved_verts = BLI_BITMAP_NEW(mesh->totvert, __func__);
+  for (const int vert_index : {0, mesh->totvert / 2}) {
+    add_v3_v3(mesh->mvert[vert_index].co, float3(0.1f, -0.05f, 0.2f));
+    BLI_BITMAP_ENABLE(moved_verts, vert_index);
+  }
+
+  SculptSession *sculpt_session = static_cast<SculptSession *>(
+      MEM_callocN(sizeof(SculptSession), __func__));
+  sculpt_session->subdiv_ccg = partial_ccg;
+  sculpt_session->multires.modifier = &mmd;
+  object.sculpt = sculpt_session;
+
+  BKE_subdiv_eval_refine_from_mesh(partial_ccg->subdiv, mesh, nullptr);
+  EXPECT_TRUE(multires_update_grids_from_base_verts(&object, moved_verts, nullptr));
+
+  Mesh *full_mesh = test_multires_ccg_mesh_create(mesh, &mmd);
+  ASSERT_NE(full_mesh, nullptr);
+  SubdivCCG *full_ccg = full_mesh->runtime.subdiv_ccg;
+
+  ASSERT_EQ(partial_ccg->num_grids, full_ccg->num_grids);
+  CCGKey key;
+  BKE_subdiv_ccg_key_top_level(&key, full_ccg);
+  /* With displacement the grid boundaries are averaged with the neighbor grids after evaluation,
+   * incrementally so for the partial update (same as after a sculpt stroke). Only compare the
+   * inner elements then, which are evaluated and get their normals calculated the same way. */
+  const int boundary = use_displacement ? 1 : 0;
+  for (const int grid_index : IndexRange(full_ccg->num_grids)) {
+    for (int y = boundary; y < key.grid_size - boundary; y++) {
+      for (int x = boundary; x < key.grid_size - boundary; x++) {
+        CCGElem *partial_elem = CCG_grid_elem(&key, partial_ccg->grids[grid_index], x, y);
+        CCGElem *full_elem = CCG_grid_elem(&key, full_ccg->grids[grid_index], x, y);
+        EXPECT_V3_NEAR(CCG_elem_co(&key, partial_elem), CCG_elem_co(&key, full_elem), 1e-5f);
+        EXPECT_V3_NEAR(CCG_elem_no(&key, partial_elem), CCG_elem_no(&key, full_elem), 1e-4f);
+      }
+    }
+  }
+
+  MEM_freeN(sculpt_session);
+  MEM_freeN(moved_verts);
+  BKE_id_free(nullptr, full_mesh);
+  BKE_id_free(nullptr, partial_mesh);
+  BKE_id_free(nullptr, mesh);
+  BKE_subdiv_exit();
+}
+
+TEST(multires_update_grids, from_base_verts)
+{
+  test_multires_update_grids_from_base_verts(false);
+}
+
+TEST(multires_update_grids, from_base_verts_displacement)
+{
+  test_multires_update_grids_from_base_verts(true);
+}
+
+/* Few base faces at a high level, where the work has to be split within the grids. */
+TEST(multires_reshape_performance, apply_base_cube_level_6)
+{
+  test_multires_apply_base(1, 6);
+}
+
+TEST(multires_reshape_performance, apply_base_1536_faces_level_5)
+{
+  test_multires_apply_base(16, 5);
+}
+
+TEST(multires_reshape_performance, unsubdivide_6_levels)
+{
+  test_multires_unsubdivide(6);
+}
+
+TEST(multires_reshape_performance, unsubdivide_8_levels)
+{
+  test_multires_unsubdivide(8);
+}
+
+#endif
+
+}  // namespace blender::bke::tests
@@ -618,44 +618,47 @@ typedef void (*ForeachGridCoordinateCallback)(const MultiresReshapeContext *resh
                                               const GridCoord *grid_coord,
                                               void *userdata_v);
 
+/* Grids are traversed in square tiles of this many elements per side, so the work is spread over
+ * all threads also for base meshes with few faces at high levels, and every task touches a
+ * compact block of the displacement grid. */
+#define GRID_TILE_SIZE 16
+
 typedef struct ForeachGridCoordinateTaskData {
   const MultiresReshapeContext *reshape_context;
 
   int grid_size;
   float grid_size_1_inv;
+  int tiles_per_side;
 
   ForeachGridCoordinateCallback callback;
   void *callback_userdata_v;
 } ForeachGridCoordinateTaskData;
 
-static void foreach_grid_face_coordinate_task(void *__restrict userdata_v,
-                                              const int face_index,
+static void foreach_grid_tile_coordinate_task(void *__restrict userdata_v,
+                                              const int tile_index,
                                               const TaskParallelTLS *__restrict UNUSED(tls))
 {
   ForeachGridCoordinateTaskData *data = userdata_v;
 
-  const MultiresReshapeContext *reshape_context = data->reshape_context;
-
-  const Mesh *base_mesh = data->reshape_context->base_mesh;
-  const MPoly *mpoly = base_mesh->mpoly;
   const int grid_size = data->grid_size;
-  const float grid_size_1_inv = 1.0f / (((float)grid_size) - 1.0f);
-
-  const int num_corners = mpoly[face_index].totloop;
-  int grid_index = reshape_context->face_start_grid_index[face_index];
-  for (int corner = 0; corner < num_corners; ++corner, ++grid_index) {
-    for (int y = 0; y < grid_size; ++y) {
-      const float v = (float)y * grid_size_1_inv;
-      for (int x = 0; x < grid_size; ++x) {
-        const float u = (float)x * grid_size_1_inv;
-
-        GridCoord grid_coord;
-        grid_coord.grid_index = grid_index;
-        grid_coord.u = u;
-        grid_coord.v = v;
-
-        data->callback(data->reshape_context, &grid_coord, data->callback_userdata_v);
-      }
+  const float grid_size_1_inv = data->grid_size_1_inv;
+  const int tiles_per_side = data->tiles_per_side;
+  const int tiles_per_grid = tiles_per_side * tiles_per_side;
+
+  const int grid_index = tile_index / tiles_per_grid;
+  const int grid_tile_index = tile_index - grid_index * tiles_per_grid;
+  const int start_x = (grid_tile_index % tiles_per_side) * GRID_TILE_SIZE;
+  const int start_y = (grid_tile_index / tiles_per_side) * GRID_TILE_SIZE;
+  const int end_x = min_ii(start_x + GRID_TILE_SIZE, grid_size);
+  const int end_y = min_ii(start_y + GRID_TILE_SIZE, grid_size);
+
+  GridCoord grid_coord;
+  grid_coord.grid_index = grid_index;
+  for (int y = start_y; y < end_y; ++y) {
+    grid_coord.v = (float)y * grid_size_1_inv;
+    for (int x = start_x; x < end_x; ++x) {
+      grid_coord.u = (float)x * grid_size_1_inv;
+      data->callback(data->reshape_context, &grid_coord, data->callback_userdata_v);
     }
   }
 }
@@ -670,6 +673,7 @@ static void foreach_grid_coordinate(const MultiresReshapeContext *reshape_contex
   data.reshape_context = reshape_context;
   data.grid_size = BKE_subdiv_grid_size_from_level(level);
   data.grid_size_1_inv = 1.0f / (((float)data.grid_size) - 1.0f);
+  data.tiles_per_side = (data.grid_size + GRID_TILE_SIZE - 1) / GRID_TILE_SIZE;
   data.callback = callback;
   data.callback_userdata_v = userdata_v;
 
@@ -677,10 +681,9 @@ static void foreach_grid_coordinate(const MultiresReshapeContext *reshape_contex
   BLI_parallel_range_settings_defaults(&parallel_range_settings);
   parallel_range_settings.min_iter_per_thread = 1;
 
-  const Mesh *base_mesh = reshape_context->base_mesh;
-  const int num_faces = base_mesh->totpoly;
+  const int num_tiles = reshape_context->num_grids * data.tiles_per_side * data.tiles_per_side;
   BLI_task_parallel_range(
-      0, num_faces, &data, foreach_grid_face_coordinate_task, &parallel_range_settings);
+      0, num_tiles, &data, foreach_grid_tile_coordinate_task, &parallel_range_settings);
 }
 
 static void object_grid_element_to_tangent_displacement(
@@ -8,6 +8,8 @@
  * its corresponding grids to match a given original mesh.
  */
 
+#include <string.h>
+
 #include "MEM_guardedalloc.h"
 
 #include "DNA_mesh_types.h"
@@ -17,6 +19,7 @@
 
 #include "BLI_gsqueue.h"
 #include "BLI_math_vector.h"
+#include "BLI_task.h"
 
 #include "BKE_customdata.h"
 #include "BKE_lib_id.h"
@@ -630,14 +633,16 @@ static void write_face_grid_in_unsubdivide_grid(MultiresUnsubdivideGrid *grid,
  * Stores the data from the mdisps grids of the loops of the face f
  * into the new grid for the new base mesh.
  *
- * Used when there are already grids in the original mesh.
+ * Used when there are already grids in the original mesh. `face_grid` is a scratch buffer big
+ * enough for the grids of the four loops of a face at the original level plus one.
  */
 static void store_grid_data(MultiresUnsubdivideContext *context,
                             MultiresUnsubdivideGrid *grid,
                             BMVert *v,
                             BMFace *f,
                             int grid_x,
-                            int grid_y)
+                            int grid_y,
+                            float (*face_grid)[3])
 {
 
   Mesh *original_mesh = context->original_mesh;
@@ -660,8 +665,6 @@ static void store_grid_data(MultiresUnsubdivideContext *context,
   /* Write the 4 grids of the current quad with the right orientation into the face_grid buffer. */
   const int grid_size = BKE_ccg_gridsize(context->num_original_levels);
   const int face_grid_size = BKE_ccg_gridsize(context->num_original_levels + 1);
-  const int face_grid_area = face_grid_size * face_grid_size;
-  float(*face_grid)[3] = MEM_calloc_arrayN(face_grid_area, sizeof(float[3]), "face_grid");
 
   for (int i = 0; i < poly->totloop; i++) {
     const int loop_index = poly->loopstart + i;
@@ -679,8 +682,6 @@ static void store_grid_data(MultiresUnsubdivideContext *context,
   /* Write the face_grid buffer in the correct position in the #MultiresUnsubdivideGrids that is
    * being extracted. */
   write_face_grid_in_unsubdivide_grid(grid, face_grid, face_grid_size, grid_x, grid_y);
-
-  MEM_freeN(face_grid);
 }
 
 /**
@@ -754,8 +755,12 @@ static void multires_unsubdivide_extract_single_grid_from_face_edge(
    * to the last vertex of the iteration as that coordinate is also included in the grids
    * corresponding to the loop of the face of the previous iteration. */
   int grid_iteration_max_steps = grid_size;
+  float(*face_grid)[3] = NULL;
   if (context->num_original_levels > 0) {
     grid_iteration_max_steps = grid_size - 1;
+    const int face_grid_size = BKE_ccg_gridsize(context->num_original_levels + 1);
+    face_grid = MEM_calloc_arrayN(
+        face_grid_size * face_grid_size, sizeof(float[3]), "face_grid");
   }
 
   /* Iterate over the mesh vertices in a grid pattern using the axis defined by the two initial
@@ -774,7 +779,7 @@ static void multires_unsubdivide_extract_single_grid_from_face_edge(
       else {
         /* If there were grids in the original mesh, extract the data from the grids and iterate
          * over the faces. */
-        store_grid_data(context, grid, current_vertex_x, grid_face, grid_x, grid_y);
+        store_grid_data(context, grid, current_vertex_x, grid_face, grid_x, grid_y, face_grid);
         edge_x = edge_step(current_vertex_x, edge_x, &current_vertex_x);
         grid_face = face_step(edge_x, grid_face);
       }
@@ -807,6 +812,8 @@ static void multires_unsubdivide_extract_single_grid_from_face_edge(
     prev_edge_y = edge_y;
     grid_y++;
   }
+
+  MEM_SAFE_FREE(face_grid);
 }
 
 /**
@@ -981,6 +988,34 @@ static bool multires_unsubdivide_flip_grid_x_axis(Mesh *mesh, int poly, int loop
   return false;
 }
 
+/* Grid of the new base mesh, and where to start extracting it from in the original mesh. */
+typedef struct UnsubdivideExtractGridData {
+  BMFace *face;
+  BMEdge *edge;
+  bool flip_grid;
+  int base_mesh_loop_index;
+} UnsubdivideExtractGridData;
+
+typedef struct UnsubdivideExtractGridsTaskData {
+  MultiresUnsubdivideContext *context;
+  const UnsubdivideExtractGridData *grids;
+} UnsubdivideExtractGridsTaskData;
+
+static void multires_unsubdivide_extract_grid_task(void *__restrict userdata_v,
+                                                   const int i,
+                                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  UnsubdivideExtractGridsTaskData *data = userdata_v;
+  MultiresUnsubdivideContext *context = data->context;
+  const UnsubdivideExtractGridData *grid_data = &data->grids[i];
+
+  /* Extraction only reads from the original #BMesh, so every grid can be walked on its own. */
+  MultiresUnsubdivideGrid *grid = &context->base_mesh_grids[grid_data->base_mesh_loop_index];
+  grid->grid_index = grid_data->base_mesh_loop_index;
+  multires_unsubdivide_extract_single_grid_from_face_edge(
+      context, grid_data->face, grid_data->edge, grid_data->flip_grid, grid);
+}
+
 static void multires_unsubdivide_extract_grids(MultiresUnsubdivideContext *context)
 {
   Mesh *original_mesh = context->original_mesh;
@@ -1032,7 +1067,11 @@ static void multires_unsubdivide_extract_grids(MultiresUnsubdivideContext *conte
   const int base_l_offset = CustomData_get_n_offset(
       &bm_base_mesh->ldata, CD_PROP_INT32, base_l_layer_index);
 
-  /* Main loop for extracting the grids. Iterates over the base mesh vertices. */
+  UnsubdivideExtractGridData *grids = MEM_malloc_arrayN(
+      base_mesh->totloop, sizeof(UnsubdivideExtractGridData), __func__);
+  int num_grids = 0;
+
+  /* Main loop for finding the grids. Iterates over the base mesh vertices. */
   BM_ITER_MESH (v, &iter, bm_base_mesh, BM_VERTS_OF_MESH) {
 
     /* For each base mesh vertex, get the corresponding #BMVert of the original mesh using the
@@ -1071,10 +1110,13 @@ static void multires_unsubdivide_extract_grids(MultiresUnsubdivideContext *conte
           const bool flip_grid = multires_unsubdivide_flip_grid_x_axis(
               base_mesh, base_mesh_face_index, base_mesh_loop_index, corner_x_index);
 
-          /* Extract the grid for that loop. */
-          context->base_mesh_grids[base_mesh_loop_index].grid_index = base_mesh_loop_index;
-          multires_unsubdivide_extract_single_grid_from_face_edge(
-              context, l->f, l->e, !flip_grid, &context->base_mesh_grids[base_mesh_loop_index]);
+          /* Store the grid for that loop, the extraction happens below. */
+          BLI_assert(num_grids < base_mesh->totloop);
+          UnsubdivideExtractGridData *grid_data = &grids[num_grids++];
+          grid_data->face = l->f;
+          grid_data->edge = l->e;
+          grid_data->flip_grid = !flip_grid;
+          grid_data->base_mesh_loop_index = base_mesh_loop_index;
 
           break;
         }
@@ -1082,6 +1124,20 @@ static void multires_unsubdivide_extract_grids(MultiresUnsubdivideContext *conte
     }
   }
 
+  UnsubdivideExtractGridsTaskData task_data = {
+      .context = context,
+      .grids = grids,
+  };
+  TaskParallelSettings parallel_range_settings;
+  BLI_parallel_range_settings_defaults(&parallel_range_settings);
+  parallel_range_settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0,
+                          num_grids,
+                          &task_data,
+                          multires_unsubdivide_extract_grid_task,
+                          &parallel_range_settings);
+  MEM_freeN(grids);
+
   MEM_freeN(orig_to_base_vmap);
   MEM_freeN(base_to_orig_vmap);
 
@@ -1163,6 +1219,34 @@ void multires_unsubdivide_context_free(MultiresUnsubdivideContext *context)
   MEM_SAFE_FREE(context->base_mesh_grids);
 }
 
+typedef struct CreateGridsTaskData {
+  const MultiresUnsubdivideContext *context;
+  MDisps *mdisps;
+  int totdisp;
+} CreateGridsTaskData;
+
+static void multires_create_grid_task(void *__restrict userdata_v,
+                                      const int i,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  CreateGridsTaskData *data = userdata_v;
+  const MultiresUnsubdivideGrid *grid = &data->context->base_mesh_grids[i];
+  MDisps *mdisp = &data->mdisps[i];
+
+  float(*disps)[3] = MEM_calloc_arrayN(data->totdisp, sizeof(float[3]), "multires disps");
+  if (grid->grid_co) {
+    memcpy(disps, grid->grid_co, sizeof(float[3]) * data->totdisp);
+  }
+
+  if (mdisp->disps) {
+    MEM_freeN(mdisp->disps);
+  }
+
+  mdisp->disps = disps;
+  mdisp->totdisp = data->totdisp;
+  mdisp->level = data->context->num_total_levels;
+}
+
 /**
  * This function allocates new mdisps with the right size to fit the new extracted grids from the
  * base mesh and copies the data to them.
@@ -1183,23 +1267,16 @@ static void multires_create_grids_in_unsubdivided_base_mesh(MultiresUnsubdivideC
   BLI_assert(base_mesh->totloop == context->num_grids);
 
   /* Allocate the MDISPS grids and copy the extracted data from context. */
-  for (int i = 0; i < totloop; i++) {
-    float(*disps)[3] = MEM_calloc_arrayN(totdisp, sizeof(float[3]), "multires disps");
-
-    if (mdisps[i].disps) {
-      MEM_freeN(mdisps[i].disps);
-    }
-
-    for (int j = 0; j < totdisp; j++) {
-      if (context->base_mesh_grids[i].grid_co) {
-        copy_v3_v3(disps[j], context->base_mesh_grids[i].grid_co[j]);
-      }
-    }
-
-    mdisps[i].disps = disps;
-    mdisps[i].totdisp = totdisp;
-    mdisps[i].level = context->num_total_levels;
-  }
+  CreateGridsTaskData data = {
+      .context = context,
+      .mdisps = mdisps,
+      .totdisp = totdisp,
+  };
+  TaskParallelSettings parallel_range_settings;
+  BLI_parallel_range_settings_defaults(&parallel_range_settings);
+  parallel_range_settings.min_iter_per_thread = 16;
+  BLI_task_parallel_range(
+      0, totloop, &data, multires_create_grid_task, &parallel_range_settings);
 }
 
 int multiresModifier_rebuild_subdiv(struct Depsgraph *depsgraph,
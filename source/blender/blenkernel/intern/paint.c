@@ -27,6 +27,7 @@
 #include "BLI_hash.h"
 #include "BLI_listbase.h"
 #include "BLI_math_vector.h"
+#include "BLI_smallhash.h"
 #include "BLI_string_utf8.h"
 #include "BLI_string_utils.h"
 #include "BLI_utildefines.h"
@@ -1419,7 +1420,8 @@ static void sculptsession_bm_to_me_update_data_only(Object *ob, bool reorder)
                                        .copy_temp_cdlayers = false,
                                        .ignore_mesh_id_layers = false,
                                        .update_shapekey_indices = true,
-                                       .cd_mask_extra = CD_MASK_MESH_ID | CD_MASK_DYNTOPO_VERT
+                                       .cd_mask_extra = CD_MASK_MESH_ID | CD_MASK_DYNTOPO_VERT |
+                                                        CD_MASK_DYNTOPO_VERT_COLD
 
           }));
     }
@@ -1450,6 +1452,8 @@ static void sculptsession_free_pbvh(Object *object)
     ss->pbvh = NULL;
   }
 
+  ss->topology_generation++;
+
   MEM_SAFE_FREE(ss->face_areas);
 
   MEM_SAFE_FREE(ss->pmap);
@@ -1495,6 +1499,23 @@ void BKE_sculptsession_bm_to_me_for_render(Object *object)
   }
 }
 
+static void sculptsession_pose_ik_chain_free(SculptPoseIKChain **ik_chain_p)
+{
+  SculptPoseIKChain *ik_chain = *ik_chain_p;
+
+  if (!ik_chain) {
+    return;
+  }
+
+  for (int i = 0; i < ik_chain->tot_segments; i++) {
+    MEM_SAFE_FREE(ik_chain->segments[i].weights);
+  }
+  MEM_SAFE_FREE(ik_chain->segments);
+  MEM_freeN(ik_chain);
+
+  *ik_chain_p = NULL;
+}
+
 void BKE_sculptsession_free(Object *ob)
 {
   if (ob && ob->sculpt) {
@@ -1504,6 +1525,7 @@ void BKE_sculptsession_free(Object *ob)
       MEM_freeN(ss->mdyntopo_verts);
       ss->mdyntopo_verts = NULL;
     }
+    MEM_SAFE_FREE(ss->mdyntopo_verts_cold);
 
     if (ss->bm_log && BM_log_free(ss->bm_log, true)) {
       ss->bm_log = NULL;
@@ -1559,19 +1581,20 @@ void BKE_sculptsession_free(Object *ob)
     MEM_SAFE_FREE(ss->deform_cos);
     MEM_SAFE_FREE(ss->deform_imats);
 
-    if (ss->pose_ik_chain_preview) {
-      for (int i = 0; i < ss->pose_ik_chain_preview->tot_segments; i++) {
-        MEM_SAFE_FREE(ss->pose_ik_chain_preview->segments[i].weights);
-      }
-      MEM_SAFE_FREE(ss->pose_ik_chain_preview->segments);
-      MEM_SAFE_FREE(ss->pose_ik_chain_preview);
-    }
+    sculptsession_pose_ik_chain_free(&ss->pose_ik_chain_preview);
+    sculptsession_pose_ik_chain_free(&ss->pose_ik_chain_cache);
 
     if (ss->boundary_preview) {
       MEM_SAFE_FREE(ss->boundary_preview->vertices);
       MEM_SAFE_FREE(ss->boundary_preview->edges);
       MEM_SAFE_FREE(ss->boundary_preview->distance);
       MEM_SAFE_FREE(ss->boundary_preview->edit_info);
+      MEM_SAFE_FREE(ss->boundary_preview->region.verts);
+      MEM_SAFE_FREE(ss->boundary_preview->region.indices);
+      if (ss->boundary_preview->region.map) {
+        BLI_smallhash_release(ss->boundary_preview->region.map);
+        MEM_freeN(ss->boundary_preview->region.map);
+      }
       MEM_SAFE_FREE(ss->boundary_preview);
     }
 
@@ -2541,6 +2564,10 @@ static void init_mdyntopo_layer_faces(SculptSession *ss, PBVH *pbvh, int totvert
   ss->mdyntopo_verts = MEM_calloc_arrayN(totvert, sizeof(*ss->mdyntopo_verts), "mdyntopo_verts");
   ss->mdyntopo_verts_size = totvert;
 
+  MEM_SAFE_FREE(ss->mdyntopo_verts_cold);
+  ss->mdyntopo_verts_cold = MEM_calloc_arrayN(
+      totvert, sizeof(*ss->mdyntopo_verts_cold), "mdyntopo_verts_cold");
+
   BKE_pbvh_set_mdyntopo_verts(pbvh, ss->mdyntopo_verts);
 
   MSculptVert *mv = ss->mdyntopo_verts;
@@ -2575,6 +2602,10 @@ static void init_mdyntopo_layer_grids(SculptSession *ss, PBVH *pbvh, int totvert
   ss->mdyntopo_verts = MEM_calloc_arrayN(totvert, sizeof(*ss->mdyntopo_verts), "mdyntopo_verts");
   ss->mdyntopo_verts_size = totvert;
 
+  MEM_SAFE_FREE(ss->mdyntopo_verts_cold);
+  ss->mdyntopo_verts_cold = MEM_calloc_arrayN(
+      totvert, sizeof(*ss->mdyntopo_verts_cold), "mdyntopo_verts_cold");
+
   BKE_pbvh_set_mdyntopo_verts(pbvh, ss->mdyntopo_verts);
 
   MSculptVert *mv = ss->mdyntopo_verts;
@@ -2667,7 +2698,9 @@ PBVH *BKE_sculpt_object_pbvh_ensure(Depsgraph *depsgraph, Object *ob)
                                                         .ignore_id_layers = false,
                                                         .copy_temp_cdlayers = true,
 
-                                                        .cd_mask_extra = CD_MASK_DYNTOPO_VERT}));
+                                                        .cd_mask_extra =
+                                                            CD_MASK_DYNTOPO_VERT |
+                                                            CD_MASK_DYNTOPO_VERT_COLD}));
 
       BKE_sculptsession_bmesh_add_layers(ob);
       SCULPT_undo_ensure_bmlog(ob);
@@ -2942,6 +2975,7 @@ void BKE_sculptsession_bmesh_add_layers(Object *ob)
   BMCustomLayerReq vlayers[] = {
       {CD_PAINT_MASK, NULL, 0},
       {CD_DYNTOPO_VERT, NULL, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY},
+      {CD_DYNTOPO_VERT_COLD, NULL, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY},
       {CD_PROP_INT32, dyntopop_node_idx_layer_id, CD_FLAG_TEMPORARY | CD_FLAG_NOCOPY}};
 
   BM_data_layers_ensure(ss->bm, &ss->bm->vdata, vlayers, ARRAY_SIZE(vlayers));
@@ -2961,6 +2995,7 @@ void BKE_sculptsession_bmesh_add_layers(Object *ob)
       &ss->bm->pdata, CD_PROP_INT32, dyntopop_node_idx_layer_id);
 
   ss->cd_sculpt_vert = CustomData_get_offset(&ss->bm->vdata, CD_DYNTOPO_VERT);
+  ss->cd_sculpt_vert_cold = CustomData_get_offset(&ss->bm->vdata, CD_DYNTOPO_VERT_COLD);
 
   ss->cd_vert_node_offset = CustomData_get_n_offset(
       &ss->bm->vdata,
@@ -91,6 +91,15 @@ float BB_volume(const BB *bb)
   return dx * dy * dz;
 }
 
+float BB_surface_area(const BB *bb)
+{
+  float dx = bb->bmax[0] - bb->bmin[0];
+  float dy = bb->bmax[1] - bb->bmin[1];
+  float dz = bb->bmax[2] - bb->bmin[2];
+
+  return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
 /* Expand the bounding box to include a new coordinate */
 void BB_expand(BB *bb, const float co[3])
 {
@@ -1673,8 +1682,40 @@ void pbvh_update_free_all_draw_buffers(PBVH *pbvh, PBVHNode *node)
   }
 }
 
-static void pbvh_update_draw_buffers(
-    PBVH *pbvh, Mesh *me, PBVHNode **nodes, int totnode, int update_flag)
+/* Vertex data of the draw buffers is packed in a task pool, so the main thread can upload the
+ * nodes that are done and record draw calls for unchanged nodes in the meantime. Node flags are
+ * only cleared once a node was flushed. */
+typedef struct PBVHDrawUpdate {
+  PBVHUpdateData data;
+  TaskPool *pool;
+
+  /* Set by the fill task of each node once it finished. */
+  uint8_t *filled;
+  /* Main thread only. */
+  bool *flushed;
+  int totflushed;
+  /* All nodes before this one are flushed. */
+  int first_unflushed;
+} PBVHDrawUpdate;
+
+/* Number of draw calls recorded between uploads of the nodes whose fill task finished. */
+#define PBVH_DRAW_FLUSH_INTERVAL 32
+
+static void pbvh_update_draw_buffer_task(TaskPool *__restrict pool, void *taskdata)
+{
+  PBVHDrawUpdate *update = BLI_task_pool_user_data(pool);
+  const int n = POINTER_AS_INT(taskdata);
+
+  pbvh_update_draw_buffer_cb(&update->data, n, NULL);
+  atomic_fetch_and_or_uint8(update->filled + n, 1);
+}
+
+static void pbvh_update_draw_buffers_begin(PBVH *pbvh,
+                                           Mesh *me,
+                                           PBVHNode **nodes,
+                                           int totnode,
+                                           int update_flag,
+                                           PBVHDrawUpdate *update)
 {
 
   CustomData *vdata;
@@ -1755,16 +1796,38 @@ static void pbvh_update_draw_buffers(
     }
   }
 
-  /* Parallel creation and update of draw buffers. */
-  PBVHUpdateData data = {
-      .pbvh = pbvh, .nodes = nodes, .flat_vcol_shading = pbvh->flat_vcol_shading, .mesh = me};
+  /* Asynchronous creation and update of draw buffers. */
+  update->data = (PBVHUpdateData){.pbvh = pbvh,
+                                  .nodes = nodes,
+                                  .totnode = totnode,
+                                  .flat_vcol_shading = pbvh->flat_vcol_shading,
+                                  .mesh = me};
+  update->filled = MEM_calloc_arrayN(totnode, sizeof(*update->filled), __func__);
+  update->flushed = MEM_calloc_arrayN(totnode, sizeof(*update->flushed), __func__);
+  update->totflushed = 0;
+  update->first_unflushed = 0;
+  update->pool = BLI_task_pool_create(update, TASK_PRIORITY_HIGH);
 
-  TaskParallelSettings settings;
-  BKE_pbvh_parallel_range_settings(&settings, true, totnode);
-  BLI_task_parallel_range(0, totnode, &data, pbvh_update_draw_buffer_cb, &settings);
+  for (int n = 0; n < totnode; n++) {
+    BLI_task_pool_push(
+        update->pool, pbvh_update_draw_buffer_task, POINTER_FROM_INT(n), false, NULL);
+  }
+}
 
-  for (int i = 0; i < totnode; i++) {
-    PBVHNode *node = nodes[i];
+/* Upload the nodes whose fill task finished. */
+static void pbvh_update_draw_buffers_flush_filled(PBVHDrawUpdate *update)
+{
+  while (update->first_unflushed < update->data.totnode &&
+         update->flushed[update->first_unflushed]) {
+    update->first_unflushed++;
+  }
+
+  for (int n = update->first_unflushed; n < update->data.totnode; n++) {
+    if (update->flushed[n] || !atomic_fetch_and_or_uint8(update->filled + n, 0)) {
+      continue;
+    }
+
+    PBVHNode *node = update->data.nodes[n];
 
     if (node->flag & PBVH_UpdateDrawBuffers) {
       /* Flush buffers uses OpenGL, so not in parallel. */
@@ -1778,9 +1841,28 @@ static void pbvh_update_draw_buffers(
     }
 
     node->flag &= ~(PBVH_RebuildDrawBuffers | PBVH_UpdateDrawBuffers);
+
+    update->flushed[n] = true;
+    update->totflushed++;
   }
 }
 
+static void pbvh_update_draw_buffers_end(PBVHDrawUpdate *update)
+{
+  pbvh_update_draw_buffers_flush_filled(update);
+
+  if (update->totflushed < update->data.totnode) {
+    BLI_task_pool_work_and_wait(update->pool);
+    pbvh_update_draw_buffers_flush_filled(update);
+  }
+
+  BLI_assert(update->totflushed == update->data.totnode);
+
+  BLI_task_pool_free(update->pool);
+  MEM_freeN(update->filled);
+  MEM_freeN(update->flushed);
+}
+
 static int pbvh_flush_bb(PBVH *pbvh, PBVHNode *node, int flag)
 {
   int update = 0;
@@ -2140,7 +2222,8 @@ void BKE_pbvh_node_mark_original_update(PBVHNode *node)
 void BKE_pbvh_node_mark_update(PBVHNode *node)
 {
   node->flag |= PBVH_UpdateNormals | PBVH_UpdateBB | PBVH_UpdateOriginalBB |
-                PBVH_UpdateDrawBuffers | PBVH_UpdateRedraw | PBVH_UpdateCurvatureDir;
+                PBVH_UpdateDrawBuffers | PBVH_UpdateRedraw | PBVH_UpdateCurvatureDir |
+                PBVH_UpdateAutomasking | PBVH_UpdatePoseIKChain;
 }
 
 void BKE_pbvh_node_mark_update_mask(PBVHNode *node)
@@ -2156,13 +2239,14 @@ void BKE_pbvh_node_mark_update_color(PBVHNode *node)
 void BKE_pbvh_node_mark_update_visibility(PBVHNode *node)
 {
   node->flag |= PBVH_UpdateVisibility | PBVH_RebuildDrawBuffers | PBVH_UpdateDrawBuffers |
-                PBVH_UpdateRedraw | PBVH_UpdateCurvatureDir;
+                PBVH_UpdateRedraw | PBVH_UpdateCurvatureDir | PBVH_UpdateAutomasking |
+                PBVH_UpdatePoseIKChain;
 }
 
 void BKE_pbvh_node_mark_rebuild_draw(PBVHNode *node)
 {
   node->flag |= PBVH_RebuildDrawBuffers | PBVH_UpdateDrawBuffers | PBVH_UpdateRedraw |
-                PBVH_UpdateCurvatureDir;
+                PBVH_UpdateCurvatureDir | PBVH_UpdateAutomasking | PBVH_UpdatePoseIKChain;
 }
 
 void BKE_pbvh_node_mark_redraw(PBVHNode *node)
@@ -2172,7 +2256,8 @@ void BKE_pbvh_node_mark_redraw(PBVHNode *node)
 
 void BKE_pbvh_node_mark_normals_update(PBVHNode *node)
 {
-  node->flag |= PBVH_UpdateNormals | PBVH_UpdateCurvatureDir;
+  node->flag |= PBVH_UpdateNormals | PBVH_UpdateCurvatureDir | PBVH_UpdateAutomasking |
+                PBVH_UpdatePoseIKChain;
 }
 
 void BKE_pbvh_node_mark_curvature_update(PBVHNode *node)
@@ -2195,6 +2280,36 @@ bool BKE_pbvh_curvature_update_get(PBVHNode *node)
   return node->flag & PBVH_UpdateCurvatureDir;
 }
 
+void BKE_pbvh_automasking_update_set(PBVHNode *node, bool state)
+{
+  if (state) {
+    node->flag |= PBVH_UpdateAutomasking;
+  }
+  else {
+    node->flag &= ~PBVH_UpdateAutomasking;
+  }
+}
+
+bool BKE_pbvh_automasking_update_get(PBVHNode *node)
+{
+  return node->flag & PBVH_UpdateAutomasking;
+}
+
+void BKE_pbvh_pose_ik_chain_update_set(PBVHNode *node, bool state)
+{
+  if (state) {
+    node->flag |= PBVH_UpdatePoseIKChain;
+  }
+  else {
+    node->flag &= ~PBVH_UpdatePoseIKChain;
+  }
+}
+
+bool BKE_pbvh_pose_ik_chain_update_get(PBVHNode *node)
+{
+  return node->flag & PBVH_UpdatePoseIKChain;
+}
+
 void BKE_pbvh_node_fully_hidden_set(PBVHNode *node, int fully_hidden)
 {
   BLI_assert(node->flag & PBVH_Leaf);
@@ -3243,6 +3358,23 @@ static bool pbvh_draw_search_cb(PBVHNode *node, void *data_v)
   return true;
 }
 
+static void pbvh_draw_node(PBVHNode *node,
+                           void (*draw_fn)(void *user_data, GPU_PBVH_Buffers *buffers),
+                           void *user_data)
+{
+  if (node->flag & PBVH_FullyHidden) {
+    return;
+  }
+
+  if (node->draw_buffers) {
+    draw_fn(user_data, node->draw_buffers);
+  }
+
+  for (int i = 0; i < node->tot_mat_draw_buffers; i++) {
+    draw_fn(user_data, node->mat_draw_buffers[i]);
+  }
+}
+
 void BKE_pbvh_draw_cb(PBVH *pbvh,
                       Mesh *me,
                       bool update_only_visible,
@@ -3254,6 +3386,8 @@ void BKE_pbvh_draw_cb(PBVH *pbvh,
   PBVHNode **nodes;
   int totnode;
   int update_flag = 0;
+  PBVHDrawUpdate update;
+  bool updating = false;
 
   /* Search for nodes that need updates. */
   if (update_only_visible) {
@@ -3293,28 +3427,53 @@ void BKE_pbvh_draw_cb(PBVH *pbvh,
       return;
     }
 
-    pbvh_update_draw_buffers(pbvh, me, nodes, totnode, update_flag);
+    pbvh_update_draw_buffers_begin(pbvh, me, nodes, totnode, update_flag, &update);
+    updating = true;
+  }
+
+  /* Nodes still being filled are drawn once their buffers are flushed. */
+  BLI_bitmap *pending = NULL;
+  if (updating) {
+    pending = BLI_BITMAP_NEW(pbvh->totnode, __func__);
+
+    for (int i = 0; i < totnode; i++) {
+      BLI_BITMAP_ENABLE(pending, nodes[i] - pbvh->nodes);
+    }
   }
-  MEM_SAFE_FREE(nodes);
 
   /* Draw visible nodes. */
+  PBVHNode **draw_nodes;
+  int totdraw;
   PBVHDrawSearchData draw_data = {.frustum = draw_frustum, .accum_update_flag = 0};
-  BKE_pbvh_search_gather(pbvh, pbvh_draw_search_cb, &draw_data, &nodes, &totnode);
+  BKE_pbvh_search_gather(pbvh, pbvh_draw_search_cb, &draw_data, &draw_nodes, &totdraw);
 
-  for (int i = 0; i < totnode; i++) {
-    PBVHNode *node = nodes[i];
-    if (!(node->flag & PBVH_FullyHidden)) {
-      if (node->draw_buffers) {
-        draw_fn(user_data, node->draw_buffers);
-      }
+  for (int i = 0; i < totdraw; i++) {
+    PBVHNode *node = draw_nodes[i];
+    if (pending == NULL || !BLI_BITMAP_TEST(pending, node - pbvh->nodes)) {
+      pbvh_draw_node(node, draw_fn, user_data);
+    }
 
-      for (int i = 0; i < node->tot_mat_draw_buffers; i++) {
-        draw_fn(user_data, node->mat_draw_buffers[i]);
+    /* Upload what is packed so far while the tasks keep packing the other nodes. */
+    if (updating && (i % PBVH_DRAW_FLUSH_INTERVAL) == PBVH_DRAW_FLUSH_INTERVAL - 1) {
+      pbvh_update_draw_buffers_flush_filled(&update);
+    }
+  }
+
+  if (updating) {
+    pbvh_update_draw_buffers_end(&update);
+
+    for (int i = 0; i < totdraw; i++) {
+      PBVHNode *node = draw_nodes[i];
+      if (BLI_BITMAP_TEST(pending, node - pbvh->nodes)) {
+        pbvh_draw_node(node, draw_fn, user_data);
       }
     }
+
+    MEM_freeN(pending);
   }
 
   MEM_SAFE_FREE(nodes);
+  MEM_SAFE_FREE(draw_nodes);
 }
 
 // bad global from gpu_buffers.c
@@ -952,13 +952,12 @@ void BKE_pbvh_bmesh_update_origvert(
     }
   }
 
-  if (r_color && pbvh->vcol_type != -1) {
-    BKE_pbvh_bmesh_get_vcol(
-        v, mv->origcolor, pbvh->vcol_type, pbvh->vcol_domain, pbvh->cd_vcol_offset);
+  if (r_color && pbvh->vcol_type != -1 && pbvh->cd_sculpt_vert_cold != -1) {
+    MSculptVertCold *mv_cold = BKE_PBVH_SCULPTVERT_COLD(pbvh->cd_sculpt_vert_cold, v);
 
-    if (r_color) {
-      *r_color = mv->origcolor;
-    }
+    BKE_pbvh_bmesh_get_vcol(
+        v, mv_cold->origcolor, pbvh->vcol_type, pbvh->vcol_domain, pbvh->cd_vcol_offset);
+    *r_color = mv_cold->origcolor;
   }
   else if (r_color) {
     *r_color = NULL;
@@ -2327,6 +2326,7 @@ void BKE_pbvh_update_sculpt_verts(BMesh *bm,
   BMIter iter;
 
   int totuv = do_uvs ? CustomData_number_of_layers(&bm->ldata, CD_MLOOPUV) : 0;
+  const int cd_sculpt_vert_cold = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT_COLD);
 
   BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
     MSculptVert *mv = BKE_PBVH_SCULPTVERT(cd_sculpt_vert, v);
@@ -2348,11 +2348,17 @@ void BKE_pbvh_update_sculpt_verts(BMesh *bm,
     copy_v3_v3(mv->origco, v->co);
     copy_v3_v3(mv->origno, v->no);
 
+    if (cd_sculpt_vert_cold == -1) {
+      continue;
+    }
+
+    MSculptVertCold *mv_cold = BKE_PBVH_SCULPTVERT_COLD(cd_sculpt_vert_cold, v);
+
     if (vcol_type != -1) {
-      BKE_pbvh_bmesh_get_vcol(v, mv->origcolor, vcol_type, vcol_domain, cd_vcol_offset);
+      BKE_pbvh_bmesh_get_vcol(v, mv_cold->origcolor, vcol_type, vcol_domain, cd_vcol_offset);
     }
     else {
-      zero_v4(mv->origcolor);
+      zero_v4(mv_cold->origcolor);
     }
   }
 }
@@ -2377,6 +2383,7 @@ void BKE_pbvh_build_bmesh(PBVH *pbvh,
   pbvh->cd_face_node_offset = cd_face_node_offset;
   pbvh->cd_vert_mask_offset = CustomData_get_offset(&bm->vdata, CD_PAINT_MASK);
   pbvh->cd_sculpt_vert = cd_sculpt_vert;
+  pbvh->cd_sculpt_vert_cold = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT_COLD);
 
   smooth_shading |= fast_draw;
 
@@ -4040,6 +4047,302 @@ static void pbvh_bmesh_join_nodes(PBVH *bvh)
   MEM_freeN(map);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Incremental Rebalancing
+ *
+ * Runs after every stroke within a fixed time budget. Leaves that overflowed the leaf limit
+ * are split first, then sibling leaf pairs whose split became poor (high surface area
+ * heuristic cost, typically heavily overlapping children after dyntopo) get their faces
+ * re-partitioned in place along the best SAH plane. Underfull subtrees are merged by
+ * #pbvh_bmesh_join_nodes. Node indices are kept, so no compaction is needed and work that
+ * doesn't fit in the budget is simply picked up after the next stroke.
+ * \{ */
+
+#define PBVH_REBALANCE_TIME_LIMIT 0.005
+#define PBVH_REBALANCE_MIN_COST 0.7f
+#define PBVH_REBALANCE_MIN_GAIN 0.85f
+#define PBVH_SAH_BINS 16
+
+typedef struct PBVHSAHBin {
+  BB bb;
+  int count;
+} PBVHSAHBin;
+
+static int pbvh_sah_bin_index(const BB *cb, const int axis, const float co)
+{
+  const float extent = cb->bmax[axis] - cb->bmin[axis];
+  const int bin = (int)((co - cb->bmin[axis]) / extent * (float)PBVH_SAH_BINS);
+
+  return clamp_i(bin, 0, PBVH_SAH_BINS - 1);
+}
+
+/**
+ * Binned SAH split of `bbcs` by centroid. Returns the cost of the best split, or FLT_MAX when
+ * the centroids can't be separated. Faces go to the first child when their bin is
+ * `<= *r_bin` along `*r_axis`.
+ */
+static float pbvh_sah_best_split(
+    const BBC *bbcs, const int totface, const BB *cb, int *r_axis, int *r_bin)
+{
+  float best_cost = FLT_MAX;
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (cb->bmax[axis] - cb->bmin[axis] < FLT_EPSILON) {
+      continue;
+    }
+
+    PBVHSAHBin bins[PBVH_SAH_BINS];
+    for (int i = 0; i < PBVH_SAH_BINS; i++) {
+      BB_reset(&bins[i].bb);
+      bins[i].count = 0;
+    }
+
+    for (int i = 0; i < totface; i++) {
+      PBVHSAHBin *bin = bins + pbvh_sah_bin_index(cb, axis, bbcs[i].bcentroid[axis]);
+
+      BB_expand_with_bb(&bin->bb, (BB *)(bbcs + i));
+      bin->count++;
+    }
+
+    /* Sweep from the right to get the cost of every right hand side. */
+    float right_area[PBVH_SAH_BINS];
+    int right_count[PBVH_SAH_BINS];
+    BB bb;
+    int count = 0;
+
+    BB_reset(&bb);
+    for (int i = PBVH_SAH_BINS - 1; i > 0; i--) {
+      BB_expand_with_bb(&bb, &bins[i].bb);
+      count += bins[i].count;
+      right_area[i] = count ? BB_surface_area(&bb) : 0.0f;
+      right_count[i] = count;
+    }
+
+    BB_reset(&bb);
+    count = 0;
+    for (int i = 0; i < PBVH_SAH_BINS - 1; i++) {
+      BB_expand_with_bb(&bb, &bins[i].bb);
+      count += bins[i].count;
+
+      if (count == 0 || right_count[i + 1] == 0) {
+        continue;
+      }
+
+      const float cost = BB_surface_area(&bb) * (float)count +
+                         right_area[i + 1] * (float)right_count[i + 1];
+
+      if (cost < best_cost) {
+        best_cost = cost;
+        *r_axis = axis;
+        *r_bin = i;
+      }
+    }
+  }
+
+  return best_cost;
+}
+
+/* Normalized SAH cost of the split between two sibling leaves, 1.0 for fully overlapping
+ * children. */
+static float pbvh_bmesh_leaf_pair_cost(PBVHNode *c1, PBVHNode *c2)
+{
+  const int n1 = BLI_table_gset_len(c1->bm_faces);
+  const int n2 = BLI_table_gset_len(c2->bm_faces);
+
+  if (n1 == 0 || n2 == 0) {
+    /* Left behind by dyntopo collapses, bounds of the empty leaf are invalid. */
+    return n1 + n2 > 1 ? 1.0f : 0.0f;
+  }
+
+  BB bb = c1->vb;
+  BB_expand_with_bb(&bb, &c2->vb);
+
+  const float area = BB_surface_area(&bb) * (float)(n1 + n2);
+  if (area == 0.0f) {
+    return 0.0f;
+  }
+
+  return (BB_surface_area(&c1->vb) * (float)n1 + BB_surface_area(&c2->vb) * (float)n2) / area;
+}
+
+static void pbvh_bmesh_leaf_clear(PBVH *pbvh, PBVHNode *node)
+{
+#ifdef PROXY_ADVANCED
+  BKE_pbvh_free_proxyarray(pbvh, node);
+#endif
+
+  if (node->tribuf || node->tri_buffers) {
+    BKE_pbvh_bmesh_free_tris(pbvh, node);
+  }
+
+  pbvh_free_all_draw_buffers(node);
+  MEM_SAFE_FREE(node->layer_disp);
+
+  BLI_table_gset_free(node->bm_faces, NULL);
+  BLI_table_gset_free(node->bm_other_verts, NULL);
+  node->bm_faces = NULL;
+  node->bm_other_verts = NULL;
+}
+
+/* Re-partitions the faces of the sibling leaves at `ci` and `ci + 1` along the best SAH plane,
+ * returns false if that wouldn't improve the current split. */
+static bool pbvh_bmesh_leaf_pair_repartition(PBVH *pbvh, const int ci)
+{
+  const int cd_vert_node_offset = pbvh->cd_vert_node_offset;
+  const int cd_face_node_offset = pbvh->cd_face_node_offset;
+  PBVHNode *children[2] = {pbvh->nodes + ci, pbvh->nodes + ci + 1};
+
+  const int totface = BLI_table_gset_len(children[0]->bm_faces) +
+                      BLI_table_gset_len(children[1]->bm_faces);
+  if (totface < 2) {
+    return false;
+  }
+
+  BMFace **faces = MEM_malloc_arrayN(totface, sizeof(*faces), __func__);
+  BBC *bbcs = MEM_malloc_arrayN(totface, sizeof(*bbcs), __func__);
+  BB child_bb[2], cb;
+  float cur_cost = 0.0f;
+  int i = 0;
+
+  BB_reset(&cb);
+
+  for (int j = 0; j < 2; j++) {
+    BMFace *f;
+    int count = 0;
+
+    BB_reset(&child_bb[j]);
+
+    TGSET_ITER (f, children[j]->bm_faces) {
+      BBC *bbc = bbcs + i;
+      BMLoop *l_iter = f->l_first;
+
+      BB_reset((BB *)bbc);
+      do {
+        BB_expand((BB *)bbc, l_iter->v->co);
+      } while ((l_iter = l_iter->next) != f->l_first);
+      BBC_update_centroid(bbc);
+
+      BB_expand_with_bb(&child_bb[j], (BB *)bbc);
+      BB_expand(&cb, bbc->bcentroid);
+
+      faces[i++] = f;
+      count++;
+    }
+    TGSET_ITER_END
+
+    cur_cost += count ? BB_surface_area(&child_bb[j]) * (float)count : 0.0f;
+  }
+
+  int axis, bin;
+  const float cost = pbvh_sah_best_split(bbcs, totface, &cb, &axis, &bin);
+
+  if (cost == FLT_MAX || cost > cur_cost * PBVH_REBALANCE_MIN_GAIN) {
+    MEM_freeN(faces);
+    MEM_freeN(bbcs);
+    return false;
+  }
+
+  /* Vertices owned by either leaf are redistributed with the same plane so every one of them
+   * keeps an owner, see #pbvh_bmesh_node_split. */
+  const float plane = cb.bmin[axis] +
+                      (cb.bmax[axis] - cb.bmin[axis]) * (float)(bin + 1) / (float)PBVH_SAH_BINS;
+  TableGSet *unique_verts[2] = {BLI_table_gset_new("bm_unique_verts"),
+                                BLI_table_gset_new("bm_unique_verts")};
+
+  for (int j = 0; j < 2; j++) {
+    BMVert *v;
+
+    TGSET_ITER (v, children[j]->bm_unique_verts) {
+      const int side = v->co[axis] < plane ? 0 : 1;
+
+      BLI_table_gset_add(unique_verts[side], v);
+      BM_ELEM_CD_SET_INT(v, cd_vert_node_offset, ci + side);
+    }
+    TGSET_ITER_END
+
+    BLI_table_gset_free(children[j]->bm_unique_verts, NULL);
+    children[j]->bm_unique_verts = unique_verts[j];
+
+    pbvh_bmesh_leaf_clear(pbvh, children[j]);
+    children[j]->bm_faces = BLI_table_gset_new_ex("bm_faces", totface / 2);
+  }
+
+  for (i = 0; i < totface; i++) {
+    const int side = pbvh_sah_bin_index(&cb, axis, bbcs[i].bcentroid[axis]) <= bin ? 0 : 1;
+    BLI_table_gset_insert(children[side]->bm_faces, faces[i]);
+  }
+
+  pbvh_bmesh_node_finalize(pbvh, ci, cd_vert_node_offset, cd_face_node_offset, false);
+  pbvh_bmesh_node_finalize(pbvh, ci + 1, cd_vert_node_offset, cd_face_node_offset, false);
+
+  MEM_freeN(faces);
+  MEM_freeN(bbcs);
+
+  return true;
+}
+
+static void pbvh_bmesh_rebalance_incremental(PBVH *pbvh, const double time_limit)
+{
+  const double start_time = PIL_check_seconds_timer();
+  bool modified = false;
+
+  /* Split leaves that overflowed during the stroke. */
+  const int totnode = pbvh->totnode;
+  for (int i = 0; i < totnode; i++) {
+    if (pbvh->nodes[i].flag & PBVH_Leaf) {
+      modified |= pbvh_bmesh_node_limit_ensure(pbvh, i);
+
+      if (PIL_check_seconds_timer() - start_time > time_limit) {
+        break;
+      }
+    }
+  }
+
+  /* Re-partition the worst sibling leaf pairs first. */
+  struct SortIntByFloat *pairs = MEM_malloc_arrayN(pbvh->totnode, sizeof(*pairs), __func__);
+  int totpair = 0;
+
+  for (int i = 0; i < pbvh->totnode; i++) {
+    PBVHNode *node = pbvh->nodes + i;
+
+    if (node->flag & PBVH_Leaf) {
+      continue;
+    }
+
+    PBVHNode *c1 = pbvh->nodes + node->children_offset;
+    PBVHNode *c2 = c1 + 1;
+
+    if (!(c1->flag & PBVH_Leaf) || !(c2->flag & PBVH_Leaf)) {
+      continue;
+    }
+
+    const float cost = pbvh_bmesh_leaf_pair_cost(c1, c2);
+    if (cost > PBVH_REBALANCE_MIN_COST) {
+      pairs[totpair].sort_value = cost;
+      pairs[totpair].data = node->children_offset;
+      totpair++;
+    }
+  }
+
+  qsort(pairs, (size_t)totpair, sizeof(*pairs), BLI_sortutil_cmp_float_reverse);
+
+  for (int i = 0; i < totpair; i++) {
+    if (PIL_check_seconds_timer() - start_time > time_limit) {
+      break;
+    }
+
+    modified |= pbvh_bmesh_leaf_pair_repartition(pbvh, pairs[i].data);
+  }
+
+  if (modified) {
+    BKE_pbvh_update_bounds(pbvh, (PBVH_UpdateBB | PBVH_UpdateOriginalBB | PBVH_UpdateRedraw));
+  }
+
+  MEM_freeN(pairs);
+}
+
+/** \} */
+
 void BKE_pbvh_bmesh_after_stroke(PBVH *pbvh, bool force_balance)
 {
   int totnode = pbvh->totnode;
@@ -4052,10 +4355,9 @@ void BKE_pbvh_bmesh_after_stroke(PBVH *pbvh, bool force_balance)
 
   BKE_pbvh_update_bounds(pbvh, (PBVH_UpdateBB | PBVH_UpdateOriginalBB | PBVH_UpdateRedraw));
 
-  if (force_balance || pbvh->balance_counter++ == 10) {
+  if (force_balance) {
     pbvh_bmesh_balance_tree(pbvh);
     pbvh_bmesh_check_nodes(pbvh);
-    pbvh->balance_counter = 0;
 
     totnode = pbvh->totnode;
 
@@ -4075,6 +4377,10 @@ void BKE_pbvh_bmesh_after_stroke(PBVH *pbvh, bool force_balance)
       }
     }
   }
+  else {
+    pbvh_bmesh_rebalance_incremental(pbvh, PBVH_REBALANCE_TIME_LIMIT);
+    pbvh_bmesh_check_nodes(pbvh);
+  }
 
   pbvh_print_mem_size(pbvh);
 }
@@ -4120,6 +4426,7 @@ void BKE_pbvh_update_offsets(PBVH *pbvh,
   pbvh->cd_face_area = cd_face_areas;
   pbvh->cd_vert_mask_offset = CustomData_get_offset(&pbvh->bm->vdata, CD_PAINT_MASK);
   pbvh->cd_sculpt_vert = cd_sculpt_vert;
+  pbvh->cd_sculpt_vert_cold = CustomData_get_offset(&pbvh->bm->vdata, CD_DYNTOPO_VERT_COLD);
   pbvh->cd_faceset_offset = CustomData_get_offset(&pbvh->bm->pdata, CD_SCULPT_FACE_SETS);
 
   pbvh->totuv = CustomData_number_of_layers(&pbvh->bm->ldata, CD_MLOOPUV);
@@ -5611,6 +5918,7 @@ void pbvh_bmesh_cache_test(CacheParams *params, BMesh **r_bm, PBVH **r_pbvh_out)
 
   BM_data_layer_add(bm, &bm->vdata, CD_PAINT_MASK);
   BM_data_layer_add(bm, &bm->vdata, CD_DYNTOPO_VERT);
+  BM_data_layer_add(bm, &bm->vdata, CD_DYNTOPO_VERT_COLD);
   BM_data_layer_add(bm, &bm->vdata, CD_PROP_COLOR);
 
   for (int side = 0; side < 6; side++) {
@@ -6157,6 +6465,7 @@ static void pbvh_bmesh_fetch_cdrefs(PBVH *pbvh)
   pbvh->cd_vert_mask_offset = CustomData_get_offset(&bm->vdata, CD_PAINT_MASK);
   pbvh->cd_faceset_offset = CustomData_get_offset(&bm->pdata, CD_SCULPT_FACE_SETS);
   pbvh->cd_sculpt_vert = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT);
+  pbvh->cd_sculpt_vert_cold = CustomData_get_offset(&bm->vdata, CD_DYNTOPO_VERT_COLD);
 }
 
 void BKE_pbvh_bmesh_set_toolflags(PBVH *pbvh, bool use_toolflags)
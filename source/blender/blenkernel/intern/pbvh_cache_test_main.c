@@ -1,31 +1,1236 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+/** \file
+ * \ingroup bke
+ *
+ * Headless PBVH benchmark.
+ *
+ * Generates torus meshes of a requested triangle count, builds PBVH_FACES, PBVH_GRIDS and
+ * PBVH_BMESH trees over them and replays a scripted stroke of brush stamps.  Every stamp
+ * raycasts the tree to find the surface, displaces the vertices under the brush, runs dyntopo
+ * (PBVH_BMESH only) and then updates bounds and normals, the same order sculpt mode uses.
+ *
+ * The "origdata" phase reads the original coordinates and normals of the vertices under the
+ * brush like most brushes do, "origdata_fused" does the same on the fused #MSculptVert layout
+ * that also held original colors and curvature directions (PBVH_FACES and PBVH_GRIDS only).
+ * Use `--tris 10000000` for meshes of about five million vertices.
+ *
+ * After the stroke PBVH_BMESH runs a detail flood fill, remeshing the whole torus to a detail
+ * size of `--flood-detail` times the one it was built with (0 skips it).
+ *
+ * Per-phase wall time, hardware cache counters summed over all threads of the process (Linux
+ * only, -1 elsewhere or when the kernel refuses perf events) and guarded-alloc memory usage are
+ * written as JSON so that regressions can be tracked by scripts.
+ *
+ * Usage:
+ *
+ *   pbvh_cache_test [--tris 100000,1000000] [--types faces,grids,bmesh] [--stamps 200]
+ *                   [--radius 0.1] [--strength 0.02] [--flood-detail 0.75] [--threads 0]
+ *                   [--output result.json]
+ */
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_compiler_compat.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
+#include "BKE_ccg.h"
 #include "BKE_customdata.h"
+#include "BKE_DerivedMesh.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_mapping.h"
 #include "BKE_pbvh.h"
 
 #include "DNA_customdata_types.h"
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
 
+#include "CLG_log.h"
+#include "PIL_time.h"
+
 #include "bmesh.h"
+#include "bmesh_log.h"
 #include "pbvh_intern.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <math.h>
 
-// void pbvh_bmesh_do_cache_test(void);
+#ifdef __linux__
+#  include <dirent.h>
+#  include <linux/perf_event.h>
+#  include <sys/ioctl.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#  define WITH_PERF_EVENTS
+#endif
+
+/* -------------------------------------------------------------------- */
+/** \name Phase Statistics
+ * \{ */
+
+typedef enum BenchPhase {
+  BENCH_PHASE_BUILD = 0,
+  BENCH_PHASE_RAYCAST,
+  BENCH_PHASE_ORIGDATA,
+  BENCH_PHASE_ORIGDATA_FUSED,
+  BENCH_PHASE_STAMP,
+  BENCH_PHASE_TOPOLOGY,
+  BENCH_PHASE_BOUNDS,
+  BENCH_PHASE_NORMALS,
+  BENCH_PHASE_FLOOD_FILL,
+  BENCH_PHASE_TOT,
+} BenchPhase;
+
+static const char *bench_phase_names[BENCH_PHASE_TOT] = {"build",
+                                                         "raycast",
+                                                         "origdata",
+                                                         "origdata_fused",
+                                                         "stamp",
+                                                         "topology",
+                                                         "bounds",
+                                                         "normals",
+                                                         "flood_fill"};
+
+typedef struct BenchCounters {
+  double time;
+  int64_t cache_misses;
+  int64_t cache_refs;
+} BenchCounters;
+
+typedef struct BenchPhaseStats {
+  double seconds;
+  int64_t cache_misses;
+  int64_t cache_refs;
+  int calls;
+} BenchPhaseStats;
+
+static bool perf_available = false;
+
+#ifdef WITH_PERF_EVENTS
+/**
+ * Counters of one thread of the process. Inherited counters only add up the counts of child
+ * threads once they exit, while the task scheduler keeps its workers alive for the whole run, so
+ * every thread gets its own counters and they are summed on read.
+ */
+typedef struct BenchPerfThread {
+  int tid;
+  int fd_misses;
+  int fd_refs;
+} BenchPerfThread;
+
+static BenchPerfThread *perf_threads = NULL;
+static int perf_threads_len = 0;
+static int perf_threads_size = 0;
+
+static int perf_event_open_counter(int tid, uint64_t config)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  return (int)syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+}
+
+static int64_t perf_counter_read(int fd)
+{
+  int64_t value;
+
+  if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+    return -1;
+  }
+
+  return value;
+}
+
+static bool perf_thread_add(int tid)
+{
+  for (int i = 0; i < perf_threads_len; i++) {
+    if (perf_threads[i].tid == tid) {
+      return true;
+    }
+  }
+
+  BenchPerfThread thread;
+  thread.tid = tid;
+  thread.fd_misses = perf_event_open_counter(tid, PERF_COUNT_HW_CACHE_MISSES);
+  thread.fd_refs = perf_event_open_counter(tid, PERF_COUNT_HW_CACHE_REFERENCES);
+
+  if (thread.fd_misses < 0 || thread.fd_refs < 0) {
+    if (thread.fd_misses >= 0) {
+      close(thread.fd_misses);
+    }
+    if (thread.fd_refs >= 0) {
+      close(thread.fd_refs);
+    }
+    return false;
+  }
+
+  if (perf_threads_len == perf_threads_size) {
+    perf_threads_size = perf_threads_size ? perf_threads_size * 2 : 32;
+    perf_threads = MEM_reallocN(perf_threads, sizeof(*perf_threads) * perf_threads_size);
+  }
+  perf_threads[perf_threads_len++] = thread;
+
+  return true;
+}
+
+/**
+ * Open counters for the threads that appeared since the last call. A thread is only counted from
+ * the first read after it started, the task scheduler is warmed up before the first phase so its
+ * workers already exist by then. Counters of threads that exited keep their final value.
+ */
+static void perf_threads_update(void)
+{
+  DIR *dir = opendir("/proc/self/task");
+  if (!dir) {
+    return;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(dir))) {
+    const int tid = atoi(entry->d_name);
+    if (tid > 0) {
+      perf_thread_add(tid);
+    }
+  }
+
+  closedir(dir);
+}
+#endif
+
+static void bench_counters_init(void)
+{
+#ifdef WITH_PERF_EVENTS
+  perf_available = perf_thread_add((int)syscall(SYS_gettid));
+#endif
+}
+
+static void bench_counters_exit(void)
+{
+#ifdef WITH_PERF_EVENTS
+  for (int i = 0; i < perf_threads_len; i++) {
+    close(perf_threads[i].fd_misses);
+    close(perf_threads[i].fd_refs);
+  }
+  MEM_SAFE_FREE(perf_threads);
+  perf_threads_len = perf_threads_size = 0;
+#endif
+  perf_available = false;
+}
+
+static void bench_counters_get(BenchCounters *r_counters)
+{
+  r_counters->time = PIL_check_seconds_timer();
+  r_counters->cache_misses = -1;
+  r_counters->cache_refs = -1;
+
+#ifdef WITH_PERF_EVENTS
+  if (!perf_available) {
+    return;
+  }
+
+  perf_threads_update();
+
+  int64_t misses = 0, refs = 0;
+  for (int i = 0; i < perf_threads_len; i++) {
+    const int64_t thread_misses = perf_counter_read(perf_threads[i].fd_misses);
+    const int64_t thread_refs = perf_counter_read(perf_threads[i].fd_refs);
+    if (thread_misses < 0 || thread_refs < 0) {
+      return;
+    }
+    misses += thread_misses;
+    refs += thread_refs;
+  }
+
+  r_counters->cache_misses = misses;
+  r_counters->cache_refs = refs;
+#endif
+}
+
+static void bench_phase_end(BenchPhaseStats *stats, const BenchCounters *start)
+{
+  BenchCounters end;
+  bench_counters_get(&end);
+
+  stats->seconds += end.time - start->time;
+  stats->calls++;
+
+  if (start->cache_misses >= 0 && end.cache_misses >= 0) {
+    stats->cache_misses += end.cache_misses - start->cache_misses;
+  }
+  else {
+    stats->cache_misses = -1;
+  }
+
+  if (start->cache_refs >= 0 && end.cache_refs >= 0) {
+    stats->cache_refs += end.cache_refs - start->cache_refs;
+  }
+  else {
+    stats->cache_refs = -1;
+  }
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Test Meshes
+ *
+ * All test meshes are tori, they are closed and have no seams so the vertex
+ * index of a parametric (u, v) sample is trivial to compute.
+ * \{ */
+
+#define TORUS_MAJOR_RADIUS 1.0f
+#define TORUS_MINOR_RADIUS 0.35f
+
+static void torus_eval(float u, float v, float r_co[3], float r_no[3])
+{
+  const float su = sinf(u * (float)M_PI * 2.0f), cu = cosf(u * (float)M_PI * 2.0f);
+  const float sv = sinf(v * (float)M_PI * 2.0f), cv = cosf(v * (float)M_PI * 2.0f);
+
+  r_no[0] = cu * cv;
+  r_no[1] = su * cv;
+  r_no[2] = sv;
+
+  r_co[0] = cu * TORUS_MAJOR_RADIUS + r_no[0] * TORUS_MINOR_RADIUS;
+  r_co[1] = su * TORUS_MAJOR_RADIUS + r_no[1] * TORUS_MINOR_RADIUS;
+  r_co[2] = r_no[2] * TORUS_MINOR_RADIUS;
+}
+
+/** Quad torus with `2 * nv * nv` quads, i.e. `4 * nv * nv` triangles. */
+static Mesh *bench_mesh_torus(int tottri)
+{
+  const int nv = max_ii((int)sqrtf((float)tottri / 4.0f), 3);
+  const int nu = nv * 2;
+  const int totvert = nu * nv;
+  const int totpoly = nu * nv;
+
+  Mesh *me = BKE_mesh_new_nomain(totvert, 0, 0, totpoly * 4, totpoly);
+
+  for (int i = 0; i < nu; i++) {
+    for (int j = 0; j < nv; j++) {
+      float no[3];
+      torus_eval((float)i / (float)nu, (float)j / (float)nv, me->mvert[i * nv + j].co, no);
+    }
+  }
+
+  MPoly *mp = me->mpoly;
+  MLoop *ml = me->mloop;
+
+  for (int i = 0; i < nu; i++) {
+    const int i2 = (i + 1) % nu;
+
+    for (int j = 0; j < nv; j++, mp++) {
+      const int j2 = (j + 1) % nv;
+
+      mp->loopstart = (int)(ml - me->mloop);
+      mp->totloop = 4;
+      mp->flag = ME_SMOOTH;
+
+      (ml++)->v = i * nv + j;
+      (ml++)->v = i2 * nv + j;
+      (ml++)->v = i2 * nv + j2;
+      (ml++)->v = i * nv + j2;
+    }
+  }
+
+  BKE_mesh_calc_edges(me, false, false);
+
+  return me;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name PBVH Construction
+ * \{ */
+
+typedef struct BenchPBVH {
+  PBVHType type;
+  PBVH *pbvh;
+
+  /* PBVH_FACES */
+  Mesh *me;
+  MLoopTri *looptri;
+  MeshElemMap *pmap;
+  int *pmap_mem;
+
+  /* PBVH_GRIDS */
+  CCGKey key;
+  CCGElem **grids;
+  void *grid_mem;
+  void **gridfaces;
+  DMFlagMat *flagmats;
+  BLI_bitmap **grid_hidden;
+
+  /* PBVH_BMESH */
+  BMesh *bm;
+  BMLog *bm_log;
+
+  MSculptVert *msculptverts;
+  struct BenchSculptVertFused *msculptverts_fused;
+  float *face_areas;
+
+  int totvert, tottri;
+} BenchPBVH;
+
+/** #MSculptVert as it was before the rarely used members moved to #MSculptVertCold. */
+typedef struct BenchSculptVertFused {
+  unsigned short valence;
+  short stroke_id;
+  int flag;
+  float origco[3], origno[3];
+  float origcolor[4];
+  unsigned short origmask;
+  unsigned short curv;
+  float curvature_dir[3];
+} BenchSculptVertFused;
+
+static void bench_msculptverts_init(BenchPBVH *bp, int totvert)
+{
+  bp->msculptverts_fused = MEM_calloc_arrayN(totvert, sizeof(BenchSculptVertFused), __func__);
+
+  bp->msculptverts = MEM_calloc_arrayN(totvert, sizeof(MSculptVert), __func__);
+
+  for (int i = 0; i < totvert; i++) {
+    MSculptVert *mv = bp->msculptverts + i;
+
+    mv->flag = SCULPTVERT_NEED_BOUNDARY | SCULPTVERT_NEED_VALENCE | SCULPTVERT_NEED_DISK_SORT;
+    mv->stroke_id = -1;
+
+    bp->msculptverts_fused[i].flag = mv->flag;
+    bp->msculptverts_fused[i].stroke_id = -1;
+  }
+}
+
+static void bench_build_faces(BenchPBVH *bp, int tottri)
+{
+  Mesh *me = bp->me = bench_mesh_torus(tottri);
+  const int looptri_num = poly_to_tri_count(me->totpoly, me->totloop);
+
+  bp->looptri = MEM_malloc_arrayN(looptri_num, sizeof(*bp->looptri), __func__);
+  BKE_mesh_recalc_looptri(me->mloop, me->mpoly, me->mvert, me->totloop, me->totpoly, bp->looptri);
+
+  BKE_mesh_vert_poly_map_create(&bp->pmap,
+                                &bp->pmap_mem,
+                                me->mvert,
+                                me->medge,
+                                me->mpoly,
+                                me->mloop,
+                                me->totvert,
+                                me->totpoly,
+                                me->totloop,
+                                false);
+
+  bench_msculptverts_init(bp, me->totvert);
+  bp->face_areas = MEM_calloc_arrayN(me->totpoly, sizeof(float) * 2, __func__);
+
+  bp->pbvh = BKE_pbvh_new();
+  BKE_pbvh_build_mesh(bp->pbvh,
+                      me,
+                      me->mpoly,
+                      me->mloop,
+                      me->mvert,
+                      bp->msculptverts,
+                      me->totvert,
+                      &me->vdata,
+                      &me->ldata,
+                      &me->pdata,
+                      bp->looptri,
+                      looptri_num,
+                      true,
+                      bp->face_areas,
+                      bp->pmap);
+
+  bp->totvert = me->totvert;
+  bp->tottri = looptri_num;
+}
+
+static void bench_build_grids(BenchPBVH *bp, int tottri)
+{
+  /* Level 4 grids (17x17), one grid per base quad. */
+  const int level = 4;
+  const int gridsize = (1 << level) + 1;
+  const int base_tris = max_ii(tottri / ((gridsize - 1) * (gridsize - 1)), 16);
+  const int nv = max_ii((int)sqrtf((float)base_tris / 4.0f), 2);
+  const int nu = nv * 2;
+  const int totgrid = nu * nv;
+
+  CCGKey *key = &bp->key;
+  key->level = level;
+  key->grid_size = gridsize;
+  key->grid_area = gridsize * gridsize;
+  key->has_normals = true;
+  key->has_mask = false;
+  key->normal_offset = sizeof(float[3]);
+  key->mask_offset = -1;
+  key->elem_size = sizeof(float[3]) * 2;
+  key->grid_bytes = key->elem_size * key->grid_area;
+
+  bp->grid_mem = MEM_malloc_arrayN((size_t)totgrid, (size_t)key->grid_bytes, __func__);
+  bp->grids = MEM_malloc_arrayN(totgrid, sizeof(CCGElem *), __func__);
+  bp->gridfaces = MEM_calloc_arrayN(totgrid, sizeof(void *), __func__);
+  bp->flagmats = MEM_calloc_arrayN(totgrid, sizeof(DMFlagMat), __func__);
+  bp->grid_hidden = MEM_calloc_arrayN(totgrid, sizeof(BLI_bitmap *), __func__);
+
+  for (int i = 0; i < nu; i++) {
+    for (int j = 0; j < nv; j++) {
+      const int g = i * nv + j;
+      CCGElem *grid = (CCGElem *)((char *)bp->grid_mem + (size_t)g * (size_t)key->grid_bytes);
+
+      bp->grids[g] = grid;
+      bp->flagmats[g].flag = ME_SMOOTH;
+
+      for (int y = 0; y < gridsize; y++) {
+        for (int x = 0; x < gridsize; x++) {
+          CCGElem *elem = CCG_grid_elem(key, grid, x, y);
+          const float u = ((float)i + (float)x / (float)(gridsize - 1)) / (float)nu;
+          const float v = ((float)j + (float)y / (float)(gridsize - 1)) / (float)nv;
+
+          torus_eval(u, v, CCG_elem_co(key, elem), CCG_elem_no(key, elem));
+        }
+      }
+    }
+  }
+
+  const int totvert = totgrid * key->grid_area;
+  const int totface = totgrid * (gridsize - 1) * (gridsize - 1);
+
+  bench_msculptverts_init(bp, totvert);
+  bp->face_areas = MEM_calloc_arrayN(totface, sizeof(float) * 2, __func__);
+
+  bp->pbvh = BKE_pbvh_new();
+  BKE_pbvh_build_grids(bp->pbvh,
+                       bp->grids,
+                       totgrid,
+                       key,
+                       bp->gridfaces,
+                       bp->flagmats,
+                       bp->grid_hidden,
+                       true,
+                       bp->face_areas);
+  BKE_pbvh_set_mdyntopo_verts(bp->pbvh, bp->msculptverts);
+
+  bp->totvert = totvert;
+  bp->tottri = totface * 2;
+}
+
+static void bench_build_bmesh(BenchPBVH *bp, int tottri)
+{
+  Mesh *me = bench_mesh_torus(tottri);
+
+  const BMAllocTemplate allocsize = BMALLOC_TEMPLATE_FROM_ME(me);
+  BMesh *bm = bp->bm = BM_mesh_create(
+      &allocsize,
+      &((struct BMeshCreateParams){.use_toolflags = false,
+                                   .create_unique_ids = true,
+                                   .id_elem_mask = BM_VERT | BM_EDGE | BM_FACE,
+                                   .id_map = true,
+                                   .temporary_ids = false,
+                                   .no_reuse_ids = false}));
+
+  BM_mesh_bm_from_me(NULL, bm, me, (&(struct BMeshFromMeshParams){.calc_face_normal = true}));
+  BKE_id_free(NULL, me);
+
+  bp->pbvh = BKE_pbvh_new();
+
+  /* Ensures the dyntopo attribute layers and fills in the PBVH offsets. */
+  DynTopoState *ds = BKE_dyntopo_init(bm, bp->pbvh);
+  BKE_dyntopo_free(ds);
+
+  PBVH *pbvh = bp->pbvh;
+  bp->bm_log = BM_log_create(bm, pbvh->cd_sculpt_vert);
+
+  BKE_pbvh_build_bmesh(pbvh,
+                       NULL,
+                       bm,
+                       true,
+                       bp->bm_log,
+                       pbvh->cd_vert_node_offset,
+                       pbvh->cd_face_node_offset,
+                       pbvh->cd_sculpt_vert,
+                       pbvh->cd_face_area,
+                       true,
+                       true);
+
+  /* Detail size relative to the generated edge length, so strokes both split and collapse. */
+  const float edge_len = (float)M_PI * 2.0f * TORUS_MINOR_RADIUS /
+                         sqrtf((float)tottri / 4.0f);
+  BKE_pbvh_bmesh_detail_size_set(pbvh, edge_len * 1.25f, 0.4f);
+
+  bp->totvert = bm->totvert;
+  bp->tottri = bm->totface * 2;
+}
+
+static void bench_pbvh_free(BenchPBVH *bp)
+{
+  if (bp->pbvh) {
+    BKE_pbvh_free(bp->pbvh);
+  }
+
+  if (bp->bm_log) {
+    BM_log_free(bp->bm_log, false);
+  }
+  if (bp->bm) {
+    BM_mesh_free(bp->bm);
+  }
+  if (bp->me) {
+    BKE_id_free(NULL, bp->me);
+  }
+
+  MEM_SAFE_FREE(bp->looptri);
+  MEM_SAFE_FREE(bp->pmap);
+  MEM_SAFE_FREE(bp->pmap_mem);
+
+  MEM_SAFE_FREE(bp->grid_mem);
+  MEM_SAFE_FREE(bp->grids);
+  MEM_SAFE_FREE(bp->gridfaces);
+  MEM_SAFE_FREE(bp->flagmats);
+  MEM_SAFE_FREE(bp->grid_hidden);
+
+  MEM_SAFE_FREE(bp->msculptverts);
+  MEM_SAFE_FREE(bp->msculptverts_fused);
+  MEM_SAFE_FREE(bp->face_areas);
+}
+
+static int bench_pbvh_tottri(BenchPBVH *bp)
+{
+  if (bp->type == PBVH_BMESH) {
+    BMFace *f;
+    BMIter iter;
+    int tottri = 0;
+
+    BM_ITER_MESH (f, &iter, bp->bm, BM_FACES_OF_MESH) {
+      tottri += f->len - 2;
+    }
+
+    return tottri;
+  }
+
+  return bp->tottri;
+}
+
+static int bench_pbvh_totleaf(PBVH *pbvh)
+{
+  int totleaf = 0;
+
+  for (int i = 0; i < pbvh->totnode; i++) {
+    totleaf += (pbvh->nodes[i].flag & PBVH_Leaf) ? 1 : 0;
+  }
+
+  return totleaf;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Brush Stamps
+ * \{ */
+
+typedef struct BenchStamp {
+  BenchPBVH *bp;
+
+  float center[3];
+  float radius;
+  float strength;
+
+  PBVHNode **nodes;
+  int totnode;
+
+  /* Sum of original normals per node, keeps the original data reads from being optimized
+   * away. */
+  float (*orig_no_sums)[3];
+  bool use_fused;
+} BenchStamp;
+
+typedef struct BenchRaycastData {
+  PBVH *pbvh;
+  struct IsectRayPrecalc isect_precalc;
+  float ray_start[3], ray_normal[3];
+  float depth, back_depth;
+  int hit_count;
+  bool hit;
+} BenchRaycastData;
+
+static void bench_raycast_cb(PBVHNode *node, void *data_v, float *tmin)
+{
+  BenchRaycastData *rd = data_v;
+
+  if (BKE_pbvh_node_get_tmin(node) >= *tmin) {
+    return;
+  }
+
+  SculptVertRef active_vertex;
+  SculptFaceRef active_face;
+  float face_normal[3];
+
+  if (BKE_pbvh_node_raycast(rd->pbvh,
+                            node,
+                            NULL,
+                            false,
+                            rd->ray_start,
+                            rd->ray_normal,
+                            &rd->isect_precalc,
+                            &rd->hit_count,
+                            &rd->depth,
+                            &rd->back_depth,
+                            &active_vertex,
+                            &active_face,
+                            face_normal,
+                            0)) {
+    rd->hit = true;
+    *tmin = rd->depth;
+  }
+}
+
+/** Fire a ray at the parametric stroke sample, like the cursor does in the viewport. */
+static bool bench_stamp_raycast(BenchStamp *stamp, const float target[3], const float no[3])
+{
+  BenchRaycastData rd = {.pbvh = stamp->bp->pbvh, .depth = FLT_MAX, .back_depth = FLT_MAX};
+
+  negate_v3_v3(rd.ray_normal, no);
+  madd_v3_v3v3fl(rd.ray_start, target, no, 2.0f);
+  isect_ray_tri_watertight_v3_precalc(&rd.isect_precalc, rd.ray_normal);
+
+  BKE_pbvh_raycast(stamp->bp->pbvh, bench_raycast_cb, &rd, rd.ray_start, rd.ray_normal, false, 0);
+
+  if (rd.hit) {
+    madd_v3_v3v3fl(stamp->center, rd.ray_start, rd.ray_normal, rd.depth);
+  }
+  else {
+    copy_v3_v3(stamp->center, target);
+  }
+
+  return rd.hit;
+}
+
+static bool bench_stamp_search_cb(PBVHNode *node, void *data_v)
+{
+  BenchStamp *stamp = data_v;
+  float bb_min[3], bb_max[3], nearest[3];
+
+  BKE_pbvh_node_get_BB(node, bb_min, bb_max);
+
+  for (int i = 0; i < 3; i++) {
+    nearest[i] = clamp_f(stamp->center[i], bb_min[i], bb_max[i]);
+  }
+
+  return len_squared_v3v3(nearest, stamp->center) < stamp->radius * stamp->radius;
+}
+
+static void bench_stamp_task_cb(void *__restrict userdata,
+                                const int n,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BenchStamp *stamp = userdata;
+  PBVH *pbvh = stamp->bp->pbvh;
+  PBVHNode *node = stamp->nodes[n];
+  const float radius_sq = stamp->radius * stamp->radius;
+  const float offset = stamp->radius * stamp->strength;
+  PBVHVertexIter vd;
+
+  BKE_pbvh_vertex_iter_begin (pbvh, node, vd, PBVH_ITER_UNIQUE) {
+    const float dist_sq = len_squared_v3v3(vd.co, stamp->center);
+
+    if (dist_sq >= radius_sq) {
+      continue;
+    }
+
+    /* Smooth falloff, matches the default brush curve closely enough. */
+    const float fac = 1.0f - sqrtf(dist_sq) / stamp->radius;
+    const float fade = fac * fac * (3.0f - 2.0f * fac);
+    const float *no = vd.no ? vd.no : vd.fno;
+
+    madd_v3_v3fl(vd.co, no, offset * fade);
+
+    if (vd.mvert) {
+      BKE_pbvh_vert_mark_update(pbvh, vd.vertex);
+    }
+  }
+  BKE_pbvh_vertex_iter_end;
+
+  BKE_pbvh_node_mark_update(node);
+
+  if (pbvh->type == PBVH_BMESH) {
+    BKE_pbvh_node_mark_topology_update(node);
+  }
+}
+
+/** Same as #SCULPT_vertex_check_origdata for the first stroke, then read the data back. */
+BLI_INLINE void bench_origdata_vert(
+    short *stroke_id, float origco[3], float origno[3], const PBVHVertexIter *vd, float r_sum[3])
+{
+  if (*stroke_id != 1) {
+    *stroke_id = 1;
+    copy_v3_v3(origco, vd->co);
+    copy_v3_v3(origno, vd->no ? vd->no : vd->fno);
+  }
+
+  add_v3_v3(r_sum, origno);
+}
+
+static void bench_origdata_task_cb(void *__restrict userdata,
+                                   const int n,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BenchStamp *stamp = userdata;
+  BenchPBVH *bp = stamp->bp;
+  const float radius_sq = stamp->radius * stamp->radius;
+  float *sum = stamp->orig_no_sums[n];
+  PBVHVertexIter vd;
+
+  zero_v3(sum);
+
+  BKE_pbvh_vertex_iter_begin (bp->pbvh, stamp->nodes[n], vd, PBVH_ITER_UNIQUE) {
+    if (len_squared_v3v3(vd.co, stamp->center) >= radius_sq) {
+      continue;
+    }
+
+    if (bp->type == PBVH_BMESH) {
+      MSculptVert *mv = BKE_PBVH_SCULPTVERT(bp->pbvh->cd_sculpt_vert, vd.bm_vert);
+      bench_origdata_vert(&mv->stroke_id, mv->origco, mv->origno, &vd, sum);
+    }
+    else if (stamp->use_fused) {
+      BenchSculptVertFused *mv = bp->msculptverts_fused + vd.index;
+      bench_origdata_vert(&mv->stroke_id, mv->origco, mv->origno, &vd, sum);
+    }
+    else {
+      MSculptVert *mv = bp->msculptverts + vd.index;
+      bench_origdata_vert(&mv->stroke_id, mv->origco, mv->origno, &vd, sum);
+    }
+  }
+  BKE_pbvh_vertex_iter_end;
+}
+
+static void bench_origdata(BenchStamp *stamp, bool use_fused)
+{
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, stamp->totnode);
+
+  stamp->use_fused = use_fused;
+  BLI_task_parallel_range(0, stamp->totnode, stamp, bench_origdata_task_cb, &settings);
+}
+
+static float bench_mask_cb(SculptVertRef UNUSED(vertex), void *UNUSED(userdata))
+{
+  return 1.0f;
+}
+
+/**
+ * Grids normally get their normals from #SubdivCCG, which the benchmark does not create.
+ * Recompute them per grid from central differences instead so the phase still has a
+ * comparable cost.
+ */
+static void bench_grids_normals_task_cb(void *__restrict userdata,
+                                        const int n,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BenchStamp *stamp = userdata;
+  BenchPBVH *bp = stamp->bp;
+  PBVHNode *node = stamp->nodes[n];
+  const CCGKey *key = &bp->key;
+  const int gridsize = key->grid_size;
+  int *grid_indices, totgrid;
+
+  BKE_pbvh_node_get_grids(bp->pbvh, node, &grid_indices, &totgrid, NULL, NULL, NULL);
+
+  for (int i = 0; i < totgrid; i++) {
+    CCGElem *grid = bp->grids[grid_indices[i]];
+
+    for (int y = 0; y < gridsize; y++) {
+      for (int x = 0; x < gridsize; x++) {
+        const int x1 = max_ii(x - 1, 0), x2 = min_ii(x + 1, gridsize - 1);
+        const int y1 = max_ii(y - 1, 0), y2 = min_ii(y + 1, gridsize - 1);
+        float du[3], dv[3];
+
+        sub_v3_v3v3(du,
+                    CCG_grid_elem_co(key, grid, x2, y),
+                    CCG_grid_elem_co(key, grid, x1, y));
+        sub_v3_v3v3(dv,
+                    CCG_grid_elem_co(key, grid, x, y2),
+                    CCG_grid_elem_co(key, grid, x, y1));
+
+        float *no = CCG_grid_elem_no(key, grid, x, y);
+        cross_v3_v3v3(no, du, dv);
+        normalize_v3(no);
+      }
+    }
+  }
+
+  node->flag &= ~PBVH_UpdateNormals;
+}
+
+static void bench_update_normals(BenchStamp *stamp)
+{
+  BenchPBVH *bp = stamp->bp;
+
+  if (bp->type != PBVH_GRIDS) {
+    BKE_pbvh_update_normals(bp->pbvh, NULL);
+    return;
+  }
+
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, stamp->totnode);
+  BLI_task_parallel_range(0, stamp->totnode, stamp, bench_grids_normals_task_cb, &settings);
+}
+
+static void bench_run_stroke(BenchPBVH *bp,
+                             int totstamp,
+                             float radius,
+                             float strength,
+                             BenchPhaseStats stats[BENCH_PHASE_TOT],
+                             int *r_tothit)
+{
+  BenchStamp stamp = {.bp = bp, .radius = radius, .strength = strength};
+  BenchCounters start;
+  int tothit = 0;
+
+  if (bp->type == PBVH_BMESH) {
+    BM_log_entry_add(bp->bm, bp->bm_log);
+  }
+
+  for (int i = 0; i < totstamp; i++) {
+    /* Wavy stroke half way around the torus. */
+    const float t = (float)i / (float)max_ii(totstamp - 1, 1);
+    const float u = t * 0.5f;
+    const float v = 0.25f + 0.1f * sinf(t * (float)M_PI * 8.0f);
+    float target[3], no[3];
+
+    torus_eval(u, v, target, no);
+
+    bench_counters_get(&start);
+    tothit += bench_stamp_raycast(&stamp, target, no) ? 1 : 0;
+    bench_phase_end(&stats[BENCH_PHASE_RAYCAST], &start);
+
+    BKE_pbvh_search_gather(
+        bp->pbvh, bench_stamp_search_cb, &stamp, &stamp.nodes, &stamp.totnode);
+    stamp.orig_no_sums = MEM_malloc_arrayN(
+        max_ii(stamp.totnode, 1), sizeof(*stamp.orig_no_sums), __func__);
+
+    bench_counters_get(&start);
+    bench_origdata(&stamp, false);
+    bench_phase_end(&stats[BENCH_PHASE_ORIGDATA], &start);
+
+    if (bp->type != PBVH_BMESH) {
+      bench_counters_get(&start);
+      bench_origdata(&stamp, true);
+      bench_phase_end(&stats[BENCH_PHASE_ORIGDATA_FUSED], &start);
+    }
+
+    bench_counters_get(&start);
+    TaskParallelSettings settings;
+    BKE_pbvh_parallel_range_settings(&settings, true, stamp.totnode);
+    BLI_task_parallel_range(0, stamp.totnode, &stamp, bench_stamp_task_cb, &settings);
+    bench_phase_end(&stats[BENCH_PHASE_STAMP], &start);
+
+    if (bp->type == PBVH_BMESH) {
+      bench_counters_get(&start);
+      BKE_pbvh_bmesh_update_topology(bp->pbvh,
+                                     PBVH_Subdivide | PBVH_Collapse,
+                                     stamp.center,
+                                     NULL,
+                                     radius,
+                                     false,
+                                     false,
+                                     -1,
+                                     true,
+                                     bench_mask_cb,
+                                     NULL,
+                                     0,
+                                     false,
+                                     false);
+      bench_phase_end(&stats[BENCH_PHASE_TOPOLOGY], &start);
+    }
+
+    bench_counters_get(&start);
+    BKE_pbvh_update_bounds(bp->pbvh, PBVH_UpdateBB | PBVH_UpdateOriginalBB);
+    bench_phase_end(&stats[BENCH_PHASE_BOUNDS], &start);
+
+    bench_counters_get(&start);
+    bench_update_normals(&stamp);
+    bench_phase_end(&stats[BENCH_PHASE_NORMALS], &start);
+
+    MEM_SAFE_FREE(stamp.nodes);
+    MEM_SAFE_FREE(stamp.orig_no_sums);
+    stamp.totnode = 0;
+  }
+
+  *r_tothit = tothit;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Driver
+ * \{ */
+
+typedef struct BenchArgs {
+  int tris[16];
+  int tottris;
+  bool types[3];
+  int totstamp;
+  float radius;
+  float strength;
+  float flood_detail;
+  int threads;
+  const char *output;
+} BenchArgs;
+
+static const char *bench_type_names[3] = {"faces", "grids", "bmesh"};
+static const PBVHType bench_types[3] = {PBVH_FACES, PBVH_GRIDS, PBVH_BMESH};
+
+static void bench_json_phase(FILE *file, const char *name, const BenchPhaseStats *stats, bool last)
+{
+  fprintf(file,
+          "        \"%s\": {\"seconds\": %.6f, \"calls\": %d, \"cache_misses\": %lld, "
+          "\"cache_refs\": %lld}%s\n",
+          name,
+          stats->seconds,
+          stats->calls,
+          (long long)stats->cache_misses,
+          (long long)stats->cache_refs,
+          last ? "" : ",");
+}
+
+static void bench_run(FILE *file, const BenchArgs *args, int type_i, int tris, bool first)
+{
+  BenchPhaseStats stats[BENCH_PHASE_TOT];
+  BenchCounters start;
+  BenchPBVH bp = {.type = bench_types[type_i]};
+
+  memset(stats, 0, sizeof(stats));
+
+  fprintf(stderr, "pbvh_cache_test: %s, %d triangles\n", bench_type_names[type_i], tris);
+
+  const size_t mem_base = MEM_get_memory_in_use();
+  MEM_reset_peak_memory();
+
+  bench_counters_get(&start);
+  switch (bp.type) {
+    case PBVH_FACES:
+      bench_build_faces(&bp, tris);
+      break;
+    case PBVH_GRIDS:
+      bench_build_grids(&bp, tris);
+      break;
+    case PBVH_BMESH:
+      bench_build_bmesh(&bp, tris);
+      break;
+  }
+  bench_phase_end(&stats[BENCH_PHASE_BUILD], &start);
+
+  const size_t mem_built = MEM_get_memory_in_use() - mem_base;
+  const int totnode_built = bench_pbvh_totleaf(bp.pbvh);
+  const int tottri_built = bench_pbvh_tottri(&bp);
+
+  /* Radius is relative to the minor radius so it scales with the mesh, not the density. */
+  int tothit = 0;
+  bench_run_stroke(&bp,
+                   args->totstamp,
+                   args->radius * TORUS_MINOR_RADIUS * 2.0f,
+                   args->strength,
+                   stats,
+                   &tothit);
+
+  int totpass_flood = 0;
+  if (bp.type == PBVH_BMESH && args->flood_detail > 0.0f) {
+    PBVH *pbvh = bp.pbvh;
+    BKE_pbvh_bmesh_detail_size_set(
+        pbvh, pbvh->bm_max_edge_len * args->flood_detail, pbvh->bm_detail_range);
+
+    bench_counters_get(&start);
+    totpass_flood = BKE_pbvh_bmesh_remesh_all(pbvh, bench_mask_cb, NULL, 8, false, NULL, NULL);
+    bench_phase_end(&stats[BENCH_PHASE_FLOOD_FILL], &start);
+  }
+
+  const size_t mem_final = MEM_get_memory_in_use() - mem_base;
+  const size_t mem_peak = MEM_get_peak_memory() - mem_base;
+
+  fprintf(file, "%s    {\n", first ? "" : ",\n");
+  fprintf(file, "      \"type\": \"%s\",\n", bench_type_names[type_i]);
+  fprintf(file, "      \"target_tris\": %d,\n", tris);
+  fprintf(file, "      \"tris\": %d,\n", tottri_built);
+  fprintf(file, "      \"tris_final\": %d,\n", bench_pbvh_tottri(&bp));
+  fprintf(file, "      \"verts\": %d,\n", bp.totvert);
+  fprintf(file, "      \"leaf_nodes\": %d,\n", totnode_built);
+  fprintf(file, "      \"leaf_nodes_final\": %d,\n", bench_pbvh_totleaf(bp.pbvh));
+  fprintf(file, "      \"stamps\": %d,\n", args->totstamp);
+  fprintf(file, "      \"raycast_hits\": %d,\n", tothit);
+  fprintf(file, "      \"flood_fill_passes\": %d,\n", totpass_flood);
+  fprintf(file, "      \"memory\": {\"built\": %zu, \"final\": %zu, \"peak\": %zu},\n",
+          mem_built,
+          mem_final,
+          mem_peak);
+  fprintf(file, "      \"phases\": {\n");
+  for (int i = 0; i < BENCH_PHASE_TOT; i++) {
+    bench_json_phase(file, bench_phase_names[i], &stats[i], i == BENCH_PHASE_TOT - 1);
+  }
+  fprintf(file, "      }\n");
+  fprintf(file, "    }");
+
+  bench_pbvh_free(&bp);
+}
+
+static void bench_print_usage(void)
+{
+  printf(
+      "usage: pbvh_cache_test [options]\n"
+      "  --tris N[,N...]          triangle counts to test (default 100000,1000000)\n"
+      "  --types T[,T...]         any of faces,grids,bmesh (default all)\n"
+      "  --stamps N               brush stamps per stroke (default 200)\n"
+      "  --radius F               brush radius relative to the torus thickness (default 0.1)\n"
+      "  --strength F             displacement relative to the brush radius (default 0.02)\n"
+      "  --flood-detail F         flood fill detail relative to the built one (default 0.75)\n"
+      "  --threads N              override the number of threads (default 0, all)\n"
+      "  --output FILE            write JSON results to FILE instead of stdout\n");
+}
+
+static bool bench_parse_args(int argc, char **argv, BenchArgs *args)
+{
+  memset(args, 0, sizeof(*args));
+  args->tris[0] = 100000;
+  args->tris[1] = 1000000;
+  args->tottris = 2;
+  args->types[0] = args->types[1] = args->types[2] = true;
+  args->totstamp = 200;
+  args->radius = 0.1f;
+  args->strength = 0.02f;
+  args->flood_detail = 0.75f;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (STREQ(arg, "--help") || STREQ(arg, "-h")) {
+      return false;
+    }
+    if (!value) {
+      fprintf(stderr, "missing value for %s\n", arg);
+      return false;
+    }
+    i++;
+
+    if (STREQ(arg, "--tris")) {
+      args->tottris = 0;
+      for (const char *s = value; s && *s && args->tottris < (int)ARRAY_SIZE(args->tris);) {
+        args->tris[args->tottris++] = max_ii(atoi(s), 16);
+        s = strchr(s, ',');
+        s = s ? s + 1 : NULL;
+      }
+    }
+    else if (STREQ(arg, "--types")) {
+      for (int j = 0; j < 3; j++) {
+        args->types[j] = strstr(value, bench_type_names[j]) != NULL;
+      }
+    }
+    else if (STREQ(arg, "--stamps")) {
+      args->totstamp = max_ii(atoi(value), 1);
+    }
+    else if (STREQ(arg, "--radius")) {
+      args->radius = (float)atof(value);
+    }
+    else if (STREQ(arg, "--strength")) {
+      args->strength = (float)atof(value);
+    }
+    else if (STREQ(arg, "--flood-detail")) {
+      args->flood_detail = max_ff((float)atof(value), 0.0f);
+    }
+    else if (STREQ(arg, "--threads")) {
+      args->threads = max_ii(atoi(value), 0);
+    }
+    else if (STREQ(arg, "--output")) {
+      args->output = value;
+    }
+    else {
+      fprintf(stderr, "unknown argument %s\n", arg);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static void bench_warmup_task_cb(void *__restrict UNUSED(userdata),
+                                 const int UNUSED(i),
+                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+}
+
+/** Make the task scheduler start its worker threads, so their counters exist from the start. */
+static void bench_task_scheduler_warmup(void)
+{
+  const int range = BLI_task_scheduler_num_threads() * 64;
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = 1;
+  BLI_task_parallel_range(0, range, NULL, bench_warmup_task_cb, &settings);
+}
 
 int main(int argc, char **argv)
 {
-  printf("argc: %d\n", argc);
+  BenchArgs args;
+
+  if (!bench_parse_args(argc, argv, &args)) {
+    bench_print_usage();
+    return 1;
+  }
 
-  // pbvh_bmesh_do_cache_test();
+  CLG_init();
+  BLI_threadapi_init();
+  if (args.threads) {
+    BLI_system_num_threads_override_set(args.threads);
+  }
+  BLI_task_scheduler_init();
+
+  bench_counters_init();
+  bench_task_scheduler_warmup();
+
+  FILE *file = args.output ? fopen(args.output, "w") : stdout;
+  if (!file) {
+    fprintf(stderr, "could not open %s\n", args.output);
+    return 1;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"benchmark\": \"pbvh\",\n");
+  fprintf(file, "  \"threads\": %d,\n", BLI_task_scheduler_num_threads());
+  fprintf(file, "  \"perf_counters\": %s,\n", perf_available ? "true" : "false");
+  fprintf(file, "  \"runs\": [\n");
+
+  bool first = true;
+  for (int i = 0; i < args.tottris; i++) {
+    for (int j = 0; j < 3; j++) {
+      if (args.types[j]) {
+        bench_run(file, &args, j, args.tris[i], first);
+        first = false;
+      }
+    }
+  }
+
+  fprintf(file, "\n  ]\n}\n");
+
+  if (file != stdout) {
+    fclose(file);
+  }
+
+  BLI_task_scheduler_exit();
+  BLI_threadapi_exit();
+  CLG_exit();
+  bench_counters_exit();
 
   return 0;
 }
+
+/** \} */
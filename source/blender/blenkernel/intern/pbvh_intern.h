@@ -194,6 +194,7 @@ struct PBVH {
   float bm_detail_range;
 
   int cd_sculpt_vert;
+  int cd_sculpt_vert_cold;
   int cd_vert_node_offset;
   int cd_face_node_offset;
   int cd_vert_mask_offset;
@@ -218,7 +219,6 @@ struct PBVH {
   bool flat_vcol_shading;
   bool need_full_render;  // used by pbvh drawing for PBVH_BMESH
 
-  int balance_counter;
   int stroke_id;  // used to keep origdata up to date in PBVH_BMESH
 };
 
@@ -239,6 +239,7 @@ void BBC_update_centroid(BBC *bbc);
 int BB_widest_axis(const BB *bb);
 void BB_intersect(BB *r_out, BB *a, BB *b);
 float BB_volume(const BB *bb);
+float BB_surface_area(const BB *bb);
 
 void pbvh_grow_nodes(PBVH *bvh, int totnode);
 bool ray_face_intersection_quad(const float ray_start[3],
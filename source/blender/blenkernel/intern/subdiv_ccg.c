@@ -167,6 +167,9 @@ typedef struct CCGEvalGridsData {
   int *face_ptex_offset;
   SubdivCCGMaskEvaluator *mask_evaluator;
   SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator;
+
+  /* Optional lookup table. Maps task index to index in `subdiv_ccg->faces`. */
+  const int *face_index_map;
 } CCGEvalGridsData;
 
 static void subdiv_ccg_eval_grid_element_limit(CCGEvalGridsData *data,
@@ -285,10 +288,11 @@ static void subdiv_ccg_eval_special_grid(CCGEvalGridsData *data, const int face_
 }
 
 static void subdiv_ccg_eval_grids_task(void *__restrict userdata_v,
-                                       const int face_index,
+                                       const int n,
                                        const TaskParallelTLS *__restrict UNUSED(tls))
 {
   CCGEvalGridsData *data = userdata_v;
+  const int face_index = data->face_index_map ? data->face_index_map[n] : n;
   SubdivCCG *subdiv_ccg = data->subdiv_ccg;
   SubdivCCGFace *face = &subdiv_ccg->faces[face_index];
   if (face->num_grids == 4) {
@@ -299,13 +303,14 @@ static void subdiv_ccg_eval_grids_task(void *__restrict userdata_v,
   }
 }
 
-static bool subdiv_ccg_evaluate_grids(SubdivCCG *subdiv_ccg,
-                                      Subdiv *subdiv,
-                                      SubdivCCGMaskEvaluator *mask_evaluator,
-                                      SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator)
+static void subdiv_ccg_evaluate_faces_grids(
+    SubdivCCG *subdiv_ccg,
+    Subdiv *subdiv,
+    SubdivCCGMaskEvaluator *mask_evaluator,
+    SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator,
+    const int *face_index_map,
+    const int num_faces)
 {
-  OpenSubdiv_TopologyRefiner *topology_refiner = subdiv->topology_refiner;
-  const int num_faces = topology_refiner->getNumFaces(topology_refiner);
   /* Initialize data passed to all the tasks. */
   CCGEvalGridsData data;
   data.subdiv_ccg = subdiv_ccg;
@@ -313,11 +318,23 @@ static bool subdiv_ccg_evaluate_grids(SubdivCCG *subdiv_ccg,
   data.face_ptex_offset = BKE_subdiv_face_ptex_offset_get(subdiv);
   data.mask_evaluator = mask_evaluator;
   data.material_flags_evaluator = material_flags_evaluator;
+  data.face_index_map = face_index_map;
   /* Threaded grids evaluation. */
   TaskParallelSettings parallel_range_settings;
   BLI_parallel_range_settings_defaults(&parallel_range_settings);
   BLI_task_parallel_range(
       0, num_faces, &data, subdiv_ccg_eval_grids_task, &parallel_range_settings);
+}
+
+static bool subdiv_ccg_evaluate_grids(SubdivCCG *subdiv_ccg,
+                                      Subdiv *subdiv,
+                                      SubdivCCGMaskEvaluator *mask_evaluator,
+                                      SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator)
+{
+  OpenSubdiv_TopologyRefiner *topology_refiner = subdiv->topology_refiner;
+  const int num_faces = topology_refiner->getNumFaces(topology_refiner);
+  subdiv_ccg_evaluate_faces_grids(
+      subdiv_ccg, subdiv, mask_evaluator, material_flags_evaluator, NULL, num_faces);
   /* If displacement is used, need to calculate normals after all final
    * coordinates are known. */
   if (subdiv->displacement_evaluator != NULL) {
@@ -614,6 +631,38 @@ Mesh *BKE_subdiv_to_ccg_mesh(Subdiv *subdiv,
   return result;
 }
 
+void BKE_subdiv_ccg_eval_faces(SubdivCCG *subdiv_ccg,
+                               SubdivCCGMaskEvaluator *mask_evaluator,
+                               SubdivCCGMaterialFlagsEvaluator *material_flags_evaluator,
+                               struct CCGFace **effected_faces,
+                               int num_effected_faces)
+{
+  if (num_effected_faces == 0) {
+    return;
+  }
+  Subdiv *subdiv = subdiv_ccg->subdiv;
+  BKE_subdiv_stats_begin(&subdiv->stats, SUBDIV_STATS_SUBDIV_TO_CCG);
+
+  int *face_index_map = MEM_malloc_arrayN(num_effected_faces, sizeof(int), __func__);
+  for (int i = 0; i < num_effected_faces; i++) {
+    face_index_map[i] = (SubdivCCGFace *)effected_faces[i] - subdiv_ccg->faces;
+  }
+  subdiv_ccg_evaluate_faces_grids(subdiv_ccg,
+                                  subdiv,
+                                  mask_evaluator,
+                                  material_flags_evaluator,
+                                  face_index_map,
+                                  num_effected_faces);
+  MEM_freeN(face_index_map);
+
+  /* Same as the full evaluation: with displacement the normals are only known once the final
+   * coordinates are, which also stitches the faces with their neighbors. */
+  if (subdiv->displacement_evaluator != NULL) {
+    BKE_subdiv_ccg_update_normals(subdiv_ccg, effected_faces, num_effected_faces);
+  }
+  BKE_subdiv_stats_end(&subdiv->stats, SUBDIV_STATS_SUBDIV_TO_CCG);
+}
+
 void BKE_subdiv_ccg_destroy(SubdivCCG *subdiv_ccg)
 {
   const int num_grids = subdiv_ccg->num_grids;
@@ -1346,9 +1395,65 @@ void BKE_subdiv_ccg_average_stitch_faces(SubdivCCG *subdiv_ccg,
                           &data,
                           subdiv_ccg_stitch_face_inner_grids_task,
                           &parallel_range_settings);
-  /* TODO(sergey): Only average elements which are adjacent to modified
-   * faces. */
-  subdiv_ccg_average_all_boundaries_and_corners(subdiv_ccg, &key);
+  subdiv_ccg_average_faces_boundaries_and_corners(
+      subdiv_ccg, &key, effected_faces, num_effected_faces);
+}
+
+struct CCGFace **BKE_subdiv_ccg_faces_from_coarse_verts(SubdivCCG *subdiv_ccg,
+                                                        const BLI_bitmap *coarse_verts,
+                                                        int *r_num_faces)
+{
+  Subdiv *subdiv = subdiv_ccg->subdiv;
+  OpenSubdiv_TopologyRefiner *topology_refiner = subdiv->topology_refiner;
+  const int num_vertices = topology_refiner->getNumVertices(topology_refiner);
+  const int num_faces = subdiv_ccg->num_faces;
+
+  StaticOrHeapIntStorage face_vertices_storage;
+  static_or_heap_storage_init(&face_vertices_storage);
+
+  /* The limit surface of a face depends on the coarse vertices of every face sharing a vertex
+   * with it, so grow the given vertices by the faces using them first. */
+  BLI_bitmap *ring_verts = BLI_BITMAP_NEW(num_vertices, __func__);
+  for (int face_index = 0; face_index < num_faces; face_index++) {
+    const int num_face_vertices = subdiv_ccg->faces[face_index].num_grids;
+    int *face_vertices = static_or_heap_storage_get(&face_vertices_storage, num_face_vertices);
+    topology_refiner->getFaceVertices(topology_refiner, face_index, face_vertices);
+    bool is_dirty = false;
+    for (int i = 0; i < num_face_vertices; i++) {
+      if (BLI_BITMAP_TEST(coarse_verts, face_vertices[i])) {
+        is_dirty = true;
+        break;
+      }
+    }
+    if (is_dirty) {
+      for (int i = 0; i < num_face_vertices; i++) {
+        BLI_BITMAP_ENABLE(ring_verts, face_vertices[i]);
+      }
+    }
+  }
+
+  struct CCGFace **faces = NULL;
+  int num_effected_faces = 0;
+  for (int face_index = 0; face_index < num_faces; face_index++) {
+    const int num_face_vertices = subdiv_ccg->faces[face_index].num_grids;
+    int *face_vertices = static_or_heap_storage_get(&face_vertices_storage, num_face_vertices);
+    topology_refiner->getFaceVertices(topology_refiner, face_index, face_vertices);
+    for (int i = 0; i < num_face_vertices; i++) {
+      if (BLI_BITMAP_TEST(ring_verts, face_vertices[i])) {
+        if (faces == NULL) {
+          faces = MEM_malloc_arrayN(num_faces, sizeof(*faces), __func__);
+        }
+        faces[num_effected_faces++] = (struct CCGFace *)&subdiv_ccg->faces[face_index];
+        break;
+      }
+    }
+  }
+
+  MEM_freeN(ring_verts);
+  static_or_heap_storage_free(&face_vertices_storage);
+
+  *r_num_faces = num_effected_faces;
+  return faces;
 }
 
 void BKE_subdiv_ccg_topology_counters(const SubdivCCG *subdiv_ccg,
@@ -42,6 +42,15 @@
 #include "bmesh_private.h"
 #include "range_tree.h"
 
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#  define LZO_OUT_LEN(size) ((size) + (size) / 16 + 64 + 3)
+#endif
+
 //#define BM_VALIDATE_LOG
 
 #ifdef BM_VALIDATE_LOG
@@ -316,6 +325,15 @@ typedef struct BMLogIdMap {
   int *maps[15];
 } BMLogIdMap;
 
+/* Serialized element maps of a cold #BMLogEntry, see #bm_log_entry_pack. */
+typedef struct BMLogPacked {
+  uchar *data;
+  size_t size;
+  /* Size of the columnar data before compression. */
+  size_t raw_size;
+  bool compressed;
+} BMLogPacked;
+
 struct BMLogEntry {
   struct BMLogEntry *next, *prev;
 
@@ -356,6 +374,10 @@ struct BMLogEntry {
 
   BMLogEntryType type;
 
+  /* When set the element maps, their pools and the customdata pools above are freed,
+   * use #bm_log_entry_ensure_unpacked before accessing them. */
+  BMLogPacked *packed;
+
   struct Mesh
       *full_copy_mesh;  // avoid excessive memory use by saving a Mesh instead of copying the bmesh
   BMLogIdMap idmap;
@@ -1608,7 +1630,8 @@ static void bm_log_full_mesh_intern(BMesh *bm, BMLog *log, BMLogEntry *entry)
   // keep shapekey as explicit cd layers since we
   // don't have access to the original mesh's ->key member.
 
-  CustomData_MeshMasks cd_mask_extra = {CD_MASK_DYNTOPO_VERT | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
+  CustomData_MeshMasks cd_mask_extra = {
+      CD_MASK_DYNTOPO_VERT | CD_MASK_DYNTOPO_VERT_COLD | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
 
   BM_mesh_elem_index_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
 
@@ -1624,6 +1647,54 @@ static void bm_log_full_mesh_intern(BMesh *bm, BMLog *log, BMLogEntry *entry)
 
 static int log_entry_idgen = 0;
 
+/* Allocate the element maps and pools of a partial log entry */
+static void bm_log_entry_maps_alloc(BMLogEntry *entry)
+{
+  entry->topo_modified_verts_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->topo_modified_verts_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->topo_modified_edges_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->topo_modified_edges_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->topo_modified_faces_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->topo_modified_faces_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+
+  entry->modified_verts = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->modified_edges = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  entry->modified_faces = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+
+  entry->pool_verts = BLI_mempool_create(sizeof(BMLogVert), 0, 64, BLI_MEMPOOL_NOP);
+  entry->pool_edges = BLI_mempool_create(sizeof(BMLogEdge), 0, 64, BLI_MEMPOOL_NOP);
+  entry->pool_faces = BLI_mempool_create(sizeof(BMLogFace), 0, 64, BLI_MEMPOOL_NOP);
+
+  entry->arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "bmlog arena");
+}
+
+static void bm_log_entry_maps_free(BMLogEntry *entry)
+{
+  BLI_ghash_free(entry->topo_modified_verts_pre, NULL, NULL);
+  BLI_ghash_free(entry->topo_modified_verts_post, NULL, NULL);
+  BLI_ghash_free(entry->topo_modified_edges_pre, NULL, NULL);
+  BLI_ghash_free(entry->topo_modified_edges_post, NULL, NULL);
+  BLI_ghash_free(entry->topo_modified_faces_pre, NULL, NULL);
+  BLI_ghash_free(entry->topo_modified_faces_post, NULL, NULL);
+
+  BLI_ghash_free(entry->modified_verts, NULL, NULL);
+  BLI_ghash_free(entry->modified_edges, NULL, NULL);
+  BLI_ghash_free(entry->modified_faces, NULL, NULL);
+
+  BLI_mempool_destroy(entry->pool_verts);
+  BLI_mempool_destroy(entry->pool_edges);
+  BLI_mempool_destroy(entry->pool_faces);
+  BLI_memarena_free(entry->arena);
+
+  entry->topo_modified_verts_pre = entry->topo_modified_verts_post = NULL;
+  entry->topo_modified_edges_pre = entry->topo_modified_edges_post = NULL;
+  entry->topo_modified_faces_pre = entry->topo_modified_faces_post = NULL;
+  entry->modified_verts = entry->modified_edges = entry->modified_faces = NULL;
+
+  entry->pool_verts = entry->pool_edges = entry->pool_faces = NULL;
+  entry->arena = NULL;
+}
+
 /* Allocate an empty log entry */
 static BMLogEntry *bm_log_entry_create(BMLogEntryType type)
 {
@@ -1633,27 +1704,691 @@ static BMLogEntry *bm_log_entry_create(BMLogEntryType type)
   entry->id = log_entry_idgen++;
 
   if (type == LOG_ENTRY_PARTIAL) {
-    entry->topo_modified_verts_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->topo_modified_verts_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->topo_modified_edges_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->topo_modified_edges_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->topo_modified_faces_pre = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->topo_modified_faces_post = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+    bm_log_entry_maps_alloc(entry);
+  }
 
-    entry->modified_verts = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->modified_edges = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
-    entry->modified_faces = BLI_ghash_new(logkey_hash, logkey_cmp, __func__);
+  return entry;
+}
+
+/** \name Entry Packing
+ *
+ * Log entries behind the current one are rarely touched again until undo reaches them, yet
+ * every logged element keeps a mempool element, a hash entry and its own customdata blocks
+ * alive. Such cold entries are serialized into a single columnar buffer:
+ *
+ * - Element IDs are sorted and stored as varint deltas.
+ * - Coordinates and normals are XOR'd with those of the previous element in ID order. Nearby
+ *   floats share their sign, exponent and upper mantissa bits so the result is a small integer
+ *   that varint encodes well, while staying lossless.
+ * - Vertex IDs of edges and faces are stored as zig-zag encoded deltas.
+ * - Flags, face sizes and customdata blocks are stored column by column.
+ *
+ * The buffer is LZO compressed when available. Entries are unpacked again when undo or redo
+ * reaches them, or when they become the current entry.
+ * \{ */
+
+/* Number of most recent entries that are never packed. */
+#define BMLOG_UNPACKED_ENTRIES 2
+
+static const struct {
+  size_t offset;
+  char htype;
+} bm_log_entry_maps[] = {
+    {offsetof(BMLogEntry, topo_modified_verts_pre), BM_VERT},
+    {offsetof(BMLogEntry, topo_modified_edges_pre), BM_EDGE},
+    {offsetof(BMLogEntry, topo_modified_faces_pre), BM_FACE},
+    {offsetof(BMLogEntry, topo_modified_verts_post), BM_VERT},
+    {offsetof(BMLogEntry, topo_modified_edges_post), BM_EDGE},
+    {offsetof(BMLogEntry, topo_modified_faces_post), BM_FACE},
+    {offsetof(BMLogEntry, modified_verts), BM_VERT},
+    {offsetof(BMLogEntry, modified_edges), BM_EDGE},
+    {offsetof(BMLogEntry, modified_faces), BM_FACE},
+};
 
-    entry->pool_verts = BLI_mempool_create(sizeof(BMLogVert), 0, 64, BLI_MEMPOOL_NOP);
-    entry->pool_edges = BLI_mempool_create(sizeof(BMLogEdge), 0, 64, BLI_MEMPOOL_NOP);
-    entry->pool_faces = BLI_mempool_create(sizeof(BMLogFace), 0, 64, BLI_MEMPOOL_NOP);
+#define BM_LOG_ENTRY_MAP(entry, i) (*(GHash **)POINTER_OFFSET(entry, bm_log_entry_maps[i].offset))
 
-    entry->arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "bmlog arena");
+typedef struct BMLogPackItem {
+  uint id;
+  void *elem;
+} BMLogPackItem;
+
+typedef struct BMLogPackWriter {
+  uchar *data;
+  size_t len, size;
+} BMLogPackWriter;
+
+typedef struct BMLogPackReader {
+  const uchar *data;
+  size_t pos, len;
+} BMLogPackReader;
+
+static void pack_reserve(BMLogPackWriter *w, size_t size)
+{
+  if (w->len + size > w->size) {
+    w->size = MAX2(w->size * 2, w->len + size);
+    w->data = MEM_reallocN(w->data, w->size);
   }
+}
 
-  return entry;
+static void pack_bytes(BMLogPackWriter *w, const void *data, size_t size)
+{
+  pack_reserve(w, size);
+  memcpy(w->data + w->len, data, size);
+  w->len += size;
+}
+
+static void pack_uint(BMLogPackWriter *w, uint u)
+{
+  pack_reserve(w, 5);
+
+  while (u >= 0x80) {
+    w->data[w->len++] = (uchar)(u | 0x80);
+    u >>= 7;
+  }
+
+  w->data[w->len++] = (uchar)u;
+}
+
+/* Zig-zag encode the difference of two IDs so small negative deltas stay small. */
+static void pack_delta(BMLogPackWriter *w, uint a, uint b)
+{
+  const int delta = (int)(a - b);
+  pack_uint(w, ((uint)delta << 1) ^ (uint)(delta >> 31));
+}
+
+static void pack_vec3_xor(BMLogPackWriter *w, const float v[3], uint prev[3])
+{
+  for (int i = 0; i < 3; i++) {
+    uint u;
+    memcpy(&u, v + i, sizeof(u));
+
+    pack_uint(w, u ^ prev[i]);
+    prev[i] = u;
+  }
+}
+
+static void unpack_bytes(BMLogPackReader *r, void *data, size_t size)
+{
+  BLI_assert(r->pos + size <= r->len);
+
+  memcpy(data, r->data + r->pos, size);
+  r->pos += size;
+}
+
+static uint unpack_uint(BMLogPackReader *r)
+{
+  uint u = 0;
+  int shift = 0;
+  uchar c;
+
+  do {
+    BLI_assert(r->pos < r->len);
+
+    c = r->data[r->pos++];
+    u |= (uint)(c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+
+  return u;
+}
+
+static uint unpack_delta(BMLogPackReader *r, uint b)
+{
+  const uint u = unpack_uint(r);
+  const int delta = (int)(u >> 1) ^ -(int)(u & 1);
+
+  return b + (uint)delta;
+}
+
+static void unpack_vec3_xor(BMLogPackReader *r, float v[3], uint prev[3])
+{
+  for (int i = 0; i < 3; i++) {
+    const uint u = unpack_uint(r) ^ prev[i];
+
+    memcpy(v + i, &u, sizeof(u));
+    prev[i] = u;
+  }
+}
+
+/* Store a column of customdata block presence flags followed by the blocks themselves. */
+static void pack_cdata_blocks(BMLogPackWriter *w, CustomData *cdata, void **blocks, int len)
+{
+  for (int i = 0; i < len; i++) {
+    const uchar used = blocks[i] != NULL;
+    pack_bytes(w, &used, 1);
+  }
+
+  for (int i = 0; i < len; i++) {
+    if (blocks[i]) {
+      CustomData_bmesh_asan_unpoison(cdata, blocks[i]);
+      pack_bytes(w, blocks[i], (size_t)cdata->totsize);
+    }
+  }
+}
+
+/* Allocate blocks from the (re-created) customdata pool of the entry. */
+static void unpack_cdata_blocks(BMLogPackReader *r, CustomData *cdata, void **blocks, int len)
+{
+  for (int i = 0; i < len; i++) {
+    uchar used;
+    unpack_bytes(r, &used, 1);
+
+    blocks[i] = used ? cdata->pool : NULL;
+  }
+
+  for (int i = 0; i < len; i++) {
+    if (blocks[i]) {
+      blocks[i] = BLI_mempool_alloc(cdata->pool);
+
+      unpack_bytes(r, blocks[i], (size_t)cdata->totsize);
+      CustomData_bmesh_asan_poison(cdata, blocks[i]);
+    }
+  }
+}
+
+static int bm_log_pack_item_cmp(const void *a_v, const void *b_v)
+{
+  const BMLogPackItem *a = a_v;
+  const BMLogPackItem *b = b_v;
+
+  return a->id < b->id ? -1 : (int)(a->id > b->id);
+}
+
+static void bm_log_pack_verts(BMLogPackWriter *w,
+                              BMLogEntry *entry,
+                              const BMLogPackItem *items,
+                              void **blocks,
+                              int len)
+{
+  uint prev[3] = {0, 0, 0};
+
+  for (int i = 0; i < len; i++) {
+    /* Unpacking restores the ids from the keys. */
+    BLI_assert(((BMLogVert *)items[i].elem)->head.id == items[i].id);
+    pack_vec3_xor(w, ((BMLogVert *)items[i].elem)->co, prev);
+  }
+
+  prev[0] = prev[1] = prev[2] = 0;
+  for (int i = 0; i < len; i++) {
+    pack_vec3_xor(w, ((BMLogVert *)items[i].elem)->no, prev);
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogVert *lv = items[i].elem;
+
+    pack_bytes(w, &lv->hflag, 1);
+    blocks[i] = lv->customdata;
+  }
+
+  pack_cdata_blocks(w, &entry->vdata, blocks, len);
+}
+
+static void bm_log_unpack_verts(
+    BMLogPackReader *r, BMLogEntry *entry, BMLogPackItem *items, void **blocks, int len)
+{
+  uint prev[3] = {0, 0, 0};
+
+  for (int i = 0; i < len; i++) {
+    BMLogVert *lv = BLI_mempool_calloc(entry->pool_verts);
+
+    lv->head.id = items[i].id;
+    unpack_vec3_xor(r, lv->co, prev);
+
+    items[i].elem = lv;
+  }
+
+  prev[0] = prev[1] = prev[2] = 0;
+  for (int i = 0; i < len; i++) {
+    unpack_vec3_xor(r, ((BMLogVert *)items[i].elem)->no, prev);
+  }
+
+  for (int i = 0; i < len; i++) {
+    unpack_bytes(r, &((BMLogVert *)items[i].elem)->hflag, 1);
+  }
+
+  unpack_cdata_blocks(r, &entry->vdata, blocks, len);
+
+  for (int i = 0; i < len; i++) {
+    ((BMLogVert *)items[i].elem)->customdata = blocks[i];
+  }
+}
+
+static void bm_log_pack_edges(BMLogPackWriter *w,
+                              BMLogEntry *entry,
+                              const BMLogPackItem *items,
+                              void **blocks,
+                              int len)
+{
+  uint prev_v1 = 0;
+
+  for (int i = 0; i < len; i++) {
+    BMLogEdge *le = items[i].elem;
+
+    /* Normally equal to the map key. */
+    pack_delta(w, le->head.id, items[i].id);
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogEdge *le = items[i].elem;
+
+    pack_delta(w, le->v1, prev_v1);
+    pack_delta(w, le->v2, le->v1);
+    prev_v1 = le->v1;
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogEdge *le = items[i].elem;
+
+    pack_bytes(w, &le->hflag, 1);
+    blocks[i] = le->customdata;
+  }
+
+  pack_cdata_blocks(w, &entry->edata, blocks, len);
+}
+
+static void bm_log_unpack_edges(
+    BMLogPackReader *r, BMLogEntry *entry, BMLogPackItem *items, void **blocks, int len)
+{
+  uint prev_v1 = 0;
+
+  for (int i = 0; i < len; i++) {
+    BMLogEdge *le = BLI_mempool_calloc(entry->pool_edges);
+
+    le->head.id = unpack_delta(r, items[i].id);
+    items[i].elem = le;
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogEdge *le = items[i].elem;
+
+    le->v1 = unpack_delta(r, prev_v1);
+    le->v2 = unpack_delta(r, le->v1);
+    prev_v1 = le->v1;
+  }
+
+  for (int i = 0; i < len; i++) {
+    unpack_bytes(r, &((BMLogEdge *)items[i].elem)->hflag, 1);
+  }
+
+  unpack_cdata_blocks(r, &entry->edata, blocks, len);
+
+  for (int i = 0; i < len; i++) {
+    ((BMLogEdge *)items[i].elem)->customdata = blocks[i];
+  }
+}
+
+static void bm_log_pack_faces(BMLogPackWriter *w,
+                              BMLogEntry *entry,
+                              const BMLogPackItem *items,
+                              void **blocks,
+                              int len)
+{
+  uint prev[3] = {0, 0, 0};
+  uint prev_v = 0, prev_l = 0;
+  int totloop = 0;
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    pack_delta(w, lf->head.id, items[i].id);
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    pack_uint(w, lf->len);
+    pack_uint(w, (uint)(ushort)lf->mat_nr);
+    totloop += (int)lf->len;
+  }
+
+  for (int i = 0; i < len; i++) {
+    pack_vec3_xor(w, ((BMLogFace *)items[i].elem)->no, prev);
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    pack_bytes(w, &lf->hflag, 1);
+    blocks[i] = lf->customdata_f;
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    for (uint j = 0; j < lf->len; j++) {
+      pack_delta(w, lf->v_ids[j], prev_v);
+      prev_v = lf->v_ids[j];
+    }
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    for (uint j = 0; j < lf->len; j++) {
+      pack_delta(w, lf->l_ids[j], prev_l);
+      prev_l = lf->l_ids[j];
+    }
+  }
+
+  pack_cdata_blocks(w, &entry->pdata, blocks, len);
+
+  void **loop_blocks = MEM_malloc_arrayN((size_t)totloop, sizeof(void *), __func__);
+  int loop_i = 0;
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    memcpy(loop_blocks + loop_i, lf->customdata, sizeof(void *) * lf->len);
+    loop_i += (int)lf->len;
+  }
+
+  pack_cdata_blocks(w, &entry->ldata, loop_blocks, totloop);
+  MEM_freeN(loop_blocks);
+}
+
+static void bm_log_unpack_faces(
+    BMLogPackReader *r, BMLogEntry *entry, BMLogPackItem *items, void **blocks, int len)
+{
+  uint prev[3] = {0, 0, 0};
+  uint prev_v = 0, prev_l = 0;
+  int totloop = 0;
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = BLI_mempool_calloc(entry->pool_faces);
+
+    lf->head.id = unpack_delta(r, items[i].id);
+    items[i].elem = lf;
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    lf->len = unpack_uint(r);
+    lf->mat_nr = (short)(ushort)unpack_uint(r);
+
+    if (lf->len > MAX_FACE_RESERVED) {
+      lf->v_ids = (uint *)BLI_memarena_alloc(entry->arena, sizeof(*lf->v_ids) * lf->len);
+      lf->l_ids = (uint *)BLI_memarena_alloc(entry->arena, sizeof(*lf->l_ids) * lf->len);
+      lf->customdata = (void **)BLI_memarena_alloc(entry->arena, sizeof(void *) * lf->len);
+    }
+    else {
+      lf->v_ids = lf->v_ids_res;
+      lf->l_ids = lf->l_ids_res;
+      lf->customdata = lf->customdata_res;
+    }
+
+    totloop += (int)lf->len;
+  }
+
+  for (int i = 0; i < len; i++) {
+    unpack_vec3_xor(r, ((BMLogFace *)items[i].elem)->no, prev);
+  }
+
+  for (int i = 0; i < len; i++) {
+    unpack_bytes(r, &((BMLogFace *)items[i].elem)->hflag, 1);
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    for (uint j = 0; j < lf->len; j++) {
+      prev_v = lf->v_ids[j] = unpack_delta(r, prev_v);
+    }
+  }
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    for (uint j = 0; j < lf->len; j++) {
+      prev_l = lf->l_ids[j] = unpack_delta(r, prev_l);
+    }
+  }
+
+  unpack_cdata_blocks(r, &entry->pdata, blocks, len);
+
+  for (int i = 0; i < len; i++) {
+    ((BMLogFace *)items[i].elem)->customdata_f = blocks[i];
+  }
+
+  void **loop_blocks = MEM_malloc_arrayN((size_t)totloop, sizeof(void *), __func__);
+  int loop_i = 0;
+
+  unpack_cdata_blocks(r, &entry->ldata, loop_blocks, totloop);
+
+  for (int i = 0; i < len; i++) {
+    BMLogFace *lf = items[i].elem;
+
+    memcpy(lf->customdata, loop_blocks + loop_i, sizeof(void *) * lf->len);
+    loop_i += (int)lf->len;
+  }
+
+  MEM_freeN(loop_blocks);
+}
+
+static void bm_log_packed_free(BMLogPacked *packed)
+{
+  MEM_freeN(packed->data);
+  MEM_freeN(packed);
+}
+
+static bool bm_log_entry_can_pack(BMLogEntry *entry)
+{
+  /* MDisps own their displacement arrays, which are freed by walking the loop pool of the
+   * entry in #bm_log_entry_free_direct. */
+  return entry->type == LOG_ENTRY_PARTIAL && !entry->packed &&
+         !CustomData_has_layer(&entry->ldata, CD_MDISPS);
+}
+
+/* Serialize the element maps of a partial entry and free them. */
+static void bm_log_entry_pack(BMLogEntry *entry)
+{
+  if (!bm_log_entry_can_pack(entry)) {
+    return;
+  }
+
+  BMLogPackWriter w = {NULL, 0, 4096};
+  w.data = MEM_mallocN(w.size, __func__);
+
+  for (uint i = 0; i < ARRAY_SIZE(bm_log_entry_maps); i++) {
+    GHash *map = BM_LOG_ENTRY_MAP(entry, i);
+    const int len = BLI_ghash_len(map);
+
+    pack_uint(&w, (uint)len);
+
+    if (!len) {
+      continue;
+    }
+
+    BMLogPackItem *items = MEM_malloc_arrayN((size_t)len, sizeof(*items), __func__);
+    void **blocks = MEM_malloc_arrayN((size_t)len, sizeof(void *), __func__);
+    int j = 0;
+
+    GHashIterator gh_iter;
+    GHASH_ITER (gh_iter, map) {
+      items[j].id = POINTER_AS_UINT(BLI_ghashIterator_getKey(&gh_iter));
+      items[j].elem = BLI_ghashIterator_getValue(&gh_iter);
+      j++;
+    }
+
+    qsort(items, (size_t)len, sizeof(*items), bm_log_pack_item_cmp);
+
+    uint prev_id = 0;
+    for (j = 0; j < len; j++) {
+      pack_uint(&w, items[j].id - prev_id);
+      prev_id = items[j].id;
+    }
+
+    switch (bm_log_entry_maps[i].htype) {
+      case BM_VERT:
+        bm_log_pack_verts(&w, entry, items, blocks, len);
+        break;
+      case BM_EDGE:
+        bm_log_pack_edges(&w, entry, items, blocks, len);
+        break;
+      case BM_FACE:
+        bm_log_pack_faces(&w, entry, items, blocks, len);
+        break;
+    }
+
+    MEM_freeN(items);
+    MEM_freeN(blocks);
+  }
+
+  BMLogPacked *packed = MEM_callocN(sizeof(*packed), __func__);
+  packed->raw_size = w.len;
+
+#ifdef WITH_LZO
+  lzo_uint out_len = LZO_OUT_LEN(w.len);
+  uchar *out = MEM_mallocN(out_len, __func__);
+  void *wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, __func__);
+
+  const int ret = lzo1x_1_compress(w.data, (lzo_uint)w.len, out, &out_len, wrkmem);
+  MEM_freeN(wrkmem);
+
+  if (ret == LZO_E_OK && out_len < w.len) {
+    packed->data = MEM_reallocN(out, out_len);
+    packed->size = out_len;
+    packed->compressed = true;
+    MEM_freeN(w.data);
+  }
+  else {
+    MEM_freeN(out);
+  }
+#endif
+
+  if (!packed->compressed) {
+    packed->data = MEM_reallocN(w.data, w.len);
+    packed->size = w.len;
+  }
+
+  bm_log_entry_maps_free(entry);
+
+  CustomData *cdatas[4] = {&entry->vdata, &entry->edata, &entry->ldata, &entry->pdata};
+  for (int i = 0; i < 4; i++) {
+    if (cdatas[i]->pool) {
+      BLI_mempool_destroy(cdatas[i]->pool);
+      cdatas[i]->pool = NULL;
+    }
+  }
+
+  entry->packed = packed;
+}
+
+static void bm_log_entry_unpack(BMLogEntry *entry)
+{
+  BMLogPacked *packed = entry->packed;
+
+  if (!packed) {
+    return;
+  }
+
+  uchar *data = packed->data;
+
+#ifdef WITH_LZO
+  if (packed->compressed) {
+    lzo_uint out_len = (lzo_uint)packed->raw_size;
+    data = MEM_mallocN(packed->raw_size, __func__);
+
+    const int ret = lzo1x_decompress_safe(
+        packed->data, (lzo_uint)packed->size, data, &out_len, NULL);
+
+    BLI_assert(ret == LZO_E_OK && out_len == packed->raw_size);
+    UNUSED_VARS_NDEBUG(ret);
+  }
+#else
+  BLI_assert(!packed->compressed);
+#endif
+
+  bm_log_entry_maps_alloc(entry);
+
+  CustomData_bmesh_init_pool_ex(&entry->vdata, 0, BM_VERT, __func__);
+  CustomData_bmesh_init_pool_ex(&entry->edata, 0, BM_EDGE, __func__);
+  CustomData_bmesh_init_pool_ex(&entry->ldata, 0, BM_LOOP, __func__);
+  CustomData_bmesh_init_pool_ex(&entry->pdata, 0, BM_FACE, __func__);
+
+  BMLogPackReader r = {data, 0, packed->raw_size};
+
+  for (uint i = 0; i < ARRAY_SIZE(bm_log_entry_maps); i++) {
+    GHash *map = BM_LOG_ENTRY_MAP(entry, i);
+    const int len = (int)unpack_uint(&r);
+
+    if (!len) {
+      continue;
+    }
+
+    BMLogPackItem *items = MEM_malloc_arrayN((size_t)len, sizeof(*items), __func__);
+    void **blocks = MEM_malloc_arrayN((size_t)len, sizeof(void *), __func__);
+
+    uint prev_id = 0;
+    for (int j = 0; j < len; j++) {
+      prev_id = items[j].id = prev_id + unpack_uint(&r);
+    }
+
+    switch (bm_log_entry_maps[i].htype) {
+      case BM_VERT:
+        bm_log_unpack_verts(&r, entry, items, blocks, len);
+        break;
+      case BM_EDGE:
+        bm_log_unpack_edges(&r, entry, items, blocks, len);
+        break;
+      case BM_FACE:
+        bm_log_unpack_faces(&r, entry, items, blocks, len);
+        break;
+    }
+
+    BLI_ghash_reserve(map, len);
+    for (int j = 0; j < len; j++) {
+      BLI_ghash_insert(map, POINTER_FROM_UINT(items[j].id), items[j].elem);
+    }
+
+    MEM_freeN(items);
+    MEM_freeN(blocks);
+  }
+
+  BLI_assert(r.pos == r.len);
+
+  if (data != packed->data) {
+    MEM_freeN(data);
+  }
+
+  bm_log_packed_free(packed);
+  entry->packed = NULL;
 }
 
+/* Unpack an entry and all the sub-entries it was combined with. */
+static void bm_log_entry_ensure_unpacked(BMLogEntry *entry)
+{
+  if (!entry) {
+    return;
+  }
+
+  while (entry->combined_next) {
+    entry = entry->combined_next;
+  }
+
+  for (; entry; entry = entry->combined_prev) {
+    bm_log_entry_unpack(entry);
+  }
+}
+
+/* Pack everything but the current entry and the #BMLOG_UNPACKED_ENTRIES most recent ones. */
+static void bm_log_pack_cold_entries(BMLog *log)
+{
+  int i = 0;
+
+  for (BMLogEntry *entry = log->entries.last; entry; entry = entry->prev, i++) {
+    if (i < BMLOG_UNPACKED_ENTRIES || entry == log->current_entry) {
+      continue;
+    }
+
+    for (BMLogEntry *entry2 = entry; entry2; entry2 = entry2->combined_prev) {
+      bm_log_entry_pack(entry2);
+    }
+  }
+}
+
+/** \} */
+
 /* Free the data in a log entry
  *
  * NOTE: does not free the log entry itself. */
@@ -1668,26 +2403,18 @@ static void bm_log_entry_free_direct(BMLogEntry *entry)
       BKE_mesh_free_data_for_undo(entry->full_copy_mesh);
       break;
     case LOG_ENTRY_PARTIAL:
-      BLI_ghash_free(entry->topo_modified_verts_pre, NULL, NULL);
-      BLI_ghash_free(entry->topo_modified_verts_post, NULL, NULL);
-      BLI_ghash_free(entry->topo_modified_edges_pre, NULL, NULL);
-      BLI_ghash_free(entry->topo_modified_edges_post, NULL, NULL);
-      BLI_ghash_free(entry->topo_modified_faces_pre, NULL, NULL);
-      BLI_ghash_free(entry->topo_modified_faces_post, NULL, NULL);
-
-      BLI_ghash_free(entry->modified_verts, NULL, NULL);
-      BLI_ghash_free(entry->modified_edges, NULL, NULL);
-      BLI_ghash_free(entry->modified_faces, NULL, NULL);
-
-      BLI_mempool_destroy(entry->pool_verts);
-      BLI_mempool_destroy(entry->pool_edges);
-      BLI_mempool_destroy(entry->pool_faces);
-      BLI_memarena_free(entry->arena);
+      if (entry->packed) {
+        bm_log_packed_free(entry->packed);
+        entry->packed = NULL;
+      }
+      else {
+        bm_log_entry_maps_free(entry);
+      }
 
       /* check for the weird case that a user has dynamic
          topology on with multires data */
 
-      if (CustomData_has_layer(&entry->ldata, CD_MDISPS)) {
+      if (entry->ldata.pool && CustomData_has_layer(&entry->ldata, CD_MDISPS)) {
         int cd_mdisps = CustomData_get_offset(&entry->ldata, CD_MDISPS);
 
         /* iterate over cdata blocks directly */
@@ -1825,6 +2552,7 @@ BMLog *BM_log_create(BMesh *bm, int cd_sculpt_vert)
 BMLog *bm_log_from_existing_entries_create(BMesh *bm, BMLog *log, BMLogEntry *entry)
 {
   log->current_entry = entry;
+  bm_log_entry_ensure_unpacked(entry);
 
   /* Let BMLog manage the entry list again */
   log->entries.first = log->entries.last = entry;
@@ -1985,6 +2713,14 @@ void BM_log_print_entry(BMLog *log, BMLogEntry *entry)
         fprintf(DEBUG_FILE, "==element IDs snapshot\n");
         break;
       case LOG_ENTRY_PARTIAL:
+        if (first->packed) {
+          fprintf(DEBUG_FILE,
+                  "==packed: %d bytes (%d unpacked)\n",
+                  (int)first->packed->size,
+                  (int)first->packed->raw_size);
+          break;
+        }
+
         fprintf(DEBUG_FILE, "==modified: ");
         fprintf(DEBUG_FILE, "v: %d ", BLI_ghash_len(first->modified_verts));
         fprintf(DEBUG_FILE, "e: %d ", BLI_ghash_len(first->modified_edges));
@@ -2184,6 +2920,8 @@ BMLogEntry *bm_log_entry_add_ex(
 
   log->current_entry = entry;
 
+  bm_log_pack_cold_entries(log);
+
   return entry;
 }
 
@@ -2267,7 +3005,8 @@ bool BM_log_entry_drop(BMLogEntry *entry)
 
 static void full_copy_load(BMesh *bm, BMLog *log, BMLogEntry *entry)
 {
-  CustomData_MeshMasks cd_mask_extra = {CD_MASK_DYNTOPO_VERT | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
+  CustomData_MeshMasks cd_mask_extra = {
+      CD_MASK_DYNTOPO_VERT | CD_MASK_DYNTOPO_VERT_COLD | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
 
   int shapenr = bm->shapenr;
 
@@ -2528,6 +3267,7 @@ void BM_log_set_current_entry(BMLog *log, BMLogEntry *entry)
   }
 
   log->current_entry = entry;
+  bm_log_entry_ensure_unpacked(entry);
 }
 
 BMLogEntry *BM_log_all_ids(BMesh *bm, BMLog *log, BMLogEntry *entry)
@@ -2550,7 +3290,8 @@ BMLogEntry *BM_log_all_ids(BMesh *bm, BMLog *log, BMLogEntry *entry)
 
 static void full_copy_swap(BMesh *bm, BMLog *log, BMLogEntry *entry)
 {
-  CustomData_MeshMasks cd_mask_extra = {CD_MASK_DYNTOPO_VERT | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
+  CustomData_MeshMasks cd_mask_extra = {
+      CD_MASK_DYNTOPO_VERT | CD_MASK_DYNTOPO_VERT_COLD | CD_MASK_SHAPEKEY, 0, 0, 0, 0};
 
   BMLogEntry tmp = {0};
 
@@ -2612,6 +3353,8 @@ static void bm_log_undo_intern(
     return;
   }
 
+  bm_log_entry_unpack(entry);
+
   /* Delete added faces and verts */
   bm_log_faces_unmake_pre(bm, log, entry->topo_modified_faces_post, entry, callbacks);
   bm_log_edges_unmake_pre(bm, log, entry->topo_modified_edges_post, entry, callbacks);
@@ -2637,6 +3380,8 @@ void BM_log_undo_skip(BMesh *bm, BMLog *log)
   if (log->current_entry) {
     log->current_entry = log->current_entry->prev;
   }
+
+  bm_log_entry_ensure_unpacked(log->current_entry);
 }
 
 void BM_log_redo_skip(BMesh *bm, BMLog *log)
@@ -2647,6 +3392,8 @@ void BM_log_redo_skip(BMesh *bm, BMLog *log)
   else {
     log->current_entry = log->entries.first;
   }
+
+  bm_log_entry_ensure_unpacked(log->current_entry);
 }
 
 void BM_log_undo_single(BMesh *bm,
@@ -2667,6 +3414,7 @@ void BM_log_undo_single(BMesh *bm,
   entry = entry->combined_prev;
 
   log->current_entry = entry ? entry : preventry;
+  bm_log_entry_ensure_unpacked(log->current_entry);
 }
 
 void BM_log_undo(BMesh *bm, BMLog *log, BMLogCallbacks *callbacks, const char *node_layer_id)
@@ -2686,6 +3434,7 @@ void BM_log_undo(BMesh *bm, BMLog *log, BMLogCallbacks *callbacks, const char *n
   }
 
   log->current_entry = preventry;
+  bm_log_entry_ensure_unpacked(log->current_entry);
 }
 
 /* Redo one BMLogEntry
@@ -2716,6 +3465,8 @@ static void bm_log_redo_intern(
   bm->elem_index_dirty |= BM_VERT | BM_EDGE | BM_FACE;
   bm->elem_table_dirty |= BM_VERT | BM_EDGE | BM_FACE;
 
+  bm_log_entry_unpack(entry);
+
   /* Re-delete previously deleted faces and verts */
   bm_log_faces_unmake_pre(bm, log, entry->topo_modified_faces_pre, entry, callbacks);
   bm_log_edges_unmake_pre(bm, log, entry->topo_modified_edges_pre, entry, callbacks);
@@ -2842,6 +3593,7 @@ void BM_log_redo(BMesh *bm, BMLog *log, BMLogCallbacks *callbacks, const char *n
   }
 
   log->current_entry = nextentry;
+  bm_log_entry_ensure_unpacked(log->current_entry);
 }
 
 /* Log a vertex before it is modified
@@ -3565,7 +4317,10 @@ static int bmlog_entry_memsize(BMLogEntry *entry)
 {
   int ret = 0;
 
-  if (entry->type == LOG_ENTRY_PARTIAL) {
+  if (entry->type == LOG_ENTRY_PARTIAL && entry->packed) {
+    ret += (int)(sizeof(*entry->packed) + entry->packed->size);
+  }
+  else if (entry->type == LOG_ENTRY_PARTIAL) {
     ret += (int)BLI_mempool_get_size(entry->pool_verts);
     ret += (int)BLI_mempool_get_size(entry->pool_edges);
     ret += (int)BLI_mempool_get_size(entry->pool_faces);
@@ -3696,6 +4451,8 @@ ATTR_NO_OPT static GHash *bm_clone_ghash(BMLogEntry *entry, GHash *ghash, int ty
 
 ATTR_NO_OPT static BMLogEntry *bm_log_entry_clone_intern(BMLogEntry *entry, BMLog *newlog)
 {
+  bm_log_entry_unpack(entry);
+
   BMLogEntry *newentry = MEM_callocN(sizeof(*entry), "BMLogEntry cloned");
 
   *newentry = *entry;
@@ -3860,6 +4617,8 @@ ATTR_NO_OPT static bool bm_log_validate_intern(
     return true;
   }
 
+  bm_log_entry_unpack(srcEntry);
+
   BMLogEntry *entry = precopy ? bm_log_entry_clone(srcEntry, newlog) : srcEntry;
   bool ok = true;
 
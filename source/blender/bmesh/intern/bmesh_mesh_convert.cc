@@ -75,6 +75,8 @@
 #include "DNA_modifier_types.h"
 #include "DNA_object_types.h"
 
+#include <atomic>
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_alloca.h"
@@ -84,6 +86,7 @@
 #include "BLI_listbase.h"
 #include "BLI_math_vector.h"
 #include "BLI_span.hh"
+#include "BLI_task.hh"
 
 #include "BKE_customdata.h"
 #include "BKE_mesh.h"
@@ -99,6 +102,9 @@
 #include "intern/bmesh_private.h" /* For element checking. */
 #include "range_tree.h"
 
+/* Smallest mesh converted on all threads, below this the task overhead isn't worth it. */
+#define BM_FROM_ME_THREADED_MIN_VERTS 1024
+
 static void bm_free_cd_pools(BMesh *bm)
 {
   if (bm->vdata.pool) {
@@ -167,6 +173,7 @@ static CLG_LogRef LOG = {"bmesh.mesh.convert"};
 using blender::Array;
 using blender::IndexRange;
 using blender::Span;
+using blender::threading::parallel_for;
 
 void BM_mesh_cd_flag_ensure(BMesh *bm, Mesh *mesh, const char cd_flag)
 {
@@ -287,6 +294,62 @@ void BM_enter_multires_space(Object *ob, BMesh *bm, int space)
 
 #include "BLI_compiler_attrs.h"
 
+/**
+ * Check that every face can be built as is: at least three corners, corner indices in range, each
+ * corner edge connecting the corner to the next one and no vertex used twice. The threaded
+ * conversion has no bad face handling, meshes failing this are converted on a single thread.
+ */
+static bool bm_mesh_faces_valid_for_threading(const Mesh *me)
+{
+  Span<MPoly> mpoly{me->mpoly, me->totpoly};
+  Span<MLoop> mloop{me->mloop, me->totloop};
+  Span<MEdge> medge{me->medge, me->totedge};
+  std::atomic<bool> valid = true;
+
+  parallel_for(mpoly.index_range(), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      if (!valid.load(std::memory_order_relaxed)) {
+        return;
+      }
+
+      const MPoly &mp = mpoly[i];
+      if (mp.totloop < 3 || mp.loopstart < 0 || mp.loopstart + mp.totloop > mloop.size()) {
+        valid = false;
+        return;
+      }
+
+      Span<MLoop> loops = mloop.slice(mp.loopstart, mp.totloop);
+      for (const int j : loops.index_range()) {
+        const MLoop &ml = loops[j];
+        const MLoop &ml_next = loops[(j + 1) % loops.size()];
+
+        if (ml.v >= uint(me->totvert) || ml_next.v >= uint(me->totvert) ||
+            ml.e >= uint(medge.size())) {
+          valid = false;
+          return;
+        }
+
+        const MEdge &me_corner = medge[ml.e];
+        if (!ELEM(ml.v, me_corner.v1, me_corner.v2) ||
+            !ELEM(ml_next.v, me_corner.v1, me_corner.v2) || me_corner.v1 == me_corner.v2) {
+          valid = false;
+          return;
+        }
+
+        /* Unique vertices with connecting edges also means the edges are unique. */
+        for (const int k : IndexRange(j + 1, loops.size() - j - 1)) {
+          if (loops[k].v == ml.v) {
+            valid = false;
+            return;
+          }
+        }
+      }
+    }
+  });
+
+  return valid;
+}
+
 /**
  * \brief Mesh -> BMesh
  * \param ob: object that owns bm, may be nullptr (which will disable multires space change)
@@ -594,186 +657,258 @@ void BM_mesh_bm_from_me(Object *ob,
     cd_shape_key_offset[i] = bm->vdata.layers[idx].offset;
   }
 
-  Span<MVert> mvert{me->mvert, me->totvert};
   Array<BMVert *> vtable(me->totvert);
-  for (const int i : mvert.index_range()) {
-    BMVert *v = vtable[i] = BM_vert_create(
-        bm, keyco ? keyco[i] : mvert[i].co, nullptr, BM_CREATE_SKIP_CD);
-    BM_elem_index_set(v, i); /* set_ok */
-
-    /* Transfer flag. */
-    v->head.hflag = BM_vert_flag_from_mflag(mvert[i].flag & ~SELECT);
-
-    /* This is necessary for selection counts to work properly. */
-    if (mvert[i].flag & SELECT) {
-      BM_vert_select_set(bm, v, true);
-    }
-
-    if (vert_normals) {
-      copy_v3_v3(v->no, vert_normals[i]);
-    }
+  Array<BMEdge *> etable(me->totedge);
 
-    /* Copy Custom Data */
-    CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i, &v->head.data, true);
+  /* Building the elements dominates the conversion time of large meshes, empty BMesh's are
+   * filled in on all threads. These may still have layers, e.g. for IDs or tool-flags.
+   * Invalid meshes go through the single threaded path and its bad face handling. */
+  const bool use_threading = !params->no_threading &&
+                             me->totvert >= BM_FROM_ME_THREADED_MIN_VERTS && bm->totvert == 0 &&
+                             bm->totedge == 0 && bm->totface == 0 &&
+                             bm_mesh_faces_valid_for_threading(me);
 
-    bm_elem_check_toolflags(bm, (BMElem *)v);
+  /* Only needed for selection, the threaded conversion uses it to assign tool-flags and IDs. */
+  Array<BMFace *> ftable;
+  if (use_threading || (me->mselect && me->totselect != 0)) {
+    ftable.reinitialize(me->totpoly);
+  }
 
-    if (has_ids & BM_VERT) {
-      if ((use_exist_ids & BM_VERT) && !IS_GARBAGE_ID(existing_id_layers[0][i])) {
-        bm_assign_id(bm, (BMElem *)v, existing_id_layers[0][i], false);
+  if (use_threading) {
+    BMFromMeThreadedParams threaded_params = {nullptr};
+    threaded_params.vert_coords = keyco;
+    threaded_params.vert_normals = vert_normals;
+    threaded_params.shape_key_table = shape_key_table;
+    threaded_params.cd_shape_key_offset = cd_shape_key_offset;
+    threaded_params.tot_shape_keys = tot_shape_keys;
+    threaded_params.cd_shape_keyindex_offset = cd_shape_keyindex_offset;
+    threaded_params.cd_vert_bweight_offset = cd_vert_bweight_offset;
+    threaded_params.cd_edge_bweight_offset = cd_edge_bweight_offset;
+    threaded_params.cd_edge_crease_offset = cd_edge_crease_offset;
+    threaded_params.calc_face_normal = params->calc_face_normal;
+    threaded_params.vtable = vtable.data();
+    threaded_params.etable = etable.data();
+    threaded_params.ftable = ftable.data();
+
+    bm_mesh_bm_from_me_threaded(bm, me, &threaded_params);
+
+    if (me->act_face >= 0 && me->act_face < me->totpoly) {
+      bm->act_face = ftable[me->act_face];
+    }
+
+    /* Tool-flags and IDs come from shared pools, assign them in the same order as the single
+     * threaded conversion so both give the same result. */
+    auto elem_id_assign = [&](BMElem *elem, const int type, const int *existing_ids, int i) {
+      if ((use_exist_ids & type) && !IS_GARBAGE_ID(existing_ids[i])) {
+        bm_assign_id(bm, elem, existing_ids[i], false);
       }
       else {
-        bm_alloc_id(bm, (BMElem *)v);
+        bm_alloc_id(bm, elem);
       }
-    }
+    };
 
-    if (cd_vert_bweight_offset != -1) {
-      BM_ELEM_CD_SET_FLOAT(v, cd_vert_bweight_offset, (float)mvert[i].bweight / 255.0f);
+    for (const int i : vtable.index_range()) {
+      bm_elem_check_toolflags(bm, (BMElem *)vtable[i]);
+      if (has_ids & BM_VERT) {
+        elem_id_assign((BMElem *)vtable[i], BM_VERT, existing_id_layers[0], i);
+      }
     }
-
-    /* Set shape key original index. */
-    if (cd_shape_keyindex_offset != -1) {
-      BM_ELEM_CD_SET_INT(v, cd_shape_keyindex_offset, i);
+    for (const int i : etable.index_range()) {
+      bm_elem_check_toolflags(bm, (BMElem *)etable[i]);
+      if (has_ids & BM_EDGE) {
+        elem_id_assign((BMElem *)etable[i], BM_EDGE, existing_id_layers[1], i);
+      }
     }
+    for (const int i : ftable.index_range()) {
+      BMFace *f = ftable[i];
+      if (has_ids & BM_LOOP) {
+        int j = me->mpoly[i].loopstart;
+        BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
+        BMLoop *l_iter = l_first;
+        do {
+          elem_id_assign((BMElem *)l_iter, BM_LOOP, existing_id_layers[2], j++);
+        } while ((l_iter = l_iter->next) != l_first);
+      }
 
-    /* Set shape-key data. */
-    if (tot_shape_keys) {
-      for (int j = 0; j < tot_shape_keys; j++) {
-        float(*co_dst)[3] = static_cast<float(*)[3]>(
-            BM_ELEM_CD_GET_VOID_P(v, cd_shape_key_offset[j]));
-        copy_v3_v3(co_dst[0], shape_key_table[j][i]);
+      bm_elem_check_toolflags(bm, (BMElem *)f);
+      if (has_ids & BM_FACE) {
+        elem_id_assign((BMElem *)f, BM_FACE, existing_id_layers[3], i);
       }
     }
   }
-  if (is_new) {
-    bm->elem_index_dirty &= ~BM_VERT; /* Added in order, clear dirty flag. */
-  }
+  else {
+    Span<MVert> mvert{me->mvert, me->totvert};
+    for (const int i : mvert.index_range()) {
+      BMVert *v = vtable[i] = BM_vert_create(
+          bm, keyco ? keyco[i] : mvert[i].co, nullptr, BM_CREATE_SKIP_CD);
+      BM_elem_index_set(v, i); /* set_ok */
+
+      /* Transfer flag. */
+      v->head.hflag = BM_vert_flag_from_mflag(mvert[i].flag & ~SELECT);
+
+      /* This is necessary for selection counts to work properly. */
+      if (mvert[i].flag & SELECT) {
+        BM_vert_select_set(bm, v, true);
+      }
 
-  Span<MEdge> medge{me->medge, me->totedge};
-  Array<BMEdge *> etable(me->totedge);
-  for (const int i : medge.index_range()) {
-    BMEdge *e = etable[i] = BM_edge_create(
-        bm, vtable[medge[i].v1], vtable[medge[i].v2], nullptr, BM_CREATE_SKIP_CD);
-    BM_elem_index_set(e, i); /* set_ok */
+      if (vert_normals) {
+        copy_v3_v3(v->no, vert_normals[i]);
+      }
 
-    /* Transfer flags. */
-    e->head.hflag = BM_edge_flag_from_mflag(medge[i].flag & ~SELECT);
+      /* Copy Custom Data */
+      CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i, &v->head.data, true);
 
-    /* This is necessary for selection counts to work properly. */
-    if (medge[i].flag & SELECT) {
-      BM_edge_select_set(bm, e, true);
-    }
+      bm_elem_check_toolflags(bm, (BMElem *)v);
 
-    /* Copy Custom Data */
-    CustomData_to_bmesh_block(&me->edata, &bm->edata, i, &e->head.data, true);
+      if (has_ids & BM_VERT) {
+        if ((use_exist_ids & BM_VERT) && !IS_GARBAGE_ID(existing_id_layers[0][i])) {
+          bm_assign_id(bm, (BMElem *)v, existing_id_layers[0][i], false);
+        }
+        else {
+          bm_alloc_id(bm, (BMElem *)v);
+        }
+      }
 
-    bm_elem_check_toolflags(bm, (BMElem *)e);
+      if (cd_vert_bweight_offset != -1) {
+        BM_ELEM_CD_SET_FLOAT(v, cd_vert_bweight_offset, (float)mvert[i].bweight / 255.0f);
+      }
 
-    if (has_ids & BM_EDGE) {
-      if ((use_exist_ids & BM_EDGE) && !IS_GARBAGE_ID(existing_id_layers[1][i])) {
-        bm_assign_id(bm, (BMElem *)e, existing_id_layers[1][i], false);
+      /* Set shape key original index. */
+      if (cd_shape_keyindex_offset != -1) {
+        BM_ELEM_CD_SET_INT(v, cd_shape_keyindex_offset, i);
       }
-      else {
-        bm_alloc_id(bm, (BMElem *)e);
+
+      /* Set shape-key data. */
+      if (tot_shape_keys) {
+        for (int j = 0; j < tot_shape_keys; j++) {
+          float(*co_dst)[3] = static_cast<float(*)[3]>(
+              BM_ELEM_CD_GET_VOID_P(v, cd_shape_key_offset[j]));
+          copy_v3_v3(co_dst[0], shape_key_table[j][i]);
+        }
       }
     }
+    if (is_new) {
+      bm->elem_index_dirty &= ~BM_VERT; /* Added in order, clear dirty flag. */
+    }
+
+    Span<MEdge> medge{me->medge, me->totedge};
+    for (const int i : medge.index_range()) {
+      BMEdge *e = etable[i] = BM_edge_create(
+          bm, vtable[medge[i].v1], vtable[medge[i].v2], nullptr, BM_CREATE_SKIP_CD);
+      BM_elem_index_set(e, i); /* set_ok */
+
+      /* Transfer flags. */
+      e->head.hflag = BM_edge_flag_from_mflag(medge[i].flag & ~SELECT);
+
+      /* This is necessary for selection counts to work properly. */
+      if (medge[i].flag & SELECT) {
+        BM_edge_select_set(bm, e, true);
+      }
+
+      /* Copy Custom Data */
+      CustomData_to_bmesh_block(&me->edata, &bm->edata, i, &e->head.data, true);
 
-    if (cd_edge_bweight_offset != -1) {
-      BM_ELEM_CD_SET_FLOAT(e, cd_edge_bweight_offset, (float)medge[i].bweight / 255.0f);
+      bm_elem_check_toolflags(bm, (BMElem *)e);
+
+      if (has_ids & BM_EDGE) {
+        if ((use_exist_ids & BM_EDGE) && !IS_GARBAGE_ID(existing_id_layers[1][i])) {
+          bm_assign_id(bm, (BMElem *)e, existing_id_layers[1][i], false);
+        }
+        else {
+          bm_alloc_id(bm, (BMElem *)e);
+        }
+      }
+
+      if (cd_edge_bweight_offset != -1) {
+        BM_ELEM_CD_SET_FLOAT(e, cd_edge_bweight_offset, (float)medge[i].bweight / 255.0f);
+      }
+      if (cd_edge_crease_offset != -1) {
+        BM_ELEM_CD_SET_FLOAT(e, cd_edge_crease_offset, (float)medge[i].crease / 255.0f);
+      }
     }
-    if (cd_edge_crease_offset != -1) {
-      BM_ELEM_CD_SET_FLOAT(e, cd_edge_crease_offset, (float)medge[i].crease / 255.0f);
+    if (is_new) {
+      bm->elem_index_dirty &= ~BM_EDGE; /* Added in order, clear dirty flag. */
     }
-  }
-  if (is_new) {
-    bm->elem_index_dirty &= ~BM_EDGE; /* Added in order, clear dirty flag. */
-  }
 
-  Span<MPoly> mpoly{me->mpoly, me->totpoly};
-  Span<MLoop> mloop{me->mloop, me->totloop};
+    Span<MPoly> mpoly{me->mpoly, me->totpoly};
+    Span<MLoop> mloop{me->mloop, me->totloop};
 
-  /* Only needed for selection. */
+    int totloops = 0;
+    for (const int i : mpoly.index_range()) {
+      BMFace *f = bm_face_create_from_mpoly(
+          *bm, mloop.slice(mpoly[i].loopstart, mpoly[i].totloop), vtable, etable);
+      if (!ftable.is_empty()) {
+        ftable[i] = f;
+      }
 
-  Array<BMFace *> ftable;
-  if (me->mselect && me->totselect != 0) {
-    ftable.reinitialize(me->totpoly);
-  }
+      if (UNLIKELY(f == nullptr)) {
+        printf(
+            "%s: Warning! Bad face in mesh"
+            " \"%s\" at index %d!, skipping\n",
+            __func__,
+            me->id.name + 2,
+            i);
+        continue;
+      }
 
-  int totloops = 0;
-  for (const int i : mpoly.index_range()) {
-    BMFace *f = bm_face_create_from_mpoly(
-        *bm, mloop.slice(mpoly[i].loopstart, mpoly[i].totloop), vtable, etable);
-    if (!ftable.is_empty()) {
-      ftable[i] = f;
-    }
+      /* Don't use 'i' since we may have skipped the face. */
+      BM_elem_index_set(f, bm->totface - 1); /* set_ok */
 
-    if (UNLIKELY(f == nullptr)) {
-      printf(
-          "%s: Warning! Bad face in mesh"
-          " \"%s\" at index %d!, skipping\n",
-          __func__,
-          me->id.name + 2,
-          i);
-      continue;
-    }
+      /* Transfer flag. */
+      f->head.hflag = BM_face_flag_from_mflag(mpoly[i].flag & ~ME_FACE_SEL);
 
-    /* Don't use 'i' since we may have skipped the face. */
-    BM_elem_index_set(f, bm->totface - 1); /* set_ok */
+      /* This is necessary for selection counts to work properly. */
+      if (mpoly[i].flag & ME_FACE_SEL) {
+        BM_face_select_set(bm, f, true);
+      }
 
-    /* Transfer flag. */
-    f->head.hflag = BM_face_flag_from_mflag(mpoly[i].flag & ~ME_FACE_SEL);
+      f->mat_nr = mpoly[i].mat_nr;
+      if (i == me->act_face) {
+        bm->act_face = f;
+      }
 
-    /* This is necessary for selection counts to work properly. */
-    if (mpoly[i].flag & ME_FACE_SEL) {
-      BM_face_select_set(bm, f, true);
-    }
+      int j = mpoly[i].loopstart;
+      BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
+      BMLoop *l_iter = l_first;
+      do {
+        /* Don't use 'j' since we may have skipped some faces, hence some loops. */
+        BM_elem_index_set(l_iter, totloops++); /* set_ok */
 
-    f->mat_nr = mpoly[i].mat_nr;
-    if (i == me->act_face) {
-      bm->act_face = f;
-    }
+        /* Save index of corresponding #MLoop. */
+        CustomData_to_bmesh_block(&me->ldata, &bm->ldata, j++, &l_iter->head.data, true);
 
-    int j = mpoly[i].loopstart;
-    BMLoop *l_first = BM_FACE_FIRST_LOOP(f);
-    BMLoop *l_iter = l_first;
-    do {
-      /* Don't use 'j' since we may have skipped some faces, hence some loops. */
-      BM_elem_index_set(l_iter, totloops++); /* set_ok */
+        if (has_ids & BM_LOOP) {
+          if ((use_exist_ids & BM_LOOP) && !IS_GARBAGE_ID(existing_id_layers[2][j - 1])) {
+            bm_assign_id(bm, (BMElem *)l_iter, existing_id_layers[2][j - 1], false);
+          }
+          else {
+            bm_alloc_id(bm, (BMElem *)l_iter);
+          }
+        }
+      } while ((l_iter = l_iter->next) != l_first);
 
-      /* Save index of corresponding #MLoop. */
-      CustomData_to_bmesh_block(&me->ldata, &bm->ldata, j++, &l_iter->head.data, true);
+      /* Copy Custom Data */
+      CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
 
-      if (has_ids & BM_LOOP) {
-        if ((use_exist_ids & BM_LOOP) && !IS_GARBAGE_ID(existing_id_layers[2][j - 1])) {
-          bm_assign_id(bm, (BMElem *)l_iter, existing_id_layers[2][j - 1], false);
+      bm_elem_check_toolflags(bm, (BMElem *)f);
+
+      if (has_ids & BM_FACE) {
+        if ((use_exist_ids & BM_FACE) && !IS_GARBAGE_ID(existing_id_layers[3][i])) {
+          bm_assign_id(bm, (BMElem *)f, existing_id_layers[3][i], false);
         }
         else {
-          bm_alloc_id(bm, (BMElem *)l_iter);
+          bm_alloc_id(bm, (BMElem *)f);
         }
       }
-    } while ((l_iter = l_iter->next) != l_first);
-
-    /* Copy Custom Data */
-    CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
 
-    bm_elem_check_toolflags(bm, (BMElem *)f);
-
-    if (has_ids & BM_FACE) {
-      if ((use_exist_ids & BM_FACE) && !IS_GARBAGE_ID(existing_id_layers[3][i])) {
-        bm_assign_id(bm, (BMElem *)f, existing_id_layers[3][i], false);
-      }
-      else {
-        bm_alloc_id(bm, (BMElem *)f);
+      if (params->calc_face_normal) {
+        BM_face_normal_update(f);
       }
     }
-
-    if (params->calc_face_normal) {
-      BM_face_normal_update(f);
+    if (is_new) {
+      bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP); /* Added in order, clear dirty flag. */
     }
   }
-  if (is_new) {
-    bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP); /* Added in order, clear dirty flag. */
-  }
 
   if (check_id_unqiue) {
     bm_update_idmap_cdlayers(bm);
@@ -1356,10 +1491,7 @@ BLI_INLINE void bmesh_quick_edgedraw_flag(MEdge *med, BMEdge *e)
 void BM_mesh_bm_to_me(
     Main *bmain, Object *ob, BMesh *bm, Mesh *me, const struct BMeshToMeshParams *params)
 {
-  MEdge *med;
-  BMVert *v, *eve;
-  BMEdge *e;
-  BMFace *f;
+  BMVert *eve;
   BMIter iter;
   int i, j;
 
@@ -1469,91 +1601,106 @@ void BM_mesh_bm_to_me(
   /* This is called again, 'dotess' arg is used there. */
   BKE_mesh_update_customdata_pointers(me, false);
 
-  i = 0;
-  BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
-    copy_v3_v3(mvert->co, v->co);
+  /* Faces read the vertex and edge indices, every pass runs on all threads. */
+  BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
 
-    mvert->flag = BM_vert_flag_to_mflag(v);
+  parallel_for(IndexRange(bm->totvert), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMVert *v = bm->vtable[i];
+      MVert *mv = &mvert[i];
 
-    BM_elem_index_set(v, i); /* set_inline */
+      copy_v3_v3(mv->co, v->co);
 
-    /* Copy over custom-data. */
-    CustomData_from_bmesh_block(&bm->vdata, &me->vdata, v->head.data, i);
+      mv->flag = BM_vert_flag_to_mflag(v);
 
-    if (cd_vert_bweight_offset != -1) {
-      mvert->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, cd_vert_bweight_offset);
-    }
+      BM_elem_index_set(v, i); /* set_inline */
 
-    i++;
-    mvert++;
+      /* Copy over custom-data. */
+      CustomData_from_bmesh_block(&bm->vdata, &me->vdata, v->head.data, i);
 
-    BM_CHECK_ELEMENT(v);
-  }
+      if (cd_vert_bweight_offset != -1) {
+        mv->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(v, cd_vert_bweight_offset);
+      }
+
+      BM_CHECK_ELEMENT(v);
+    }
+  });
   bm->elem_index_dirty &= ~BM_VERT;
 
-  med = medge;
-  i = 0;
-  BM_ITER_MESH (e, &iter, bm, BM_EDGES_OF_MESH) {
-    med->v1 = BM_elem_index_get(e->v1);
-    med->v2 = BM_elem_index_get(e->v2);
+  parallel_for(IndexRange(bm->totedge), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMEdge *e = bm->etable[i];
+      MEdge *med = &medge[i];
 
-    med->flag = BM_edge_flag_to_mflag(e);
+      med->v1 = BM_elem_index_get(e->v1);
+      med->v2 = BM_elem_index_get(e->v2);
 
-    BM_elem_index_set(e, i); /* set_inline */
+      med->flag = BM_edge_flag_to_mflag(e);
 
-    /* Copy over custom-data. */
-    CustomData_from_bmesh_block(&bm->edata, &me->edata, e->head.data, i);
+      BM_elem_index_set(e, i); /* set_inline */
 
-    bmesh_quick_edgedraw_flag(med, e);
+      /* Copy over custom-data. */
+      CustomData_from_bmesh_block(&bm->edata, &me->edata, e->head.data, i);
 
-    if (cd_edge_crease_offset != -1) {
-      med->crease = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_crease_offset);
-    }
-    if (cd_edge_bweight_offset != -1) {
-      med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_bweight_offset);
-    }
+      bmesh_quick_edgedraw_flag(med, e);
 
-    i++;
-    med++;
-    BM_CHECK_ELEMENT(e);
-  }
-  bm->elem_index_dirty &= ~BM_EDGE;
+      if (cd_edge_crease_offset != -1) {
+        med->crease = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_crease_offset);
+      }
+      if (cd_edge_bweight_offset != -1) {
+        med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(e, cd_edge_bweight_offset);
+      }
 
-  i = 0;
-  j = 0;
-  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
-    BMLoop *l_iter, *l_first;
-    mpoly->loopstart = j;
-    mpoly->totloop = f->len;
-    mpoly->mat_nr = f->mat_nr;
-    mpoly->flag = BM_face_flag_to_mflag(f);
+      BM_CHECK_ELEMENT(e);
+    }
+  });
+  bm->elem_index_dirty &= ~BM_EDGE;
 
-    l_iter = l_first = BM_FACE_FIRST_LOOP(f);
-    do {
-      mloop->e = BM_elem_index_get(l_iter->e);
-      mloop->v = BM_elem_index_get(l_iter->v);
+  int loopstart = 0;
+  for (const int i : IndexRange(bm->totface)) {
+    mpoly[i].loopstart = loopstart;
+    loopstart += bm->ftable[i]->len;
+  }
+
+  parallel_for(IndexRange(bm->totface), 512, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMFace *f = bm->ftable[i];
+      MPoly *mp = &mpoly[i];
+      BMLoop *l_iter, *l_first;
+      mp->totloop = f->len;
+      mp->mat_nr = f->mat_nr;
+      mp->flag = BM_face_flag_to_mflag(f);
+
+      int j = mp->loopstart;
+      l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+      do {
+        mloop[j].e = BM_elem_index_get(l_iter->e);
+        mloop[j].v = BM_elem_index_get(l_iter->v);
+
+        /* Copy over custom-data. */
+        CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
+
+        j++;
+        BM_CHECK_ELEMENT(l_iter);
+        BM_CHECK_ELEMENT(l_iter->e);
+        BM_CHECK_ELEMENT(l_iter->v);
+      } while ((l_iter = l_iter->next) != l_first);
+
+      if (f == bm->act_face) {
+        me->act_face = i;
+      }
 
       /* Copy over custom-data. */
-      CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
-
-      j++;
-      mloop++;
-      BM_CHECK_ELEMENT(l_iter);
-      BM_CHECK_ELEMENT(l_iter->e);
-      BM_CHECK_ELEMENT(l_iter->v);
-    } while ((l_iter = l_iter->next) != l_first);
-
-    if (f == bm->act_face) {
-      me->act_face = i;
+      CustomData_from_bmesh_block(&bm->pdata, &me->pdata, f->head.data, i);
     }
+  });
 
-    /* Copy over custom-data. */
-    CustomData_from_bmesh_block(&bm->pdata, &me->pdata, f->head.data, i);
-
-    i++;
-    mpoly++;
-    BM_CHECK_ELEMENT(f);
+#ifndef NDEBUG
+  /* Checking faces tags their vertices and edges, which isn't thread safe. */
+  for (const int i : IndexRange(bm->totface)) {
+    BM_CHECK_ELEMENT(bm->ftable[i]);
   }
+#endif
 
   /* Patch hook indices and vertex parents. */
   if (params->calc_object_remap && (ototvert > 0)) {
@@ -1713,15 +1860,10 @@ void BM_mesh_bm_to_me_for_eval(BMesh *bm, Mesh *me, const CustomData_MeshMasks *
 
   BKE_mesh_update_customdata_pointers(me, false);
 
-  BMIter iter;
-  BMVert *eve;
-  BMEdge *eed;
-  BMFace *efa;
   MVert *mvert = me->mvert;
   MEdge *medge = me->medge;
   MLoop *mloop = me->mloop;
   MPoly *mpoly = me->mpoly;
-  unsigned int i, j;
 
   const int cd_vert_bweight_offset = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
   const int cd_edge_bweight_offset = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
@@ -1733,79 +1875,94 @@ void BM_mesh_bm_to_me_for_eval(BMesh *bm, Mesh *me, const CustomData_MeshMasks *
 
   me->runtime.deformed_only = true;
 
-  BM_ITER_MESH_INDEX (eve, &iter, bm, BM_VERTS_OF_MESH, i) {
-    MVert *mv = &mvert[i];
+  BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
 
-    copy_v3_v3(mv->co, eve->co);
+  parallel_for(IndexRange(bm->totvert), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMVert *eve = bm->vtable[i];
+      MVert *mv = &mvert[i];
 
-    BM_elem_index_set(eve, i); /* set_inline */
+      copy_v3_v3(mv->co, eve->co);
 
-    mv->flag = BM_vert_flag_to_mflag(eve);
+      BM_elem_index_set(eve, i); /* set_inline */
 
-    if (cd_vert_bweight_offset != -1) {
-      mv->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eve, cd_vert_bweight_offset);
-    }
+      mv->flag = BM_vert_flag_to_mflag(eve);
 
-    CustomData_from_bmesh_block(&bm->vdata, &me->vdata, eve->head.data, i);
-  }
+      if (cd_vert_bweight_offset != -1) {
+        mv->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eve, cd_vert_bweight_offset);
+      }
+
+      CustomData_from_bmesh_block(&bm->vdata, &me->vdata, eve->head.data, i);
+    }
+  });
   bm->elem_index_dirty &= ~BM_VERT;
 
-  BM_ITER_MESH_INDEX (eed, &iter, bm, BM_EDGES_OF_MESH, i) {
-    MEdge *med = &medge[i];
+  parallel_for(IndexRange(bm->totedge), 1024, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMEdge *eed = bm->etable[i];
+      MEdge *med = &medge[i];
 
-    BM_elem_index_set(eed, i); /* set_inline */
+      BM_elem_index_set(eed, i); /* set_inline */
 
-    med->v1 = BM_elem_index_get(eed->v1);
-    med->v2 = BM_elem_index_get(eed->v2);
+      med->v1 = BM_elem_index_get(eed->v1);
+      med->v2 = BM_elem_index_get(eed->v2);
 
-    med->flag = BM_edge_flag_to_mflag(eed);
+      med->flag = BM_edge_flag_to_mflag(eed);
 
-    /* Handle this differently to editmode switching,
-     * only enable draw for single user edges rather than calculating angle. */
-    if ((med->flag & ME_EDGEDRAW) == 0) {
-      if (eed->l && eed->l == eed->l->radial_next) {
-        med->flag |= ME_EDGEDRAW;
+      /* Handle this differently to editmode switching,
+       * only enable draw for single user edges rather than calculating angle. */
+      if ((med->flag & ME_EDGEDRAW) == 0) {
+        if (eed->l && eed->l == eed->l->radial_next) {
+          med->flag |= ME_EDGEDRAW;
+        }
       }
-    }
 
-    if (cd_edge_crease_offset != -1) {
-      med->crease = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eed, cd_edge_crease_offset);
-    }
-    if (cd_edge_bweight_offset != -1) {
-      med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eed, cd_edge_bweight_offset);
+      if (cd_edge_crease_offset != -1) {
+        med->crease = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eed, cd_edge_crease_offset);
+      }
+      if (cd_edge_bweight_offset != -1) {
+        med->bweight = BM_ELEM_CD_GET_FLOAT_AS_UCHAR(eed, cd_edge_bweight_offset);
+      }
+
+      CustomData_from_bmesh_block(&bm->edata, &me->edata, eed->head.data, i);
     }
+  });
+  bm->elem_index_dirty &= ~BM_EDGE;
 
-    CustomData_from_bmesh_block(&bm->edata, &me->edata, eed->head.data, i);
+  int loopstart = 0;
+  for (const int i : IndexRange(bm->totface)) {
+    mpoly[i].loopstart = loopstart;
+    loopstart += bm->ftable[i]->len;
   }
-  bm->elem_index_dirty &= ~BM_EDGE;
 
-  j = 0;
-  BM_ITER_MESH_INDEX (efa, &iter, bm, BM_FACES_OF_MESH, i) {
-    BMLoop *l_iter;
-    BMLoop *l_first;
-    MPoly *mp = &mpoly[i];
+  parallel_for(IndexRange(bm->totface), 512, [&](const IndexRange range) {
+    for (const int i : range) {
+      BMFace *efa = bm->ftable[i];
+      BMLoop *l_iter;
+      BMLoop *l_first;
+      MPoly *mp = &mpoly[i];
 
-    BM_elem_index_set(efa, i); /* set_inline */
+      BM_elem_index_set(efa, i); /* set_inline */
 
-    mp->totloop = efa->len;
-    mp->flag = BM_face_flag_to_mflag(efa);
-    mp->loopstart = j;
-    mp->mat_nr = efa->mat_nr;
+      mp->totloop = efa->len;
+      mp->flag = BM_face_flag_to_mflag(efa);
+      mp->mat_nr = efa->mat_nr;
 
-    l_iter = l_first = BM_FACE_FIRST_LOOP(efa);
-    do {
-      mloop->v = BM_elem_index_get(l_iter->v);
-      mloop->e = BM_elem_index_get(l_iter->e);
-      CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
+      int j = mp->loopstart;
+      l_iter = l_first = BM_FACE_FIRST_LOOP(efa);
+      do {
+        mloop[j].v = BM_elem_index_get(l_iter->v);
+        mloop[j].e = BM_elem_index_get(l_iter->e);
+        CustomData_from_bmesh_block(&bm->ldata, &me->ldata, l_iter->head.data, j);
 
-      BM_elem_index_set(l_iter, j); /* set_inline */
+        BM_elem_index_set(l_iter, j); /* set_inline */
 
-      j++;
-      mloop++;
-    } while ((l_iter = l_iter->next) != l_first);
+        j++;
+      } while ((l_iter = l_iter->next) != l_first);
 
-    CustomData_from_bmesh_block(&bm->pdata, &me->pdata, efa->head.data, i);
-  }
+      CustomData_from_bmesh_block(&bm->pdata, &me->pdata, efa->head.data, i);
+    }
+  });
   bm->elem_index_dirty &= ~(BM_FACE | BM_LOOP);
 
   me->cd_flag = BM_mesh_cd_flag_from_bmesh(bm);
@@ -31,6 +31,8 @@ struct BMeshFromMeshParams {
   struct CustomData_MeshMasks cd_mask_extra;
   uint copy_temp_cdlayers : 1;
   uint ignore_id_layers : 1;
+  /* build the elements of a new BMesh on a single thread */
+  uint no_threading : 1;
 };
 
 struct Object;
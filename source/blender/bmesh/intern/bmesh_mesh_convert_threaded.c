@@ -1,590 +1,575 @@
-#if 1
-#  include "DNA_key_types.h"
-#  include "DNA_mesh_types.h"
-#  include "DNA_meshdata_types.h"
-#  include "DNA_modifier_types.h"
-#  include "DNA_object_types.h"
+#include "DNA_key_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_modifier_types.h"
+#include "DNA_object_types.h"
 
-#  include "MEM_guardedalloc.h"
+#include "MEM_guardedalloc.h"
 
-#  include "BLI_alloca.h"
-#  include "BLI_compiler_attrs.h"
-#  include "BLI_listbase.h"
-#  include "BLI_math_vector.h"
-#  include "BLI_task.h"
-#  include "BLI_threads.h"
+#include "BLI_alloca.h"
+#include "BLI_compiler_attrs.h"
+#include "BLI_listbase.h"
+#include "BLI_math_vector.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
-#  include "BKE_customdata.h"
-#  include "BKE_mesh.h"
-#  include "BKE_mesh_runtime.h"
-#  include "BKE_multires.h"
+#include "BKE_customdata.h"
+#include "BKE_mesh.h"
+#include "BKE_mesh_mapping.h"
+#include "BKE_mesh_runtime.h"
+#include "BKE_multires.h"
 
-#  include "BKE_key.h"
-#  include "BKE_main.h"
+#include "BKE_key.h"
+#include "BKE_main.h"
 
-#  include "DEG_depsgraph_query.h"
+#include "DEG_depsgraph_query.h"
 
-#  include "bmesh.h"
-#  include "intern/bmesh_private.h" /* For element checking. */
+#include "bmesh.h"
+#include "intern/bmesh_private.h" /* For element checking. */
 
-#  include "BLI_task.h"
+#include "BLI_task.h"
 
-#  include "atomic_ops.h"
+#include "atomic_ops.h"
 
-#  define ECHUNK 512
-#  define VCHUNK 512
-#  define FCHUNK 512
-#  define LCHUNK 1024
+#define ECHUNK 512
+#define VCHUNK 512
+#define FCHUNK 512
+#define LCHUNK 1024
 
 typedef struct BMThreadData {
   BMesh *bm;
-  Object *ob;
   const Mesh *me;
+  const BMFromMeThreadedParams *params;
 
-  struct BMeshFromMeshParams *params;
-
-  void **vdata, **edata, **ldata, **fdata;
-  int totdv, totde, totdl, totdf;
+  /* Chunks of the element pools, elements are `*size` bytes apart within a chunk. */
+  void **verts, **edges, **loops, **faces;
   int vsize, esize, lsize, fsize;
 
-  int vchunk, echunk, lchunk, fchunk;
-
-  BMVert **verts;
-  BMEdge **edges;
-  BMLoop **loops;
-  BMFace **faces;
-
-  float (**shape_key_table)[3];
-  int tot_shape_keys;
+  /* Chunks of the custom-data pools, NULL for domains without layers. */
+  void **vdata, **edata, **ldata, **fdata;
+  int cdvsize, cdesize, cdlsize, cdfsize;
 
-  int cd_vert_bweight;
-  int cd_edge_bweight;
-  int cd_crease;
+  int totcv, totce, totcf;
 
-  int cdvsize, cdesize, cdlsize, cdfsize;
+  /* #MToolFlags offsets, the flag pointers of new blocks have to start out cleared. */
+  int cd_vert_toolflags, cd_edge_toolflags, cd_face_toolflags;
 
-  // chunk sizes
-  int totcv, totce, totcl, totcf;
+  /* Edges of every vertex and loops of every edge, in the order #BM_mesh_bm_from_me links them
+   * into the disk and radial cycles. */
+  MeshElemMap *vert_edges;
+  MeshElemMap *edge_loops;
 } BMThreadData;
 
-#  define ELEM_NEXT(type, ptr, size) ((type *)(((char *)ptr) + size))
+#define CHUNK_ELEM(type, chunks, chunk_len, elem_size, i) \
+    ((type *)((char *)(chunks)[(i) / (chunk_len)] + \
+              (size_t)((i) % (chunk_len)) * (size_t)(elem_size)))
 
-static void bm_vert_task(void *__restrict userdata,
-                         const int n,
-                         const TaskParallelTLS *__restrict tls)
+BLI_INLINE BMVert *bm_thread_vert(const BMThreadData *data, const int i)
 {
-  BMThreadData *data = userdata;
-  BMesh *bm = data->bm;
-  const Mesh *me = data->me;
-
-  int starti = n * VCHUNK;
+  return CHUNK_ELEM(BMVert, data->verts, VCHUNK, data->vsize, i);
+}
 
-  int ilen = starti + VCHUNK > bm->totvert ? bm->totvert - starti : VCHUNK;
-  MVert *mv = me->mvert + starti;
-  BMVert *v = data->verts[n];
-  char *cdblock = data->vdata ? (char *)data->vdata[n] : NULL;
+BLI_INLINE BMEdge *bm_thread_edge(const BMThreadData *data, const int i)
+{
+  return CHUNK_ELEM(BMEdge, data->edges, ECHUNK, data->esize, i);
+}
 
-  for (int i = 0; i < ilen; i++, mv++) {
-    if (cdblock) {
-      v->head.data = (void *)cdblock;
-      cdblock += data->cdvsize;
-    }
-    else {
-      v->head.data = NULL;
-    }
+BLI_INLINE BMLoop *bm_thread_loop(const BMThreadData *data, const int i)
+{
+  return CHUNK_ELEM(BMLoop, data->loops, LCHUNK, data->lsize, i);
+}
 
-    v->head.htype = BM_VERT;
-    v->head.hflag = BM_vert_flag_from_mflag(mv->flag);
-    v->head.api_flag = 0;
+BLI_INLINE BMFace *bm_thread_face(const BMThreadData *data, const int i)
+{
+  return CHUNK_ELEM(BMFace, data->faces, FCHUNK, data->fsize, i);
+}
 
-    copy_v3_v3(v->co, mv->co);
-    //XXX normal_short_to_float_v3(v->no, mv->no);
+BLI_INLINE void *bm_thread_cdblock(
+    void **chunks, const int chunk_len, const int size, const int cd_toolflags, const int i)
+{
+  if (!chunks) {
+    return NULL;
+  }
 
-    v->e = NULL;
-    v->head.index = i + starti;
-    v = ELEM_NEXT(BMVert, v, data->vsize);
+  void *block = CHUNK_ELEM(void, chunks, chunk_len, size, i);
+  if (cd_toolflags != -1) {
+    ((MToolFlags *)POINTER_OFFSET(block, cd_toolflags))->flag = NULL;
   }
+  return block;
+}
 
-  if (data->vdata) {
-    v = data->verts[n];
-    for (int i = 0; i < ilen; i++) {
-      CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i + starti, &v->head.data, true);
-      v = ELEM_NEXT(BMVert, v, data->vsize);
-    }
+BLI_INLINE void bm_thread_elem_select(BMHeader *head)
+{
+  if (!(head->hflag & BM_ELEM_HIDDEN)) {
+    atomic_fetch_and_or_uint8((uint8_t *)&head->hflag, BM_ELEM_SELECT);
   }
 }
 
-static void bm_edge_task(void *__restrict userdata,
+static void bm_vert_task(void *__restrict userdata,
                          const int n,
-                         const TaskParallelTLS *__restrict tls)
+                         const TaskParallelTLS *__restrict UNUSED(tls))
 {
   BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
   BMesh *bm = data->bm;
   const Mesh *me = data->me;
 
-  int starti = n * ECHUNK;
+  const int starti = n * VCHUNK;
+  const int endi = min_ii(starti + VCHUNK, me->totvert);
+
+  for (int i = starti; i < endi; i++) {
+    const MVert *mv = &me->mvert[i];
+    BMVert *v = params->vtable[i] = bm_thread_vert(data, i);
+
+    v->head.data = bm_thread_cdblock(
+        data->vdata, VCHUNK, data->cdvsize, data->cd_vert_toolflags, i);
+    v->head.index = i;
+    v->head.htype = BM_VERT;
+    v->head.hflag = BM_vert_flag_from_mflag(mv->flag & ~SELECT);
+    v->head.api_flag = 0;
 
-  int ilen = starti + ECHUNK > bm->totedge ? bm->totedge - starti : ECHUNK;
-  MEdge *med = me->medge + starti;
-  BMEdge *e = data->edges[n];
-  char *cdblock = data->edata ? (char *)data->edata[n] : NULL;
+    /* Hidden vertices can't be selected, same as #BM_vert_select_set. */
+    if (mv->flag & SELECT) {
+      bm_thread_elem_select(&v->head);
+    }
 
-  for (int i = 0; i < ilen; i++, med++) {
-    if (cdblock) {
-      e->head.data = (void *)cdblock;
-      cdblock += data->cdesize;
+    copy_v3_v3(v->co, params->vert_coords ? params->vert_coords[i] : mv->co);
+    if (params->vert_normals) {
+      copy_v3_v3(v->no, params->vert_normals[i]);
     }
     else {
-      e->head.data = NULL;
+      zero_v3(v->no);
     }
+    v->e = NULL;
 
-    e->head.htype = BM_EDGE;
-    e->head.hflag = BM_edge_flag_from_mflag(med->flag);
-    e->head.api_flag = 0;
-
-    e->v1 = &data->verts[med->v1 / VCHUNK][med->v1 % VCHUNK];
-    e->v2 = &data->verts[med->v2 / VCHUNK][med->v2 % VCHUNK];
-
-    e->l = NULL;
-    e->v1_disk_link.next = e->v1_disk_link.prev = NULL;
-    e->v2_disk_link.next = e->v2_disk_link.prev = NULL;
+    if (v->head.data == NULL) {
+      continue;
+    }
 
-    e = ELEM_NEXT(BMEdge, e, data->esize);
-  }
+    CustomData_to_bmesh_block(&me->vdata, &bm->vdata, i, &v->head.data, true);
 
-  if (data->edata) {
-    e = data->edges[n];
-    for (int i = 0; i < ilen; i++) {
-      CustomData_to_bmesh_block(&me->edata, &bm->edata, i + starti, &e->head.data, true);
-      e = ELEM_NEXT(BMEdge, e, data->esize);
+    if (params->cd_vert_bweight_offset != -1) {
+      BM_ELEM_CD_SET_FLOAT(v, params->cd_vert_bweight_offset, (float)mv->bweight / 255.0f);
+    }
+    if (params->cd_shape_keyindex_offset != -1) {
+      BM_ELEM_CD_SET_INT(v, params->cd_shape_keyindex_offset, i);
+    }
+    for (int j = 0; j < params->tot_shape_keys; j++) {
+      float *co_dst = BM_ELEM_CD_GET_VOID_P(v, params->cd_shape_key_offset[j]);
+      copy_v3_v3(co_dst, params->shape_key_table[j][i]);
     }
   }
 }
 
-static void bm_loop_task(void *__restrict userdata,
+static void bm_edge_task(void *__restrict userdata,
                          const int n,
-                         const TaskParallelTLS *__restrict tls)
+                         const TaskParallelTLS *__restrict UNUSED(tls))
 {
   BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
   BMesh *bm = data->bm;
   const Mesh *me = data->me;
 
-  int starti = n * LCHUNK;
+  const int starti = n * ECHUNK;
+  const int endi = min_ii(starti + ECHUNK, me->totedge);
 
-  int ilen = starti + LCHUNK > bm->totloop ? bm->totloop - starti : LCHUNK;
-  MLoop *ml = me->mloop + starti;
-  BMLoop *l = data->loops[n];
-  char *cdblock = data->ldata ? (char *)data->ldata[n] : NULL;
+  for (int i = starti; i < endi; i++) {
+    const MEdge *med = &me->medge[i];
+    BMEdge *e = params->etable[i] = bm_thread_edge(data, i);
 
-  for (int i = 0; i < ilen; i++, ml++) {
-    if (cdblock) {
-      l->head.data = (void *)cdblock;
-      cdblock += data->cdlsize;
-    }
-    else {
-      l->head.data = NULL;
+    e->head.data = bm_thread_cdblock(
+        data->edata, ECHUNK, data->cdesize, data->cd_edge_toolflags, i);
+    e->head.index = i;
+    e->head.htype = BM_EDGE;
+    e->head.hflag = BM_edge_flag_from_mflag(med->flag & ~SELECT);
+    e->head.api_flag = 0;
+
+    if (med->flag & SELECT) {
+      bm_thread_elem_select(&e->head);
     }
 
-    l->head.htype = BM_LOOP;
-    l->head.hflag = 0;
-    l->head.api_flag = 0;
+    e->v1 = bm_thread_vert(data, (int)med->v1);
+    e->v2 = bm_thread_vert(data, (int)med->v2);
+    e->l = NULL;
+    e->v1_disk_link.next = e->v1_disk_link.prev = NULL;
+    e->v2_disk_link.next = e->v2_disk_link.prev = NULL;
 
-    l->v = data->verts[ml->v / VCHUNK] + (ml->v % VCHUNK);
-    l->e = data->edges[ml->e / ECHUNK] + (ml->e % ECHUNK);
-    l->radial_next = l->radial_prev = l->next = l->prev = NULL;
-    l->f = NULL;
+    if (e->head.data == NULL) {
+      continue;
+    }
 
-    l = ELEM_NEXT(BMLoop, l, data->lsize);
-  }
+    CustomData_to_bmesh_block(&me->edata, &bm->edata, i, &e->head.data, true);
 
-  if (data->ldata) {
-    l = data->loops[n];
-    for (int i = 0; i < ilen; i++) {
-      CustomData_to_bmesh_block(&me->ldata, &bm->ldata, i + starti, &l->head.data, true);
-      l = ELEM_NEXT(BMLoop, l, data->lsize);
+    if (params->cd_edge_bweight_offset != -1) {
+      BM_ELEM_CD_SET_FLOAT(e, params->cd_edge_bweight_offset, (float)med->bweight / 255.0f);
+    }
+    if (params->cd_edge_crease_offset != -1) {
+      BM_ELEM_CD_SET_FLOAT(e, params->cd_edge_crease_offset, (float)med->crease / 255.0f);
     }
   }
 }
 
+/* Faces with their loops, the loops are linked into a cycle but not into the radial cycles
+ * of their edges yet. */
 static void bm_face_task(void *__restrict userdata,
                          const int n,
-                         const TaskParallelTLS *__restrict tls)
+                         const TaskParallelTLS *__restrict UNUSED(tls))
 {
   BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
   BMesh *bm = data->bm;
   const Mesh *me = data->me;
 
-  int starti = n * FCHUNK;
+  const int starti = n * FCHUNK;
+  const int endi = min_ii(starti + FCHUNK, me->totpoly);
 
-  int ilen = starti + FCHUNK > bm->totface ? bm->totface - starti : FCHUNK;
-  MPoly *mp = me->mpoly + starti;
-  BMFace *f = data->faces[n];
-  char *cdblock = data->fdata ? (char *)data->fdata[n] : NULL;
-
-  for (int i = 0; i < ilen; i++, mp++) {
-    if (cdblock) {
-      f->head.data = (void *)cdblock;
-      cdblock += data->cdfsize;
-    }
-    else {
-      f->head.data = NULL;
-    }
+  for (int i = starti; i < endi; i++) {
+    const MPoly *mp = &me->mpoly[i];
+    BMFace *f = params->ftable[i] = bm_thread_face(data, i);
 
+    f->head.data = bm_thread_cdblock(
+        data->fdata, FCHUNK, data->cdfsize, data->cd_face_toolflags, i);
+    f->head.index = i;
     f->head.htype = BM_FACE;
-    f->head.hflag = BM_face_flag_from_mflag(mp->flag);
+    f->head.hflag = BM_face_flag_from_mflag(mp->flag & ~ME_FACE_SEL);
     f->head.api_flag = 0;
 
+    if (mp->flag & ME_FACE_SEL) {
+      bm_thread_elem_select(&f->head);
+    }
+
     f->len = mp->totloop;
     f->mat_nr = mp->mat_nr;
     zero_v3(f->no);
 
-    int li = mp->loopstart;
-    BMLoop *lastl = NULL;
+    BMLoop *l_prev = NULL;
+    for (int j = 0; j < mp->totloop; j++) {
+      const int li = mp->loopstart + j;
+      const MLoop *ml = &me->mloop[li];
+      BMLoop *l = bm_thread_loop(data, li);
 
-    for (int j = 0; j < mp->totloop; j++, li++) {
-      BMLoop *l = data->loops[li / LCHUNK] + (li % LCHUNK);
+      l->head.data = bm_thread_cdblock(data->ldata, LCHUNK, data->cdlsize, -1, li);
+      l->head.index = li;
+      l->head.htype = BM_LOOP;
+      l->head.hflag = 0;
+      l->head.api_flag = 0;
 
+      l->v = bm_thread_vert(data, (int)ml->v);
+      l->e = bm_thread_edge(data, (int)ml->e);
       l->f = f;
+      l->radial_next = l->radial_prev = NULL;
 
-      if (j == 0) {
-        f->l_first = l;
+      if (l_prev) {
+        l_prev->next = l;
+        l->prev = l_prev;
       }
       else {
-        lastl->next = l;
-        l->prev = lastl;
+        f->l_first = l;
       }
+      l_prev = l;
 
-      lastl = l;
+      if (l->head.data) {
+        CustomData_to_bmesh_block(&me->ldata, &bm->ldata, li, &l->head.data, true);
+      }
     }
 
-    lastl->next = f->l_first;
-    f->l_first->prev = lastl;
+    l_prev->next = f->l_first;
+    f->l_first->prev = l_prev;
 
-    f = ELEM_NEXT(BMFace, f, data->fsize);
-  }
+    if (f->head.data) {
+      CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i, &f->head.data, true);
+    }
 
-  if (data->fdata) {
-    f = data->faces[n];
-    for (int i = 0; i < ilen; i++) {
-      CustomData_to_bmesh_block(&me->pdata, &bm->pdata, i + starti, &f->head.data, true);
-      f = ELEM_NEXT(BMFace, f, data->fsize);
+    if (params->calc_face_normal) {
+      BM_face_normal_update(f);
     }
   }
 }
 
-static void bm_mesh_cd_flag_apply(BMesh *bm, const char cd_flag)
+/* Every vertex only touches the disk links that belong to it, so vertices can be linked in
+ * parallel as long as each one appends its edges in order. */
+static void bm_vert_link_task(void *__restrict userdata,
+                              const int n,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  /* CustomData_bmesh_init_pool() must run first */
-  BLI_assert(bm->vdata.totlayer == 0 || bm->vdata.pool != NULL);
-  BLI_assert(bm->edata.totlayer == 0 || bm->edata.pool != NULL);
-  BLI_assert(bm->pdata.totlayer == 0 || bm->pdata.pool != NULL);
-
-  if (cd_flag & ME_CDFLAG_VERT_BWEIGHT) {
-    if (!CustomData_has_layer(&bm->vdata, CD_BWEIGHT)) {
-      CustomData_add_layer(&bm->vdata, CD_BWEIGHT, CD_ASSIGN, NULL, 0);
-    }
-  }
-  else {
-    if (CustomData_has_layer(&bm->vdata, CD_BWEIGHT)) {
-      CustomData_free_layer_active(&bm->vdata, CD_BWEIGHT, 0);
-    }
-  }
+  BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
 
-  if (cd_flag & ME_CDFLAG_EDGE_BWEIGHT) {
-    if (!CustomData_has_layer(&bm->edata, CD_BWEIGHT)) {
-      CustomData_add_layer(&bm->edata, CD_BWEIGHT, CD_ASSIGN, NULL, 0);
-    }
-  }
-  else {
-    if (CustomData_has_layer(&bm->edata, CD_BWEIGHT)) {
-      CustomData_free_layer_active(&bm->edata, CD_BWEIGHT, 0);
-    }
-  }
+  const int starti = n * VCHUNK;
+  const int endi = min_ii(starti + VCHUNK, data->me->totvert);
 
-  if (cd_flag & ME_CDFLAG_EDGE_CREASE) {
-    if (!CustomData_has_layer(&bm->edata, CD_CREASE)) {
-      CustomData_add_layer(&bm->edata, CD_CREASE, CD_ASSIGN, NULL, 0);
-    }
-  }
-  else {
-    if (CustomData_has_layer(&bm->edata, CD_CREASE)) {
-      CustomData_free_layer_active(&bm->edata, CD_CREASE, 0);
+  for (int i = starti; i < endi; i++) {
+    const MeshElemMap *map = &data->vert_edges[i];
+    for (int j = 0; j < map->count; j++) {
+      bmesh_disk_edge_append(params->etable[map->indices[j]], params->vtable[i]);
     }
   }
 }
 
-BMesh *BM_mesh_bm_from_me_threaded(BMesh *bm,
-                                   Object *ob,
-                                   const Mesh *me,
-                                   const struct BMeshFromMeshParams *params)
+static void bm_edge_link_task(void *__restrict userdata,
+                              const int n,
+                              const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  if (!bm) {
-    bm = MEM_callocN(sizeof(BMesh), "BM_mesh_bm_from_me_threaded bm");
-  }
-  else {
-    BM_mesh_data_free(bm);
-    memset((void *)bm, 0, sizeof(*bm));
-  }
-  const bool is_new = true;
-
-  bm->totvert = me->totvert;
-  bm->totedge = me->totedge;
-  bm->totface = me->totpoly;
-  bm->totloop = me->totloop;
-
-  bm->elem_index_dirty = bm->elem_table_dirty = BM_VERT | BM_EDGE | BM_LOOP | BM_FACE;
-  bm->spacearr_dirty = BM_SPACEARR_DIRTY_ALL;
-
-  BMVert **verts;
-  BMEdge **edges;
-  BMLoop **loops;
-  BMFace **faces;
-
-  void **vdata = NULL, **edata = NULL, **ldata = NULL, **fdata = NULL;
-  int totdv = 0, totde = 0, totdl = 0, totdf = 0;
-
-  int totcv = 0, totce = 0, totcl = 0, totcf = 0;
+  BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
 
-  BMThreadData data = {0};
+  const int starti = n * ECHUNK;
+  const int endi = min_ii(starti + ECHUNK, data->me->totedge);
 
-  int vsize, esize, lsize, fsize;
+  for (int i = starti; i < endi; i++) {
+    const MeshElemMap *map = &data->edge_loops[i];
+    for (int j = 0; j < map->count; j++) {
+      bmesh_radial_loop_append(params->etable[i], bm_thread_loop(data, map->indices[j]));
+    }
+  }
+}
 
-  bm->vpool = BLI_mempool_create_for_tasks(sizeof(BMVert),
-                                           bm->totvert,
-                                           VCHUNK,
-                                           (void ***)&verts,
-                                           &totcv,
-                                           &vsize,
-                                           BLI_MEMPOOL_ALLOW_ITER);
-  bm->epool = BLI_mempool_create_for_tasks(sizeof(BMEdge),
-                                           bm->totedge,
-                                           ECHUNK,
-                                           (void ***)&edges,
-                                           &totce,
-                                           &esize,
-                                           BLI_MEMPOOL_ALLOW_ITER);
-  bm->lpool = BLI_mempool_create_for_tasks(sizeof(BMLoop),
-                                           bm->totloop,
-                                           LCHUNK,
-                                           (void ***)&loops,
-                                           &totcl,
-                                           &lsize,
-                                           BLI_MEMPOOL_ALLOW_ITER);
-  bm->fpool = BLI_mempool_create_for_tasks(sizeof(BMFace),
-                                           bm->totface,
-                                           FCHUNK,
-                                           (void ***)&faces,
-                                           &totcf,
-                                           &fsize,
-                                           BLI_MEMPOOL_ALLOW_ITER);
-
-  data.verts = verts;
-  data.edges = edges;
-  data.loops = loops;
-  data.faces = faces;
-
-  data.vsize = vsize;
-  data.esize = esize;
-  data.lsize = lsize;
-  data.fsize = fsize;
-
-  data.totcv = totcv;
-  data.totce = totce;
-  data.totcl = totcl;
-  data.totcf = totcf;
-
-  data.bm = bm;
-  data.me = me;
-
-  // bm->vpool = BLI_mem
-
-  KeyBlock *actkey, *block;
-  BMEdge *e;
-  BMFace *f;
-  float(*keyco)[3] = NULL;
-  int i;
-  CustomData_MeshMasks mask = CD_MASK_BMESH;
-  CustomData_MeshMasks_update(&mask, &params->cd_mask_extra);
+/* Selecting edges and faces selects their vertices and edges, see #BM_face_select_set. */
+static void bm_edge_select_flush_task(void *__restrict userdata,
+                                      const int n,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
 
-  MultiresModifierData *mmd = ob ? get_multires_modifier(NULL, ob, true) : NULL;
+  const int starti = n * ECHUNK;
+  const int endi = min_ii(starti + ECHUNK, data->me->totedge);
 
-  if (mmd) {
-    bm->multires = *mmd;
-    bm->haveMultiResSettings = true;
-    bm->multiresSpace = MULTIRES_SPACE_TANGENT;
-  }
-  else {
-    bm->haveMultiResSettings = false;
+  for (int i = starti; i < endi; i++) {
+    BMEdge *e = params->etable[i];
+    if (BM_elem_flag_test(e, BM_ELEM_SELECT)) {
+      bm_thread_elem_select(&e->v1->head);
+      bm_thread_elem_select(&e->v2->head);
+    }
   }
+}
 
-  CustomData_copy(&me->vdata, &bm->vdata, mask.vmask, CD_ASSIGN, CD_FLAG_NOCOPY);
-  CustomData_copy(&me->edata, &bm->edata, mask.emask, CD_ASSIGN, CD_FLAG_NOCOPY);
-  CustomData_copy(&me->ldata, &bm->ldata, mask.lmask, CD_ASSIGN, CD_FLAG_NOCOPY);
-  CustomData_copy(&me->pdata, &bm->pdata, mask.pmask, CD_ASSIGN, CD_FLAG_NOCOPY);
+static void bm_face_select_flush_task(void *__restrict userdata,
+                                      const int n,
+                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
 
-  CustomData *cds[] = {&bm->vdata, &bm->edata, &bm->ldata, &bm->pdata};
+  const int starti = n * FCHUNK;
+  const int endi = min_ii(starti + FCHUNK, data->me->totpoly);
 
-  // clear customdata->layers[X].data pointers
-  for (int i = 0; i < 4; i++) {
-    CustomData *cd = cds[i];
-    for (int j = 0; j < cd->totlayer; j++) {
-      cd->layers[j].data = NULL;
+  for (int i = starti; i < endi; i++) {
+    BMFace *f = params->ftable[i];
+    if (!BM_elem_flag_test(f, BM_ELEM_SELECT)) {
+      continue;
     }
+
+    BMLoop *l_iter, *l_first;
+    l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+    do {
+      bm_thread_elem_select(&l_iter->v->head);
+      bm_thread_elem_select(&l_iter->e->head);
+    } while ((l_iter = l_iter->next) != l_first);
   }
-  bm_mesh_cd_flag_apply(bm, me->cd_flag);
+}
+
+static void bm_select_count_task(void *__restrict userdata,
+                                 const int n,
+                                 const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BMThreadData *data = userdata;
+  const BMFromMeThreadedParams *params = data->params;
+  BMesh *bm = data->bm;
+  const Mesh *me = data->me;
 
-  data.cd_vert_bweight = CustomData_get_offset(&bm->vdata, CD_BWEIGHT);
-  data.cd_edge_bweight = CustomData_get_offset(&bm->edata, CD_BWEIGHT);
-  data.cd_crease = CustomData_get_offset(&bm->edata, CD_CREASE);
+  int totvertsel = 0, totedgesel = 0, totfacesel = 0;
 
-  if (bm->vdata.totlayer) {
-    bm->vdata.pool = BLI_mempool_create_for_tasks(
-        bm->vdata.totsize, bm->totvert, VCHUNK, &vdata, &totdv, &data.cdvsize, BLI_MEMPOOL_NOP);
+  for (int i = n * VCHUNK; i < min_ii((n + 1) * VCHUNK, me->totvert); i++) {
+    totvertsel += BM_elem_flag_test(params->vtable[i], BM_ELEM_SELECT) ? 1 : 0;
   }
-  if (bm->edata.totlayer) {
-    bm->edata.pool = BLI_mempool_create_for_tasks(
-        bm->edata.totsize, bm->totedge, ECHUNK, &edata, &totde, &data.cdesize, BLI_MEMPOOL_NOP);
+  for (int i = n * ECHUNK; i < min_ii((n + 1) * ECHUNK, me->totedge); i++) {
+    totedgesel += BM_elem_flag_test(params->etable[i], BM_ELEM_SELECT) ? 1 : 0;
   }
-  if (bm->ldata.totlayer) {
-    bm->ldata.pool = BLI_mempool_create_for_tasks(
-        bm->ldata.totsize, bm->totloop, LCHUNK, &ldata, &totdl, &data.cdlsize, BLI_MEMPOOL_NOP);
-  }
-  if (bm->pdata.totlayer) {
-    bm->pdata.pool = BLI_mempool_create_for_tasks(
-        bm->pdata.totsize, bm->totface, FCHUNK, &fdata, &totdf, &data.cdfsize, BLI_MEMPOOL_NOP);
+  for (int i = n * FCHUNK; i < min_ii((n + 1) * FCHUNK, me->totpoly); i++) {
+    totfacesel += BM_elem_flag_test(params->ftable[i], BM_ELEM_SELECT) ? 1 : 0;
   }
 
-  data.vdata = vdata;
-  data.edata = edata;
-  data.ldata = ldata;
-  data.fdata = fdata;
-
-  data.totdv = totdv;
-  data.totde = totde;
-  data.totdl = totdl;
-  data.totdf = totdf;
-
-  /* -------------------------------------------------------------------- */
-  /* Shape Key */
-  int tot_shape_keys = 0;
-  if (me->key != NULL && DEG_is_original_id(&me->id)) {
-    /* Evaluated meshes can be topologically inconsistent with their shape keys.
-     * Shape keys are also already integrated into the state of the evaluated
-     * mesh, so considering them here would kind of apply them twice. */
-    tot_shape_keys = BLI_listbase_count(&me->key->block);
-
-    /* Original meshes must never contain a shape-key custom-data layers.
-     *
-     * This may happen if and object's mesh data is accidentally
-     * set to the output from the modifier stack, causing it to be an "original" ID,
-     * even though the data isn't fully compatible (hence this assert).
-     *
-     * This results in:
-     * - The newly created #BMesh having twice the number of custom-data layers.
-     * - When converting the #BMesh back to a regular mesh,
-     *   At least one of the extra shape-key blocks will be created in #Mesh.key
-     *   depending on the value of #CustomDataLayer.uid.
-     *
-     * We could support mixing both kinds of data if there is a compelling use-case for it.
-     * At the moment it's simplest to assume all original meshes use the key-block and meshes
-     * that are evaluated (through the modifier stack for example) use custom-data layers.
-     */
-    BLI_assert(!CustomData_has_layer(&me->vdata, CD_SHAPEKEY));
-  }
-  if (is_new == false) {
-    tot_shape_keys = min_ii(tot_shape_keys, CustomData_number_of_layers(&bm->vdata, CD_SHAPEKEY));
-  }
+  atomic_add_and_fetch_int32(&bm->totvertsel, totvertsel);
+  atomic_add_and_fetch_int32(&bm->totedgesel, totedgesel);
+  atomic_add_and_fetch_int32(&bm->totfacesel, totfacesel);
+}
 
-  float(**shape_key_table)[3] = tot_shape_keys ?
-                                    BLI_array_alloca(shape_key_table, tot_shape_keys) :
-                                    NULL;
+/* Loops of every edge in face order, like the serial conversion appends them. */
+static MeshElemMap *bm_edge_loop_map_create(const Mesh *me, int **r_mem)
+{
+  MeshElemMap *map = MEM_callocN(sizeof(*map) * (size_t)me->totedge, __func__);
+  int *indices = MEM_mallocN(sizeof(*indices) * (size_t)me->totloop, __func__);
 
-  if ((params->active_shapekey != 0) && tot_shape_keys > 0) {
-    actkey = BLI_findlink(&me->key->block, params->active_shapekey - 1);
+  for (int i = 0; i < me->totloop; i++) {
+    map[me->mloop[i].e].count++;
   }
-  else {
-    actkey = NULL;
+
+  int *index_step = indices;
+  for (int i = 0; i < me->totedge; i++) {
+    map[i].indices = index_step;
+    index_step += map[i].count;
+    map[i].count = 0;
   }
 
-  if (is_new) {
-    if (tot_shape_keys || params->add_key_index) {
-      CustomData_add_layer(&bm->vdata, CD_SHAPE_KEYINDEX, CD_ASSIGN, NULL, 0);
+  for (int i = 0; i < me->totpoly; i++) {
+    const MPoly *mp = &me->mpoly[i];
+    for (int li = mp->loopstart; li < mp->loopstart + mp->totloop; li++) {
+      MeshElemMap *map_ele = &map[me->mloop[li].e];
+      map_ele->indices[map_ele->count++] = li;
     }
   }
 
-  if (tot_shape_keys) {
-    if (is_new) {
-      /* Check if we need to generate unique ids for the shape-keys.
-       * This also exists in the file reading code, but is here for a sanity check. */
-      if (!me->key->uidgen) {
-        fprintf(stderr,
-                "%s had to generate shape key uid's in a situation we shouldn't need to! "
-                "(bmesh internal error)\n",
-                __func__);
-
-        me->key->uidgen = 1;
-        for (block = me->key->block.first; block; block = block->next) {
-          block->uid = me->key->uidgen++;
-        }
-      }
-    }
+  *r_mem = indices;
+  return map;
+}
 
-    if (actkey && actkey->totelem == me->totvert) {
-      keyco = params->use_shapekey ? actkey->data : NULL;
-      if (is_new) {
-        bm->shapenr = params->active_shapekey;
-      }
-    }
+static BLI_mempool *bm_pool_create_for_tasks(BLI_mempool *pool_old,
+                                             const uint esize,
+                                             const int totelem,
+                                             const int chunk_len,
+                                             void ***r_chunks,
+                                             int *r_totchunk,
+                                             int *r_esize,
+                                             const int flag)
+{
+  if (pool_old) {
+    BLI_assert(BLI_mempool_len(pool_old) == 0);
+    BLI_mempool_destroy(pool_old);
+  }
 
-    for (i = 0, block = me->key->block.first; i < tot_shape_keys; block = block->next, i++) {
-      if (is_new) {
-        CustomData_add_layer_named(&bm->vdata, CD_SHAPEKEY, CD_ASSIGN, NULL, 0, block->name);
-        int j = CustomData_get_layer_index_n(&bm->vdata, CD_SHAPEKEY, i);
-        bm->vdata.layers[j].uid = block->uid;
-      }
-      shape_key_table[i] = (float(*)[3])block->data;
-    }
+  return BLI_mempool_create_for_tasks(
+      esize, totelem, chunk_len, r_chunks, r_totchunk, r_esize, flag);
+}
+
+static BLI_mempool *bm_cd_pool_create_for_tasks(CustomData *cdata,
+                                                const int totelem,
+                                                const int chunk_len,
+                                                void ***r_chunks,
+                                                int *r_esize)
+{
+  int totchunk;
+
+  /* Blocks are only allocated when there is data to store, see #CustomData_bmesh_alloc_block. */
+  if (cdata->totsize == 0) {
+    *r_chunks = NULL;
+    return cdata->pool;
   }
 
-  data.tot_shape_keys = tot_shape_keys;
-  data.shape_key_table = shape_key_table;
+  return bm_pool_create_for_tasks(cdata->pool,
+                                  (uint)cdata->totsize,
+                                  totelem,
+                                  chunk_len,
+                                  r_chunks,
+                                  &totchunk,
+                                  r_esize,
+                                  BLI_MEMPOOL_NOP);
+}
 
-  TaskParallelSettings settings;
+void bm_mesh_bm_from_me_threaded(BMesh *bm, const Mesh *me, const BMFromMeThreadedParams *params)
+{
+  BMThreadData data = {.bm = bm, .me = me, .params = params};
+  int totcl;
+
+  BLI_assert(bm->totvert == 0 && bm->totedge == 0 && bm->totloop == 0 && bm->totface == 0);
+
+  /* Swap the empty pools of the new BMesh for pools with all chunks allocated up front, which the
+   * tasks fill in place. */
+  bm->vpool = bm_pool_create_for_tasks(bm->vpool,
+                                       sizeof(BMVert),
+                                       me->totvert,
+                                       VCHUNK,
+                                       &data.verts,
+                                       &data.totcv,
+                                       &data.vsize,
+                                       BLI_MEMPOOL_ALLOW_ITER);
+  bm->epool = bm_pool_create_for_tasks(bm->epool,
+                                       sizeof(BMEdge),
+                                       me->totedge,
+                                       ECHUNK,
+                                       &data.edges,
+                                       &data.totce,
+                                       &data.esize,
+                                       BLI_MEMPOOL_ALLOW_ITER);
+  bm->lpool = bm_pool_create_for_tasks(bm->lpool,
+                                       sizeof(BMLoop),
+                                       me->totloop,
+                                       LCHUNK,
+                                       &data.loops,
+                                       &totcl,
+                                       &data.lsize,
+                                       BLI_MEMPOOL_ALLOW_ITER);
+  bm->fpool = bm_pool_create_for_tasks(bm->fpool,
+                                       sizeof(BMFace),
+                                       me->totpoly,
+                                       FCHUNK,
+                                       &data.faces,
+                                       &data.totcf,
+                                       &data.fsize,
+                                       BLI_MEMPOOL_ALLOW_ITER);
+
+  bm->vdata.pool = bm_cd_pool_create_for_tasks(
+      &bm->vdata, me->totvert, VCHUNK, &data.vdata, &data.cdvsize);
+  bm->edata.pool = bm_cd_pool_create_for_tasks(
+      &bm->edata, me->totedge, ECHUNK, &data.edata, &data.cdesize);
+  bm->ldata.pool = bm_cd_pool_create_for_tasks(
+      &bm->ldata, me->totloop, LCHUNK, &data.ldata, &data.cdlsize);
+  bm->pdata.pool = bm_cd_pool_create_for_tasks(
+      &bm->pdata, me->totpoly, FCHUNK, &data.fdata, &data.cdfsize);
+
+  data.cd_vert_toolflags = CustomData_get_offset(&bm->vdata, CD_TOOLFLAGS);
+  data.cd_edge_toolflags = CustomData_get_offset(&bm->edata, CD_TOOLFLAGS);
+  data.cd_face_toolflags = CustomData_get_offset(&bm->pdata, CD_TOOLFLAGS);
+
+  int *vert_edges_mem, *edge_loops_mem;
+  BKE_mesh_vert_edge_map_create(&data.vert_edges,
+                                &vert_edges_mem,
+                                me->mvert,
+                                me->medge,
+                                me->totvert,
+                                me->totedge,
+                                false);
+  data.edge_loops = bm_edge_loop_map_create(me, &edge_loops_mem);
 
+  TaskParallelSettings settings;
   BLI_parallel_range_settings_defaults(&settings);
+
+  /* Faces read the vertex coordinates for their normals. */
   BLI_task_parallel_range(0, data.totcv, &data, bm_vert_task, &settings);
   BLI_task_parallel_range(0, data.totce, &data, bm_edge_task, &settings);
-  BLI_task_parallel_range(0, data.totcl, &data, bm_loop_task, &settings);
   BLI_task_parallel_range(0, data.totcf, &data, bm_face_task, &settings);
 
-  BMIter iter;
+  BLI_task_parallel_range(0, data.totcv, &data, bm_vert_link_task, &settings);
+  BLI_task_parallel_range(0, data.totce, &data, bm_edge_link_task, &settings);
 
-  // link edges
-  BM_ITER_MESH (e, &iter, bm, BM_EDGES_OF_MESH) {
-    bmesh_disk_edge_append(e, e->v1);
-    bmesh_disk_edge_append(e, e->v2);
-  }
+  BLI_task_parallel_range(0, data.totce, &data, bm_edge_select_flush_task, &settings);
+  BLI_task_parallel_range(0, data.totcf, &data, bm_face_select_flush_task, &settings);
+  BLI_task_parallel_range(
+      0, max_iii(data.totcv, data.totce, data.totcf), &data, bm_select_count_task, &settings);
 
-  // link radial lists
-  i = 0;
-  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
-    BMLoop *l = f->l_first;
+  MEM_freeN(data.vert_edges);
+  MEM_freeN(vert_edges_mem);
+  MEM_freeN(data.edge_loops);
+  MEM_freeN(edge_loops_mem);
 
-    do {
-      bmesh_radial_loop_append(l->e, l);
+  MEM_SAFE_FREE(data.verts);
+  MEM_SAFE_FREE(data.edges);
+  MEM_SAFE_FREE(data.loops);
+  MEM_SAFE_FREE(data.faces);
+  MEM_SAFE_FREE(data.vdata);
+  MEM_SAFE_FREE(data.edata);
+  MEM_SAFE_FREE(data.ldata);
+  MEM_SAFE_FREE(data.fdata);
 
-      l = l->next;
-    } while (l != f->l_first);
-
-    i++;
-  }
-
-  printf("totface: %d\n", i);
-
-  bm->elem_index_dirty = BM_VERT | BM_EDGE | BM_FACE;
-  bm->elem_table_dirty = BM_VERT | BM_EDGE | BM_FACE;
+  bm->totvert = me->totvert;
+  bm->totedge = me->totedge;
+  bm->totloop = me->totloop;
+  bm->totface = me->totpoly;
 
-  return bm;
+  /* All elements were added in order. */
+  bm->elem_index_dirty &= ~(BM_VERT | BM_EDGE | BM_LOOP | BM_FACE);
+  bm->elem_table_dirty |= BM_VERT | BM_EDGE | BM_FACE;
+  bm->spacearr_dirty |= BM_SPACEARR_DIRTY_ALL;
 }
 
 static void bm_unmark_temp_cdlayers(BMesh *bm)
@@ -830,14 +815,14 @@ void BM_mesh_bm_to_me_threaded(
     /* Keep the old verts in case we are working on* a key, which is done at the end. */
 
     /* Use the array in-place instead of duplicating the array. */
-#  if 0
+#if 0
   oldverts = MEM_dupallocN(me->mvert);
-#  else
+#else
     oldverts = me->mvert;
     me->mvert = NULL;
     CustomData_update_typemap(&me->vdata);
     CustomData_set_layer(&me->vdata, CD_MVERT, NULL);
-#  endif
+#endif
   }
 
   BMToMeTask taskdata = {.params = params, .bm = bm, .me = me, .ob = ob, .bmain = bmain};
@@ -874,7 +859,7 @@ void BM_mesh_bm_to_me_threaded(
 
   me->cd_flag = BM_mesh_cd_flag_from_bmesh(bm);
 
-#  if 0
+#if 0
   struct TaskGraph *taskgraph = BLI_task_graph_create();
   struct TaskNode *node;
 
@@ -889,7 +874,7 @@ void BM_mesh_bm_to_me_threaded(
 
   BLI_task_graph_work_and_wait(taskgraph);
   BLI_task_graph_free(taskgraph);
-#  else
+#else
   ListBase threadpool;
   Test datas[3] = {{&taskdata, 0}, {&taskdata, 1}, {&taskdata, 2}};
 
@@ -900,7 +885,7 @@ void BM_mesh_bm_to_me_threaded(
   BLI_threadpool_end(&threadpool);
 
 // BLI_threadpool_
-#  endif
+#endif
   // undo changes to source bmesh's id layers' flags
   if (!params->ignore_mesh_id_layers) {
     for (int i = 0; i < 4; i++) {
@@ -1191,4 +1176,3 @@ void BM_mesh_bm_to_me_threaded(
     bm_mark_temp_cdlayers(bm);
   }
 }
-#endif
@@ -90,6 +90,41 @@ enum {
  */
 void poly_rotate_plane(const float normal[3], float (*verts)[3], uint nverts);
 
+struct Mesh;
+
+/** Data #BM_mesh_bm_from_me resolves before building the elements. */
+typedef struct BMFromMeThreadedParams {
+  /** Active shape-key coordinates, NULL to use the mesh vertices. */
+  const float (*vert_coords)[3];
+  /** NULL when the mesh normals are dirty. */
+  const float (*vert_normals)[3];
+
+  const float (**shape_key_table)[3];
+  const int *cd_shape_key_offset;
+  int tot_shape_keys;
+
+  int cd_shape_keyindex_offset;
+  int cd_vert_bweight_offset;
+  int cd_edge_bweight_offset;
+  int cd_edge_crease_offset;
+
+  bool calc_face_normal;
+
+  /** Filled in with the new elements, sized by the mesh element counts. */
+  BMVert **vtable;
+  BMEdge **etable;
+  BMFace **ftable;
+} BMFromMeThreadedParams;
+
+/**
+ * Build the elements of an empty #BMesh from \a me using all threads. Custom-data layouts and
+ * pools must already be set up, tool-flags and IDs are left for the caller to assign.
+ * The mesh is expected to be valid, faces are not checked for duplicates.
+ */
+void bm_mesh_bm_from_me_threaded(BMesh *bm,
+                                 const struct Mesh *me,
+                                 const BMFromMeThreadedParams *params);
+
 /* include the rest of our private declarations */
 #include "bmesh_structure.h"
 
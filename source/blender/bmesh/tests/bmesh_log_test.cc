@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+#include "bmesh.h"
+
+extern "C" {
+#include "bmesh_log.h"
+}
+
+#define TOTVERT 12
+#define TOTENTRY 6
+
+static BMesh *log_test_mesh_create()
+{
+  BMeshCreateParams params = {0};
+
+  params.id_elem_mask = BM_VERT | BM_EDGE | BM_FACE;
+  params.id_map = true;
+  params.create_unique_ids = true;
+
+  BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default, &params);
+  BM_data_layer_add(bm, &bm->vdata, CD_PROP_FLOAT);
+
+  BMVert *verts[TOTVERT];
+  for (int i = 0; i < TOTVERT; i++) {
+    const float angle = (float)i / (float)TOTVERT * (float)M_PI * 2.0f;
+    const float co[3] = {cosf(angle), sinf(angle), 0.0f};
+
+    verts[i] = BM_vert_create(bm, co, nullptr, BM_CREATE_NOP);
+    BM_elem_float_data_set(&bm->vdata, verts[i], CD_PROP_FLOAT, (float)i);
+  }
+
+  /* More corners than a log face stores inline. */
+  BM_face_create_verts(bm, verts, TOTVERT, nullptr, BM_CREATE_NOP, true);
+
+  return bm;
+}
+
+static void log_test_mesh_modify(BMesh *bm, BMLog *log, int step)
+{
+  BMIter iter;
+  BMVert *v;
+  BMFace *f;
+
+  BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
+    BM_log_vert_before_modified(log, v, -1, true);
+
+    v->co[2] += 0.1f * (float)(step + 1);
+    v->no[0] = 1.0f / (float)(step + 1);
+    BM_elem_flag_toggle(v, BM_ELEM_SELECT);
+    BM_elem_float_data_set(
+        &bm->vdata, v, CD_PROP_FLOAT, BM_elem_float_data_get(&bm->vdata, v, CD_PROP_FLOAT) * 2.0f);
+  }
+
+  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
+    BM_log_face_modified(log, f);
+    f->mat_nr = (short)step;
+  }
+}
+
+static void log_test_mesh_state(BMesh *bm, float r_state[TOTVERT][5])
+{
+  BMIter iter;
+  BMVert *v;
+  int i;
+
+  BM_ITER_MESH_INDEX (v, &iter, bm, BM_VERTS_OF_MESH, i) {
+    copy_v3_v3(r_state[i], v->co);
+    r_state[i][3] = v->no[0];
+    r_state[i][4] = BM_elem_float_data_get(&bm->vdata, v, CD_PROP_FLOAT);
+  }
+}
+
+static void log_test_mesh_state_expect(BMesh *bm, float state[TOTVERT][5])
+{
+  float cur[TOTVERT][5];
+  log_test_mesh_state(bm, cur);
+
+  for (int i = 0; i < TOTVERT; i++) {
+    for (int j = 0; j < 5; j++) {
+      EXPECT_EQ(cur[i][j], state[i][j]);
+    }
+  }
+}
+
+TEST(bmesh_log, undo_redo_packed_entries)
+{
+  BMesh *bm = log_test_mesh_create();
+  BMLog *log = BM_log_create(bm, -1);
+  BMLogEntry *entries[TOTENTRY];
+  float states[TOTENTRY + 1][TOTVERT][5];
+  int unpacked_size = 0;
+
+  log_test_mesh_state(bm, states[0]);
+
+  for (int i = 0; i < TOTENTRY; i++) {
+    entries[i] = BM_log_entry_add(bm, log);
+    log_test_mesh_modify(bm, log, i);
+    log_test_mesh_state(bm, states[i + 1]);
+
+    if (i == 0) {
+      unpacked_size = BM_log_entry_size(entries[0]);
+    }
+  }
+
+  /* The oldest entries are cold by now. */
+  EXPECT_LT(BM_log_entry_size(entries[0]), unpacked_size);
+
+  for (int i = TOTENTRY - 1; i >= 0; i--) {
+    BM_log_undo(bm, log, nullptr, nullptr);
+    log_test_mesh_state_expect(bm, states[i]);
+  }
+
+  for (int i = 0; i < TOTENTRY; i++) {
+    BM_log_redo(bm, log, nullptr, nullptr);
+    log_test_mesh_state_expect(bm, states[i + 1]);
+  }
+
+  BMFace *f = (BMFace *)BM_iter_at_index(bm, BM_FACES_OF_MESH, nullptr, 0);
+  EXPECT_EQ(f->mat_nr, TOTENTRY - 1);
+
+  bool log_freed = false;
+  for (int i = TOTENTRY - 1; i >= 0; i--) {
+    log_freed = BM_log_entry_drop(entries[i]);
+  }
+
+  EXPECT_TRUE(log_freed);
+  BM_log_free(log, true);
+  BM_mesh_free(bm);
+}
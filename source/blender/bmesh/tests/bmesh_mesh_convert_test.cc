@@ -0,0 +1,329 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+
+#include "testing/testing.h"
+
+#include <cstring>
+
+#include "BLI_math.h"
+#include "BLI_utildefines.h"
+
+#include "BKE_customdata.h"
+#include "BKE_lib_id.h"
+#include "BKE_mesh.h"
+
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+
+#include "bmesh.h"
+
+/* Enough vertices for the threaded conversion, which spans several task chunks. */
+#define GRID_SIZE 80
+
+static Mesh *convert_test_mesh_create()
+{
+  const int totvert = (GRID_SIZE + 1) * (GRID_SIZE + 1);
+  const int totpoly = GRID_SIZE * GRID_SIZE;
+
+  Mesh *me = BKE_mesh_new_nomain(totvert, 0, 0, totpoly * 4, totpoly);
+
+  for (int y = 0; y <= GRID_SIZE; y++) {
+    for (int x = 0; x <= GRID_SIZE; x++) {
+      const int i = y * (GRID_SIZE + 1) + x;
+      MVert *mv = &me->mvert[i];
+
+      mv->co[0] = (float)x;
+      mv->co[1] = (float)y;
+      mv->co[2] = 0.01f * (float)((x * y) % 7);
+      mv->flag = (i % 5 == 0) ? SELECT : (i % 11 == 0) ? ME_HIDE : 0;
+      mv->bweight = (char)(i % 120);
+    }
+  }
+
+  for (int y = 0; y < GRID_SIZE; y++) {
+    for (int x = 0; x < GRID_SIZE; x++) {
+      const int i = y * GRID_SIZE + x;
+      const int v = y * (GRID_SIZE + 1) + x;
+      MPoly *mp = &me->mpoly[i];
+
+      mp->loopstart = i * 4;
+      mp->totloop = 4;
+      mp->mat_nr = (short)(i % 3);
+      /* Hidden faces can't be selected. */
+      mp->flag = (i % 7 == 0) ? ME_FACE_SEL : (i % 13 == 0) ? ME_HIDE : 0;
+
+      me->mloop[i * 4 + 0].v = v;
+      me->mloop[i * 4 + 1].v = v + 1;
+      me->mloop[i * 4 + 2].v = v + GRID_SIZE + 2;
+      me->mloop[i * 4 + 3].v = v + GRID_SIZE + 1;
+    }
+  }
+
+  BKE_mesh_calc_edges(me, false, false);
+
+  for (int i = 0; i < me->totedge; i++) {
+    me->medge[i].flag |= (i % 3 == 0) ? SELECT : 0;
+    me->medge[i].crease = (char)(i % 120);
+    me->medge[i].bweight = (char)(i % 100);
+  }
+  me->cd_flag |= ME_CDFLAG_VERT_BWEIGHT | ME_CDFLAG_EDGE_BWEIGHT | ME_CDFLAG_EDGE_CREASE;
+  me->act_face = totpoly / 2;
+
+  float *vfloat = static_cast<float *>(
+      CustomData_add_layer(&me->vdata, CD_PROP_FLOAT, CD_CALLOC, nullptr, me->totvert));
+  for (int i = 0; i < me->totvert; i++) {
+    vfloat[i] = (float)i * 0.5f;
+  }
+
+  MLoopUV *mloopuv = static_cast<MLoopUV *>(
+      CustomData_add_layer(&me->ldata, CD_MLOOPUV, CD_CALLOC, nullptr, me->totloop));
+  for (int i = 0; i < me->totloop; i++) {
+    const MVert *mv = &me->mvert[me->mloop[i].v];
+    mloopuv[i].uv[0] = mv->co[0] / (float)GRID_SIZE;
+    mloopuv[i].uv[1] = mv->co[1] / (float)GRID_SIZE;
+  }
+
+  int *pint = static_cast<int *>(
+      CustomData_add_layer(&me->pdata, CD_PROP_INT32, CD_CALLOC, nullptr, me->totpoly));
+  for (int i = 0; i < me->totpoly; i++) {
+    pint[i] = i * 3;
+  }
+
+  BKE_mesh_vertex_normals_ensure(me);
+
+  return me;
+}
+
+static BMesh *convert_test_bmesh_create(const Mesh *me, const bool use_ids, const bool threaded)
+{
+  BMeshCreateParams create_params = {0};
+  if (use_ids) {
+    create_params.create_unique_ids = true;
+    create_params.id_elem_mask = BM_VERT | BM_EDGE | BM_FACE;
+    create_params.id_map = true;
+  }
+  else {
+    create_params.use_toolflags = true;
+  }
+
+  BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default, &create_params);
+
+  BMeshFromMeshParams params = {0};
+  params.calc_face_normal = true;
+  params.no_threading = !threaded;
+  BM_mesh_bm_from_me(nullptr, bm, me, &params);
+
+  BM_mesh_elem_table_ensure(bm, BM_VERT | BM_EDGE | BM_FACE);
+
+  return bm;
+}
+
+/* Compare the data of every layer except IDs and tool-flags, which are checked separately. */
+static void convert_test_cdata_expect(const CustomData *cdata, const void *block_a, void *block_b)
+{
+  ASSERT_EQ(block_a == nullptr, block_b == nullptr);
+
+  for (int i = 0; i < cdata->totlayer; i++) {
+    const CustomDataLayer *layer = &cdata->layers[i];
+    if (ELEM(layer->type, CD_MESH_ID, CD_TOOLFLAGS)) {
+      continue;
+    }
+
+    EXPECT_EQ(memcmp(POINTER_OFFSET(block_a, layer->offset),
+                     POINTER_OFFSET(block_b, layer->offset),
+                     CustomData_sizeof(layer->type)),
+              0)
+        << "layer " << layer->name;
+  }
+}
+
+static void convert_test_head_expect(BMesh *bm_a, BMesh *bm_b, BMElem *ele_a, BMElem *ele_b)
+{
+  EXPECT_EQ(ele_a->head.htype, ele_b->head.htype);
+  EXPECT_EQ(ele_a->head.hflag, ele_b->head.hflag);
+  EXPECT_EQ(ele_a->head.index, ele_b->head.index);
+
+  if (bm_a->idmap.flag & ele_a->head.htype) {
+    EXPECT_EQ(BM_ELEM_GET_ID(bm_a, ele_a), BM_ELEM_GET_ID(bm_b, ele_b));
+  }
+}
+
+static void convert_test_bmesh_expect(BMesh *bm_a, BMesh *bm_b)
+{
+  ASSERT_EQ(bm_a->totvert, bm_b->totvert);
+  ASSERT_EQ(bm_a->totedge, bm_b->totedge);
+  ASSERT_EQ(bm_a->totloop, bm_b->totloop);
+  ASSERT_EQ(bm_a->totface, bm_b->totface);
+  EXPECT_EQ(bm_a->totvertsel, bm_b->totvertsel);
+  EXPECT_EQ(bm_a->totedgesel, bm_b->totedgesel);
+  EXPECT_EQ(bm_a->totfacesel, bm_b->totfacesel);
+  EXPECT_EQ(BM_elem_index_get(bm_a->act_face), BM_elem_index_get(bm_b->act_face));
+
+  for (int i = 0; i < bm_a->totvert; i++) {
+    BMVert *v_a = bm_a->vtable[i];
+    BMVert *v_b = bm_b->vtable[i];
+
+    convert_test_head_expect(bm_a, bm_b, (BMElem *)v_a, (BMElem *)v_b);
+    EXPECT_EQ(memcmp(v_a->co, v_b->co, sizeof(v_a->co)), 0);
+    EXPECT_EQ(memcmp(v_a->no, v_b->no, sizeof(v_a->no)), 0);
+    convert_test_cdata_expect(&bm_a->vdata, v_a->head.data, v_b->head.data);
+
+    /* Same disk cycle order. */
+    ASSERT_EQ(v_a->e == nullptr, v_b->e == nullptr);
+    if (v_a->e) {
+      BMEdge *e_a = v_a->e, *e_b = v_b->e;
+      do {
+        ASSERT_EQ(BM_elem_index_get(e_a), BM_elem_index_get(e_b));
+        e_a = BM_DISK_EDGE_NEXT(e_a, v_a);
+        e_b = BM_DISK_EDGE_NEXT(e_b, v_b);
+      } while (e_a != v_a->e);
+      EXPECT_EQ(e_b, v_b->e);
+    }
+  }
+
+  for (int i = 0; i < bm_a->totedge; i++) {
+    BMEdge *e_a = bm_a->etable[i];
+    BMEdge *e_b = bm_b->etable[i];
+
+    convert_test_head_expect(bm_a, bm_b, (BMElem *)e_a, (BMElem *)e_b);
+    EXPECT_EQ(BM_elem_index_get(e_a->v1), BM_elem_index_get(e_b->v1));
+    EXPECT_EQ(BM_elem_index_get(e_a->v2), BM_elem_index_get(e_b->v2));
+    convert_test_cdata_expect(&bm_a->edata, e_a->head.data, e_b->head.data);
+
+    /* Same radial cycle order. */
+    ASSERT_EQ(e_a->l == nullptr, e_b->l == nullptr);
+    if (e_a->l) {
+      BMLoop *l_a = e_a->l, *l_b = e_b->l;
+      do {
+        ASSERT_EQ(BM_elem_index_get(l_a), BM_elem_index_get(l_b));
+        l_a = l_a->radial_next;
+        l_b = l_b->radial_next;
+      } while (l_a != e_a->l);
+      EXPECT_EQ(l_b, e_b->l);
+    }
+  }
+
+  for (int i = 0; i < bm_a->totface; i++) {
+    BMFace *f_a = bm_a->ftable[i];
+    BMFace *f_b = bm_b->ftable[i];
+
+    convert_test_head_expect(bm_a, bm_b, (BMElem *)f_a, (BMElem *)f_b);
+    ASSERT_EQ(f_a->len, f_b->len);
+    EXPECT_EQ(f_a->mat_nr, f_b->mat_nr);
+    EXPECT_EQ(memcmp(f_a->no, f_b->no, sizeof(f_a->no)), 0);
+    convert_test_cdata_expect(&bm_a->pdata, f_a->head.data, f_b->head.data);
+
+    BMLoop *l_a = f_a->l_first, *l_b = f_b->l_first;
+    for (int j = 0; j < f_a->len; j++, l_a = l_a->next, l_b = l_b->next) {
+      convert_test_head_expect(bm_a, bm_b, (BMElem *)l_a, (BMElem *)l_b);
+      EXPECT_EQ(BM_elem_index_get(l_a->v), BM_elem_index_get(l_b->v));
+      EXPECT_EQ(BM_elem_index_get(l_a->e), BM_elem_index_get(l_b->e));
+      EXPECT_EQ(l_b->f, f_b);
+      convert_test_cdata_expect(&bm_a->ldata, l_a->head.data, l_b->head.data);
+    }
+    EXPECT_EQ(l_b, f_b->l_first);
+  }
+}
+
+static void convert_test_threaded_expect(const bool use_ids)
+{
+  Mesh *me = convert_test_mesh_create();
+
+  BMesh *bm_serial = convert_test_bmesh_create(me, use_ids, false);
+  BMesh *bm_threaded = convert_test_bmesh_create(me, use_ids, true);
+
+  convert_test_bmesh_expect(bm_serial, bm_threaded);
+
+  BM_mesh_free(bm_serial);
+  BM_mesh_free(bm_threaded);
+  BKE_id_free(nullptr, me);
+}
+
+TEST(bmesh_mesh_convert, from_mesh_threaded_toolflags)
+{
+  convert_test_threaded_expect(false);
+}
+
+TEST(bmesh_mesh_convert, from_mesh_threaded_ids)
+{
+  convert_test_threaded_expect(true);
+}
+
+TEST(bmesh_mesh_convert, from_mesh_bad_face)
+{
+  Mesh *me = convert_test_mesh_create();
+
+  /* An empty face, the single threaded conversion skips it. */
+  me->mpoly[3].totloop = 0;
+
+  BMesh *bm_serial = convert_test_bmesh_create(me, false, false);
+  BMesh *bm_threaded = convert_test_bmesh_create(me, false, true);
+
+  EXPECT_EQ(bm_threaded->totface, me->totpoly - 1);
+  convert_test_bmesh_expect(bm_serial, bm_threaded);
+
+  BM_mesh_free(bm_serial);
+  BM_mesh_free(bm_threaded);
+  BKE_id_free(nullptr, me);
+}
+
+TEST(bmesh_mesh_convert, round_trip)
+{
+  Mesh *me = convert_test_mesh_create();
+  BMesh *bm = convert_test_bmesh_create(me, true, true);
+
+  Mesh *me_dst = BKE_mesh_new_nomain(0, 0, 0, 0, 0);
+  BMeshToMeshParams params = {0};
+  BM_mesh_bm_to_me(nullptr, nullptr, bm, me_dst, &params);
+
+  ASSERT_EQ(me->totvert, me_dst->totvert);
+  ASSERT_EQ(me->totedge, me_dst->totedge);
+  ASSERT_EQ(me->totloop, me_dst->totloop);
+  ASSERT_EQ(me->totpoly, me_dst->totpoly);
+  EXPECT_EQ(me->act_face, me_dst->act_face);
+
+  for (int i = 0; i < me->totvert; i++) {
+    EXPECT_EQ(memcmp(me->mvert[i].co, me_dst->mvert[i].co, sizeof(float[3])), 0);
+    EXPECT_EQ(me->mvert[i].bweight, me_dst->mvert[i].bweight);
+    EXPECT_EQ(me->mvert[i].flag & ME_HIDE, me_dst->mvert[i].flag & ME_HIDE);
+  }
+  for (int i = 0; i < me->totedge; i++) {
+    EXPECT_EQ(me->medge[i].v1, me_dst->medge[i].v1);
+    EXPECT_EQ(me->medge[i].v2, me_dst->medge[i].v2);
+    EXPECT_EQ(me->medge[i].crease, me_dst->medge[i].crease);
+    EXPECT_EQ(me->medge[i].bweight, me_dst->medge[i].bweight);
+  }
+  for (int i = 0; i < me->totpoly; i++) {
+    EXPECT_EQ(me->mpoly[i].loopstart, me_dst->mpoly[i].loopstart);
+    EXPECT_EQ(me->mpoly[i].totloop, me_dst->mpoly[i].totloop);
+    EXPECT_EQ(me->mpoly[i].mat_nr, me_dst->mpoly[i].mat_nr);
+    EXPECT_EQ(me->mpoly[i].flag, me_dst->mpoly[i].flag);
+  }
+  for (int i = 0; i < me->totloop; i++) {
+    EXPECT_EQ(me->mloop[i].v, me_dst->mloop[i].v);
+    EXPECT_EQ(me->mloop[i].e, me_dst->mloop[i].e);
+  }
+
+  const float *vfloat = static_cast<const float *>(
+      CustomData_get_layer(&me_dst->vdata, CD_PROP_FLOAT));
+  const MLoopUV *mloopuv = static_cast<const MLoopUV *>(
+      CustomData_get_layer(&me_dst->ldata, CD_MLOOPUV));
+  const int *pint = static_cast<const int *>(CustomData_get_layer(&me_dst->pdata, CD_PROP_INT32));
+  ASSERT_TRUE(vfloat && mloopuv && pint);
+
+  EXPECT_EQ(memcmp(vfloat,
+                   CustomData_get_layer(&me->vdata, CD_PROP_FLOAT),
+                   sizeof(float) * (size_t)me->totvert),
+            0);
+  EXPECT_EQ(memcmp(mloopuv,
+                   CustomData_get_layer(&me->ldata, CD_MLOOPUV),
+                   sizeof(MLoopUV) * (size_t)me->totloop),
+            0);
+  EXPECT_EQ(
+      memcmp(pint, CustomData_get_layer(&me->pdata, CD_PROP_INT32), sizeof(int) * me->totpoly),
+      0);
+
+  BM_mesh_free(bm);
+  BKE_id_free(nullptr, me_dst);
+  BKE_id_free(nullptr, me);
+}
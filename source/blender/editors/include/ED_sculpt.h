@@ -41,6 +41,12 @@ void ED_sculpt_undosys_type(struct UndoType *ut);
 void ED_sculpt_undo_geometry_begin(struct Object *ob, const char *name);
 void ED_sculpt_undo_geometry_end(struct Object *ob);
 
+/**
+ * Memory used by the sculpt undo steps, split into what is resident and what was moved out to
+ * temporary files because of the sculpt undo memory limit.
+ */
+void ED_sculpt_undo_memory_stats(size_t *r_resident, size_t *r_spilled);
+
 /* Face sets. */
 
 int ED_sculpt_face_sets_find_next_available_id(struct Mesh *mesh);
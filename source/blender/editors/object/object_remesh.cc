@@ -135,8 +135,11 @@ static int voxel_remesh_exec(bContext *C, wmOperator *op)
     isovalue = mesh->remesh_voxel_size * 0.3f;
   }
 
-  Mesh *new_mesh = BKE_mesh_remesh_voxel(
-      mesh, mesh->remesh_voxel_size, mesh->remesh_voxel_adaptivity, isovalue);
+  Mesh *new_mesh = BKE_mesh_remesh_voxel_adaptive(mesh,
+                                                   mesh->remesh_voxel_size,
+                                                   mesh->remesh_voxel_adaptivity,
+                                                   isovalue,
+                                                   mesh->remesh_voxel_detail);
 
   if (!new_mesh) {
     BKE_report(op->reports, RPT_ERROR, "Voxel remesher failed to create mesh");
@@ -153,9 +156,9 @@ static int voxel_remesh_exec(bContext *C, wmOperator *op)
     new_mesh = mesh_fixed_poles;
   }
 
-  if (mesh->flag & ME_REMESH_REPROJECT_VOLUME || mesh->flag & ME_REMESH_REPROJECT_PAINT_MASK ||
-      mesh->flag & ME_REMESH_REPROJECT_SCULPT_FACE_SETS ||
-      mesh->flag & ME_REMESH_REPROJECT_MATERIALS) {
+  if (mesh->flag & (ME_REMESH_REPROJECT_VOLUME | ME_REMESH_REPROJECT_PAINT_MASK |
+                    ME_REMESH_REPROJECT_SCULPT_FACE_SETS | ME_REMESH_REPROJECT_MATERIALS |
+                    ME_REMESH_REPROJECT_VERTEX_COLORS)) {
     BKE_mesh_runtime_clear_geometry(mesh);
   }
 
@@ -163,22 +166,7 @@ static int voxel_remesh_exec(bContext *C, wmOperator *op)
     BKE_shrinkwrap_remesh_target_project(new_mesh, mesh, ob);
   }
 
-  if (mesh->flag & ME_REMESH_REPROJECT_PAINT_MASK) {
-    BKE_mesh_remesh_reproject_paint_mask(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_SCULPT_FACE_SETS) {
-    BKE_remesh_reproject_sculpt_face_sets(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_MATERIALS) {
-    BKE_remesh_reproject_materials(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_VERTEX_COLORS) {
-    BKE_mesh_runtime_clear_geometry(mesh);
-    BKE_remesh_reproject_vertex_paint(new_mesh, mesh);
-  }
+  BKE_mesh_remesh_reproject_attributes(new_mesh, mesh, mesh->flag);
 
   if (ob->mode == OB_MODE_SCULPT) {
     BKE_mesh_remesh_sculpt_array_update(ob, new_mesh, mesh);
@@ -891,7 +879,7 @@ static void quadriflow_start_job(void *customdata, short *stop, short *do_update
 
   if (qj->preserve_paint_mask) {
     BKE_mesh_runtime_clear_geometry(mesh);
-    BKE_mesh_remesh_reproject_paint_mask(new_mesh, mesh);
+    BKE_mesh_remesh_reproject_attributes(new_mesh, mesh, ME_REMESH_REPROJECT_PAINT_MASK);
   }
 
   BKE_mesh_nomain_to_mesh(new_mesh, mesh, ob, &CD_MASK_MESH, true);
@@ -1242,9 +1230,9 @@ static int instant_meshes_remesh_exec(bContext *C, wmOperator *op)
     return OPERATOR_CANCELLED;
   }
 
-  if (mesh->flag & ME_REMESH_REPROJECT_VOLUME || mesh->flag & ME_REMESH_REPROJECT_PAINT_MASK ||
-      mesh->flag & ME_REMESH_REPROJECT_SCULPT_FACE_SETS ||
-      mesh->flag & ME_REMESH_REPROJECT_MATERIALS) {
+  if (mesh->flag & (ME_REMESH_REPROJECT_VOLUME | ME_REMESH_REPROJECT_PAINT_MASK |
+                    ME_REMESH_REPROJECT_SCULPT_FACE_SETS | ME_REMESH_REPROJECT_MATERIALS |
+                    ME_REMESH_REPROJECT_VERTEX_COLORS)) {
     BKE_mesh_runtime_clear_geometry(mesh);
   }
 
@@ -1252,22 +1240,7 @@ static int instant_meshes_remesh_exec(bContext *C, wmOperator *op)
     BKE_shrinkwrap_remesh_target_project(new_mesh, mesh, ob);
   }
 
-  if (mesh->flag & ME_REMESH_REPROJECT_PAINT_MASK) {
-    BKE_mesh_remesh_reproject_paint_mask(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_SCULPT_FACE_SETS) {
-    BKE_remesh_reproject_sculpt_face_sets(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_MATERIALS) {
-    BKE_remesh_reproject_materials(new_mesh, mesh);
-  }
-
-  if (mesh->flag & ME_REMESH_REPROJECT_VERTEX_COLORS) {
-    BKE_mesh_runtime_clear_geometry(mesh);
-    BKE_remesh_reproject_vertex_paint(new_mesh, mesh);
-  }
+  BKE_mesh_remesh_reproject_attributes(new_mesh, mesh, mesh->flag);
 
   BKE_mesh_nomain_to_mesh(new_mesh, mesh, ob, &CD_MASK_MESH, true);
   BKE_mesh_batch_cache_dirty_tag(static_cast<Mesh *>(ob->data), BKE_MESH_BATCH_DIRTY_ALL);
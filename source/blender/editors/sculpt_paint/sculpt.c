@@ -24,6 +24,7 @@
 #include "BLI_math_color_blend.h"
 #include "BLI_memarena.h"
 #include "BLI_rand.h"
+#include "BLI_simd.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 #include "atomic_ops.h"
@@ -331,6 +332,23 @@ MSculptVert *SCULPT_vertex_get_sculptvert(const SculptSession *ss, SculptVertRef
   return NULL;
 }
 
+MSculptVertCold *SCULPT_vertex_get_sculptvert_cold(const SculptSession *ss, SculptVertRef vertex)
+{
+  switch (BKE_pbvh_type(ss->pbvh)) {
+    case PBVH_BMESH: {
+      BMVert *v = (BMVert *)vertex.i;
+      return BKE_PBVH_SCULPTVERT_COLD(ss->cd_sculpt_vert_cold, v);
+    }
+
+    case PBVH_GRIDS:
+    case PBVH_FACES: {
+      return ss->mdyntopo_verts_cold + vertex.i;
+    }
+  }
+
+  return NULL;
+}
+
 float *SCULPT_vertex_origco_get(SculptSession *ss, SculptVertRef vertex)
 {
   switch (BKE_pbvh_type(ss->pbvh)) {
@@ -2018,281 +2036,672 @@ static void sculpt_vertex_neighbors_get_grids(const SculptSession *ss,
   }
 }
 
-/* still a bit buggy */
-/* #define SCULPT_NEIGHBORS_CACHE */
+static void sculpt_vertex_neighbors_get_live(const SculptSession *ss,
+                                             const SculptVertRef vertex,
+                                             const bool include_duplicates,
+                                             SculptVertexNeighborIter *iter)
+{
+  iter->no_free = false;
+
+  switch (BKE_pbvh_type(ss->pbvh)) {
+    case PBVH_FACES:
+      /* use vemap if it exists, so result is in disk cycle order */
+      if (ss->vemap) {
+        BKE_pbvh_set_vemap(ss->pbvh, ss->vemap);
+        sculpt_vertex_neighbors_get_faces_vemap(ss, vertex, iter);
+      }
+      else {
+        sculpt_vertex_neighbors_get_faces(ss, vertex, iter);
+      }
+      return;
+    case PBVH_BMESH:
+      sculpt_vertex_neighbors_get_bmesh(ss, vertex, iter);
+      return;
+    case PBVH_GRIDS:
+      sculpt_vertex_neighbors_get_grids(ss, vertex, include_duplicates, iter);
+      return;
+  }
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Neighbor Cache
+ *
+ * Stroke lifetime adjacency cache, stored as one CSR block (offsets into flat neighbor arrays)
+ * per PBVH node. Blocks for the nodes under the brush are built in parallel before the brush
+ * runs (see #neighbor_cache_sync), blocks of other nodes are built lazily on first access for
+ * #PBVH_FACES and #PBVH_GRIDS. A query for a vertex that is not cached falls back to the live
+ * neighbor functions.
+ *
+ * For #PBVH_GRIDS the neighbor list includes duplicates, which SubdivCCG always puts after the
+ * unique neighbors, so the list without duplicates is a prefix of it.
+ *
+ * For #PBVH_BMESH dyntopo edits are tracked incrementally: blocks whose vertices were freed,
+ * moved to another node or tagged with #SCULPTVERT_NEED_DISK_SORT are dropped and rebuilt the
+ * next time their node is under the brush. Neighbor indices are not stored since they change
+ * whenever the vertex table is renumbered.
+ * \{ */
+
+enum {
+  NCACHE_BLOCK_EMPTY = 0,
+  NCACHE_BLOCK_BUILDING,
+  NCACHE_BLOCK_READY,
+};
+
+#define NCACHE_SLOT_NONE -1
+#define NCACHE_SLOT(block, local) (((int64_t)(block) << 32) | (int64_t)(local))
+#define NCACHE_SLOT_BLOCK(slot) ((int)((slot) >> 32))
+#define NCACHE_SLOT_LOCAL(slot) ((int)((slot)&0xffffffff))
+
+typedef struct NeighborCacheBlock {
+  int32_t state;
+  int totvert;
 
-#ifdef SCULPT_NEIGHBORS_CACHE
-typedef struct NeighborCacheItem {
+  SculptVertRef *verts;
+  /* Neighbors of verts[i] are neighbors[offsets[i]] to neighbors[offsets[i + 1] - 1]. */
+  int *offsets;
   struct _SculptNeighborRef *neighbors;
-  int *neighbors_indices;
-  short num_duplicates, valence;
-  bool has_edge;
-} NeighborCacheItem;
+  int *neighbor_indices; /* NULL for PBVH_BMESH. */
+  short *num_duplicates; /* PBVH_GRIDS only. */
+} NeighborCacheBlock;
 
 typedef struct NeighborCache {
-  MemArena **arenas;
-  NeighborCacheItem **cache;
-  NeighborCacheItem **duplicates;
-  int totvert, totthread;
+  PBVH *pbvh;
+  bool is_bmesh;
+
+  /* One block per PBVH node index. */
+  NeighborCacheBlock *blocks;
+  int totblock;
+
+  /* Block and local index of every vertex, or #NCACHE_SLOT_NONE. */
+  int64_t *vert_slot;
+  int totvert;
+
+  /* Set when dyntopo modified the mesh since the last sync. */
+  bool topology_changed;
+  int bm_totvert, bm_totedge;
 } NeighborCache;
 
+static void neighbor_cache_block_free(NeighborCacheBlock *block)
+{
+  MEM_SAFE_FREE(block->verts);
+  MEM_SAFE_FREE(block->offsets);
+  MEM_SAFE_FREE(block->neighbors);
+  MEM_SAFE_FREE(block->neighbor_indices);
+  MEM_SAFE_FREE(block->num_duplicates);
+
+  block->totvert = 0;
+  block->state = NCACHE_BLOCK_EMPTY;
+}
+
 static void neighbor_cache_free(NeighborCache *ncache)
 {
-  for (int i = 0; i < ncache->totthread; i++) {
-    BLI_memarena_free(ncache->arenas[i]);
+  for (int i = 0; i < ncache->totblock; i++) {
+    neighbor_cache_block_free(ncache->blocks + i);
   }
 
-  MEM_SAFE_FREE(ncache->arenas);
-  MEM_SAFE_FREE(ncache->cache);
-  MEM_SAFE_FREE(ncache->duplicates);
-  MEM_SAFE_FREE(ncache);
+  MEM_SAFE_FREE(ncache->blocks);
+  MEM_SAFE_FREE(ncache->vert_slot);
+  MEM_freeN(ncache);
 }
 
-static bool neighbor_cache_begin(const SculptSession *ss)
+/* Fills the block of node `ni`, the caller owns the block (state is #NCACHE_BLOCK_BUILDING). */
+static void neighbor_cache_block_build(const SculptSession *ss, NeighborCache *ncache, int ni)
 {
-  if (!ss->cache) {
-    return false;
-  }
+  NeighborCacheBlock *block = ncache->blocks + ni;
+  PBVH *pbvh = ss->pbvh;
+  PBVHNode *node = BKE_pbvh_get_node(pbvh, ni);
+  const PBVHType type = BKE_pbvh_type(pbvh);
 
-  // return false;
-  Brush *brush = ss->cache->brush;
+  int totvert;
+  BKE_pbvh_node_num_verts(pbvh, node, &totvert, NULL);
 
-  if (brush && SCULPT_stroke_is_dynamic_topology(ss, brush)) {
-    return false;
-  }
+  block->verts = MEM_malloc_arrayN(totvert, sizeof(*block->verts), __func__);
 
-  if (ss->cache->ncache) {
-    return true;
+  switch (type) {
+    case PBVH_FACES: {
+      const int *vert_indices;
+      BKE_pbvh_node_get_verts(pbvh, node, &vert_indices, NULL);
+
+      for (int i = 0; i < totvert; i++) {
+        block->verts[i] = BKE_pbvh_make_vref(vert_indices[i]);
+      }
+      break;
+    }
+    case PBVH_GRIDS: {
+      const CCGKey *key = BKE_pbvh_get_grid_key(pbvh);
+      int *grid_indices, totgrid;
+      BKE_pbvh_node_get_grids(pbvh, node, &grid_indices, &totgrid, NULL, NULL, NULL);
+
+      for (int i = 0; i < totgrid; i++) {
+        for (int j = 0; j < key->grid_area; j++) {
+          block->verts[i * key->grid_area + j] = BKE_pbvh_make_vref(
+              grid_indices[i] * key->grid_area + j);
+        }
+      }
+      break;
+    }
+    case PBVH_BMESH: {
+      TableGSet *unique_verts = BKE_pbvh_bmesh_node_unique_verts(node);
+      BMVert *v;
+      int i = 0;
+
+      TGSET_ITER (v, unique_verts) {
+        SculptVertRef vertex = BKE_pbvh_make_vref((intptr_t)v);
+
+        /* Only the thread building this node touches its disk cycles. */
+        SCULPT_dyntopo_check_disk_sort((SculptSession *)ss, vertex);
+        block->verts[i++] = vertex;
+      }
+      TGSET_ITER_END;
+
+      totvert = i;
+      break;
+    }
   }
 
-  int totvert = SCULPT_vertex_count_get(ss);
+  block->totvert = totvert;
+  block->offsets = MEM_malloc_arrayN(totvert + 1, sizeof(*block->offsets), __func__);
+  if (type == PBVH_GRIDS) {
+    block->num_duplicates = MEM_malloc_arrayN(totvert, sizeof(*block->num_duplicates), __func__);
+  }
 
-  NeighborCache *ncache = MEM_callocN(sizeof(NeighborCache), "NeighborCache");
-  ncache->cache = MEM_calloc_arrayN(totvert, sizeof(void *), "Cache Items");
+  int capacity = max_ii(totvert * 6, SCULPT_VERTEX_NEIGHBOR_FIXED_CAPACITY);
+  int tot = 0;
 
-  if (BKE_pbvh_type(ss->pbvh) == PBVH_GRIDS) {
-    ncache->duplicates = MEM_calloc_arrayN(totvert, sizeof(void *), "Cache Items");
+  block->neighbors = MEM_malloc_arrayN(capacity, sizeof(*block->neighbors), __func__);
+  if (type != PBVH_BMESH) {
+    block->neighbor_indices = MEM_malloc_arrayN(
+        capacity, sizeof(*block->neighbor_indices), __func__);
   }
 
-  int totthread = BLI_task_scheduler_num_threads() * 4;
-  ncache->arenas = MEM_malloc_arrayN(totthread, sizeof(void *), "neighbor cache->arenas");
-  ncache->totthread = totthread;
+  for (int i = 0; i < totvert; i++) {
+    SculptVertexNeighborIter niter;
+    sculpt_vertex_neighbors_get_live(ss, block->verts[i], true, &niter);
+
+    if (tot + niter.size > capacity) {
+      capacity = (tot + niter.size) * 2;
+      block->neighbors = MEM_reallocN(block->neighbors, sizeof(*block->neighbors) * capacity);
+      if (block->neighbor_indices) {
+        block->neighbor_indices = MEM_reallocN(block->neighbor_indices,
+                                               sizeof(*block->neighbor_indices) * capacity);
+      }
+    }
+
+    memcpy(block->neighbors + tot, niter.neighbors, sizeof(*block->neighbors) * niter.size);
+    if (block->neighbor_indices) {
+      memcpy(block->neighbor_indices + tot,
+             niter.neighbor_indices,
+             sizeof(*block->neighbor_indices) * niter.size);
+    }
+    if (block->num_duplicates) {
+      block->num_duplicates[i] = (short)niter.num_duplicates;
+    }
+
+    block->offsets[i] = tot;
+    tot += niter.size;
 
-  for (int i = 0; i < totthread; i++) {
-    ncache->arenas[i] = BLI_memarena_new(1 << 17, "neighbor cache");
+    if (niter.neighbors != niter.neighbors_fixed) {
+      MEM_freeN(niter.neighbors);
+      MEM_freeN(niter.neighbor_indices);
+    }
   }
 
-  ncache->totvert = totvert;
+  block->offsets[totvert] = tot;
+}
+
+static void neighbor_cache_block_slots_write(const SculptSession *ss,
+                                             NeighborCache *ncache,
+                                             int ni)
+{
+  NeighborCacheBlock *block = ncache->blocks + ni;
+
+  for (int i = 0; i < block->totvert; i++) {
+    const int index = BKE_pbvh_vertex_index_to_table(ss->pbvh, block->verts[i]);
+
+    if (index >= 0 && index < ncache->totvert) {
+      ncache->vert_slot[index] = NCACHE_SLOT(ni, i);
+    }
+  }
+}
 
-  if (atomic_cas_ptr((void **)&ss->cache->ncache, NULL, ncache) != NULL) {
-    // another thread got here first?
+/* Lazy build from inside brush threads, only used when the topology can't change. */
+static bool neighbor_cache_block_ensure(const SculptSession *ss, NeighborCache *ncache, int ni)
+{
+  NeighborCacheBlock *block = ncache->blocks + ni;
 
-    neighbor_cache_free(ncache);
+  if (block->state == NCACHE_BLOCK_READY) {
+    return true;
+  }
+  if (ncache->is_bmesh) {
+    /* Walking disk cycles of other nodes races with their disk sorting. */
+    return false;
+  }
 
+  if (atomic_cas_int32(&block->state, NCACHE_BLOCK_EMPTY, NCACHE_BLOCK_BUILDING) !=
+      NCACHE_BLOCK_EMPTY) {
+    /* Another thread is building it, don't wait. */
     return false;
   }
 
+  neighbor_cache_block_build(ss, ncache, ni);
+  atomic_cas_int32(&block->state, NCACHE_BLOCK_BUILDING, NCACHE_BLOCK_READY);
+
   return true;
 }
 
-static NeighborCacheItem *neighbor_cache_get(const SculptSession *ss,
-                                             SculptVertRef vertex,
-                                             const bool include_duplicates)
+static bool neighbor_cache_get(const SculptSession *ss,
+                               const SculptVertRef vertex,
+                               const bool include_duplicates,
+                               SculptVertexNeighborIter *iter)
 {
-  int i = BKE_pbvh_vertex_index_to_table(ss->pbvh, vertex);
-
   NeighborCache *ncache = ss->cache->ncache;
+  const int index = BKE_pbvh_vertex_index_to_table(ss->pbvh, vertex);
 
-  if (include_duplicates && !ncache->duplicates) {
-    NeighborCacheItem **duplicates = MEM_calloc_arrayN(
-        ncache->totvert, sizeof(void *), "ncache->duplicages");
+  if (index < 0 || index >= ncache->totvert) {
+    return false;
+  }
 
-    if (atomic_cas_ptr(&ncache->duplicates, NULL, duplicates) != NULL) {
-      /* some other thread got here first */
-      MEM_freeN(duplicates);
-    }
+  const int64_t slot = ncache->vert_slot[index];
+  if (slot == NCACHE_SLOT_NONE) {
+    return false;
   }
 
-  NeighborCacheItem **cache = include_duplicates ? ncache->duplicates : ncache->cache;
-  int thread_nr = BLI_task_parallel_thread_id(NULL);
+  const int ni = NCACHE_SLOT_BLOCK(slot);
+  const int local = NCACHE_SLOT_LOCAL(slot);
+  NeighborCacheBlock *block = ncache->blocks + ni;
 
-  if (!cache[i]) {
-    NeighborCacheItem *item = BLI_memarena_calloc(ncache->arenas[thread_nr], sizeof(*item));
-    SculptVertexNeighborIter ni = {0};
+  if (!neighbor_cache_block_ensure(ss, ncache, ni) || block->verts[local].i != vertex.i) {
+    return false;
+  }
 
-    ni.neighbors = ni.neighbors_fixed;
-    ni.neighbor_indices = ni.neighbor_indices_fixed;
-    ni.capacity = SCULPT_VERTEX_NEIGHBOR_FIXED_CAPACITY;
+  if (ncache->is_bmesh) {
+    MSculptVert *mv = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, (BMVert *)vertex.i);
 
-    switch (BKE_pbvh_type(ss->pbvh)) {
-      case PBVH_FACES:
-        // use vemap if it exists, so result is in disk cycle order
-        if (ss->vemap) {
-          BKE_pbvh_set_vemap(ss->pbvh, ss->vemap);
-          sculpt_vertex_neighbors_get_faces_vemap(ss, vertex, &ni);
-        }
-        else {
-          sculpt_vertex_neighbors_get_faces(ss, vertex, &ni);
-        }
-        break;
-      case PBVH_BMESH:
-        sculpt_vertex_neighbors_get_bmesh(ss, vertex, &ni);
-        break;
-      case PBVH_GRIDS:
-        sculpt_vertex_neighbors_get_grids(ss, vertex, include_duplicates, &ni);
-        break;
+    if (mv->flag & SCULPTVERT_NEED_DISK_SORT) {
+      return false;
     }
+  }
 
-    item->num_duplicates = ni.num_duplicates;
-    item->has_edge = ni.has_edge;
-    item->valence = ni.size;
-
-    item->neighbors = BLI_memarena_alloc(ncache->arenas[thread_nr],
-                                         sizeof(*item->neighbors) * ni.size);
-    item->neighbors_indices = BLI_memarena_alloc(ncache->arenas[thread_nr],
-                                                 sizeof(*item->neighbors_indices) * ni.size);
+  const int start = block->offsets[local];
+  int size = block->offsets[local + 1] - start;
+  int num_duplicates = 0;
 
-    memcpy(item->neighbors, ni.neighbors, sizeof(*item->neighbors) * ni.size);
-    memcpy(
-        item->neighbors_indices, ni.neighbor_indices, sizeof(*item->neighbors_indices) * ni.size);
+  if (block->num_duplicates) {
+    if (include_duplicates) {
+      num_duplicates = block->num_duplicates[local];
+    }
+    else {
+      size -= block->num_duplicates[local];
+    }
+  }
 
-    // if (atomic_cas_ptr(&cache[i], NULL, item) != item) {
-    // another thread got here first
-    //}
+  if (block->neighbor_indices) {
+    iter->neighbor_indices = block->neighbor_indices + start;
+  }
+  else {
+    if (size > SCULPT_VERTEX_NEIGHBOR_FIXED_CAPACITY) {
+      return false;
+    }
 
-    atomic_cas_ptr((void **)&cache[i], NULL, item);
+    for (int i = 0; i < size; i++) {
+      BMVert *v2 = (BMVert *)block->neighbors[start + i].vertex.i;
+      iter->neighbor_indices_fixed[i] = BM_elem_index_get(v2);
+    }
+    iter->neighbor_indices = iter->neighbor_indices_fixed;
   }
 
-  return cache[i];
+  iter->neighbors = block->neighbors + start;
+  iter->size = iter->capacity = size;
+  iter->num_duplicates = num_duplicates;
+  iter->is_duplicate = block->num_duplicates ? include_duplicates : false;
+  iter->has_edge = true;
+  iter->no_free = true;
+  iter->i = 0;
+
+  return true;
 }
-#endif
 
-void SCULPT_vertex_neighbors_get(const SculptSession *ss,
-                                 const SculptVertRef vertex,
-                                 const bool include_duplicates,
-                                 SculptVertexNeighborIter *iter)
+static void neighbor_cache_slots_task_cb(void *__restrict userdata,
+                                         const int n,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
 {
-#ifdef SCULPT_NEIGHBORS_CACHE
-  if (neighbor_cache_begin(ss)) {
-    NeighborCacheItem *item = neighbor_cache_get(ss, vertex, include_duplicates);
-
-    // memset(iter, 0, sizeof(*iter));
+  SculptThreadedTaskData *data = userdata;
+  SculptSession *ss = data->ob->sculpt;
+  NeighborCache *ncache = ss->cache->ncache;
+  PBVH *pbvh = ss->pbvh;
+  PBVHNode *node = data->nodes[n];
+  const int ni = BKE_pbvh_get_node_index(pbvh, node);
 
-    iter->no_free = true;
-    iter->neighbors = item->neighbors;
-    iter->neighbor_indices = item->neighbors_indices;
-    iter->num_duplicates = item->num_duplicates;
-    iter->size = iter->capacity = item->valence;
-    iter->has_edge = item->has_edge;
-    iter->is_duplicate = false;
+  if (BKE_pbvh_type(pbvh) == PBVH_GRIDS) {
+    const CCGKey *key = BKE_pbvh_get_grid_key(pbvh);
+    int *grid_indices, totgrid;
+    BKE_pbvh_node_get_grids(pbvh, node, &grid_indices, &totgrid, NULL, NULL, NULL);
 
-    return;
+    for (int i = 0; i < totgrid; i++) {
+      for (int j = 0; j < key->grid_area; j++) {
+        const int local = i * key->grid_area + j;
+        ncache->vert_slot[grid_indices[i] * key->grid_area + j] = NCACHE_SLOT(ni, local);
+      }
+    }
   }
-#endif
-
-  iter->no_free = false;
+  else {
+    const int *vert_indices;
+    int uniq_verts;
+    BKE_pbvh_node_num_verts(pbvh, node, &uniq_verts, NULL);
+    BKE_pbvh_node_get_verts(pbvh, node, &vert_indices, NULL);
 
-  switch (BKE_pbvh_type(ss->pbvh)) {
-    case PBVH_FACES:
-      /* use vemap if it exists, so result is in disk cycle order */
-      if (ss->vemap) {
-        BKE_pbvh_set_vemap(ss->pbvh, ss->vemap);
-        sculpt_vertex_neighbors_get_faces_vemap(ss, vertex, iter);
-      }
-      else {
-        sculpt_vertex_neighbors_get_faces(ss, vertex, iter);
-      }
-      return;
-    case PBVH_BMESH:
-      sculpt_vertex_neighbors_get_bmesh(ss, vertex, iter);
-      return;
-    case PBVH_GRIDS:
-      sculpt_vertex_neighbors_get_grids(ss, vertex, include_duplicates, iter);
-      return;
+    for (int i = 0; i < uniq_verts; i++) {
+      ncache->vert_slot[vert_indices[i]] = NCACHE_SLOT(ni, i);
+    }
   }
 }
 
-SculptBoundaryType SCULPT_edge_is_boundary(const SculptSession *ss,
-                                           const SculptEdgeRef edge,
-                                           SculptBoundaryType typemask)
+static NeighborCache *neighbor_cache_new(Object *ob)
 {
+  SculptSession *ss = ob->sculpt;
+  NeighborCache *ncache = MEM_callocN(sizeof(NeighborCache), "NeighborCache");
 
-  int ret = 0;
-
-  switch (BKE_pbvh_type(ss->pbvh)) {
-    case PBVH_BMESH: {
-      BMEdge *e = (BMEdge *)edge.i;
-
-      if (typemask & SCULPT_BOUNDARY_MESH) {
-        ret |= (!e->l || e->l == e->l->radial_next) ? SCULPT_BOUNDARY_MESH : 0;
-      }
-
-      if ((typemask & SCULPT_BOUNDARY_FACE_SET) && e->l && e->l != e->l->radial_next) {
-        if (ss->boundary_symmetry) {
-          // TODO: calc and cache this properly
-          MSculptVert *mv1 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v1);
-          MSculptVert *mv2 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v2);
+  ncache->pbvh = ss->pbvh;
+  ncache->is_bmesh = BKE_pbvh_type(ss->pbvh) == PBVH_BMESH;
+  ncache->totblock = BKE_pbvh_get_totnodes(ss->pbvh);
+  ncache->blocks = MEM_calloc_arrayN(ncache->totblock, sizeof(*ncache->blocks), __func__);
 
-          bool ok = (mv1->flag & SCULPTVERT_FSET_BOUNDARY) &&
-                    (mv2->flag & SCULPTVERT_FSET_BOUNDARY);
-          ret |= ok ? SCULPT_BOUNDARY_FACE_SET : 0;
-        }
-        else {
-          int fset1 = BM_ELEM_CD_GET_INT(e->l->f, ss->cd_faceset_offset);
-          int fset2 = BM_ELEM_CD_GET_INT(e->l->radial_next->f, ss->cd_faceset_offset);
+  if (ncache->is_bmesh) {
+    BM_mesh_elem_index_ensure(ss->bm, BM_VERT);
+    ncache->bm_totvert = ss->bm->totvert;
+    ncache->bm_totedge = ss->bm->totedge;
+  }
 
-          bool ok = (fset1 < 0) != (fset2 < 0);
+  ncache->totvert = ncache->is_bmesh ? ss->bm->totvert : SCULPT_vertex_count_get(ss);
+  ncache->vert_slot = MEM_malloc_arrayN(ncache->totvert, sizeof(*ncache->vert_slot), __func__);
+  memset(ncache->vert_slot, 0xff, sizeof(*ncache->vert_slot) * ncache->totvert);
 
-          ok = ok || fset1 != fset2;
+  ss->cache->ncache = ncache;
 
-          ret |= ok ? SCULPT_BOUNDARY_FACE_SET : 0;
-        }
-      }
+  if (ncache->is_bmesh) {
+    /* Slots are written when blocks are built. */
+    return ncache;
+  }
 
-      if (typemask & SCULPT_BOUNDARY_UV) {
-        MSculptVert *mv1 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v1);
-        MSculptVert *mv2 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v2);
+  /* Vertex ownership doesn't change during the stroke, so all slots are known up front. */
+  PBVHNode **nodes;
+  int totnode;
+  BKE_pbvh_get_nodes(ss->pbvh, PBVH_Leaf, &nodes, &totnode);
 
-        bool ok = (mv1->flag & SCULPTVERT_UV_BOUNDARY) && (mv2->flag & SCULPTVERT_UV_BOUNDARY);
-        ret |= ok ? SCULPT_BOUNDARY_UV : 0;
-      }
+  SculptThreadedTaskData data = {
+      .ob = ob,
+      .nodes = nodes,
+  };
 
-      if (typemask & SCULPT_BOUNDARY_SHARP) {
-        ret |= !BM_elem_flag_test(e, BM_ELEM_SMOOTH) ? SCULPT_BOUNDARY_SHARP : 0;
-      }
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, totnode);
+  BLI_task_parallel_range(0, totnode, &data, neighbor_cache_slots_task_cb, &settings);
 
-      if (typemask & SCULPT_BOUNDARY_SEAM) {
-        ret |= BM_elem_flag_test(e, BM_ELEM_SEAM) ? SCULPT_BOUNDARY_SEAM : 0;
-      }
+  MEM_SAFE_FREE(nodes);
 
-      break;
-    }
-    case PBVH_FACES: {
-      int mask = typemask & (SCULPT_BOUNDARY_MESH | SCULPT_BOUNDARY_FACE_SET);
-      SculptVertRef v1, v2;
+  return ncache;
+}
 
-      SCULPT_edge_get_verts(ss, edge, &v1, &v2);
+static void neighbor_cache_validate_task_cb(void *__restrict userdata,
+                                            const int n,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SculptThreadedTaskData *data = userdata;
+  SculptSession *ss = data->ob->sculpt;
+  NeighborCache *ncache = ss->cache->ncache;
+  NeighborCacheBlock *block = ncache->blocks + n;
 
-      if (mask) {  // use less accurate approximation for now
-        SculptBoundaryType a = SCULPT_vertex_is_boundary(ss, v1, mask);
-        SculptBoundaryType b = SCULPT_vertex_is_boundary(ss, v2, mask);
+  if (block->state != NCACHE_BLOCK_READY) {
+    return;
+  }
 
-        ret |= a & b;
-      }
+  bool stale = n >= BKE_pbvh_get_totnodes(ss->pbvh);
 
-      if (typemask & SCULPT_BOUNDARY_SHARP) {
-        ret |= ss->medge[edge.i].flag & ME_SHARP ? SCULPT_BOUNDARY_SHARP : 0;
-      }
+  if (!stale) {
+    int uniq_verts;
+    BKE_pbvh_node_num_verts(ss->pbvh, BKE_pbvh_get_node(ss->pbvh, n), &uniq_verts, NULL);
+    stale = uniq_verts != block->totvert;
+  }
 
-      if (typemask & SCULPT_BOUNDARY_SEAM) {
-        ret |= ss->medge[edge.i].flag & ME_SEAM ? SCULPT_BOUNDARY_SEAM : 0;
-      }
+  for (int i = 0; !stale && i < block->totvert; i++) {
+    BMVert *v = (BMVert *)block->verts[i].i;
 
-      break;
+    /* Freed elements stay inside the mempool, so reading the header is safe. */
+    if (v->head.htype != BM_VERT || BM_ELEM_CD_GET_INT(v, ss->cd_vert_node_offset) != n) {
+      stale = true;
     }
-    case PBVH_GRIDS: {
-      // not implemented
-      break;
+    else {
+      MSculptVert *mv = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, v);
+      stale = (mv->flag & SCULPTVERT_NEED_DISK_SORT) != 0;
+    }
+  }
+
+  if (stale) {
+    neighbor_cache_block_free(block);
+  }
+}
+
+static void neighbor_cache_block_slots_task_cb(void *__restrict userdata,
+                                               const int n,
+                                               const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SculptThreadedTaskData *data = userdata;
+  SculptSession *ss = data->ob->sculpt;
+  NeighborCache *ncache = ss->cache->ncache;
+
+  if (ncache->blocks[n].state == NCACHE_BLOCK_READY) {
+    neighbor_cache_block_slots_write(ss, ncache, n);
+  }
+}
+
+static void neighbor_cache_sync_bmesh(Object *ob, NeighborCache *ncache)
+{
+  SculptSession *ss = ob->sculpt;
+  BMesh *bm = ss->bm;
+
+  if (!ncache->topology_changed && bm->totvert == ncache->bm_totvert &&
+      bm->totedge == ncache->bm_totedge) {
+    return;
+  }
+
+  ncache->topology_changed = false;
+  ncache->bm_totvert = bm->totvert;
+  ncache->bm_totedge = bm->totedge;
+
+  BM_mesh_elem_index_ensure(bm, BM_VERT);
+
+  const int totnode = BKE_pbvh_get_totnodes(ss->pbvh);
+  if (totnode > ncache->totblock) {
+    ncache->blocks = MEM_recallocN(ncache->blocks, sizeof(*ncache->blocks) * totnode);
+    ncache->totblock = totnode;
+  }
+
+  if (bm->totvert > ncache->totvert) {
+    MEM_freeN(ncache->vert_slot);
+    ncache->totvert = bm->totvert;
+    ncache->vert_slot = MEM_malloc_arrayN(ncache->totvert, sizeof(*ncache->vert_slot), __func__);
+  }
+  memset(ncache->vert_slot, 0xff, sizeof(*ncache->vert_slot) * ncache->totvert);
+
+  SculptThreadedTaskData data = {
+      .ob = ob,
+  };
+
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, ncache->totblock);
+
+  /* Drop blocks touched by dyntopo, then re-register the surviving blocks under the new vertex
+   * indices. */
+  BLI_task_parallel_range(0, ncache->totblock, &data, neighbor_cache_validate_task_cb, &settings);
+  BLI_task_parallel_range(
+      0, ncache->totblock, &data, neighbor_cache_block_slots_task_cb, &settings);
+}
+
+static void neighbor_cache_build_task_cb(void *__restrict userdata,
+                                         const int n,
+                                         const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SculptThreadedTaskData *data = userdata;
+  SculptSession *ss = data->ob->sculpt;
+  NeighborCache *ncache = ss->cache->ncache;
+  const int ni = BKE_pbvh_get_node_index(ss->pbvh, data->nodes[n]);
+  NeighborCacheBlock *block = ncache->blocks + ni;
+
+  if (atomic_cas_int32(&block->state, NCACHE_BLOCK_EMPTY, NCACHE_BLOCK_BUILDING) !=
+      NCACHE_BLOCK_EMPTY) {
+    return;
+  }
+
+  neighbor_cache_block_build(ss, ncache, ni);
+  atomic_cas_int32(&block->state, NCACHE_BLOCK_BUILDING, NCACHE_BLOCK_READY);
+
+  if (ncache->is_bmesh) {
+    neighbor_cache_block_slots_write(ss, ncache, ni);
+  }
+}
+
+/**
+ * Creates the neighbor cache once a neighbor query asked for it, brings it up to date with
+ * dyntopo changes and builds the blocks of the nodes about to be sculpted.
+ * Must not run concurrently with neighbor queries.
+ */
+static void neighbor_cache_sync(Object *ob, PBVHNode **nodes, int totnode)
+{
+  SculptSession *ss = ob->sculpt;
+  StrokeCache *cache = ss->cache;
+
+  if (cache->ncache && cache->ncache->pbvh != ss->pbvh) {
+    neighbor_cache_free(cache->ncache);
+    cache->ncache = NULL;
+  }
+
+  if (ss->fake_neighbors.use_fake_neighbors) {
+    return;
+  }
+
+  if (!cache->ncache) {
+    if (!cache->ncache_requested) {
+      return;
+    }
+    neighbor_cache_new(ob);
+  }
+  else if (cache->ncache->is_bmesh) {
+    neighbor_cache_sync_bmesh(ob, cache->ncache);
+  }
+
+  SculptThreadedTaskData data = {
+      .ob = ob,
+      .nodes = nodes,
+  };
+
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, totnode);
+  BLI_task_parallel_range(0, totnode, &data, neighbor_cache_build_task_cb, &settings);
+}
+
+/** \} */
+
+void SCULPT_vertex_neighbors_get(const SculptSession *ss,
+                                 const SculptVertRef vertex,
+                                 const bool include_duplicates,
+                                 SculptVertexNeighborIter *iter)
+{
+  if (ss->cache && !ss->fake_neighbors.use_fake_neighbors) {
+    if (ss->cache->ncache) {
+      if (neighbor_cache_get(ss, vertex, include_duplicates, iter)) {
+        return;
+      }
+    }
+    else {
+      /* Picked up by #neighbor_cache_sync on the next brush step. */
+      ss->cache->ncache_requested = true;
+    }
+  }
+
+  sculpt_vertex_neighbors_get_live(ss, vertex, include_duplicates, iter);
+}
+
+SculptBoundaryType SCULPT_edge_is_boundary(const SculptSession *ss,
+                                           const SculptEdgeRef edge,
+                                           SculptBoundaryType typemask)
+{
+
+  int ret = 0;
+
+  switch (BKE_pbvh_type(ss->pbvh)) {
+    case PBVH_BMESH: {
+      BMEdge *e = (BMEdge *)edge.i;
+
+      if (typemask & SCULPT_BOUNDARY_MESH) {
+        ret |= (!e->l || e->l == e->l->radial_next) ? SCULPT_BOUNDARY_MESH : 0;
+      }
+
+      if ((typemask & SCULPT_BOUNDARY_FACE_SET) && e->l && e->l != e->l->radial_next) {
+        if (ss->boundary_symmetry) {
+          // TODO: calc and cache this properly
+          MSculptVert *mv1 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v1);
+          MSculptVert *mv2 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v2);
+
+          bool ok = (mv1->flag & SCULPTVERT_FSET_BOUNDARY) &&
+                    (mv2->flag & SCULPTVERT_FSET_BOUNDARY);
+          ret |= ok ? SCULPT_BOUNDARY_FACE_SET : 0;
+        }
+        else {
+          int fset1 = BM_ELEM_CD_GET_INT(e->l->f, ss->cd_faceset_offset);
+          int fset2 = BM_ELEM_CD_GET_INT(e->l->radial_next->f, ss->cd_faceset_offset);
+
+          bool ok = (fset1 < 0) != (fset2 < 0);
+
+          ok = ok || fset1 != fset2;
+
+          ret |= ok ? SCULPT_BOUNDARY_FACE_SET : 0;
+        }
+      }
+
+      if (typemask & SCULPT_BOUNDARY_UV) {
+        MSculptVert *mv1 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v1);
+        MSculptVert *mv2 = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, e->v2);
+
+        bool ok = (mv1->flag & SCULPTVERT_UV_BOUNDARY) && (mv2->flag & SCULPTVERT_UV_BOUNDARY);
+        ret |= ok ? SCULPT_BOUNDARY_UV : 0;
+      }
+
+      if (typemask & SCULPT_BOUNDARY_SHARP) {
+        ret |= !BM_elem_flag_test(e, BM_ELEM_SMOOTH) ? SCULPT_BOUNDARY_SHARP : 0;
+      }
+
+      if (typemask & SCULPT_BOUNDARY_SEAM) {
+        ret |= BM_elem_flag_test(e, BM_ELEM_SEAM) ? SCULPT_BOUNDARY_SEAM : 0;
+      }
+
+      break;
+    }
+    case PBVH_FACES: {
+      int mask = typemask & (SCULPT_BOUNDARY_MESH | SCULPT_BOUNDARY_FACE_SET);
+      SculptVertRef v1, v2;
+
+      SCULPT_edge_get_verts(ss, edge, &v1, &v2);
+
+      if (mask) {  // use less accurate approximation for now
+        SculptBoundaryType a = SCULPT_vertex_is_boundary(ss, v1, mask);
+        SculptBoundaryType b = SCULPT_vertex_is_boundary(ss, v2, mask);
+
+        ret |= a & b;
+      }
+
+      if (typemask & SCULPT_BOUNDARY_SHARP) {
+        ret |= ss->medge[edge.i].flag & ME_SHARP ? SCULPT_BOUNDARY_SHARP : 0;
+      }
+
+      if (typemask & SCULPT_BOUNDARY_SEAM) {
+        ret |= ss->medge[edge.i].flag & ME_SEAM ? SCULPT_BOUNDARY_SEAM : 0;
+      }
+
+      break;
+    }
+    case PBVH_GRIDS: {
+      // not implemented
+      break;
     }
   }
 
@@ -3014,7 +3423,8 @@ bool SCULPT_vertex_check_origdata(SculptSession *ss, SculptVertRef vertex)
     copy_v3_v3(mv->origco, SCULPT_vertex_co_get(ss, vertex));
     SCULPT_vertex_normal_get(ss, vertex, mv->origno);
 
-    SCULPT_vertex_color_get(ss, vertex, mv->origcolor);
+    SCULPT_vertex_color_get(
+        ss, vertex, SCULPT_vertex_get_sculptvert_cold(ss, vertex)->origcolor);
 
     mv->origmask = unit_float_to_ushort_clamp(SCULPT_vertex_mask_get(ss, vertex));
 
@@ -3041,7 +3451,7 @@ void SCULPT_orig_vert_data_update(SculptOrigVertData *orig_data, SculptVertRef v
     orig_data->co = mv->origco;
   }
   else if (orig_data->datatype == SCULPT_UNDO_COLOR) {
-    orig_data->col = mv->origcolor;
+    orig_data->col = SCULPT_vertex_get_sculptvert_cold(orig_data->ss, vertex)->origcolor;
   }
   else if (orig_data->datatype == SCULPT_UNDO_MASK) {
     orig_data->mask = (float)mv->origmask / 65535.0f;
@@ -3131,11 +3541,13 @@ static void paint_mesh_restore_co_task_cb(void *__restrict userdata,
       float color[4];
 
       if (SCULPT_vertex_color_get(ss, vd.vertex, color)) {
-        if (len_squared_v4v4(color, mv->origcolor) > FLT_EPSILON) {
+        const float *origcolor = SCULPT_vertex_get_sculptvert_cold(ss, vd.vertex)->origcolor;
+
+        if (len_squared_v4v4(color, origcolor) > FLT_EPSILON) {
           modified = true;
         }
 
-        SCULPT_vertex_color_set(ss, vd.vertex, mv->origcolor);
+        SCULPT_vertex_color_set(ss, vd.vertex, origcolor);
       }
     }
 
@@ -4108,15 +4520,11 @@ static float brush_strength(const Sculpt *sd,
   }
 }
 
-float SCULPT_brush_strength_factor(SculptSession *ss,
-                                   const Brush *br,
-                                   const float brush_point[3],
-                                   const float len,
-                                   const float vno[3],
-                                   const float fno[3],
-                                   const float mask,
-                                   const SculptVertRef vertex_index,
-                                   const int thread_id)
+/* Strength of the brush texture at `brush_point`, 1.0 when the brush has no texture. */
+static float sculpt_brush_texture_factor(SculptSession *ss,
+                                         const Brush *br,
+                                         const float brush_point[3],
+                                         const int thread_id)
 {
   StrokeCache *cache = ss->cache;
   const Scene *scene = cache->vc->scene;
@@ -4177,20 +4585,39 @@ float SCULPT_brush_strength_factor(SculptSession *ss,
     }
   }
 
-  /* Hardness. */
-  float final_len = len;
-  const float hardness = cache->paint_brush.hardness;
-  float p = len / cache->radius;
+  return avg;
+}
+
+/* Distance fed into the falloff curve, with the brush hardness applied. */
+BLI_INLINE float sculpt_brush_hardness_len(const float radius, const float hardness, float len)
+{
+  float p = len / radius;
   if (p < hardness) {
-    final_len = 0.0f;
-  }
-  else if (hardness == 1.0f) {
-    final_len = cache->radius;
+    return 0.0f;
   }
-  else {
-    p = (p - hardness) / (1.0f - hardness);
-    final_len = p * cache->radius;
+  if (hardness == 1.0f) {
+    return radius;
   }
+  p = (p - hardness) / (1.0f - hardness);
+  return p * radius;
+}
+
+float SCULPT_brush_strength_factor(SculptSession *ss,
+                                   const Brush *br,
+                                   const float brush_point[3],
+                                   const float len,
+                                   const float vno[3],
+                                   const float fno[3],
+                                   const float mask,
+                                   const SculptVertRef vertex_index,
+                                   const int thread_id)
+{
+  StrokeCache *cache = ss->cache;
+  float avg = sculpt_brush_texture_factor(ss, br, brush_point, thread_id);
+
+  /* Hardness. */
+  const float final_len = sculpt_brush_hardness_len(
+      cache->radius, cache->paint_brush.hardness, len);
 
   /* Falloff curve. */
   avg *= BKE_brush_curve_strength(br, final_len, cache->radius);
@@ -4205,6 +4632,94 @@ float SCULPT_brush_strength_factor(SculptSession *ss,
   return avg;
 }
 
+/* Square root of the distances followed by #sculpt_brush_hardness_len. */
+static void sculpt_brush_batch_hardness_len(const float radius,
+                                            const float hardness,
+                                            const float *dist_sq,
+                                            float *r_len,
+                                            const int count)
+{
+  int i = 0;
+
+#ifdef BLI_HAVE_SSE2
+  const __m128 radius4 = _mm_set1_ps(radius);
+  const __m128 hardness4 = _mm_set1_ps(hardness);
+  const __m128 hardness_range = _mm_set1_ps(1.0f - hardness);
+
+  for (; i + 4 <= count; i += 4) {
+    const __m128 len = _mm_sqrt_ps(_mm_loadu_ps(dist_sq + i));
+    const __m128 p = _mm_div_ps(len, radius4);
+    const __m128 is_hard = _mm_cmplt_ps(p, hardness4);
+    __m128 final_len = radius4;
+
+    if (hardness != 1.0f) {
+      final_len = _mm_mul_ps(_mm_div_ps(_mm_sub_ps(p, hardness4), hardness_range), radius4);
+    }
+
+    _mm_storeu_ps(r_len + i, _mm_andnot_ps(is_hard, final_len));
+  }
+#endif
+
+  for (; i < count; i++) {
+    r_len[i] = sculpt_brush_hardness_len(radius, hardness, sqrtf(dist_sq[i]));
+  }
+}
+
+static void sculpt_brush_batch_apply_mask(float *fade, const float *mask, const int count)
+{
+  int i = 0;
+
+#ifdef BLI_HAVE_SSE2
+  const __m128 one = _mm_set1_ps(1.0f);
+
+  for (; i + 4 <= count; i += 4) {
+    const __m128 factor = _mm_sub_ps(one, _mm_loadu_ps(mask + i));
+    _mm_storeu_ps(fade + i, _mm_mul_ps(_mm_loadu_ps(fade + i), factor));
+  }
+#endif
+
+  for (; i < count; i++) {
+    fade[i] *= 1.0f - mask[i];
+  }
+}
+
+void SCULPT_brush_strength_factor_batch(SculptSession *ss,
+                                        const Brush *br,
+                                        SculptBrushBatch *batch,
+                                        const int thread_id)
+{
+  StrokeCache *cache = ss->cache;
+  const int totvert = batch->totvert;
+  float *fade = batch->fade;
+
+  /* Hardness and falloff curve, vectorized. */
+  sculpt_brush_batch_hardness_len(
+      cache->radius, cache->paint_brush.hardness, batch->dist_sq, fade, totvert);
+  BKE_brush_curve_strength_array(br->curve_preset, br->curve, fade, cache->radius, totvert, fade);
+
+  /* Texture sampling, front-face and auto-masking stay per vertex, they are skipped entirely
+   * when disabled since their factor is 1.0 then. */
+  if (br->mtex.tex) {
+    for (int i = 0; i < totvert; i++) {
+      fade[i] = sculpt_brush_texture_factor(ss, br, batch->co[i], thread_id) * fade[i];
+    }
+  }
+
+  if (br->flag & BRUSH_FRONTFACE) {
+    for (int i = 0; i < totvert; i++) {
+      fade[i] *= frontface(br, cache->view_normal, batch->no[i], batch->fno[i]);
+    }
+  }
+
+  sculpt_brush_batch_apply_mask(fade, batch->mask, totvert);
+
+  if (cache->automasking) {
+    for (int i = 0; i < totvert; i++) {
+      fade[i] *= SCULPT_automasking_factor_get(cache->automasking, ss, batch->vertex[i]);
+    }
+  }
+}
+
 float SCULPT_brush_strength_factor_pbr_channels(SculptSession *ss,
                                                 const Brush *br,
                                                 const float brush_point[3],
@@ -5145,6 +5660,10 @@ static void sculpt_topology_update(Sculpt *sd,
 
   SCULPT_dyntopo_automasking_end(mask_cb_data);
 
+  if (modified && ss->cache->ncache) {
+    ss->cache->ncache->topology_changed = true;
+  }
+
   if (actv != -1) {
     BMVert *v = (BMVert *)BM_ELEM_FROM_ID_SAFE(ss->bm, actv);
 
@@ -5394,6 +5913,9 @@ void do_brush_action(
   if (totnode == 0) {
     return;
   }
+
+  neighbor_cache_sync(ob, nodes, totnode);
+
   float location[3];
 
   // dyntopo can't push undo nodes inside a thread
@@ -6990,15 +7512,15 @@ static const char *sculpt_tool_name(Sculpt *sd)
 
 void SCULPT_cache_free(SculptSession *ss, Object *ob, StrokeCache *cache)
 {
+  SCULPT_replay_log_cache_free(cache);
+
   MEM_SAFE_FREE(cache->dial);
   MEM_SAFE_FREE(cache->surface_smooth_laplacian_disp);
 
-#ifdef SCULPT_NEIGHBORS_CACHE
-  if (ss->cache->ncache) {
-    neighbor_cache_free(ss->cache->ncache);
-    ss->cache->ncache = NULL;
+  if (cache->ncache) {
+    neighbor_cache_free(cache->ncache);
+    cache->ncache = NULL;
   }
-#endif
 
   if (ss->custom_layers[SCULPT_SCL_LAYER_DISP]) {
     SCULPT_attr_release_layer(ss, ob, ss->custom_layers[SCULPT_SCL_LAYER_DISP]);
@@ -7180,8 +7702,78 @@ int SCULPT_get_tool(const SculptSession *ss, const Brush *br)
   return br->sculpt_tool;
 }
 
-/* Initialize the stroke cache invariants from operator properties. */
-static void sculpt_update_cache_invariants(
+/* View dependent and brush dependent invariants, shared by the stroke operator and headless
+ * stroke replay. Expects cache->vc and cache->brush to be set. */
+static void sculpt_update_cache_view_invariants(Sculpt *sd,
+                                                SculptSession *ss,
+                                                Object *ob,
+                                                Brush *brush,
+                                                BrushChannelSet *channels)
+{
+  StrokeCache *cache = ss->cache;
+  float mat[3][3];
+  float viewDir[3] = {0.0f, 0.0f, 1.0f};
+
+  /* Cache projection matrix. */
+  ED_view3d_ob_project_mat_get(cache->vc->rv3d, ob, cache->projection_mat);
+
+  invert_m4_m4(ob->imat, ob->obmat);
+  copy_m3_m4(mat, cache->vc->rv3d->viewinv);
+  mul_m3_v3(mat, viewDir);
+  copy_m3_m4(mat, ob->imat);
+  mul_m3_v3(mat, viewDir);
+  normalize_v3_v3(cache->true_view_normal, viewDir);
+
+  copy_v3_v3(cache->true_view_origin, cache->vc->rv3d->viewinv[3]);
+
+  cache->supports_gravity = (!ELEM(SCULPT_get_tool(ss, brush),
+                                   SCULPT_TOOL_MASK,
+                                   SCULPT_TOOL_SMOOTH,
+                                   SCULPT_TOOL_SIMPLIFY,
+                                   SCULPT_TOOL_DISPLACEMENT_SMEAR,
+                                   SCULPT_TOOL_DISPLACEMENT_ERASER) &&
+                             (sd->gravity_factor > 0.0f));
+  /* Get gravity vector in world space. */
+  if (cache->supports_gravity) {
+    if (sd->gravity_object) {
+      Object *gravity_object = sd->gravity_object;
+
+      copy_v3_v3(cache->true_gravity_direction, gravity_object->obmat[2]);
+    }
+    else {
+      cache->true_gravity_direction[0] = cache->true_gravity_direction[1] = 0.0f;
+      cache->true_gravity_direction[2] = 1.0f;
+    }
+
+    /* Transform to sculpted object space. */
+    mul_m3_v3(mat, cache->true_gravity_direction);
+    normalize_v3(cache->true_gravity_direction);
+  }
+
+  /* Make copies of the mesh vertex locations and normals for some tools. */
+  if (brush->flag & BRUSH_ANCHORED) {
+    cache->original = true;
+  }
+
+  /* Draw sharp does not need the original coordinates to produce the accumulate effect, so it
+   * should work the opposite way. */
+  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_DRAW_SHARP) {
+    cache->original = true;
+  }
+
+  if (SCULPT_TOOL_HAS_ACCUMULATE(SCULPT_get_tool(ss, brush))) {
+    if (!(BRUSHSET_GET_INT(channels, accumulate, &ss->cache->input_mapping))) {
+      cache->original = true;
+      if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_DRAW_SHARP) {
+        cache->original = false;
+      }
+    }
+  }
+
+  cache->first_time = true;
+}
+
+static void sculpt_update_cache_invariants(
     bContext *C, Sculpt *sd, SculptSession *ss, wmOperator *op, const float mouse[2])
 {
   StrokeCache *cache = MEM_callocN(sizeof(StrokeCache), "stroke cache");
@@ -7189,8 +7781,6 @@ static void sculpt_update_cache_invariants(
   Brush *brush = BKE_paint_brush(&sd->paint);
   ViewContext *vc = paint_stroke_view_context(op->customdata);
   Object *ob = CTX_data_active_object(C);
-  float mat[3][3];
-  float viewDir[3] = {0.0f, 0.0f, 1.0f};
   float max_scale;
   int mode;
 
@@ -7321,70 +7911,59 @@ static void sculpt_update_cache_invariants(
   cache->vc = vc;
   cache->brush = brush;
 
-  /* Cache projection matrix. */
-  ED_view3d_ob_project_mat_get(cache->vc->rv3d, ob, cache->projection_mat);
+  sculpt_update_cache_view_invariants(sd, ss, ob, brush, channels);
 
-  invert_m4_m4(ob->imat, ob->obmat);
-  copy_m3_m4(mat, cache->vc->rv3d->viewinv);
-  mul_m3_v3(mat, viewDir);
-  copy_m3_m4(mat, ob->imat);
-  mul_m3_v3(mat, viewDir);
-  normalize_v3_v3(cache->true_view_normal, viewDir);
-
-  copy_v3_v3(cache->true_view_origin, cache->vc->rv3d->viewinv[3]);
+#define PIXEL_INPUT_THRESHHOLD 5
+  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_ROTATE) {
+    cache->dial = BLI_dial_init(cache->initial_mouse, PIXEL_INPUT_THRESHHOLD);
+  }
 
-  cache->supports_gravity = (!ELEM(SCULPT_get_tool(ss, brush),
-                                   SCULPT_TOOL_MASK,
-                                   SCULPT_TOOL_SMOOTH,
-                                   SCULPT_TOOL_SIMPLIFY,
-                                   SCULPT_TOOL_DISPLACEMENT_SMEAR,
-                                   SCULPT_TOOL_DISPLACEMENT_ERASER) &&
-                             (sd->gravity_factor > 0.0f));
-  /* Get gravity vector in world space. */
-  if (cache->supports_gravity) {
-    if (sd->gravity_object) {
-      Object *gravity_object = sd->gravity_object;
+#undef PIXEL_INPUT_THRESHHOLD
+}
 
-      copy_v3_v3(cache->true_gravity_direction, gravity_object->obmat[2]);
-    }
-    else {
-      cache->true_gravity_direction[0] = cache->true_gravity_direction[1] = 0.0f;
-      cache->true_gravity_direction[2] = 1.0f;
-    }
+/**
+ * Allocates ss->cache for a stroke that is driven without an operator, as done by batch
+ * stroke replay. Only the invariants that don't depend on the operator or the window manager
+ * are initialized, per-step input is filled in by the caller.
+ */
+StrokeCache *SCULPT_stroke_cache_headless_create(Sculpt *sd,
+                                                 Object *ob,
+                                                 Brush *brush,
+                                                 ViewContext *vc)
+{
+  SculptSession *ss = ob->sculpt;
+  StrokeCache *cache = MEM_callocN(sizeof(StrokeCache), "stroke cache");
+  float max_scale = 0.0f;
 
-    /* Transform to sculpted object space. */
-    mul_m3_v3(mat, cache->true_gravity_direction);
-    normalize_v3(cache->true_gravity_direction);
+  if (!sd->channels) {
+    BKE_brush_init_toolsettings(sd);
   }
 
-  /* Make copies of the mesh vertex locations and normals for some tools. */
-  if (brush->flag & BRUSH_ANCHORED) {
-    cache->original = true;
-  }
+  ss->cache = cache;
+  cache->vc = vc;
+  cache->brush = brush;
 
-  /* Draw sharp does not need the original coordinates to produce the accumulate effect, so it
-   * should work the opposite way. */
-  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_DRAW_SHARP) {
-    cache->original = true;
+  for (int i = 0; i < 3; i++) {
+    max_scale = max_ff(max_scale, fabsf(ob->scale[i]));
   }
+  cache->scale[0] = max_scale / ob->scale[0];
+  cache->scale[1] = max_scale / ob->scale[1];
+  cache->scale[2] = max_scale / ob->scale[2];
 
-  if (SCULPT_TOOL_HAS_ACCUMULATE(SCULPT_get_tool(ss, brush))) {
-    if (!(BRUSHSET_GET_INT(channels, accumulate, &ss->cache->input_mapping))) {
-      cache->original = true;
-      if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_DRAW_SHARP) {
-        cache->original = false;
-      }
-    }
-  }
+  float plane_trim = BRUSHSET_GET_FINAL_FLOAT(sd->channels, brush->channels, plane_trim, NULL);
+  cache->plane_trim_squared = plane_trim * plane_trim;
 
-  cache->first_time = true;
+  sculpt_init_mirror_clipping(ob, ss);
 
-#define PIXEL_INPUT_THRESHHOLD 5
-  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_ROTATE) {
-    cache->dial = BLI_dial_init(cache->initial_mouse, PIXEL_INPUT_THRESHHOLD);
+  for (int i = 0; i < SCULPT_SPEED_MA_SIZE; i++) {
+    cache->speed_avg[i] = -1.0f;
   }
 
-#undef PIXEL_INPUT_THRESHHOLD
+  cache->normal_weight = brush->normal_weight;
+
+  sculpt_update_cache_view_invariants(sd, ss, ob, brush, brush->channels);
+
+  return cache;
 }
 
 static float sculpt_brush_dynamic_size_get(Brush *brush, StrokeCache *cache, float initial_size)
@@ -8645,18 +9224,15 @@ static void sculpt_cache_dyntopo_settings(BrushChannelSet *chset,
   r_settings->constant_detail = BRUSHSET_GET_FLOAT(chset, dyntopo_constant_detail, input_data);
 };
 
-static void sculpt_stroke_update_step(bContext *C,
-                                      wmOperator *UNUSED(op),
-                                      struct PaintStroke *stroke,
-                                      PointerRNA *itemptr)
-
+/* Builds the final channel set for this step and loads it into the brush and unified settings.
+ * Shared by the interactive stroke and headless replay. */
+static void sculpt_stroke_channels_update(Sculpt *sd,
+                                          Object *ob,
+                                          Brush *brush,
+                                          UnifiedPaintSettings *ups,
+                                          struct PaintStroke *stroke)
 {
-
-  UnifiedPaintSettings *ups = &CTX_data_tool_settings(C)->unified_paint_settings;
-  Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
-  Object *ob = CTX_data_active_object(C);
   SculptSession *ss = ob->sculpt;
-  Brush *brush = BKE_paint_brush(&sd->paint);
 
   if (ss->cache->channels_final) {
     BKE_brush_channelset_free(ss->cache->channels_final);
@@ -8735,16 +9311,16 @@ static void sculpt_stroke_update_step(bContext *C,
   sculpt_cache_dyntopo_settings(ss->cache->channels_final,
                                 &brush->cached_dyntopo,
                                 ss->cache ? &ss->cache->input_mapping : NULL);
+}
 
-  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_SCENE_PROJECT) {
-    SCULPT_stroke_cache_snap_context_init(C, ob);
-  }
-
-  SCULPT_stroke_modifiers_check(C, ob, brush);
-  if (itemptr) {
-    sculpt_update_cache_variants(C, sd, ob, itemptr);
-  }
-  sculpt_restore_mesh(CTX_data_scene(C), sd, ob);
+/* Sets up symmetry and dyntopo detail for this step and runs the brush (or its command list)
+ * over all symmetry passes. Returns true if the brush went through a command list. */
+static bool sculpt_stroke_step_apply(Sculpt *sd,
+                                     Object *ob,
+                                     Brush *brush,
+                                     UnifiedPaintSettings *ups)
+{
+  SculptSession *ss = ob->sculpt;
 
   int boundsym = BKE_get_fset_boundary_symflag(ob);
   ss->cache->boundary_symmetry = boundsym;
@@ -8753,7 +9329,6 @@ static void sculpt_stroke_update_step(bContext *C,
   if (ss->pbvh) {
     BKE_pbvh_set_symmetry(ss->pbvh, SCULPT_mesh_symmetry_xyz_get(ob), boundsym);
   }
-
   int detail_mode = SCULPT_get_int(ss, dyntopo_detail_mode, sd, brush);
 
   float detail_size = SCULPT_get_float(ss, dyntopo_detail_size, sd, brush);
@@ -8824,22 +9399,13 @@ static void sculpt_stroke_update_step(bContext *C,
     do_symmetrical_brush_actions(sd, ob, do_brush_action, ups, NULL);
   }
 
-  if (ss->needs_pbvh_rebuild) {
-    /* The mesh was modified, rebuild the PBVH. */
-    BKE_particlesystem_reset_all(ob);
-    BKE_ptcache_object_reset(CTX_data_scene(C), ob, PTCACHE_RESET_OUTDATED);
-
-    DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
-    BKE_scene_graph_update_tagged(CTX_data_ensure_evaluated_depsgraph(C), CTX_data_main(C));
-    SCULPT_pbvh_clear(ob);
-    Depsgraph *depsgraph = CTX_data_ensure_evaluated_depsgraph(C);
-    BKE_sculpt_update_object_for_edit(depsgraph, ob, true, false, false);
+  return run_commandlist;
+}
 
-    if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_ARRAY) {
-      SCULPT_tag_update_overlays(C);
-    }
-    ss->needs_pbvh_rebuild = false;
-  }
+/* Merges proxies and flushes deformation/shape-key data after the brush has run. */
+static void sculpt_stroke_step_finish(Sculpt *sd, Object *ob, Brush *brush, bool run_commandlist)
+{
+  SculptSession *ss = ob->sculpt;
 
   if (!run_commandlist) {
     sculpt_combine_proxies(sd, ob);
@@ -8871,6 +9437,53 @@ static void sculpt_stroke_update_step(bContext *C,
 
   ss->cache->first_time = false;
   copy_v3_v3(ss->cache->true_last_location, ss->cache->true_location);
+}
+
+static void sculpt_stroke_update_step(bContext *C,
+                                      wmOperator *UNUSED(op),
+                                      struct PaintStroke *stroke,
+                                      PointerRNA *itemptr)
+
+{
+
+  UnifiedPaintSettings *ups = &CTX_data_tool_settings(C)->unified_paint_settings;
+  Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
+  Object *ob = CTX_data_active_object(C);
+  SculptSession *ss = ob->sculpt;
+  Brush *brush = BKE_paint_brush(&sd->paint);
+
+  sculpt_stroke_channels_update(sd, ob, brush, ups, stroke);
+
+  if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_SCENE_PROJECT) {
+    SCULPT_stroke_cache_snap_context_init(C, ob);
+  }
+
+  SCULPT_stroke_modifiers_check(C, ob, brush);
+  if (itemptr) {
+    sculpt_update_cache_variants(C, sd, ob, itemptr);
+  }
+  sculpt_restore_mesh(CTX_data_scene(C), sd, ob);
+
+  bool run_commandlist = sculpt_stroke_step_apply(sd, ob, brush, ups);
+
+  if (ss->needs_pbvh_rebuild) {
+    /* The mesh was modified, rebuild the PBVH. */
+    BKE_particlesystem_reset_all(ob);
+    BKE_ptcache_object_reset(CTX_data_scene(C), ob, PTCACHE_RESET_OUTDATED);
+
+    DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+    BKE_scene_graph_update_tagged(CTX_data_ensure_evaluated_depsgraph(C), CTX_data_main(C));
+    SCULPT_pbvh_clear(ob);
+    Depsgraph *depsgraph = CTX_data_ensure_evaluated_depsgraph(C);
+    BKE_sculpt_update_object_for_edit(depsgraph, ob, true, false, false);
+
+    if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_ARRAY) {
+      SCULPT_tag_update_overlays(C);
+    }
+    ss->needs_pbvh_rebuild = false;
+  }
+
+  sculpt_stroke_step_finish(sd, ob, brush, run_commandlist);
 
   /* Cleanup. */
   if (SCULPT_get_tool(ss, brush) == SCULPT_TOOL_MASK) {
@@ -8884,6 +9497,51 @@ static void sculpt_stroke_update_step(bContext *C,
   }
 }
 
+/**
+ * Runs one brush step without a #bContext, used by batch stroke replay.
+ *
+ * The caller owns ss->cache and is expected to have filled in the per-step input
+ * (location, pressure, input mapping, symmetry) and a #ViewContext in cache->vc.
+ * Window-manager side effects (redraw tagging, snapping to other objects) are skipped.
+ */
+void SCULPT_stroke_step_headless(Main *bmain,
+                                 Depsgraph *depsgraph,
+                                 Scene *scene,
+                                 Sculpt *sd,
+                                 Object *ob,
+                                 UnifiedPaintSettings *ups,
+                                 struct PaintStroke *stroke)
+{
+  SculptSession *ss = ob->sculpt;
+  Brush *brush = BKE_paint_brush(&sd->paint);
+
+  sculpt_stroke_channels_update(sd, ob, brush, ups, stroke);
+  sculpt_restore_mesh(scene, sd, ob);
+
+  bool run_commandlist = sculpt_stroke_step_apply(sd, ob, brush, ups);
+
+  if (ss->needs_pbvh_rebuild) {
+    BKE_particlesystem_reset_all(ob);
+    BKE_ptcache_object_reset(scene, ob, PTCACHE_RESET_OUTDATED);
+
+    DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+    BKE_scene_graph_update_tagged(depsgraph, bmain);
+    SCULPT_pbvh_clear(ob);
+    BKE_sculpt_update_object_for_edit(depsgraph, ob, true, false, false);
+
+    ss->needs_pbvh_rebuild = false;
+  }
+
+  sculpt_stroke_step_finish(sd, ob, brush, run_commandlist);
+
+  if (ss->multires.modifier) {
+    multires_mark_as_modified(depsgraph, ob, MULTIRES_COORDS_MODIFIED);
+  }
+
+  BKE_pbvh_update_bounds(ss->pbvh, PBVH_UpdateBB);
+  SCULPT_update_object_bounding_box(ob);
+}
+
 static void sculpt_brush_exit_tex(Sculpt *sd)
 {
   Brush *brush = BKE_paint_brush(&sd->paint);
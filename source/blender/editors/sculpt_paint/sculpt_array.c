@@ -64,6 +64,7 @@
 
 static const char array_symmetry_pass_cd_name[] = "v_symmetry_pass";
 static const char array_instance_cd_name[] = "v_array_instance";
+static const char array_source_cd_name[] = "v_array_source";
 
 #define ARRAY_INSTANCE_ORIGINAL -1
 
@@ -94,10 +95,16 @@ static void sculpt_array_datalayers_init(Object *ob, SculptArray *array, SculptS
     array->scl_sym = MEM_callocN(sizeof(SculptCustomLayer), __func__);
   }
 
+  if (!array->scl_src) {
+    array->scl_src = MEM_callocN(sizeof(SculptCustomLayer), __func__);
+  }
+
   SCULPT_attr_ensure_layer(
       ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_instance_cd_name, &params);
   SCULPT_attr_ensure_layer(
       ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_symmetry_pass_cd_name, &params);
+  SCULPT_attr_ensure_layer(
+      ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_source_cd_name, &params);
 
   SCULPT_attr_get_layer(
       ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_instance_cd_name, array->scl_inst, &params);
@@ -108,6 +115,8 @@ static void sculpt_array_datalayers_init(Object *ob, SculptArray *array, SculptS
                               array_symmetry_pass_cd_name,
                               array->scl_sym,
                               &params);
+  SCULPT_attr_get_layer(
+      ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_source_cd_name, array->scl_src, &params);
 }
 
 static void sculpt_array_datalayers_add(SculptArray *array, SculptSession *ss, Mesh *mesh)
@@ -123,6 +132,7 @@ static void sculpt_array_datalayers_add(SculptArray *array, SculptSession *ss, M
 
     *(int *)SCULPT_attr_vertex_data(vertex, scl) = ARRAY_INSTANCE_ORIGINAL;
     *(int *)SCULPT_attr_vertex_data(vertex, array->scl_sym) = 0;
+    *(int *)SCULPT_attr_vertex_data(vertex, array->scl_src) = ARRAY_INSTANCE_ORIGINAL;
   }
 }
 
@@ -182,10 +192,17 @@ void SCULPT_array_datalayers_free(SculptArray *array, Object *ob)
     SCULPT_attr_release_layer(ss, ob, array->scl_sym);
   }
 
+  if (array->scl_src) {
+    SCULPT_attr_get_layer(
+        ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_source_cd_name, array->scl_src, &params);
+    SCULPT_attr_release_layer(ss, ob, array->scl_src);
+  }
+
   SCULPT_update_customdata_refs(ss, ob);
 
   array->scl_inst = NULL;
   array->scl_sym = NULL;
+  array->scl_src = NULL;
 
 #if 0
   // Mesh *mesh = BKE_object_get_original_mesh(ob);
@@ -312,6 +329,11 @@ void sculpt_array_source_datalayer_update(BMesh *bm, const int symm_pass, const
   const int cd_array_symm_pass_offset = CustomData_get_n_offset(
       &bm->vdata, CD_PROP_INT32, cd_array_symm_pass_index);
 
+  const int cd_array_source_index = CustomData_get_named_layer_index(
+      &bm->vdata, CD_PROP_INT32, array_source_cd_name);
+  const int cd_array_source_offset = CustomData_get_n_offset(
+      &bm->vdata, CD_PROP_INT32, cd_array_source_index);
+
   BM_mesh_elem_table_ensure(bm, BM_VERT);
   BM_mesh_elem_index_ensure(bm, BM_VERT);
 
@@ -320,6 +342,7 @@ void sculpt_array_source_datalayer_update(BMesh *bm, const int symm_pass, const
   BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
     BM_ELEM_CD_SET_INT(v, cd_array_instance_offset, copy_index);
     BM_ELEM_CD_SET_INT(v, cd_array_symm_pass_offset, symm_pass);
+    BM_ELEM_CD_SET_INT(v, cd_array_source_offset, BM_elem_index_get(v));
   }
 }
 
@@ -362,15 +385,19 @@ static void sculpt_array_ensure_geometry_indices(Object *ob, SculptArray *array)
                               array_symmetry_pass_cd_name,
                               array->scl_sym,
                               &params);
+  SCULPT_attr_get_layer(
+      ss, ob, ATTR_DOMAIN_POINT, CD_PROP_INT32, array_source_cd_name, array->scl_src, &params);
 
   array->copy_index = MEM_malloc_arrayN(totvert, sizeof(int), "array copy index");
   array->symmetry_pass = MEM_malloc_arrayN(totvert, sizeof(int), "array symmetry pass index");
+  array->source_index = MEM_malloc_arrayN(totvert, sizeof(int), "array source index");
 
   for (int i = 0; i < totvert; i++) {
     SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
 
     array->copy_index[i] = *(int *)SCULPT_attr_vertex_data(vertex, array->scl_inst);
     array->symmetry_pass[i] = *(int *)SCULPT_attr_vertex_data(vertex, array->scl_sym);
+    array->source_index[i] = *(int *)SCULPT_attr_vertex_data(vertex, array->scl_src);
   }
 
   SCULPT_array_datalayers_free(array, ob);
@@ -389,6 +416,20 @@ static void sculpt_array_mesh_build(Sculpt *sd, Object *ob, SculptArray *array)
 
   BMesh *srcbm = sculpt_array_source_build(ob, brush, array);
 
+  /* All copies are instances of the source geometry, so its positions are only stored once. The
+   * copies index into them using the source vertex index. */
+  BM_mesh_elem_index_ensure(srcbm, BM_VERT);
+  MEM_SAFE_FREE(array->source_co);
+  array->source_totvert = srcbm->totvert;
+  array->source_co = MEM_malloc_arrayN(srcbm->totvert, sizeof(float[3]), "array source co");
+
+  BMVert *v;
+  BMIter iter;
+  int i;
+  BM_ITER_MESH_INDEX (v, &iter, srcbm, BM_VERTS_OF_MESH, i) {
+    copy_v3_v3(array->source_co[i], v->co);
+  }
+
   BMesh *destbm;
   const BMAllocTemplate allocsizeb = BMALLOC_TEMPLATE_FROM_ME(sculpt_mesh);
 
@@ -476,6 +517,8 @@ static void sculpt_array_cache_free(SculptArray *array)
   }
   MEM_freeN(array->copy_index);
   MEM_freeN(array->symmetry_pass);
+  MEM_SAFE_FREE(array->source_index);
+  MEM_SAFE_FREE(array->source_co);
   MEM_freeN(array);
 }
 
@@ -673,9 +716,14 @@ static void sculpt_array_update(Object *ob, Brush *brush, SculptArray *array)
     if (array->copies[symm_pass] == NULL) {
       continue;
     }
+    float source_origin_symm[3];
+    flip_v3_v3(source_origin_symm, array->source_origin, symm_pass);
+
     for (int copy_index = 0; copy_index < array->num_copies; copy_index++) {
       SculptArrayCopy *copy = &array->copies[symm_pass][copy_index];
       invert_m4_m4(copy->imat, copy->mat);
+      mul_m4_m4m4(copy->deform_mat, copy->mat, array->source_imat);
+      add_v3_v3(copy->deform_mat[3], source_origin_symm);
     }
   }
 }
@@ -702,13 +750,10 @@ static void do_array_deform_task_cb_ex(void *__restrict userdata,
 
     SculptArrayCopy *copy = &array->copies[array_symm_pass][array_index];
 
-    float co[3];
-    copy_v3_v3(co, array->orco[vd.index]);
-    mul_v3_m4v3(co, array->source_imat, array->orco[vd.index]);
-    mul_v3_m4v3(co, copy->mat, co);
-    float source_origin_symm[3];
-    flip_v3_v3(source_origin_symm, array->source_origin, array_symm_pass);
-    add_v3_v3v3(vd.co, co, source_origin_symm);
+    /* Coordinates stored by tweaking the array take precedence over the source geometry. */
+    const float *co = array->orco ? array->orco[vd.index] :
+                                    array->source_co[array->source_index[vd.index]];
+    mul_v3_m4v3(vd.co, copy->deform_mat, co);
 
     any_modified = true;
 
@@ -997,7 +1042,9 @@ void SCULPT_do_array_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
       }
       array->initial_radial_angle = array->radial_angle;
 
-      /* Update Geometry Orco. */
+      /* Update Geometry Orco. Copies may have been sculpted since the array was created, so they
+       * stop being instances of the source geometry from here. */
+      sculpt_array_ensure_original_coordinates(ob, array);
       for (int i = 0; i < totvert; i++) {
         SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
 
@@ -1094,7 +1141,6 @@ void SCULPT_do_array_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
   SCULPT_vertex_random_access_ensure(ss);
 
   sculpt_array_ensure_base_transform(sd, ob, ss->array);
-  sculpt_array_ensure_original_coordinates(ob, ss->array);
   sculpt_array_ensure_geometry_indices(ob, ss->array);
 
   sculpt_array_stroke_sample_add(ob, ss->array);
@@ -9,6 +9,7 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_hash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
 #include "BLI_task.h"
 
@@ -251,18 +252,26 @@ float SCULPT_automasking_factor_get(AutomaskingCache *automasking,
   return mask;
 }
 
-void SCULPT_automasking_cache_free(SculptSession *ss, Object *ob, AutomaskingCache *automasking)
+static void sculpt_automasking_layer_free(SculptSession *ss, Object *ob)
 {
-  if (!automasking) {
-    return;
-  }
-
   if (ss->custom_layers[SCULPT_SCL_AUTOMASKING]) {
     SCULPT_attr_release_layer(ss, ob, ss->custom_layers[SCULPT_SCL_AUTOMASKING]);
 
     MEM_SAFE_FREE(ss->custom_layers[SCULPT_SCL_AUTOMASKING]);
     ss->custom_layers[SCULPT_SCL_AUTOMASKING] = NULL;
   }
+}
+
+void SCULPT_automasking_cache_free(SculptSession *ss, Object *ob, AutomaskingCache *automasking)
+{
+  if (!automasking) {
+    return;
+  }
+
+  /* Persistent factors are kept for the next stroke. */
+  if (!ss->automasking_factors_key.valid) {
+    sculpt_automasking_layer_free(ss, ob);
+  }
 
   MEM_SAFE_FREE(automasking);
 }
@@ -350,9 +359,20 @@ static void SCULPT_topology_automasking_init(Sculpt *sd,
   SCULPT_floodfill_free(&flood);
 }
 
+/* Vertices to compute factors for when only part of the mesh needs an update. The first
+ * `totvert` vertices get their factors written, the ones up to `totcontext` are only read by the
+ * boundary propagation. A NULL list stands for all vertices of the mesh. */
+typedef struct AutomaskingVertList {
+  int *verts;
+  int totvert, totcontext, alloc;
+} AutomaskingVertList;
+
+#define AUTOMASK_LIST_VERT(list, i) ((list) ? (list)->verts[i] : (i))
+
 static void sculpt_face_sets_automasking_init(Sculpt *sd,
                                               Object *ob,
-                                              SculptCustomLayer *factorlayer)
+                                              SculptCustomLayer *factorlayer,
+                                              const AutomaskingVertList *list)
 {
   SculptSession *ss = ob->sculpt;
   Brush *brush = BKE_paint_brush(&sd->paint);
@@ -366,10 +386,10 @@ static void sculpt_face_sets_automasking_init(Sculpt *sd,
     return;
   }
 
-  int tot_vert = SCULPT_vertex_count_get(ss);
+  int tot_vert = list ? list->totvert : SCULPT_vertex_count_get(ss);
   int active_face_set = SCULPT_active_face_set_get(ss);
   for (int i = 0; i < tot_vert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, AUTOMASK_LIST_VERT(list, i));
 
     if (!SCULPT_vertex_has_face_set(ss, vertex, active_face_set)) {
       *(float *)SCULPT_attr_vertex_data(vertex, factorlayer) = 0.0f;
@@ -379,20 +399,24 @@ static void sculpt_face_sets_automasking_init(Sculpt *sd,
 
 #define EDGE_DISTANCE_INF -1
 
-void SCULPT_boundary_automasking_init(Object *ob,
-                                      eBoundaryAutomaskMode mode,
-                                      int propagation_steps,
-                                      SculptCustomLayer *factorlayer)
+static void sculpt_boundary_automasking_init_ex(Object *ob,
+                                               eBoundaryAutomaskMode mode,
+                                               int propagation_steps,
+                                               SculptCustomLayer *factorlayer,
+                                               const AutomaskingVertList *list)
 {
   SculptSession *ss = ob->sculpt;
 
   const int totvert = SCULPT_vertex_count_get(ss);
-  int *edge_distance = MEM_callocN(sizeof(int) * totvert, "automask_factor");
+  const int totcontext = list ? list->totcontext : totvert;
+  const int totwrite = list ? list->totvert : totvert;
+  int *edge_distance = MEM_malloc_arrayN(totvert, sizeof(int), "automask_factor");
 
-  for (int i = 0; i < totvert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+  copy_vn_i(edge_distance, totvert, EDGE_DISTANCE_INF);
 
-    edge_distance[i] = EDGE_DISTANCE_INF;
+  for (int j = 0; j < totcontext; j++) {
+    const int i = AUTOMASK_LIST_VERT(list, j);
+    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
 
     switch (mode) {
       case AUTOMASK_INIT_BOUNDARY_EDGES:
@@ -409,7 +433,8 @@ void SCULPT_boundary_automasking_init(Object *ob,
   }
 
   for (int propagation_it = 0; propagation_it < propagation_steps; propagation_it++) {
-    for (int i = 0; i < totvert; i++) {
+    for (int j = 0; j < totcontext; j++) {
+      const int i = AUTOMASK_LIST_VERT(list, j);
       SculptVertRef vref = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
 
       if (edge_distance[i] != EDGE_DISTANCE_INF) {
@@ -425,7 +450,8 @@ void SCULPT_boundary_automasking_init(Object *ob,
     }
   }
 
-  for (int i = 0; i < totvert; i++) {
+  for (int j = 0; j < totwrite; j++) {
+    const int i = AUTOMASK_LIST_VERT(list, j);
     SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
 
     if (edge_distance[i] == EDGE_DISTANCE_INF) {
@@ -440,6 +466,14 @@ void SCULPT_boundary_automasking_init(Object *ob,
   MEM_SAFE_FREE(edge_distance);
 }
 
+void SCULPT_boundary_automasking_init(Object *ob,
+                                      eBoundaryAutomaskMode mode,
+                                      int propagation_steps,
+                                      SculptCustomLayer *factorlayer)
+{
+  sculpt_boundary_automasking_init_ex(ob, mode, propagation_steps, factorlayer, NULL);
+}
+
 static void SCULPT_automasking_cache_settings_update(AutomaskingCache *automasking,
                                                      SculptSession *ss,
                                                      Sculpt *sd,
@@ -508,7 +542,8 @@ float SCULPT_calc_concavity(SculptSession *ss, SculptVertRef vref)
 static void SCULPT_concavity_automasking_init(Object *ob,
                                               const Brush *brush,
                                               AutomaskingCache *automasking,
-                                              SculptCustomLayer *factorlayer)
+                                              SculptCustomLayer *factorlayer,
+                                              const AutomaskingVertList *list)
 {
   SculptSession *ss = ob->sculpt;
 
@@ -516,10 +551,10 @@ static void SCULPT_concavity_automasking_init(Object *ob,
     return;
   }
 
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = list ? list->totvert : SCULPT_vertex_count_get(ss);
 
   for (int i = 0; i < totvert; i++) {
-    SculptVertRef vref = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vref = BKE_pbvh_table_index_to_vertex(ss->pbvh, AUTOMASK_LIST_VERT(list, i));
     float f = SCULPT_calc_concavity(ss, vref);
     f = sculpt_concavity_factor(automasking, f);
 
@@ -528,10 +563,244 @@ static void SCULPT_concavity_automasking_init(Object *ob,
   // BKE_pbvh_vertex_iter_begin
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Persistent Factors
+ *
+ * The factors in #SCULPT_SCL_AUTOMASKING are kept when the stroke ends. The next stroke reuses
+ * them when its settings, the topology and the face sets didn't change. Vertex positions only
+ * affect concavity, which is recomputed around the PBVH nodes that were modified in the meantime
+ * (tagged with #PBVH_UpdateAutomasking). Topology automasking floods from the active vertex and
+ * dynamic topology changes the mesh with every stroke, so those are never kept.
+ * \{ */
+
+#define AUTOMASKING_FACTOR_FLAGS \
+  (BRUSH_AUTOMASKING_TOPOLOGY | BRUSH_AUTOMASKING_FACE_SETS | \
+   BRUSH_AUTOMASKING_BOUNDARY_EDGES | BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS | \
+   BRUSH_AUTOMASKING_CONCAVITY | BRUSH_AUTOMASKING_INVERT_CONCAVITY)
+
+static bool sculpt_automasking_factors_persistent(const SculptSession *ss,
+                                                  const AutomaskingCache *automasking)
+{
+  return BKE_pbvh_type(ss->pbvh) != PBVH_BMESH &&
+         !(automasking->settings.flags & BRUSH_AUTOMASKING_TOPOLOGY);
+}
+
+static void sculpt_automasking_factors_key_get(const SculptSession *ss,
+                                               const AutomaskingCache *automasking,
+                                               const int propagation_steps,
+                                               SculptAutomaskingFactorsKey *r_key)
+{
+  const int flags = automasking->settings.flags & AUTOMASKING_FACTOR_FLAGS;
+
+  memset(r_key, 0, sizeof(*r_key));
+
+  r_key->flags = flags;
+  r_key->topology_generation = ss->topology_generation;
+
+  if (flags & BRUSH_AUTOMASKING_FACE_SETS) {
+    r_key->face_set = automasking->settings.initial_face_set;
+  }
+  if (flags & (BRUSH_AUTOMASKING_BOUNDARY_EDGES | BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS)) {
+    r_key->propagation_steps = propagation_steps;
+  }
+  if (flags & BRUSH_AUTOMASKING_CONCAVITY) {
+    r_key->concave_factor = automasking->settings.concave_factor;
+  }
+
+  /* Face sets are written from too many places to track, hashing them is cheap compared to
+   * recomputing the factors. */
+  if (ss->face_sets &&
+      (flags & (BRUSH_AUTOMASKING_FACE_SETS | BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS))) {
+    r_key->face_sets_hash = BLI_hash_mm2(
+        (const unsigned char *)ss->face_sets, sizeof(int) * (size_t)ss->totfaces, 0);
+  }
+
+  r_key->valid = true;
+}
+
+static void automasking_vert_list_append(AutomaskingVertList *list, BLI_bitmap *visited, int v)
+{
+  if (BLI_BITMAP_TEST(visited, v)) {
+    return;
+  }
+  BLI_BITMAP_ENABLE(visited, v);
+
+  if (list->totcontext == list->alloc) {
+    list->alloc = max_ii(list->alloc * 2, 1024);
+    list->verts = MEM_reallocN(list->verts, sizeof(int) * (size_t)list->alloc);
+  }
+  list->verts[list->totcontext++] = v;
+}
+
+/* Adds `rings` rings of neighbors around the vertices appended since `*r_ring_start`. */
+static void automasking_vert_list_expand(SculptSession *ss,
+                                         AutomaskingVertList *list,
+                                         BLI_bitmap *visited,
+                                         int *r_ring_start,
+                                         const int rings)
+{
+  for (int ring = 0; ring < rings; ring++) {
+    const int ring_end = list->totcontext;
+
+    for (int i = *r_ring_start; i < ring_end; i++) {
+      SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, list->verts[i]);
+      SculptVertexNeighborIter ni;
+
+      SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vertex, ni) {
+        automasking_vert_list_append(list, visited, ni.index);
+      }
+      SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
+    }
+
+    *r_ring_start = ring_end;
+  }
+}
+
+/* Returns the vertices of nodes modified since the factors were computed and clears the tags,
+ * or NULL when there are none. */
+static AutomaskingVertList *sculpt_automasking_modified_verts_get(SculptSession *ss,
+                                                                  BLI_bitmap *visited)
+{
+  PBVHNode **nodes;
+  int totnode;
+  AutomaskingVertList *list = NULL;
+
+  BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
+
+  for (int n = 0; n < totnode; n++) {
+    if (!BKE_pbvh_automasking_update_get(nodes[n])) {
+      continue;
+    }
+    BKE_pbvh_automasking_update_set(nodes[n], false);
+
+    if (!list) {
+      list = MEM_callocN(sizeof(AutomaskingVertList), __func__);
+    }
+
+    PBVHVertexIter vd;
+    BKE_pbvh_vertex_iter_begin (ss->pbvh, nodes[n], vd, PBVH_ITER_UNIQUE) {
+      automasking_vert_list_append(list, visited, vd.index);
+    }
+    BKE_pbvh_vertex_iter_end;
+  }
+
+  MEM_SAFE_FREE(nodes);
+
+  return list;
+}
+
+static void sculpt_automasking_modified_tags_clear(SculptSession *ss)
+{
+  PBVHNode **nodes;
+  int totnode;
+
+  BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
+  for (int n = 0; n < totnode; n++) {
+    BKE_pbvh_automasking_update_set(nodes[n], false);
+  }
+  MEM_SAFE_FREE(nodes);
+}
+
+/** \} */
+
+/* Computes the factors of the vertices in `list`, or of the whole mesh when it's NULL. */
+static void sculpt_automasking_factors_compute(Sculpt *sd,
+                                               const Brush *brush,
+                                               Object *ob,
+                                               AutomaskingCache *automasking,
+                                               const int boundary_propagation_steps,
+                                               const AutomaskingVertList *list)
+{
+  SculptSession *ss = ob->sculpt;
+  const int totvert = list ? list->totvert : SCULPT_vertex_count_get(ss);
+
+  for (int i = 0; i < totvert; i++) {
+    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, AUTOMASK_LIST_VERT(list, i));
+    float *f = SCULPT_attr_vertex_data(vertex, automasking->factorlayer);
+
+    *f = 1.0f;
+  }
+
+  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_TOPOLOGY)) {
+    BLI_assert(list == NULL);
+    SCULPT_vertex_random_access_ensure(ss);
+    SCULPT_topology_automasking_init(sd, ob, automasking->factorlayer);
+  }
+
+  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS)) {
+    SCULPT_vertex_random_access_ensure(ss);
+    sculpt_boundary_automasking_init_ex(ob,
+                                        AUTOMASK_INIT_BOUNDARY_FACE_SETS,
+                                        boundary_propagation_steps,
+                                        automasking->factorlayer,
+                                        list);
+  }
+
+  // for dyntopo, only topology and fset boundary area initialized here
+  if (ss->bm) {
+    return;
+  }
+
+  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_FACE_SETS)) {
+    SCULPT_vertex_random_access_ensure(ss);
+    sculpt_face_sets_automasking_init(sd, ob, automasking->factorlayer, list);
+  }
+
+  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_BOUNDARY_EDGES)) {
+    SCULPT_vertex_random_access_ensure(ss);
+    sculpt_boundary_automasking_init_ex(ob,
+                                        AUTOMASK_INIT_BOUNDARY_EDGES,
+                                        boundary_propagation_steps,
+                                        automasking->factorlayer,
+                                        list);
+  }
+  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_CONCAVITY)) {
+    SCULPT_vertex_random_access_ensure(ss);
+    SCULPT_concavity_automasking_init(ob, brush, automasking, automasking->factorlayer, list);
+  }
+}
+
+/* Recomputes the persistent factors that depend on vertices modified since the last stroke. */
+static void sculpt_automasking_factors_update(Sculpt *sd,
+                                              const Brush *brush,
+                                              Object *ob,
+                                              AutomaskingCache *automasking,
+                                              const int boundary_propagation_steps)
+{
+  SculptSession *ss = ob->sculpt;
+  BLI_bitmap *visited = BLI_BITMAP_NEW(SCULPT_vertex_count_get(ss), __func__);
+  AutomaskingVertList *list = sculpt_automasking_modified_verts_get(ss, visited);
+
+  /* Only concavity depends on vertex positions. */
+  if (list && (automasking->settings.flags & BRUSH_AUTOMASKING_CONCAVITY)) {
+    int ring_start = 0;
+
+    SCULPT_vertex_random_access_ensure(ss);
+
+    /* Concavity reads the neighbors of a vertex. */
+    automasking_vert_list_expand(ss, list, visited, &ring_start, 1);
+    list->totvert = list->totcontext;
+
+    /* Enough context for the boundary distances of the updated vertices to be exact. */
+    if (automasking->settings.flags &
+        (BRUSH_AUTOMASKING_BOUNDARY_EDGES | BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS)) {
+      automasking_vert_list_expand(ss, list, visited, &ring_start, boundary_propagation_steps);
+    }
+
+    sculpt_automasking_factors_compute(
+        sd, brush, ob, automasking, boundary_propagation_steps, list);
+  }
+
+  if (list) {
+    MEM_SAFE_FREE(list->verts);
+    MEM_freeN(list);
+  }
+  MEM_freeN(visited);
+}
+
 AutomaskingCache *SCULPT_automasking_cache_init(Sculpt *sd, const Brush *brush, Object *ob)
 {
   SculptSession *ss = ob->sculpt;
-  const int totvert = SCULPT_vertex_count_get(ss);
 
   if (!SCULPT_is_automasking_enabled(sd, ss, brush)) {
     return NULL;
@@ -549,7 +818,19 @@ AutomaskingCache *SCULPT_automasking_cache_init(Sculpt *sd, const Brush *brush,
   SCULPT_vertex_random_access_ensure(ss);
   SCULPT_face_random_access_ensure(ss);
 
+  const int boundary_propagation_steps = automasking_get_propegation(ss, sd, brush);
+
+  SculptAutomaskingFactorsKey key;
+  sculpt_automasking_factors_key_get(ss, automasking, boundary_propagation_steps, &key);
+
+  /* The layer may not match the mesh anymore, start over with a new one. */
+  if (ss->custom_layers[SCULPT_SCL_AUTOMASKING] &&
+      ss->automasking_factors_key.topology_generation != key.topology_generation) {
+    sculpt_automasking_layer_free(ss, ob);
+  }
+
   if (!ss->custom_layers[SCULPT_SCL_AUTOMASKING]) {
+    ss->automasking_factors_key.valid = false;
     ss->custom_layers[SCULPT_SCL_AUTOMASKING] = MEM_callocN(sizeof(SculptCustomLayer),
                                                             "automasking->factorlayer");
 
@@ -572,48 +853,23 @@ AutomaskingCache *SCULPT_automasking_cache_init(Sculpt *sd, const Brush *brush,
 
   automasking->factorlayer = ss->custom_layers[SCULPT_SCL_AUTOMASKING];
 
-  // automasking->factorlayer = SCULPT_attr_ensure_layer()
-  // automasking->factor = MEM_malloc_arrayN(totvert, sizeof(float), "automask_factor");
-  for (int i = 0; i < totvert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
-    float *f = SCULPT_attr_vertex_data(vertex, automasking->factorlayer);
-
-    *f = 1.0f;
-  }
-
-  const int boundary_propagation_steps = automasking_get_propegation(ss, sd, brush);
-
-  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_TOPOLOGY)) {
-    SCULPT_vertex_random_access_ensure(ss);
-    SCULPT_topology_automasking_init(sd, ob, automasking->factorlayer);
-  }
-
-  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_BOUNDARY_FACE_SETS)) {
-    SCULPT_vertex_random_access_ensure(ss);
-    SCULPT_boundary_automasking_init(ob,
-                                     AUTOMASK_INIT_BOUNDARY_FACE_SETS,
-                                     boundary_propagation_steps,
-                                     automasking->factorlayer);
-  }
+  const bool persistent = sculpt_automasking_factors_persistent(ss, automasking);
 
-  // for dyntopo, only topology and fset boundary area initialized here
-  if (ss->bm) {
+  if (persistent && ss->automasking_factors_key.valid &&
+      memcmp(&ss->automasking_factors_key, &key, sizeof(key)) == 0) {
+    sculpt_automasking_factors_update(sd, brush, ob, automasking, boundary_propagation_steps);
     return automasking;
   }
 
-  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_FACE_SETS)) {
-    SCULPT_vertex_random_access_ensure(ss);
-    sculpt_face_sets_automasking_init(sd, ob, automasking->factorlayer);
-  }
+  sculpt_automasking_factors_compute(
+      sd, brush, ob, automasking, boundary_propagation_steps, NULL);
 
-  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_BOUNDARY_EDGES)) {
-    SCULPT_vertex_random_access_ensure(ss);
-    SCULPT_boundary_automasking_init(
-        ob, AUTOMASK_INIT_BOUNDARY_EDGES, boundary_propagation_steps, automasking->factorlayer);
+  if (persistent) {
+    ss->automasking_factors_key = key;
+    sculpt_automasking_modified_tags_clear(ss);
   }
-  if (SCULPT_is_automasking_mode_enabled(ss, sd, brush, BRUSH_AUTOMASKING_CONCAVITY)) {
-    SCULPT_vertex_random_access_ensure(ss);
-    SCULPT_concavity_automasking_init(ob, brush, automasking, automasking->factorlayer);
+  else {
+    ss->automasking_factors_key.valid = false;
   }
 
   return automasking;
@@ -12,6 +12,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_edgehash.h"
 #include "BLI_math.h"
+#include "BLI_smallhash.h"
 #include "BLI_task.h"
 
 #include "DNA_brush_types.h"
@@ -84,7 +85,8 @@ typedef struct BoundaryInitialVertexFloodFillData {
 
   SculptVertRef boundary_initial_vertex;
 
-  int *floodfill_steps;
+  /* Steps by vertex index, only for the visited vertices. */
+  SmallHash floodfill_steps;
   float radius_sq;
 } BoundaryInitialVertexFloodFillData;
 
@@ -103,16 +105,16 @@ static bool boundary_initial_vertex_floodfill_cb(SculptSession *ss,
     return false;
   }
 
+  int to_v_steps = POINTER_AS_INT(
+      BLI_smallhash_lookup(&data->floodfill_steps, (uintptr_t)from_v));
   if (!is_duplicate) {
-    data->floodfill_steps[to_v] = data->floodfill_steps[from_v] + 1;
-  }
-  else {
-    data->floodfill_steps[to_v] = data->floodfill_steps[from_v];
+    to_v_steps++;
   }
+  BLI_smallhash_reinsert(&data->floodfill_steps, (uintptr_t)to_v, POINTER_FROM_INT(to_v_steps));
 
   if (SCULPT_vertex_is_boundary(ss, to_vref, SCULPT_BOUNDARY_MESH)) {
-    if (data->floodfill_steps[to_v] < data->boundary_initial_vertex_steps) {
-      data->boundary_initial_vertex_steps = data->floodfill_steps[to_v];
+    if (to_v_steps < data->boundary_initial_vertex_steps) {
+      data->boundary_initial_vertex_steps = to_v_steps;
       data->boundary_initial_vertex = to_vref;
     }
   }
@@ -146,13 +148,12 @@ static SculptVertRef sculpt_boundary_get_closest_boundary_vertex(
       .radius_sq = radius * radius,
   };
 
-  fdata.floodfill_steps = MEM_calloc_arrayN(
-      SCULPT_vertex_count_get(ss), sizeof(int) * TSTN, "floodfill steps");
+  BLI_smallhash_init(&fdata.floodfill_steps);
 
   SCULPT_floodfill_execute(ss, &flood, boundary_initial_vertex_floodfill_cb, &fdata);
   SCULPT_floodfill_free(&flood);
 
-  MEM_freeN(fdata.floodfill_steps);
+  BLI_smallhash_release(&fdata.floodfill_steps);
   return fdata.boundary_initial_vertex;
 }
 
@@ -161,19 +162,235 @@ static SculptVertRef sculpt_boundary_get_closest_boundary_vertex(
  * deformations usually need in the boundary. */
 static int BOUNDARY_INDICES_BLOCK_SIZE = 300;
 
+/* The boundary region holds the vertices that the brush can reach, the per-vertex data is only
+ * allocated for those instead of for the entire mesh. */
+static void sculpt_boundary_region_init(SculptBoundary *boundary, const bool init_distances)
+{
+  SculptBoundaryRegion *region = &boundary->region;
+
+  region->capacity = BOUNDARY_INDICES_BLOCK_SIZE;
+  region->verts = MEM_malloc_arrayN(region->capacity, sizeof(SculptVertRef), "region vrefs");
+  region->indices = MEM_malloc_arrayN(region->capacity, sizeof(int), "region indices");
+  region->map = MEM_mallocN(sizeof(SmallHash), "region map");
+  BLI_smallhash_init_ex(region->map, BOUNDARY_INDICES_BLOCK_SIZE);
+
+  boundary->edit_info = MEM_malloc_arrayN(
+      region->capacity, sizeof(SculptBoundaryEditInfo), "Boundary edit info");
+  if (init_distances) {
+    boundary->distance = MEM_malloc_arrayN(region->capacity, sizeof(float), "boundary distances");
+  }
+}
+
+static void sculpt_boundary_region_free(SculptBoundary *boundary)
+{
+  SculptBoundaryRegion *region = &boundary->region;
+
+  MEM_SAFE_FREE(region->verts);
+  MEM_SAFE_FREE(region->indices);
+  if (region->map) {
+    BLI_smallhash_release(region->map);
+    MEM_freeN(region->map);
+    region->map = NULL;
+  }
+
+  for (int i = 0; i < region->totnode; i++) {
+    MEM_SAFE_FREE(region->nodes[i].indices);
+  }
+  MEM_SAFE_FREE(region->nodes);
+  region->totnode = 0;
+  if (region->node_map) {
+    BLI_smallhash_release(region->node_map);
+    MEM_freeN(region->node_map);
+    region->node_map = NULL;
+  }
+}
+
+/* Position of a vertex in the boundary region, -1 if the boundary doesn't reach it. */
+static int sculpt_boundary_region_index(const SculptBoundary *boundary, const int index)
+{
+  return POINTER_AS_INT(BLI_smallhash_lookup(boundary->region.map, (uintptr_t)index)) - 1;
+}
+
+/* Adds a vertex to the boundary region if it is not there yet, returns its position. Only the
+ * edit info and the distances grow with the region, the rest of the per-vertex data is allocated
+ * after the region is complete. */
+static int sculpt_boundary_region_ensure(SculptBoundary *boundary,
+                                         const SculptVertRef vertex,
+                                         const int index)
+{
+  SculptBoundaryRegion *region = &boundary->region;
+  void **val;
+
+  if (BLI_smallhash_ensure_p(region->map, (uintptr_t)index, &val)) {
+    return POINTER_AS_INT(*val) - 1;
+  }
+
+  const int i = region->totvert++;
+  *val = POINTER_FROM_INT(i + 1);
+
+  if (region->totvert > region->capacity) {
+    region->capacity += region->capacity >> 1;
+    region->verts = MEM_reallocN(region->verts, sizeof(SculptVertRef) * region->capacity);
+    region->indices = MEM_reallocN(region->indices, sizeof(int) * region->capacity);
+    boundary->edit_info = MEM_reallocN(boundary->edit_info,
+                                       sizeof(SculptBoundaryEditInfo) * region->capacity);
+    if (boundary->distance) {
+      boundary->distance = MEM_reallocN(boundary->distance, sizeof(float) * region->capacity);
+    }
+  }
+
+  region->verts[i] = vertex;
+  region->indices[i] = index;
+
+  boundary->edit_info[i].original_vertex.i = BOUNDARY_VERTEX_NONE;
+  boundary->edit_info[i].original_vertex_i = BOUNDARY_VERTEX_NONE;
+  boundary->edit_info[i].num_propagation_steps = BOUNDARY_STEPS_NONE;
+  boundary->edit_info[i].strength_factor = 0.0f;
+  if (boundary->distance) {
+    boundary->distance[i] = 0.0f;
+  }
+
+  return i;
+}
+
+typedef struct BoundaryRegionNodesData {
+  SculptSession *ss;
+  SculptBoundary *boundary;
+} BoundaryRegionNodesData;
+
+static bool sculpt_boundary_region_nodes_search_cb(PBVHNode *node, void *data_v)
+{
+  const float(*region_bb)[3] = data_v;
+  float bb_min[3], bb_max[3];
+
+  BKE_pbvh_node_get_BB(node, bb_min, bb_max);
+  return isect_aabb_aabb_v3(bb_min, bb_max, region_bb[0], region_bb[1]);
+}
+
+static void sculpt_boundary_region_nodes_init_task_cb(void *__restrict userdata,
+                                                      const int n,
+                                                      const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  BoundaryRegionNodesData *data = userdata;
+  SculptSession *ss = data->ss;
+  SculptBoundary *boundary = data->boundary;
+  SculptBoundaryNodeRegion *node_region = &boundary->region.nodes[n];
+  PBVHVertexIter vd;
+
+  BKE_pbvh_vertex_iter_begin (ss->pbvh, node_region->node, vd, PBVH_ITER_UNIQUE) {
+    node_region->totindices = vd.i + 1;
+  }
+  BKE_pbvh_vertex_iter_end;
+
+  node_region->indices = MEM_malloc_arrayN(
+      max_ii(node_region->totindices, 1), sizeof(int), "boundary node region indices");
+  for (int i = 0; i < node_region->totindices; i++) {
+    node_region->indices[i] = -1;
+  }
+
+  bool in_region = false;
+  BKE_pbvh_vertex_iter_begin (ss->pbvh, node_region->node, vd, PBVH_ITER_UNIQUE) {
+    node_region->indices[vd.i] = sculpt_boundary_region_index(boundary, vd.index);
+    in_region |= node_region->indices[vd.i] != -1;
+  }
+  BKE_pbvh_vertex_iter_end;
+
+  if (!in_region) {
+    MEM_SAFE_FREE(node_region->indices);
+    node_region->totindices = 0;
+  }
+}
+
+/* Look up the region position of every vertex of the leaf nodes around the region once, so the
+ * deformation doesn't need to look it up for each vertex in every step. The boundary brush
+ * doesn't change the topology, so the iteration order of the nodes stays the same. */
+static void sculpt_boundary_region_nodes_init(SculptSession *ss, SculptBoundary *boundary)
+{
+  SculptBoundaryRegion *region = &boundary->region;
+  float region_bb[2][3];
+
+  INIT_MINMAX(region_bb[0], region_bb[1]);
+  for (int i = 0; i < region->totvert; i++) {
+    minmax_v3v3_v3(region_bb[0], region_bb[1], SCULPT_vertex_co_get(ss, region->verts[i]));
+  }
+
+  PBVHNode **nodes;
+  int totnode;
+  BKE_pbvh_search_gather(
+      ss->pbvh, sculpt_boundary_region_nodes_search_cb, region_bb, &nodes, &totnode);
+
+  region->nodes = MEM_calloc_arrayN(
+      max_ii(totnode, 1), sizeof(SculptBoundaryNodeRegion), "boundary node regions");
+  for (int i = 0; i < totnode; i++) {
+    region->nodes[i].node = nodes[i];
+  }
+  MEM_SAFE_FREE(nodes);
+
+  BoundaryRegionNodesData data = {
+      .ss = ss,
+      .boundary = boundary,
+  };
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, totnode);
+  BLI_task_parallel_range(0, totnode, &data, sculpt_boundary_region_nodes_init_task_cb, &settings);
+
+  region->node_map = MEM_mallocN(sizeof(SmallHash), "boundary node map");
+  BLI_smallhash_init(region->node_map);
+
+  /* Only keep the nodes the region reaches. */
+  for (int i = 0; i < totnode; i++) {
+    if (region->nodes[i].indices) {
+      region->nodes[region->totnode] = region->nodes[i];
+      BLI_smallhash_insert(region->node_map,
+                           (uintptr_t)region->nodes[i].node,
+                           POINTER_FROM_INT(region->totnode + 1));
+      region->totnode++;
+    }
+  }
+}
+
+/* Region data of a leaf node, NULL if the node has no vertices in the region. */
+static const SculptBoundaryNodeRegion *sculpt_boundary_node_region_get(
+    const SculptBoundary *boundary, PBVHNode *node)
+{
+  const int i = POINTER_AS_INT(BLI_smallhash_lookup(boundary->region.node_map, (uintptr_t)node));
+  return i ? &boundary->region.nodes[i - 1] : NULL;
+}
+
+/* Position in the region of the vertex a node iterator is at, -1 if it is outside of it. */
+BLI_INLINE int sculpt_boundary_node_region_index(const SculptBoundaryNodeRegion *node_region,
+                                                 const PBVHVertexIter *vd)
+{
+  return vd->i < node_region->totindices ? node_region->indices[vd->i] : -1;
+}
+
+/* Distance from a vertex to the boundary, FLT_MAX if the vertex is out of reach. */
+static float sculpt_boundary_dist_get(const SculptBoundary *boundary, const int index)
+{
+  const int i = sculpt_boundary_region_index(boundary, index);
+  return i != -1 ? boundary->boundary_dist[i] : FLT_MAX;
+}
+
+static int sculpt_boundary_propagation_steps_get(const SculptBoundary *boundary, const int index)
+{
+  const int i = sculpt_boundary_region_index(boundary, index);
+  return i != -1 ? boundary->edit_info[i].num_propagation_steps : BOUNDARY_STEPS_NONE;
+}
+
 static void sculpt_boundary_index_add(SculptSession *ss,
                                       SculptBoundary *boundary,
                                       const SculptVertRef new_index,
                                       const float distance,
                                       GSet *included_vertices)
 {
+  const int index = BKE_pbvh_vertex_index_to_table(ss->pbvh, new_index);
 
   boundary->vertices[boundary->num_vertices] = new_index;
-  boundary->vertex_indices[boundary->num_vertices] = BKE_pbvh_vertex_index_to_table(ss->pbvh,
-                                                                                    new_index);
+  boundary->vertex_indices[boundary->num_vertices] = index;
 
+  const int i = sculpt_boundary_region_ensure(boundary, new_index, index);
   if (boundary->distance) {
-    boundary->distance[BKE_pbvh_vertex_index_to_table(ss->pbvh, new_index)] = distance;
+    boundary->distance[i] = distance;
   }
   if (included_vertices) {
     BLI_gset_add(included_vertices, POINTER_FROM_INT(new_index.i));
@@ -273,9 +490,10 @@ static bool boundary_floodfill_cb(
   }
   const float edge_len = len_v3v3(SCULPT_vertex_co_get(ss, from_v),
                                   SCULPT_vertex_co_get(ss, to_v));
-  const float distance_boundary_to_dst = boundary->distance ?
-                                             boundary->distance[from_v_i] + edge_len :
-                                             0.0f;
+  const float distance_boundary_to_dst =
+      boundary->distance ?
+          boundary->distance[sculpt_boundary_region_index(boundary, from_v_i)] + edge_len :
+          0.0f;
   sculpt_boundary_index_add(ss, boundary, to_v, distance_boundary_to_dst, data->included_vertices);
   // if (!is_duplicate) {
   sculpt_boundary_preview_edge_add(boundary, from_v, to_v);
@@ -286,7 +504,7 @@ static bool boundary_floodfill_cb(
 
 static float *calc_boundary_tangent(SculptSession *ss, SculptBoundary *boundary)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = boundary->region.totvert;
   float dir[3];
 
   float(*tangents)[3] = MEM_calloc_arrayN(
@@ -299,7 +517,7 @@ static float *calc_boundary_tangent(SculptSession *ss, SculptBoundary *boundary)
       continue;
     }
 
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
     const float *co1 = SCULPT_vertex_co_get(ss, vertex);
 
     zero_v3(dir);
@@ -323,7 +541,7 @@ static float *calc_boundary_tangent(SculptSession *ss, SculptBoundary *boundary)
     float *scalars = BLI_array_alloca(scalars, val);
 
     SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vertex, ni) {
-      scalars[ni.i] = boundary->boundary_dist[ni.index];
+      scalars[ni.i] = sculpt_boundary_dist_get(boundary, ni.index);
       copy_v3_v3(cos[ni.i], SCULPT_vertex_co_get(ss, ni.vertex));
     }
     SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
@@ -371,10 +589,7 @@ static float *calc_boundary_tangent(SculptSession *ss, SculptBoundary *boundary)
 
       SCULPT_vertex_normal_get(ss, ni.vertex, no2);
 
-      // int i2 = BKE_pbvh_vertex_index_to_table(ss->pbvh, ni.vertex);
-      int i2 = ni.index;
-
-      float f2 = boundary->boundary_dist[i2];
+      float f2 = sculpt_boundary_dist_get(boundary, ni.index);
       float dir2[3];
 
       sub_v3_v3v3(dir2, co2, co1);
@@ -407,7 +622,7 @@ static float *calc_boundary_tangent(SculptSession *ss, SculptBoundary *boundary)
 
 static void sculpt_boundary_cotan_init(SculptSession *ss, SculptBoundary *boundary)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = boundary->region.totvert;
   boundary->boundary_cotangents = MEM_calloc_arrayN(
       totvert, sizeof(StoredCotangentW), "StoredCotangentW");
   StoredCotangentW *cotw = boundary->boundary_cotangents;
@@ -419,7 +634,7 @@ static void sculpt_boundary_cotan_init(SculptSession *ss, SculptBoundary *bounda
       continue;
     }
 
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
     const int val = SCULPT_vertex_valence_get(ss, vertex);
 
     cotw->length = val;
@@ -435,25 +650,18 @@ static void sculpt_boundary_cotan_init(SculptSession *ss, SculptBoundary *bounda
   }
 }
 
-static void sculpt_boundary_indices_init(Object *ob,
-                                         SculptSession *ss,
+static void sculpt_boundary_indices_init(SculptSession *ss,
                                          SculptBoundary *boundary,
                                          const bool init_boundary_distances,
-                                         const SculptVertRef initial_boundary_index,
-                                         const float radius)
+                                         const SculptVertRef initial_boundary_index)
 {
-
-  const int totvert = SCULPT_vertex_count_get(ss);
   boundary->vertices = MEM_malloc_arrayN(
       BOUNDARY_INDICES_BLOCK_SIZE, sizeof(SculptVertRef) * TSTN, "boundary vrefs");
   boundary->vertex_indices = MEM_malloc_arrayN(
       BOUNDARY_INDICES_BLOCK_SIZE, sizeof(int) * TSTN, "boundary indices");
 
-  boundary->sculpt_totvert = totvert;
+  sculpt_boundary_region_init(boundary, init_boundary_distances);
 
-  if (init_boundary_distances) {
-    boundary->distance = MEM_calloc_arrayN(totvert, sizeof(float) * TSTN, "boundary distances");
-  }
   boundary->edges = MEM_malloc_arrayN(
       BOUNDARY_INDICES_BLOCK_SIZE, sizeof(SculptBoundaryPreviewEdge) * TSTN, "boundary edges");
 
@@ -477,40 +685,82 @@ static void sculpt_boundary_indices_init(Object *ob,
   SCULPT_floodfill_execute(ss, &flood, boundary_floodfill_cb, &fdata);
   SCULPT_floodfill_free(&flood);
 
-  GSet *boundary_verts;
+  /* Check if the boundary loops into itself and add the extra preview edge to close the loop. */
+  if (fdata.last_visited_vertex.i != BOUNDARY_VERTEX_NONE &&
+      sculpt_boundary_is_vertex_in_editable_boundary(ss, fdata.last_visited_vertex)) {
+    SculptVertexNeighborIter ni;
+    SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, fdata.last_visited_vertex, ni) {
+      if (BLI_gset_haskey(included_vertices, POINTER_FROM_INT(ni.vertex.i)) &&
+          sculpt_boundary_is_vertex_in_editable_boundary(ss, ni.vertex)) {
+        sculpt_boundary_preview_edge_add(boundary, fdata.last_visited_vertex, ni.vertex);
+        boundary->forms_loop = true;
+      }
+    }
+    SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
+  }
 
-  if (BKE_pbvh_type(ss->pbvh) == PBVH_BMESH) {
-    boundary_verts = BLI_gset_int_new_ex("included vertices", BOUNDARY_INDICES_BLOCK_SIZE);
+  BLI_gset_free(included_vertices, NULL);
+}
 
-    GSetIterator gi;
+/**
+ * Geodesic distances from the boundary and the data derived from them. This adds the vertices
+ * inside the radius to the boundary region, so it runs after the topology propagation.
+ */
+static void sculpt_boundary_geodesic_init(Object *ob,
+                                          SculptSession *ss,
+                                          SculptBoundary *boundary,
+                                          const float radius)
+{
+  GSet *boundary_verts = BLI_gset_int_new_ex("boundary vertices", boundary->num_vertices);
+  for (int i = 0; i < boundary->num_vertices; i++) {
+    BLI_gset_add(boundary_verts, POINTER_FROM_INT(boundary->vertex_indices[i]));
+  }
 
-    GSET_ITER (gi, included_vertices) {
-      BMVert *v = (BMVert *)BLI_gsetIterator_getKey(&gi);
-      BLI_gset_add(boundary_verts, POINTER_FROM_INT(v->head.index));
-    }
+  int *indices;
+  float *dists;
+  SculptVertRef *closest_verts;
+  const int totreached = SCULPT_geodesic_distances_create_sparse(
+      ob, boundary_verts, radius, &indices, &dists, &closest_verts);
+  BLI_gset_free(boundary_verts, NULL);
+
+  for (int i = 0; i < totreached; i++) {
+    sculpt_boundary_region_ensure(
+        boundary, BKE_pbvh_table_index_to_vertex(ss->pbvh, indices[i]), indices[i]);
   }
-  else {
-    boundary_verts = included_vertices;
+
+  /* Vertices added by the topology propagation that the geodesic front didn't reach keep
+   * FLT_MAX. */
+  const int region_totvert = boundary->region.totvert;
+  boundary->boundary_dist = MEM_malloc_arrayN(region_totvert, sizeof(float), "boundary_dist");
+  boundary->boundary_closest = MEM_malloc_arrayN(
+      region_totvert, sizeof(SculptVertRef), "boundary_closest");
+  for (int i = 0; i < region_totvert; i++) {
+    boundary->boundary_dist[i] = FLT_MAX;
+    boundary->boundary_closest[i].i = BOUNDARY_VERTEX_NONE;
+  }
+  for (int i = 0; i < totreached; i++) {
+    const int region_i = sculpt_boundary_region_index(boundary, indices[i]);
+    boundary->boundary_dist[region_i] = dists[i];
+    boundary->boundary_closest[region_i] = closest_verts[i];
   }
 
-  boundary->boundary_closest = MEM_calloc_arrayN(
-      totvert, sizeof(SculptVertRef), "boundary_closest");
-  boundary->boundary_dist = SCULPT_geodesic_distances_create(
-      ob, boundary_verts, radius, boundary->boundary_closest, NULL);
+  MEM_SAFE_FREE(indices);
+  MEM_SAFE_FREE(dists);
+  MEM_SAFE_FREE(closest_verts);
 
   sculpt_boundary_cotan_init(ss, boundary);
 
 #if 0  // smooth geodesic scalar field
-  float *boundary_dist = MEM_calloc_arrayN(totvert, sizeof(float), "boundary_dist");
+  float *boundary_dist = MEM_calloc_arrayN(region_totvert, sizeof(float), "boundary_dist");
 
   for (int iteration = 0; iteration < 4; iteration++) {
-    for (int i = 0; i < totvert; i++) {
+    for (int i = 0; i < region_totvert; i++) {
       if (boundary->boundary_dist[i] == FLT_MAX) {
         boundary_dist[i] = FLT_MAX;
         continue;
       }
 
-      SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+      SculptVertRef vertex = boundary->region.verts[i];
       float tot = 0.0f;
 
       StoredCotangentW *cotw = boundary->boundary_cotangents + i;
@@ -518,14 +768,15 @@ static void sculpt_boundary_indices_init(Object *ob,
       SculptVertexNeighborIter ni;
       int j = 0;
       SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vertex, ni) {
-        if (boundary->boundary_dist[ni.index] == FLT_MAX) {
+        const float dist = sculpt_boundary_dist_get(boundary, ni.index);
+        if (dist == FLT_MAX) {
           j++;
           continue;
         }
 
         const float w = cotw->weights[j];
 
-        boundary_dist[i] += boundary->boundary_dist[ni.index] * w;
+        boundary_dist[i] += dist * w;
 
         tot += w;
         j++;
@@ -550,17 +801,17 @@ static void sculpt_boundary_indices_init(Object *ob,
 
 #if 1  // smooth geodesic tangent field
   float(*boundary_tangents)[3] = MEM_calloc_arrayN(
-      totvert, sizeof(float) * 3, "boundary_tangents");
+      region_totvert, sizeof(float) * 3, "boundary_tangents");
 
   for (int iteration = 0; iteration < 4; iteration++) {
-    for (int i = 0; i < totvert; i++) {
+    for (int i = 0; i < region_totvert; i++) {
 
       if (boundary->boundary_dist[i] == FLT_MAX) {
         copy_v3_v3(boundary_tangents[i], boundary->boundary_tangents[i]);
         continue;
       }
 
-      SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+      SculptVertRef vertex = boundary->region.verts[i];
       float tot = 0.0f;
 
       // StoredCotangentW *cotw = boundary->boundary_cotangents + i;
@@ -569,12 +820,13 @@ static void sculpt_boundary_indices_init(Object *ob,
       SculptVertexNeighborIter ni;
       int j = 0;
       SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vertex, ni) {
-        if (boundary->boundary_dist[ni.index] == FLT_MAX) {
+        const int ni_i = sculpt_boundary_region_index(boundary, ni.index);
+        if (ni_i == -1 || boundary->boundary_dist[ni_i] == FLT_MAX) {
           j++;
           continue;
         }
 
-        add_v3_v3(tan, boundary->boundary_tangents[ni.index]);
+        add_v3_v3(tan, boundary->boundary_tangents[ni_i]);
 
         tot += 1.0f;
         j++;
@@ -599,26 +851,6 @@ static void sculpt_boundary_indices_init(Object *ob,
 #endif
 
   boundary_color_vis(ss, boundary);
-
-  if (boundary_verts != included_vertices) {
-    BLI_gset_free(boundary_verts, NULL);
-  }
-
-  /* Check if the boundary loops into itself and add the extra preview edge to close the loop. */
-  if (fdata.last_visited_vertex.i != BOUNDARY_VERTEX_NONE &&
-      sculpt_boundary_is_vertex_in_editable_boundary(ss, fdata.last_visited_vertex)) {
-    SculptVertexNeighborIter ni;
-    SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, fdata.last_visited_vertex, ni) {
-      if (BLI_gset_haskey(included_vertices, POINTER_FROM_INT(ni.vertex.i)) &&
-          sculpt_boundary_is_vertex_in_editable_boundary(ss, ni.vertex)) {
-        sculpt_boundary_preview_edge_add(boundary, fdata.last_visited_vertex, ni.vertex);
-        boundary->forms_loop = true;
-      }
-    }
-    SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
-  }
-
-  BLI_gset_free(included_vertices, NULL);
 }
 
 static void boundary_color_vis(SculptSession *ss, SculptBoundary *boundary)
@@ -636,7 +868,7 @@ static void boundary_color_vis(SculptSession *ss, SculptBoundary *boundary)
 
     // calc bounds
     BM_ITER_MESH_INDEX (v, &iter, ss->bm, BM_VERTS_OF_MESH, i) {
-      float f = boundary->boundary_dist[i];
+      float f = sculpt_boundary_dist_get(boundary, i);
 
       if (f == FLT_MAX) {
         continue;
@@ -651,7 +883,7 @@ static void boundary_color_vis(SculptSession *ss, SculptBoundary *boundary)
     BM_ITER_MESH_INDEX (v, &iter, ss->bm, BM_VERTS_OF_MESH, i) {
       MPropCol *mcol = BM_ELEM_CD_GET_VOID_P(v, cd_color);
 
-      float f = boundary->boundary_dist[i];
+      float f = sculpt_boundary_dist_get(boundary, i);
 
       if (f == FLT_MAX) {
         mcol->color[0] = mcol->color[1] = 1.0f;
@@ -680,30 +912,19 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
                                            const SculptVertRef initial_vertex,
                                            const float radius)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
-
   const bool has_duplicates = BKE_pbvh_type(ss->pbvh) == PBVH_GRIDS;
 
-  boundary->edit_info = MEM_malloc_arrayN(
-      totvert, sizeof(SculptBoundaryEditInfo) * TSTN, "Boundary edit info");
-
-  for (int i = 0; i < totvert; i++) {
-    boundary->edit_info[i].original_vertex.i = BOUNDARY_VERTEX_NONE;
-    boundary->edit_info[i].original_vertex_i = BOUNDARY_VERTEX_NONE;
-    boundary->edit_info[i].num_propagation_steps = BOUNDARY_STEPS_NONE;
-  }
-
   GSQueue *current_iteration = BLI_gsqueue_new(sizeof(SculptVertRef));
   GSQueue *next_iteration = BLI_gsqueue_new(sizeof(SculptVertRef));
 
   /* Initialized the first iteration with the vertices already in the boundary. This is propagation
    * step 0. */
-  BLI_bitmap *visited_vertices = BLI_BITMAP_NEW(SCULPT_vertex_count_get(ss), "visited_vertices");
   for (int i = 0; i < boundary->num_vertices; i++) {
-    boundary->edit_info[boundary->vertex_indices[i]].original_vertex = boundary->vertices[i];
-    boundary->edit_info[boundary->vertex_indices[i]].original_vertex_i =
-        boundary->vertex_indices[i];
-    boundary->edit_info[boundary->vertex_indices[i]].num_propagation_steps = 0;
+    const int boundary_i = sculpt_boundary_region_index(boundary, boundary->vertex_indices[i]);
+
+    boundary->edit_info[boundary_i].original_vertex = boundary->vertices[i];
+    boundary->edit_info[boundary_i].original_vertex_i = boundary_i;
+    boundary->edit_info[boundary_i].num_propagation_steps = 0;
 
     /* This ensures that all duplicate vertices in the boundary have the same original_vertex
      * index, so the deformation for them will be the same. */
@@ -711,10 +932,11 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
       SculptVertexNeighborIter ni_duplis;
       SCULPT_VERTEX_DUPLICATES_AND_NEIGHBORS_ITER_BEGIN (ss, boundary->vertices[i], ni_duplis) {
         if (ni_duplis.is_duplicate) {
-          int index = ni_duplis.index;
+          const int dupli_i = sculpt_boundary_region_ensure(
+              boundary, ni_duplis.vertex, ni_duplis.index);
 
-          boundary->edit_info[index].original_vertex = boundary->vertices[i];
-          boundary->edit_info[index].original_vertex_i = boundary->vertex_indices[i];
+          boundary->edit_info[dupli_i].original_vertex = boundary->vertices[i];
+          boundary->edit_info[dupli_i].original_vertex_i = boundary_i;
         }
       }
       SCULPT_VERTEX_NEIGHBORS_ITER_END(ni_duplis);
@@ -737,32 +959,34 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
     while (!BLI_gsqueue_is_empty(current_iteration)) {
       SculptVertRef from_v;
       BLI_gsqueue_pop(current_iteration, &from_v);
-      const int from_v_i = BKE_pbvh_vertex_index_to_table(ss->pbvh, from_v);
+      const int from_v_i = sculpt_boundary_region_index(
+          boundary, BKE_pbvh_vertex_index_to_table(ss->pbvh, from_v));
 
       SculptVertexNeighborIter ni;
       SCULPT_VERTEX_DUPLICATES_AND_NEIGHBORS_ITER_BEGIN (ss, from_v, ni) {
         const bool is_visible = SCULPT_vertex_visible_get(ss, ni.vertex);
 
-        if (!is_visible ||
-            boundary->edit_info[ni.index].num_propagation_steps != BOUNDARY_STEPS_NONE) {
+        if (!is_visible) {
           continue;
         }
-        boundary->edit_info[ni.index].original_vertex =
-            boundary->edit_info[from_v_i].original_vertex;
 
-        boundary->edit_info[ni.index].original_vertex_i =
-            boundary->edit_info[from_v_i].original_vertex_i;
+        /* The region may be reallocated here, so #SculptBoundaryEditInfo pointers can't be kept
+         * around. */
+        const int to_v_i = sculpt_boundary_region_ensure(boundary, ni.vertex, ni.index);
+        SculptBoundaryEditInfo *edit_info = boundary->edit_info;
 
-        BLI_BITMAP_ENABLE(visited_vertices, ni.index);
+        if (edit_info[to_v_i].num_propagation_steps != BOUNDARY_STEPS_NONE) {
+          continue;
+        }
+        edit_info[to_v_i].original_vertex = edit_info[from_v_i].original_vertex;
+        edit_info[to_v_i].original_vertex_i = edit_info[from_v_i].original_vertex_i;
 
         if (ni.is_duplicate) {
           /* Grids duplicates handling. */
-          boundary->edit_info[ni.index].num_propagation_steps =
-              boundary->edit_info[from_v_i].num_propagation_steps;
+          edit_info[to_v_i].num_propagation_steps = edit_info[from_v_i].num_propagation_steps;
         }
         else {
-          boundary->edit_info[ni.index].num_propagation_steps =
-              boundary->edit_info[from_v_i].num_propagation_steps + 1;
+          edit_info[to_v_i].num_propagation_steps = edit_info[from_v_i].num_propagation_steps + 1;
 
           BLI_gsqueue_push(next_iteration, &ni.vertex);
 
@@ -774,12 +998,14 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
             SculptVertexNeighborIter ni_duplis;
             SCULPT_VERTEX_DUPLICATES_AND_NEIGHBORS_ITER_BEGIN (ss, ni.vertex, ni_duplis) {
               if (ni_duplis.is_duplicate) {
-                boundary->edit_info[ni_duplis.index].original_vertex =
-                    boundary->edit_info[from_v_i].original_vertex;
-                boundary->edit_info[ni_duplis.index].original_vertex_i =
-                    boundary->edit_info[from_v_i].original_vertex_i;
-                boundary->edit_info[ni_duplis.index].num_propagation_steps =
-                    boundary->edit_info[from_v_i].num_propagation_steps + 1;
+                const int dupli_i = sculpt_boundary_region_ensure(
+                    boundary, ni_duplis.vertex, ni_duplis.index);
+                edit_info = boundary->edit_info;
+
+                edit_info[dupli_i].original_vertex = edit_info[from_v_i].original_vertex;
+                edit_info[dupli_i].original_vertex_i = edit_info[from_v_i].original_vertex_i;
+                edit_info[dupli_i].num_propagation_steps =
+                    edit_info[from_v_i].num_propagation_steps + 1;
               }
             }
             SCULPT_VERTEX_NEIGHBORS_ITER_END(ni_duplis);
@@ -787,7 +1013,7 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
 
           /* Check the distance using the vertex that was propagated from the initial vertex that
            * was used to initialize the boundary. */
-          if (boundary->edit_info[from_v_i].original_vertex.i == initial_vertex.i) {
+          if (edit_info[from_v_i].original_vertex.i == initial_vertex.i) {
             boundary->pivot_vertex = ni.vertex;
             copy_v3_v3(boundary->initial_pivot_position, SCULPT_vertex_co_get(ss, ni.vertex));
             accum_distance += len_v3v3(SCULPT_vertex_co_get(ss, from_v),
@@ -808,8 +1034,6 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
     num_propagation_steps++;
   }
 
-  MEM_SAFE_FREE(visited_vertices);
-
   BLI_gsqueue_free(current_iteration);
   BLI_gsqueue_free(next_iteration);
 }
@@ -820,7 +1044,7 @@ static void sculpt_boundary_edit_data_init(SculptSession *ss,
 static void sculpt_boundary_falloff_factor_init(
     SculptSession *ss, Sculpt *sd, SculptBoundary *boundary, Brush *brush, const float radius)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = boundary->region.totvert;
   BKE_curvemapping_init(brush->curve);
 
   int boundary_type = SCULPT_get_int(ss, boundary_falloff_type, sd, brush);
@@ -843,8 +1067,11 @@ static void sculpt_boundary_falloff_factor_init(
       continue;
     }
 
-    const float boundary_distance = boundary->distance[BKE_pbvh_vertex_index_to_table(
-        ss->pbvh, boundary->edit_info[i].original_vertex)];
+    if (boundary->edit_info[i].original_vertex_i == BOUNDARY_VERTEX_NONE) {
+      continue;
+    }
+
+    const float boundary_distance = boundary->distance[boundary->edit_info[i].original_vertex_i];
     float falloff_distance = 0.0f;
     float direction = 1.0f;
 
@@ -925,12 +1152,12 @@ SculptBoundary *SCULPT_boundary_data_init(Sculpt *sd,
                                         (1.0f + SCULPT_get_float(ss, boundary_offset, sd, brush)) :
                                     radius;
 
-  sculpt_boundary_indices_init(
-      object, ss, boundary, init_boundary_distances, boundary_initial_vertex, boundary_radius);
-
+  sculpt_boundary_indices_init(ss, boundary, init_boundary_distances, boundary_initial_vertex);
   sculpt_boundary_edit_data_init(ss, boundary, boundary_initial_vertex, boundary_radius);
+  sculpt_boundary_geodesic_init(object, ss, boundary, boundary_radius);
 
   if (ss->cache) {
+    sculpt_boundary_region_nodes_init(ss, boundary);
     SCULPT_boundary_build_smoothco(ss, boundary);
   }
 
@@ -958,7 +1185,7 @@ void SCULPT_boundary_data_free(SculptBoundary *boundary)
   StoredCotangentW *cotw = boundary->boundary_cotangents;
 
   if (cotw) {
-    for (int i = 0; i < boundary->sculpt_totvert; i++, cotw++) {
+    for (int i = 0; i < boundary->region.totvert; i++, cotw++) {
       if (cotw->weights != cotw->static_weights) {
         MEM_SAFE_FREE(cotw->weights);
       }
@@ -966,6 +1193,7 @@ void SCULPT_boundary_data_free(SculptBoundary *boundary)
   }
 
   MEM_SAFE_FREE(boundary->boundary_cotangents);
+  sculpt_boundary_region_free(boundary);
   MEM_SAFE_FREE(boundary);
 }
 
@@ -1288,7 +1516,7 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
                                                              .no_reuse_ids = 0}));
 #endif
 
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = boundary->region.totvert;
   boundary->bend.pivot_rotation_axis = MEM_calloc_arrayN(
       totvert, 3 * sizeof(float), "pivot rotation axis");
   boundary->bend.pivot_positions = MEM_calloc_arrayN(
@@ -1300,7 +1528,7 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
 
   for (int i = 0; i < totvert; i++) {
 #ifdef VISBM
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
 
     if (boundary->boundary_dist[i] != FLT_MAX) {
       const float *co1 = SCULPT_vertex_co_get(ss, vertex);
@@ -1319,8 +1547,13 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
 
     if (boundary->boundary_closest[i].i != -1LL) {
       SculptVertRef v = boundary->boundary_closest[i];
-      boundary->edit_info[i].original_vertex = v;
-      boundary->edit_info[i].original_vertex_i = BKE_pbvh_vertex_index_to_table(ss->pbvh, v);
+      const int v_i = sculpt_boundary_region_index(boundary,
+                                                   BKE_pbvh_vertex_index_to_table(ss->pbvh, v));
+
+      if (v_i != -1) {
+        boundary->edit_info[i].original_vertex = v;
+        boundary->edit_info[i].original_vertex_i = v_i;
+      }
     }
 
     if (boundary->edit_info[i].num_propagation_steps != boundary->max_propagation_steps) {
@@ -1329,7 +1562,7 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
   }
 
   for (int i = 0; i < totvert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
 
     if (boundary->edit_info[i].original_vertex_i == BOUNDARY_VERTEX_NONE) {
       continue;
@@ -1388,7 +1621,7 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
   for (int vi = 0; vi < boundary->num_vertices; vi++) {
     SculptVertRef v = boundary->vertices[vi];
     const float *co1 = SCULPT_vertex_co_get(ss, v);
-    int i = BKE_pbvh_vertex_index_to_table(ss->pbvh, v);
+    int i = sculpt_boundary_region_index(boundary, boundary->vertex_indices[vi]);
 
     if (boundary->bend.pivot_positions[i][3] != 0.0f) {
       continue;
@@ -1402,7 +1635,7 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
         continue;
       }
 
-      SculptVertRef v2 = BKE_pbvh_table_index_to_vertex(ss->pbvh, j);
+      SculptVertRef v2 = boundary->region.verts[j];
       const float *co2 = SCULPT_vertex_co_get(ss, v2);
 
       float len = len_v3v3(co2, co1);
@@ -1415,8 +1648,10 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
     }
   }
 
-  for (int i = 0; i < totvert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+  /* Walk the region backwards, the boundary vertices come first in it and their pivots have to be
+   * read by the rest of the vertices before they are snapped themselves. */
+  for (int i = totvert - 1; i >= 0; i--) {
+    SculptVertRef vertex = boundary->region.verts[i];
     const float *co1 = SCULPT_vertex_co_get(ss, vertex);
     float dir[3];
 
@@ -1485,12 +1720,11 @@ static void sculpt_boundary_bend_data_init(SculptSession *ss,
 
 static void sculpt_boundary_slide_data_init(SculptSession *ss, SculptBoundary *boundary)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
-  boundary->slide.directions = MEM_calloc_arrayN(
-      totvert, 3 * sizeof(float) * TSTN, "slide directions");
+  const int totvert = boundary->region.totvert;
+  boundary->slide.directions = MEM_calloc_arrayN(totvert, 3 * sizeof(float), "slide directions");
 
   for (int i = 0; i < totvert; i++) {
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
 
     if (boundary->edit_info[i].num_propagation_steps != boundary->max_propagation_steps) {
       continue;
@@ -1536,7 +1770,7 @@ static void sculpt_boundary_twist_data_init(SculptSession *ss, SculptBoundary *b
 static void sculpt_boundary_circle_data_init(SculptSession *ss, SculptBoundary *boundary)
 {
 
-  const int totvert = SCULPT_vertex_count_get(ss);
+  const int totvert = boundary->region.totvert;
   const int totcircles = boundary->max_propagation_steps + 1;
 
   boundary->circle.radius = MEM_calloc_arrayN(totcircles, sizeof(float), "radius");
@@ -1549,7 +1783,7 @@ static void sculpt_boundary_circle_data_init(SculptSession *ss, SculptBoundary *
       continue;
     }
 
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
 
     add_v3_v3(boundary->circle.origin[propagation_step_index], SCULPT_vertex_co_get(ss, vertex));
     count[propagation_step_index]++;
@@ -1565,7 +1799,7 @@ static void sculpt_boundary_circle_data_init(SculptSession *ss, SculptBoundary *
       continue;
     }
 
-    SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+    SculptVertRef vertex = boundary->region.verts[i];
 
     boundary->circle.radius[propagation_step_index] += len_v3v3(
         boundary->circle.origin[propagation_step_index], SCULPT_vertex_co_get(ss, vertex));
@@ -1600,6 +1834,11 @@ static void do_boundary_brush_bend_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symm_area = ss->cache->mirror_symmetry_pass;
   SculptBoundary *boundary = ss->cache->boundaries[symm_area];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1617,7 +1856,8 @@ static void do_boundary_brush_bend_task_cb_ex(void *__restrict userdata,
   const float angle = angle_factor * M_PI;
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1632,12 +1872,12 @@ static void do_boundary_brush_bend_task_cb_ex(void *__restrict userdata,
     float t_orig_co[3];
     float *target_co = SCULPT_brush_deform_target_vertex_co_get(ss, boundary->deform_target, &vd);
 
-    sub_v3_v3v3(t_orig_co, orig_data.co, boundary->bend.pivot_positions[vd.index]);
+    sub_v3_v3v3(t_orig_co, orig_data.co, boundary->bend.pivot_positions[i]);
     rotate_v3_v3v3fl(target_co,
                      t_orig_co,
-                     boundary->bend.pivot_rotation_axis[vd.index],
-                     angle * boundary->edit_info[vd.index].strength_factor * mask * automask);
-    add_v3_v3(target_co, boundary->bend.pivot_positions[vd.index]);
+                     boundary->bend.pivot_rotation_axis[i],
+                     angle * boundary->edit_info[i].strength_factor * mask * automask);
+    add_v3_v3(target_co, boundary->bend.pivot_positions[i]);
 
     if (vd.mvert) {
       BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
@@ -1654,6 +1894,11 @@ static void do_boundary_brush_slide_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symm_area = ss->cache->mirror_symmetry_pass;
   SculptBoundary *boundary = ss->cache->boundaries[symm_area];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1665,7 +1910,8 @@ static void do_boundary_brush_slide_task_cb_ex(void *__restrict userdata,
   const float disp = sculpt_boundary_displacement_from_grab_delta_get(ss, boundary);
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1680,8 +1926,8 @@ static void do_boundary_brush_slide_task_cb_ex(void *__restrict userdata,
     float *target_co = SCULPT_brush_deform_target_vertex_co_get(ss, boundary->deform_target, &vd);
     madd_v3_v3v3fl(target_co,
                    orig_data.co,
-                   boundary->slide.directions[vd.index],
-                   boundary->edit_info[vd.index].strength_factor * disp * mask * automask *
+                   boundary->slide.directions[i],
+                   boundary->edit_info[i].strength_factor * disp * mask * automask *
                        strength);
 
     if (vd.mvert) {
@@ -1699,6 +1945,11 @@ static void do_boundary_brush_inflate_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symm_area = ss->cache->mirror_symmetry_pass;
   SculptBoundary *boundary = ss->cache->boundaries[symm_area];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1710,7 +1961,8 @@ static void do_boundary_brush_inflate_task_cb_ex(void *__restrict userdata,
   const float disp = sculpt_boundary_displacement_from_grab_delta_get(ss, boundary);
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1729,7 +1981,7 @@ static void do_boundary_brush_inflate_task_cb_ex(void *__restrict userdata,
     madd_v3_v3v3fl(target_co,
                    orig_data.co,
                    orig_data.no,
-                   boundary->edit_info[vd.index].strength_factor * disp * mask * automask *
+                   boundary->edit_info[i].strength_factor * disp * mask * automask *
                        strength);
 
     if (vd.mvert) {
@@ -1747,6 +1999,11 @@ static void do_boundary_brush_grab_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symm_area = ss->cache->mirror_symmetry_pass;
   SculptBoundary *boundary = ss->cache->boundaries[symm_area];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1756,7 +2013,8 @@ static void do_boundary_brush_grab_task_cb_ex(void *__restrict userdata,
   SCULPT_orig_vert_data_init(&orig_data, data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1772,7 +2030,7 @@ static void do_boundary_brush_grab_task_cb_ex(void *__restrict userdata,
     madd_v3_v3v3fl(target_co,
                    orig_data.co,
                    ss->cache->grab_delta_symmetry,
-                   boundary->edit_info[vd.index].strength_factor * mask * automask * strength);
+                   boundary->edit_info[i].strength_factor * mask * automask * strength);
 
     if (vd.mvert) {
       BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
@@ -1789,6 +2047,11 @@ static void do_boundary_brush_twist_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symm_area = ss->cache->mirror_symmetry_pass;
   SculptBoundary *boundary = ss->cache->boundaries[symm_area];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1806,7 +2069,8 @@ static void do_boundary_brush_twist_task_cb_ex(void *__restrict userdata,
   const float angle = angle_factor * M_PI;
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1824,7 +2088,7 @@ static void do_boundary_brush_twist_task_cb_ex(void *__restrict userdata,
     rotate_v3_v3v3fl(target_co,
                      t_orig_co,
                      boundary->twist.rotation_axis,
-                     angle * mask * automask * boundary->edit_info[vd.index].strength_factor);
+                     angle * mask * automask * boundary->edit_info[i].strength_factor);
     add_v3_v3(target_co, boundary->twist.pivot_position);
 
     if (vd.mvert) {
@@ -1842,6 +2106,11 @@ static void do_boundary_brush_smooth_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symmetry_pass = ss->cache->mirror_symmetry_pass;
   const SculptBoundary *boundary = ss->cache->boundaries[symmetry_pass];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1851,7 +2120,8 @@ static void do_boundary_brush_smooth_task_cb_ex(void *__restrict userdata,
   SCULPT_orig_vert_data_init(&orig_data, data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1863,10 +2133,11 @@ static void do_boundary_brush_smooth_task_cb_ex(void *__restrict userdata,
 
     float coord_accum[3] = {0.0f, 0.0f, 0.0f};
     int total_neighbors = 0;
-    const int current_propagation_steps = boundary->edit_info[vd.index].num_propagation_steps;
+    const int current_propagation_steps = boundary->edit_info[i].num_propagation_steps;
     SculptVertexNeighborIter ni;
     SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vd.vertex, ni) {
-      if (current_propagation_steps == boundary->edit_info[ni.index].num_propagation_steps) {
+      if (current_propagation_steps ==
+          sculpt_boundary_propagation_steps_get(boundary, ni.index)) {
         add_v3_v3(coord_accum, SCULPT_vertex_co_get(ss, ni.vertex));
         total_neighbors++;
       }
@@ -1883,7 +2154,7 @@ static void do_boundary_brush_smooth_task_cb_ex(void *__restrict userdata,
     sub_v3_v3v3(disp, avg, vd.co);
     float *target_co = SCULPT_brush_deform_target_vertex_co_get(ss, boundary->deform_target, &vd);
     madd_v3_v3v3fl(
-        target_co, vd.co, disp, boundary->edit_info[vd.index].strength_factor * mask * strength);
+        target_co, vd.co, disp, boundary->edit_info[i].strength_factor * mask * strength);
 
     if (vd.mvert) {
       BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
@@ -1900,6 +2171,11 @@ static void do_boundary_brush_circle_task_cb_ex(void *__restrict userdata,
   SculptSession *ss = data->ob->sculpt;
   const int symmetry_pass = ss->cache->mirror_symmetry_pass;
   const SculptBoundary *boundary = ss->cache->boundaries[symmetry_pass];
+  const SculptBoundaryNodeRegion *node_region = sculpt_boundary_node_region_get(boundary,
+                                                                                data->nodes[n]);
+  if (!node_region) {
+    return;
+  }
   const ePaintSymmetryFlags symm = SCULPT_mesh_symmetry_xyz_get(data->ob);
 
   const float strength = ss->cache->bstrength;
@@ -1909,7 +2185,8 @@ static void do_boundary_brush_circle_task_cb_ex(void *__restrict userdata,
   SCULPT_orig_vert_data_init(&orig_data, data->ob, data->nodes[n], SCULPT_UNDO_COORDS);
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
-    if (boundary->edit_info[vd.index].num_propagation_steps == -1) {
+    const int i = sculpt_boundary_node_region_index(node_region, &vd);
+    if (i == -1 || boundary->edit_info[i].num_propagation_steps == -1) {
       continue;
     }
 
@@ -1919,7 +2196,7 @@ static void do_boundary_brush_circle_task_cb_ex(void *__restrict userdata,
       continue;
     }
 
-    const int propagation_steps = boundary->edit_info[vd.index].num_propagation_steps;
+    const int propagation_steps = boundary->edit_info[i].num_propagation_steps;
     float *circle_origin = boundary->circle.origin[propagation_steps];
     float circle_disp[3];
     sub_v3_v3v3(circle_disp, circle_origin, orig_data.co);
@@ -1936,7 +2213,7 @@ static void do_boundary_brush_circle_task_cb_ex(void *__restrict userdata,
     madd_v3_v3v3fl(target_co,
                    vd.co,
                    disp,
-                   boundary->edit_info[vd.index].strength_factor * mask * automask * strength);
+                   boundary->edit_info[i].strength_factor * mask * automask * strength);
 
     if (vd.mvert) {
       BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
@@ -1947,9 +2224,6 @@ static void do_boundary_brush_circle_task_cb_ex(void *__restrict userdata,
 
 static void SCULPT_boundary_autosmooth(SculptSession *ss, SculptBoundary *boundary)
 {
-  PBVHNode **nodes;
-  int totnode;
-
   const int max_iterations = 4;
   const float fract = 1.0f / max_iterations;
   float bstrength = SCULPT_get_float(ss, autosmooth, NULL, ss->cache->brush);
@@ -1965,29 +2239,29 @@ static void SCULPT_boundary_autosmooth(SculptSession *ss, SculptBoundary *bounda
 
   BKE_curvemapping_init(ss->cache->brush->curve);
 
-  BKE_pbvh_get_nodes(ss->pbvh, PBVH_Leaf, &nodes, &totnode);
-
   float bound_smooth = SCULPT_get_float(ss, boundary_smooth, NULL, ss->cache->brush);
   float projection = SCULPT_get_float(ss, autosmooth_projection, NULL, ss->cache->brush);
   float slide_fset = SCULPT_get_float(ss, fset_slide, NULL, ss->cache->brush);
 
   for (int iteration = 0; iteration <= count; iteration++) {
-    for (int i = 0; i < totnode; i++) {
+    for (int n = 0; n < boundary->region.totnode; n++) {
       const float strength = (iteration != count) ? 1.0f : last;
 
-      PBVHNode *node = nodes[i];
+      const SculptBoundaryNodeRegion *node_region = &boundary->region.nodes[n];
+      PBVHNode *node = node_region->node;
       PBVHVertexIter vd;
 
       BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vd, PBVH_ITER_UNIQUE) {
-        if (boundary->boundary_dist[vd.index] == FLT_MAX) {
+        const int i = sculpt_boundary_node_region_index(node_region, &vd);
+        if (i == -1 || boundary->boundary_dist[i] == FLT_MAX) {
           continue;
         }
 
-        if (boundary->edit_info[vd.index].num_propagation_steps == BOUNDARY_STEPS_NONE) {
+        if (boundary->edit_info[i].num_propagation_steps == BOUNDARY_STEPS_NONE) {
           continue;
         }
 
-        float fac = boundary->boundary_dist[vd.index] / boundary_radius;
+        float fac = boundary->boundary_dist[i] / boundary_radius;
 
         if (fac > 1.0f) {
           continue;
@@ -2018,15 +2292,11 @@ static void SCULPT_boundary_autosmooth(SculptSession *ss, SculptBoundary *bounda
       BKE_pbvh_vertex_iter_end;
     }
   }
-
-  MEM_SAFE_FREE(nodes);
 }
 
 static void SCULPT_boundary_build_smoothco(SculptSession *ss, SculptBoundary *boundary)
 {
-  const int totvert = SCULPT_vertex_count_get(ss);
-  PBVHNode **nodes;
-  int totnode;
+  const int totvert = boundary->region.totvert;
 
   boundary->smoothco = MEM_calloc_arrayN(totvert, sizeof(float) * 3, "boundary->smoothco");
 
@@ -2034,44 +2304,33 @@ static void SCULPT_boundary_build_smoothco(SculptSession *ss, SculptBoundary *bo
   float projection = SCULPT_get_float(ss, autosmooth_projection, NULL, ss->cache->brush);
   float slide_fset = SCULPT_get_float(ss, fset_slide, NULL, ss->cache->brush);
 
-  BKE_pbvh_get_nodes(ss->pbvh, PBVH_Leaf, &nodes, &totnode);
-
-  for (int iteration = 0; iteration < 3; iteration++) {
-    for (int i = 0; i < totnode; i++) {
-      PBVHNode *node = nodes[i];
-      PBVHVertexIter vd;
-
-      BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vd, PBVH_ITER_UNIQUE) {
-        if (boundary->boundary_dist[vd.index] == FLT_MAX) {
-          continue;
-        }
+  /* Nothing is written back to the mesh, so a single pass gives the final coordinates. */
+  for (int i = 0; i < totvert; i++) {
+    if (boundary->boundary_dist[i] == FLT_MAX) {
+      continue;
+    }
 
-        float sco[3];
+    const SculptVertRef vertex = boundary->region.verts[i];
+    float sco[3];
 
-        SCULPT_neighbor_coords_average_interior(
-            ss,
-            sco,
-            vd.vertex,
-            &((SculptSmoothArgs){.projection = projection,
-                                 .slide_fset = slide_fset,
-                                 .bound_smooth = bound_smooth,
-                                 .do_weighted_smooth = ss->cache->brush->flag2 &
-                                                       BRUSH_SMOOTH_USE_AREA_WEIGHT,
-                                 .preserve_fset_boundaries = ss->cache->brush->flag2 &
-                                                             BRUSH_SMOOTH_PRESERVE_FACE_SETS}));
+    SCULPT_neighbor_coords_average_interior(
+        ss,
+        sco,
+        vertex,
+        &((SculptSmoothArgs){.projection = projection,
+                             .slide_fset = slide_fset,
+                             .bound_smooth = bound_smooth,
+                             .do_weighted_smooth = ss->cache->brush->flag2 &
+                                                   BRUSH_SMOOTH_USE_AREA_WEIGHT,
+                             .preserve_fset_boundaries = ss->cache->brush->flag2 &
+                                                         BRUSH_SMOOTH_PRESERVE_FACE_SETS}));
 
-        float *co = SCULPT_brush_deform_target_vertex_co_get(ss, boundary->deform_target, &vd);
-
-        interp_v3_v3v3(sco, sco, co, 0.25);
-        BKE_pbvh_node_mark_update(node);
+    const float *co = boundary->deform_target == BRUSH_DEFORM_TARGET_CLOTH_SIM ?
+                          ss->cache->cloth_sim->deformation_pos[boundary->region.indices[i]] :
+                          SCULPT_vertex_co_get(ss, vertex);
 
-        copy_v3_v3(boundary->smoothco[vd.index], sco);
-      }
-      BKE_pbvh_vertex_iter_end;
-    }
+    interp_v3_v3v3(boundary->smoothco[i], sco, co, 0.25);
   }
-
-  MEM_SAFE_FREE(nodes);
 }
 
 /* Main Brush Function. */
@@ -2132,27 +2391,23 @@ void SCULPT_do_boundary_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totn
 
     if (ss->bm && ss->cache->boundaries[symm_area] &&
         ss->cache->boundaries[symm_area]->boundary_dist) {
-      PBVHNode **nodes2;
-      int totnode2 = 0;
-
-      BKE_pbvh_get_nodes(ss->pbvh, PBVH_Leaf, &nodes2, &totnode2);
+      const SculptBoundary *boundary = ss->cache->boundaries[symm_area];
 
-      for (int i = 0; i < totnode2; i++) {
-        PBVHNode *node = nodes2[i];
-        PBVHVertexIter vd;
+      for (int i = 0; i < boundary->region.totnode; i++) {
+        const SculptBoundaryNodeRegion *node_region = &boundary->region.nodes[i];
 
         bool ok = false;
 
-        BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vd, PBVH_ITER_UNIQUE) {
-          if (ss->cache->boundaries[symm_area]->boundary_dist[vd.index] != FLT_MAX) {
+        for (int j = 0; j < node_region->totindices; j++) {
+          const int region_i = node_region->indices[j];
+          if (region_i != -1 && boundary->boundary_dist[region_i] != FLT_MAX) {
             ok = true;
             break;
           }
         }
-        BKE_pbvh_vertex_iter_end;
 
         if (ok) {
-          SCULPT_ensure_dyntopo_node_undo(ob, node, SCULPT_UNDO_COORDS, -1);
+          SCULPT_ensure_dyntopo_node_undo(ob, node_region->node, SCULPT_UNDO_COORDS, -1);
         }
       }
     }
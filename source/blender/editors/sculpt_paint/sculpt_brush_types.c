@@ -368,6 +368,27 @@ static void do_pbr_brush_task_cb_ex(void *__restrict userdata,
   BKE_pbvh_vertex_iter_end;
 }
 
+static void do_draw_brush_batch(SculptSession *ss,
+                                const Brush *brush,
+                                SculptBrushBatch *batch,
+                                const float offset[3],
+                                float (*proxy)[3],
+                                const int thread_id)
+{
+  SCULPT_brush_strength_factor_batch(ss, brush, batch, thread_id);
+
+  for (int i = 0; i < batch->totvert; i++) {
+    /* Offset vertex. */
+    mul_v3_v3fl(proxy[batch->index[i]], offset, batch->fade[i]);
+
+    if (batch->is_mvert[i]) {
+      BKE_pbvh_vert_mark_update(ss->pbvh, batch->vertex[i]);
+    }
+  }
+
+  batch->totvert = 0;
+}
+
 static void do_draw_brush_task_cb_ex(void *__restrict userdata,
                                      const int n,
                                      const TaskParallelTLS *__restrict tls)
@@ -387,28 +408,23 @@ static void do_draw_brush_task_cb_ex(void *__restrict userdata,
       ss, &test, data->brush->falloff_shape);
   const int thread_id = BLI_task_parallel_thread_id(tls);
 
+  SculptBrushBatch batch;
+  batch.totvert = 0;
+
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
     if (!sculpt_brush_test_sq_fn(&test, vd.co)) {
       continue;
     }
-    /* Offset vertex. */
-    const float fade = SCULPT_brush_strength_factor(ss,
-                                                    brush,
-                                                    vd.co,
-                                                    sqrtf(test.dist),
-                                                    vd.no,
-                                                    vd.fno,
-                                                    vd.mask ? *vd.mask : 0.0f,
-                                                    vd.vertex,
-                                                    thread_id);
-
-    mul_v3_v3fl(proxy[vd.i], offset, fade);
 
-    if (vd.mvert) {
-      BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
+    if (SCULPT_brush_batch_add(&batch, &vd, test.dist)) {
+      do_draw_brush_batch(ss, brush, &batch, offset, proxy, thread_id);
     }
   }
   BKE_pbvh_vertex_iter_end;
+
+  if (batch.totvert) {
+    do_draw_brush_batch(ss, brush, &batch, offset, proxy, thread_id);
+  }
 }
 
 void SCULPT_do_pbr_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -1291,6 +1307,34 @@ static void calc_clay_surface_reduce(const void *__restrict UNUSED(userdata),
   join->plane_dist[1] = MIN2(csd->plane_dist[1], join->plane_dist[1]);
 }
 
+static void do_clay_brush_batch(SculptSession *ss,
+                                const Brush *brush,
+                                SculptBrushBatch *batch,
+                                const float plane_tool[4],
+                                const float bstrength,
+                                float (*proxy)[3],
+                                const int thread_id)
+{
+  SCULPT_brush_strength_factor_batch(ss, brush, batch, thread_id);
+
+  for (int i = 0; i < batch->totvert; i++) {
+    const float *co = batch->co[i];
+    float intr[3];
+    float val[3];
+    closest_to_plane_normalized_v3(intr, plane_tool, co);
+
+    sub_v3_v3v3(val, intr, co);
+
+    mul_v3_v3fl(proxy[batch->index[i]], val, bstrength * batch->fade[i]);
+
+    if (batch->is_mvert[i]) {
+      BKE_pbvh_vert_mark_update(ss->pbvh, batch->vertex[i]);
+    }
+  }
+
+  batch->totvert = 0;
+}
+
 static void do_clay_brush_task_cb_ex(void *__restrict userdata,
                                      const int n,
                                      const TaskParallelTLS *__restrict tls)
@@ -1314,6 +1358,9 @@ static void do_clay_brush_task_cb_ex(void *__restrict userdata,
 
   plane_from_point_normal_v3(test.plane_tool, area_co, area_no);
 
+  SculptBrushBatch batch;
+  batch.totvert = 0;
+
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
     if (!sculpt_brush_test_sq_fn(&test, vd.co)) {
       continue;
@@ -1321,30 +1368,16 @@ static void do_clay_brush_task_cb_ex(void *__restrict userdata,
 
     SCULPT_vertex_check_origdata(ss, vd.vertex);
 
-    float intr[3];
-    float val[3];
-    closest_to_plane_normalized_v3(intr, test.plane_tool, vd.co);
-
-    sub_v3_v3v3(val, intr, vd.co);
-
-    const float fade = bstrength * SCULPT_brush_strength_factor(ss,
-                                                                brush,
-                                                                vd.co,
-                                                                sqrtf(test.dist),
-                                                                vd.no,
-                                                                vd.fno,
-                                                                vd.mask ? *vd.mask : 0.0f,
-                                                                vd.vertex,
-                                                                thread_id);
-
-    mul_v3_v3fl(proxy[vd.i], val, fade);
-
-    if (vd.mvert) {
-      BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
+    if (SCULPT_brush_batch_add(&batch, &vd, test.dist)) {
+      do_clay_brush_batch(ss, brush, &batch, test.plane_tool, bstrength, proxy, thread_id);
     }
   }
   BKE_pbvh_vertex_iter_end;
 
+  if (batch.totvert) {
+    do_clay_brush_batch(ss, brush, &batch, test.plane_tool, bstrength, proxy, thread_id);
+  }
+
   BKE_pbvh_node_mark_update(data->nodes[n]);
 }
 
@@ -2325,6 +2358,46 @@ void SCULPT_do_nudge_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
   BLI_task_parallel_range(0, totnode, &data, do_nudge_brush_task_cb_ex, &settings);
 }
 
+static void do_crease_brush_batch(SculptSession *ss,
+                                  const Brush *brush,
+                                  SculptBrushBatch *batch,
+                                  SculptProjectVector *spvc,
+                                  const float location[3],
+                                  const float offset[3],
+                                  const float flippedbstrength,
+                                  float (*proxy)[3],
+                                  const int thread_id)
+{
+  SCULPT_brush_strength_factor_batch(ss, brush, batch, thread_id);
+
+  for (int i = 0; i < batch->totvert; i++) {
+    const float fade = batch->fade[i];
+    float val1[3];
+    float val2[3];
+
+    /* First we pinch. */
+    sub_v3_v3v3(val1, location, batch->co[i]);
+    if (brush->falloff_shape == PAINT_FALLOFF_SHAPE_TUBE) {
+      project_plane_v3_v3v3(val1, val1, ss->cache->view_normal);
+    }
+
+    mul_v3_fl(val1, fade * flippedbstrength);
+
+    sculpt_project_v3(spvc, val1, val1);
+
+    /* Then we draw. */
+    mul_v3_v3fl(val2, offset, fade);
+
+    add_v3_v3v3(proxy[batch->index[i]], val1, val2);
+
+    if (batch->is_mvert[i]) {
+      BKE_pbvh_vert_mark_update(ss->pbvh, batch->vertex[i]);
+    }
+  }
+
+  batch->totvert = 0;
+}
+
 /**
  * Used for 'SCULPT_TOOL_CREASE' and 'SCULPT_TOOL_BLOB'
  */
@@ -2349,44 +2422,25 @@ static void do_crease_brush_task_cb_ex(void *__restrict userdata,
       ss, &test, data->brush->falloff_shape);
   const int thread_id = BLI_task_parallel_thread_id(tls);
 
+  SculptBrushBatch batch;
+  batch.totvert = 0;
+
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
     if (!sculpt_brush_test_sq_fn(&test, vd.co)) {
       continue;
     }
 
-    /* Offset vertex. */
-    const float fade = SCULPT_brush_strength_factor(ss,
-                                                    brush,
-                                                    vd.co,
-                                                    sqrtf(test.dist),
-                                                    vd.no,
-                                                    vd.fno,
-                                                    vd.mask ? *vd.mask : 0.0f,
-                                                    vd.vertex,
-                                                    thread_id);
-    float val1[3];
-    float val2[3];
-
-    /* First we pinch. */
-    sub_v3_v3v3(val1, test.location, vd.co);
-    if (brush->falloff_shape == PAINT_FALLOFF_SHAPE_TUBE) {
-      project_plane_v3_v3v3(val1, val1, ss->cache->view_normal);
-    }
-
-    mul_v3_fl(val1, fade * flippedbstrength);
-
-    sculpt_project_v3(spvc, val1, val1);
-
-    /* Then we draw. */
-    mul_v3_v3fl(val2, offset, fade);
-
-    add_v3_v3v3(proxy[vd.i], val1, val2);
-
-    if (vd.mvert) {
-      BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
+    if (SCULPT_brush_batch_add(&batch, &vd, test.dist)) {
+      do_crease_brush_batch(
+          ss, brush, &batch, spvc, test.location, offset, flippedbstrength, proxy, thread_id);
     }
   }
   BKE_pbvh_vertex_iter_end;
+
+  if (batch.totvert) {
+    do_crease_brush_batch(
+        ss, brush, &batch, spvc, test.location, offset, flippedbstrength, proxy, thread_id);
+  }
 }
 
 void SCULPT_do_crease_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
@@ -2647,8 +2701,8 @@ void SCULPT_do_grab_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
       float location[3];
       flip_v3_v3(location, SCULPT_active_vertex_co_get(ss), symm_pass);
       SculptVertRef v = SCULPT_nearest_vertex_get(sd, ob, location, ss->cache->radius, false);
-      ss->cache->geodesic_dists[symm_pass] = SCULPT_geodesic_from_vertex(
-          ob, v, ss->cache->initial_radius);
+      ss->cache->geodesic_dists[symm_pass] = SCULPT_geodesic_from_vertex_symm_pass(
+          ob, ss->cache, v, ss->cache->initial_radius);
     }
   }
 
@@ -2787,7 +2841,8 @@ void SCULPT_do_elastic_deform_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, in
       flip_v3_v3(location, SCULPT_active_vertex_co_get(ss), symm_pass);
       SculptVertRef v = SCULPT_nearest_vertex_get(
           sd, ob, location, ss->cache->initial_radius, false);
-      ss->cache->geodesic_dists[symm_pass] = SCULPT_geodesic_from_vertex(ob, v, FLT_MAX);
+      ss->cache->geodesic_dists[symm_pass] = SCULPT_geodesic_from_vertex_symm_pass(
+          ob, ss->cache, v, FLT_MAX);
     }
   }
 
@@ -9,11 +9,15 @@
 
 #include "BLI_blenlib.h"
 #include "BLI_dial_2d.h"
+#include "BLI_dynstr.h"
 #include "BLI_edgehash.h"
 #include "BLI_gsqueue.h"
 #include "BLI_hash.h"
+#include "BLI_hash_mm2a.h"
 #include "BLI_math.h"
+#include "BLI_math_bits.h"
 #include "BLI_rand.h"
+#include "BLI_simd.h"
 #include "BLI_task.h"
 #include "BLI_utildefines.h"
 
@@ -84,10 +88,18 @@
 #include "bmesh.h"
 #include "bmesh_tools.h"
 
+#include "PIL_time.h"
+
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
+//#define DEBUG_TIME
+
+#ifdef DEBUG_TIME
+#  include "PIL_time_utildefines.h"
+#endif
+
 /* Experimental features. */
 
 #define USE_SOLVER_RIPPLE_CONSTRAINT false
@@ -565,33 +577,63 @@ static bool cloth_brush_sim_has_bend_constraint(SculptClothSimulation *cloth_sim
   return BLI_edgeset_haskey(cloth_sim->created_bend_constraints, v1, v2);
 }
 
-typedef struct SculptClothTaskData {
-  SculptClothConstraint **constraints[TOT_CONSTRAINT_TYPES];
-  int tot_constraints[TOT_CONSTRAINT_TYPES];
-} SculptClothTaskData;
-
-static void cloth_free_tasks(SculptClothSimulation *cloth_sim)
-{
-  // printf("Freeing tasks %d\n", BLI_task_parallel_thread_id(NULL));
-
-  for (int i = 0; i < cloth_sim->tot_constraint_tasks; i++) {
-    for (int j = 0; j < TOT_CONSTRAINT_TYPES; j++) {
-      MEM_SAFE_FREE(cloth_sim->constraint_tasks[i].constraints[j]);
-    }
-  }
+/* Kinds of constraints the solver runs separate loops for. */
+typedef enum eClothSolverBatch {
+  CLOTH_BATCH_STRUCTURAL,
+  CLOTH_BATCH_SOFTBODY,
+  CLOTH_BATCH_PIN,
+  CLOTH_BATCH_DEFORMATION,
+  CLOTH_BATCH_BEND,
+} eClothSolverBatch;
+#define CLOTH_BATCH_TOT 5
+
+/* Colors fit in a 64 bit mask per vertex while coloring. */
+#define CLOTH_SOLVER_MAX_COLORS 64
+#define CLOTH_SOLVER_BLOCK_SIZE 1024
+
+/* Range of constraints of a single kind and color, solved by one task. */
+typedef struct SculptClothSolverBlock {
+  eClothSolverBatch batch;
+  int start, end;
+  /* Part of the serial color, its constraints may share vertices. */
+  bool serial;
+} SculptClothSolverBlock;
+
+typedef struct SculptClothSolver {
+  /* #SculptClothSimulation.tot_constraints this was built for. */
+  int tot_constraints[2];
+
+  /* Length constraints, sorted by color and kind. */
+  int totlength;
+  int *length_v1, *length_v2;
+  float *length, *length_strength;
+  short *length_node;
+
+  /* Bend constraints sorted by color, as indices into #SculptClothSimulation.constraints. */
+  int totbend;
+  int *bend;
+
+  /* Rest lengths and vertex weights, updated once per simulation step. */
+  float *length_rest;
+  float *length_w1, *length_w2;
+  float (*bend_w)[4];
+
+  SculptClothSolverBlock *blocks;
+  int totblock;
+
+  /* Blocks of color `i` are in `[color_blocks[i], color_blocks[i + 1])`. */
+  int color_blocks[CLOTH_SOLVER_MAX_COLORS + 2];
+  int totcolor;
+
+  /* The last color holds the constraints that didn't fit in any color, it's solved serially. */
+  bool has_serial_color;
+} SculptClothSolver;
 
-  MEM_SAFE_FREE(cloth_sim->constraint_tasks);
-  cloth_sim->constraint_tasks = NULL;
-  cloth_sim->tot_constraint_tasks = 0;
-}
 
 static void cloth_brush_reallocate_constraints(SculptClothSimulation *cloth_sim)
 {
-  bool modified = false;
-
   for (int i = 0; i < TOT_CONSTRAINT_TYPES; i++) {
     if (cloth_sim->tot_constraints[i] >= cloth_sim->capacity_constraints[i]) {
-      modified = true;
       cloth_sim->capacity_constraints[i] += CLOTH_LENGTH_CONSTRAINTS_BLOCK;
 
       cloth_sim->constraints[i] = MEM_reallocN_id(cloth_sim->constraints[i],
@@ -600,10 +642,6 @@ static void cloth_brush_reallocate_constraints(SculptClothSimulation *cloth_sim)
                                                   "cloth constraint array");
     }
   }
-
-  if (modified && cloth_sim->constraint_tasks) {
-    cloth_free_tasks(cloth_sim);
-  }
 }
 
 static void *cloth_add_constraint(SculptClothSimulation *cloth_sim, int type)
@@ -1653,390 +1691,735 @@ static void do_cloth_brush_solve_simulation_task_cb_ex(
   cloth_sim->node_state[node_index] = SCULPT_CLOTH_NODE_INACTIVE;
 }
 
-static void cloth_sort_constraints_for_tasks(SculptSession *ss,
-                                             Brush *brush,
-                                             SculptClothSimulation *cloth_sim,
-                                             int totthread)
+/* -------------------------------------------------------------------- */
+/** \name Constraint Solver
+ *
+ * Constraints are greedily graph colored so no two constraints of the same color share a vertex,
+ * which lets every color be solved in parallel without locking. Inside a color the constraints
+ * are sorted by kind and copied into flat arrays, so each kind is solved by a tight loop that
+ * doesn't branch on the constraint type.
+ * \{ */
+
+static int cloth_solver_color_get(uint64_t *vert_colors, const int *verts, const int totvert)
 {
-  SculptClothTaskData *tasks = MEM_calloc_arrayN(
-      totthread + 1, sizeof(SculptClothTaskData), "SculptClothTaskData");
+  uint64_t used = 0;
+  for (int i = 0; i < totvert; i++) {
+    used |= vert_colors[verts[i]];
+  }
 
-  int *vthreads = MEM_calloc_arrayN(
-      SCULPT_vertex_count_get(ss), sizeof(*vthreads), "cloth vthreads");
+  if (used == UINT64_MAX) {
+    return CLOTH_SOLVER_MAX_COLORS;
+  }
 
-  SculptClothConstraint *con;
-  int totcon;
+  const int color = (int)bitscan_forward_uint64(~used);
+  for (int i = 0; i < totvert; i++) {
+    vert_colors[verts[i]] |= (uint64_t)1 << color;
+  }
 
-  RNG *rng = BLI_rng_new(BLI_thread_rand(0));
+  return color;
+}
 
-  bool not_dynamic = cloth_sim->simulation_area_type != BRUSH_CLOTH_SIMULATION_AREA_DYNAMIC;
+static eClothSolverBatch cloth_solver_length_batch_get(
+    const SculptClothLengthConstraint *constraint)
+{
+  switch (constraint->type) {
+    case SCULPT_CLOTH_CONSTRAINT_SOFTBODY:
+      return CLOTH_BATCH_SOFTBODY;
+    case SCULPT_CLOTH_CONSTRAINT_PIN:
+      return CLOTH_BATCH_PIN;
+    case SCULPT_CLOTH_CONSTRAINT_DEFORMATION:
+      return CLOTH_BATCH_DEFORMATION;
+    case SCULPT_CLOTH_CONSTRAINT_STRUCTURAL:
+      break;
+  }
+  return CLOTH_BATCH_STRUCTURAL;
+}
+
+static SculptClothSolver *cloth_solver_build(const int totvert, SculptClothSimulation *cloth_sim)
+{
+  SculptClothSolver *solver = MEM_callocN(sizeof(SculptClothSolver), __func__);
+  const SculptClothLengthConstraint *length_constraints = (SculptClothLengthConstraint *)
+                                                              cloth_sim->constraints[CON_LENGTH];
+  const int totlength = cloth_sim->tot_constraints[CON_LENGTH];
+#ifdef BENDING_CONSTRAINTS
+  const SculptClothBendConstraint *bend_constraints = (SculptClothBendConstraint *)
+                                                          cloth_sim->constraints[CON_BEND];
+  const int totbend = cloth_sim->tot_constraints[CON_BEND];
+#else
+  const int totbend = 0;
+#endif
 
-  // for (int ctype = 0; ctype < TOT_CONSTRAINT_TYPES; ctype++) {
-  /* start with bending constraints since they have more vertices */
-  for (int ctype = TOT_CONSTRAINT_TYPES - 1; ctype >= 0; ctype--) {
-    con = cloth_sim->constraints[ctype];
-    totcon = cloth_sim->tot_constraints[ctype];
+  memcpy(solver->tot_constraints, cloth_sim->tot_constraints, sizeof(solver->tot_constraints));
 
-    int size = (int)constraint_types[ctype].size;
-    int totelem = constraint_types[ctype].totelem;
+  uint64_t *vert_colors = MEM_calloc_arrayN(totvert, sizeof(uint64_t), __func__);
+  uchar *colors = MEM_malloc_arrayN(totlength + totbend, sizeof(uchar), __func__);
+  int counts[CLOTH_SOLVER_MAX_COLORS + 1][CLOTH_BATCH_TOT] = {{0}};
 
-#if 0
-    int *order = MEM_malloc_arrayN(totcon, sizeof(*order), "rand order");
-    for (int i = 0; i < totcon; i++) {
-      order[i] = i;
+#ifdef BENDING_CONSTRAINTS
+  /* Start with the bending constraints, they touch more vertices and are harder to place. */
+  for (int i = 0; i < totbend; i++) {
+    int verts[4];
+    for (int j = 0; j < 4; j++) {
+      verts[j] = UNPACK_POS_INDEX(bend_constraints[i].elems[j].index);
     }
-    BLI_rng_shuffle_array(rng, order, sizeof(*order), totcon);
+
+    const int color = cloth_solver_color_get(vert_colors, verts, 4);
+    colors[totlength + i] = (uchar)color;
+    counts[color][CLOTH_BATCH_BEND]++;
+  }
 #endif
 
-    char *ptr = (char *)cloth_sim->constraints[ctype];
+  for (int i = 0; i < totlength; i++) {
+    const int verts[2] = {UNPACK_POS_INDEX(length_constraints[i].elems[0].index),
+                          UNPACK_POS_INDEX(length_constraints[i].elems[1].index)};
+
+    const int color = cloth_solver_color_get(vert_colors, verts, verts[0] == verts[1] ? 1 : 2);
+    colors[i] = (uchar)color;
+    counts[color][cloth_solver_length_batch_get(&length_constraints[i])]++;
+  }
 
-    for (int _i = 0; _i < totcon; _i++) {
-      int i = _i;  // order[_i];
-      con = (SculptClothConstraint *)(ptr + size * i);
+  MEM_freeN(vert_colors);
 
-      bool ok = true;
-      int last = 0, same = true;
+  /* Colors are handed out first-fit so the used ones are contiguous, constraints that didn't fit
+   * in any color are appended as a last color that is solved serially. */
+  int color_map[CLOTH_SOLVER_MAX_COLORS + 1];
+  int totcolor = 0;
+  for (int c = 0; c <= CLOTH_SOLVER_MAX_COLORS; c++) {
+    int tot = 0;
+    for (int b = 0; b < CLOTH_BATCH_TOT; b++) {
+      tot += counts[c][b];
+      solver->totblock += (counts[c][b] + CLOTH_SOLVER_BLOCK_SIZE - 1) / CLOTH_SOLVER_BLOCK_SIZE;
+    }
+    color_map[c] = tot ? totcolor++ : -1;
+  }
+  solver->totcolor = totcolor;
+  solver->has_serial_color = color_map[CLOTH_SOLVER_MAX_COLORS] != -1;
+
+  solver->totlength = totlength;
+  solver->length_v1 = MEM_malloc_arrayN(totlength, sizeof(int), __func__);
+  solver->length_v2 = MEM_malloc_arrayN(totlength, sizeof(int), __func__);
+  solver->length = MEM_malloc_arrayN(totlength, sizeof(float), __func__);
+  solver->length_strength = MEM_malloc_arrayN(totlength, sizeof(float), __func__);
+  solver->length_node = MEM_malloc_arrayN(totlength, sizeof(short), __func__);
+  solver->length_rest = MEM_malloc_arrayN(totlength, sizeof(float), __func__);
+  solver->length_w1 = MEM_malloc_arrayN(totlength, sizeof(float), __func__);
+  solver->length_w2 = MEM_malloc_arrayN(totlength, sizeof(float), __func__);
+
+  solver->totbend = totbend;
+  solver->bend = MEM_malloc_arrayN(totbend, sizeof(int), __func__);
+  solver->bend_w = MEM_malloc_arrayN(totbend, sizeof(*solver->bend_w), __func__);
+
+  solver->blocks = MEM_malloc_arrayN(solver->totblock, sizeof(SculptClothSolverBlock), __func__);
+
+  /* Split every (color, kind) range into blocks and turn the counts into write offsets. */
+  int length_offset = 0, bend_offset = 0, totblock = 0;
+  for (int c = 0; c <= CLOTH_SOLVER_MAX_COLORS; c++) {
+    if (color_map[c] == -1) {
+      continue;
+    }
 
-      for (int j = 0; j < totelem; j++) {
-        int threadnr = vthreads[UNPACK_POS_INDEX(con->elems[j].index)];
+    solver->color_blocks[color_map[c]] = totblock;
 
-        if (threadnr) {
-          ok = false;
-        }
+    for (int b = 0; b < CLOTH_BATCH_TOT; b++) {
+      int *offset = b == CLOTH_BATCH_BEND ? &bend_offset : &length_offset;
+      const int start = *offset;
 
-        if (j > 0 && threadnr && last && threadnr != last) {
-          same = false;
-        }
+      *offset += counts[c][b];
+      counts[c][b] = start;
 
-        if (threadnr) {
-          last = threadnr;
-        }
+      for (int i = start; i < *offset; i += CLOTH_SOLVER_BLOCK_SIZE) {
+        SculptClothSolverBlock *block = solver->blocks + totblock++;
+        block->batch = (eClothSolverBatch)b;
+        block->start = i;
+        block->end = min_ii(i + CLOTH_SOLVER_BLOCK_SIZE, *offset);
+        block->serial = c == CLOTH_SOLVER_MAX_COLORS;
       }
+    }
+  }
+  solver->color_blocks[totcolor] = totblock;
 
-      int tasknr;
-      if (ok) {
-        tasknr = BLI_rng_get_int(rng) % totthread;
+  for (int i = 0; i < totlength; i++) {
+    const SculptClothLengthConstraint *constraint = &length_constraints[i];
+    const int j = counts[colors[i]][cloth_solver_length_batch_get(constraint)]++;
 
-        for (int j = 0; j < totelem; j++) {
-          vthreads[UNPACK_POS_INDEX(con->elems[j].index)] = tasknr + 1;
-        }
-      }
-      else if (same) {
-        tasknr = last - 1;
+    solver->length_v1[j] = UNPACK_POS_INDEX(constraint->elems[0].index);
+    solver->length_v2[j] = UNPACK_POS_INDEX(constraint->elems[1].index);
+    solver->length[j] = constraint->length;
+    solver->length_strength[j] = constraint->strength;
+    solver->length_node[j] = constraint->node;
+  }
 
-        for (int j = 0; j < totelem; j++) {
-          vthreads[UNPACK_POS_INDEX(con->elems[j].index)] = tasknr + 1;
-        }
-      }
-      else {
-        tasks[totthread].tot_constraints[ctype]++;
+  for (int i = 0; i < totbend; i++) {
+    solver->bend[counts[colors[totlength + i]][CLOTH_BATCH_BEND]++] = i;
+  }
+
+  MEM_freeN(colors);
+
+  return solver;
+}
+
+static void cloth_solver_free(SculptClothSolver *solver)
+{
+  MEM_SAFE_FREE(solver->length_v1);
+  MEM_SAFE_FREE(solver->length_v2);
+  MEM_SAFE_FREE(solver->length);
+  MEM_SAFE_FREE(solver->length_strength);
+  MEM_SAFE_FREE(solver->length_node);
+  MEM_SAFE_FREE(solver->length_rest);
+  MEM_SAFE_FREE(solver->length_w1);
+  MEM_SAFE_FREE(solver->length_w2);
+  MEM_SAFE_FREE(solver->bend);
+  MEM_SAFE_FREE(solver->bend_w);
+  MEM_SAFE_FREE(solver->blocks);
+  MEM_freeN(solver);
+}
+
+typedef struct ClothSolverTaskData {
+  SculptSession *ss;
+  const Brush *brush;
+  SculptClothSimulation *cloth_sim;
+  SculptClothSolver *solver;
+  AutomaskingCache *automasking;
+  float sim_location[3];
+  bool solve_bend;
+  bool use_simd;
+} ClothSolverTaskData;
+
+static float cloth_solver_sim_factor_get(const ClothSolverTaskData *data, const int v)
+{
+  const SculptSession *ss = data->ss;
 
-        con->thread_nr = -1;
+  if (!ss->cache) {
+    return 1.0f;
+  }
+  return cloth_brush_simulation_falloff_get(data->cloth_sim,
+                                            data->brush,
+                                            ss->cache->radius,
+                                            data->sim_location,
+                                            data->cloth_sim->init_pos[v]);
+}
+
+static float cloth_solver_length_factor_get(const ClothSolverTaskData *data, const int v)
+{
+  SculptSession *ss = data->ss;
+  const SculptVertRef vref = BKE_pbvh_table_index_to_vertex(ss->pbvh, v);
+  const float mask = (1.0f - SCULPT_vertex_mask_get(ss, vref)) *
+                     SCULPT_automasking_factor_get(data->automasking, ss, vref);
+
+  return mask * cloth_solver_sim_factor_get(data, v);
+}
+
+/* Masking, automasking, simulation falloff and deformation strength don't change while the
+ * constraints are iterated, so they are folded into per-constraint weights once per step.
+ * Constraints of inactive nodes get zero weights instead of being skipped by the solver. */
+static void cloth_solver_update_weights_cb(void *__restrict userdata,
+                                           const int n,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ClothSolverTaskData *data = (ClothSolverTaskData *)userdata;
+  SculptClothSimulation *cloth_sim = data->cloth_sim;
+  SculptClothSolver *solver = data->solver;
+  const SculptClothSolverBlock *block = solver->blocks + n;
+
+  if (block->batch == CLOTH_BATCH_BEND) {
+#ifdef BENDING_CONSTRAINTS
+    const SculptClothBendConstraint *bend_constraints = (SculptClothBendConstraint *)
+                                                            cloth_sim->constraints[CON_BEND];
+
+    for (int i = block->start; i < block->end; i++) {
+      const SculptClothBendConstraint *constraint = &bend_constraints[solver->bend[i]];
+      float *w = solver->bend_w[i];
+
+      if (cloth_sim->node_state[constraint->node] != SCULPT_CLOTH_NODE_ACTIVE) {
+        zero_v4(w);
         continue;
       }
 
-      con->thread_nr = tasknr;
-      tasks[tasknr].tot_constraints[ctype]++;
+      for (int j = 0; j < 4; j++) {
+        const int v = UNPACK_POS_INDEX(constraint->elems[j].index);
 
-      /*propagate thread nr to adjacent verts, unless in
-        dynamic mode where the performance benefits are
-        not worth it*/
-      for (int step = 0; not_dynamic && step < totelem; step++) {
-        int v = UNPACK_POS_INDEX(con->elems[step].index);
+        /* Increase strength of bending constraints. */
+        w[j] = sqrtf(cloth_solver_sim_factor_get(data, v));
 
-        SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, v);
-        SculptVertexNeighborIter ni;
-
-        SCULPT_VERTEX_NEIGHBORS_ITER_BEGIN (ss, vertex, ni) {
-          if (!vthreads[ni.index]) {
-            vthreads[ni.index] = tasknr + 1;
-          }
+        if (w[j] == 0.0f) {
+          continue;
         }
-        SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
+
+        SculptVertRef vref = BKE_pbvh_table_index_to_vertex(data->ss->pbvh, v);
+        w[j] *= SCULPT_automasking_factor_get(data->automasking, data->ss, vref) * 1.0f -
+                SCULPT_vertex_mask_get(data->ss, vref);
       }
     }
+#endif
+    return;
   }
 
-  int tottask = totthread + 1;
-  for (int i = 0; i < tottask; i++) {
-    for (int j = 0; j < TOT_CONSTRAINT_TYPES; j++) {
-      tasks[i].constraints[j] = MEM_malloc_arrayN(
-          tasks[i].tot_constraints[j], sizeof(void *), "cloth task data");
-      tasks[i].tot_constraints[j] = 0;
+  const float softbody_plasticity = data->brush ? data->brush->cloth_constraint_softbody_strength :
+                                                  0.0f;
+
+  for (int i = block->start; i < block->end; i++) {
+    const int v1 = solver->length_v1[i];
+    const int v2 = solver->length_v2[i];
+
+    solver->length_rest[i] = solver->length[i] + (cloth_sim->length_constraint_tweak[v1] * 0.5f) +
+                             (cloth_sim->length_constraint_tweak[v2] * 0.5f);
+
+    if (cloth_sim->node_state[solver->length_node[i]] != SCULPT_CLOTH_NODE_ACTIVE) {
+      solver->length_w1[i] = solver->length_w2[i] = 0.0f;
+      continue;
+    }
+
+    const float strength = solver->length_strength[i];
+    const float factor_v1 = cloth_solver_length_factor_get(data, v1);
+
+    switch (block->batch) {
+      case CLOTH_BATCH_STRUCTURAL:
+        solver->length_w1[i] = factor_v1 * strength;
+        solver->length_w2[i] = cloth_solver_length_factor_get(data, v2) * strength;
+        break;
+      case CLOTH_BATCH_SOFTBODY:
+        solver->length_w1[i] = factor_v1 * strength * softbody_plasticity;
+        solver->length_w2[i] = factor_v1 * strength * (1.0f - softbody_plasticity);
+        break;
+      case CLOTH_BATCH_PIN:
+        solver->length_w1[i] = factor_v1 * strength;
+        solver->length_w2[i] = 0.0f;
+        break;
+      case CLOTH_BATCH_DEFORMATION:
+        solver->length_w1[i] = factor_v1 * strength * cloth_sim->deformation_strength[v1];
+        solver->length_w2[i] = 0.0f;
+        break;
+      case CLOTH_BATCH_BEND:
+        BLI_assert_unreachable();
+        break;
     }
   }
+}
 
-  for (int ctype = 0; ctype < TOT_CONSTRAINT_TYPES; ctype++) {
-    con = cloth_sim->constraints[ctype];
-    totcon = cloth_sim->tot_constraints[ctype];
-    int size = (int)constraint_types[ctype].size;
+#ifdef BLI_HAVE_SSE2
+BLI_INLINE __m128 cloth_solver_gather(float (*co)[3], const int *index, const int axis)
+{
+  return _mm_setr_ps(
+      co[index[0]][axis], co[index[1]][axis], co[index[2]][axis], co[index[3]][axis]);
+}
 
-    for (int i = 0; i < totcon; i++, con = (SculptClothConstraint *)(((char *)con) + size)) {
-      int tasknr = con->thread_nr;
-      if (tasknr == -1) {
-        tasknr = totthread;
-      }
+BLI_INLINE void cloth_solver_scatter(float (*co)[3],
+                                     const int *index,
+                                     const int axis,
+                                     const __m128 value)
+{
+  float r[4];
+  _mm_storeu_ps(r, value);
 
-      tasks[tasknr].constraints[ctype][tasks[tasknr].tot_constraints[ctype]++] = con;
-    }
+  for (int j = 0; j < 4; j++) {
+    co[index[j]][axis] = r[j];
   }
+}
+#endif
 
-  BLI_rng_free(rng);
+/* Pulls `pos[v1]` and `target[v2]` towards their rest length. Structural constraints target
+ * other mesh vertices, soft-body, pin and deformation constraints target a position of the same
+ * vertex in another array, which is only moved for soft-body constraints.
+ *
+ * With `use_simd` four constraints are solved at once. The operations are the same as in the
+ * scalar loop, so both give the same result as long as the constraints don't share vertices. */
+BLI_INLINE void cloth_solver_solve_length(const SculptClothSolver *solver,
+                                          const SculptClothSolverBlock *block,
+                                          float (*pos)[3],
+                                          float (*target)[3],
+                                          const bool move_target,
+                                          const bool use_simd)
+{
+  const int *v1 = solver->length_v1;
+  const int *v2 = solver->length_v2;
+  const float *rest = solver->length_rest;
+  const float *w1 = solver->length_w1;
+  const float *w2 = solver->length_w2;
+  int i = block->start;
+
+#ifdef BLI_HAVE_SSE2
+  if (use_simd) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 factor = _mm_set1_ps(CLOTH_SOLVER_DISPLACEMENT_FACTOR);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= block->end; i += 4) {
+      __m128 pos1[3], pos2[3], correction_vector_half[3];
+
+      for (int axis = 0; axis < 3; axis++) {
+        pos1[axis] = cloth_solver_gather(pos, v1 + i, axis);
+        pos2[axis] = cloth_solver_gather(target, v2 + i, axis);
+        correction_vector_half[axis] = _mm_sub_ps(pos2[axis], pos1[axis]);
+      }
 
-  cloth_sim->constraint_tasks = tasks;
-  cloth_sim->tot_constraint_tasks = totthread + 1;
+      __m128 len_sq = _mm_mul_ps(correction_vector_half[0], correction_vector_half[0]);
+      len_sq = _mm_add_ps(len_sq, _mm_mul_ps(correction_vector_half[1], correction_vector_half[1]));
+      len_sq = _mm_add_ps(len_sq, _mm_mul_ps(correction_vector_half[2], correction_vector_half[2]));
 
-#if 1
-  unsigned int size = sizeof(SculptClothLengthConstraint) * cloth_sim->tot_constraints[0];
-  size += sizeof(SculptClothBendConstraint) * cloth_sim->tot_constraints[1];
+      const __m128 current_distance = _mm_sqrt_ps(len_sq);
+      const __m128 has_distance = _mm_cmpgt_ps(current_distance, zero);
+      __m128 correction = _mm_sub_ps(one, _mm_div_ps(_mm_loadu_ps(rest + i), current_distance));
+      correction = _mm_or_ps(_mm_and_ps(has_distance, correction),
+                             _mm_andnot_ps(has_distance, one));
 
-  printf("%.2fmb", (float)size / 1024.0f / 1024.0f);
+      const __m128 fac = _mm_mul_ps(_mm_mul_ps(factor, correction), half);
+      const __m128 fac1 = _mm_loadu_ps(w1 + i);
+      const __m128 fac2 = _mm_loadu_ps(w2 + i);
 
-  for (int i = 0; i < totthread + 1; i++) {
-    printf("%d: ", i);
+      for (int axis = 0; axis < 3; axis++) {
+        const __m128 offset = _mm_mul_ps(correction_vector_half[axis], fac);
 
-    for (int j = 0; j < TOT_CONSTRAINT_TYPES; j++) {
-      printf("  %d", tasks[i].tot_constraints[j]);
+        cloth_solver_scatter(pos, v1 + i, axis, _mm_add_ps(pos1[axis], _mm_mul_ps(offset, fac1)));
+        if (move_target) {
+          cloth_solver_scatter(
+              target, v2 + i, axis, _mm_sub_ps(pos2[axis], _mm_mul_ps(offset, fac2)));
+        }
+      }
     }
-
-    printf("\n");
   }
+#else
+  UNUSED_VARS(use_simd);
 #endif
 
-  MEM_SAFE_FREE(vthreads);
-}
+  for (; i < block->end; i++) {
+    float *pos1 = pos[v1[i]];
+    float *pos2 = target[v2[i]];
+    float correction_vector_half[3];
 
-static void cloth_brush_satisfy_constraints_intern(SculptSession *ss,
-                                                   Brush *brush,
-                                                   SculptClothSimulation *cloth_sim,
-                                                   SculptClothTaskData *task,
-                                                   bool no_boundary)
-{
+    sub_v3_v3v3(correction_vector_half, pos2, pos1);
 
-  AutomaskingCache *automasking = SCULPT_automasking_active_cache_get(ss);
-  SculptClothLengthConstraint **constraints = (SculptClothLengthConstraint **)
-                                                  task->constraints[CON_LENGTH];
+    const float current_distance = len_v3(correction_vector_half);
+    const float correction = current_distance > 0.0f ? (1.0f - (rest[i] / current_distance)) :
+                                                       1.0f;
+
+    mul_v3_fl(correction_vector_half, CLOTH_SOLVER_DISPLACEMENT_FACTOR * correction * 0.5f);
+
+    madd_v3_v3fl(pos1, correction_vector_half, w1[i]);
+    if (move_target) {
+      madd_v3_v3fl(pos2, correction_vector_half, -w2[i]);
+    }
+  }
+}
 
 #ifdef BENDING_CONSTRAINTS
-  SculptClothBendConstraint **bend_constraints = (SculptClothBendConstraint **)
-                                                     task->constraints[CON_BEND];
+static void cloth_solver_solve_bend(SculptClothSimulation *cloth_sim,
+                                    const SculptClothSolver *solver,
+                                    const SculptClothSolverBlock *block)
+{
+  const SculptClothBendConstraint *bend_constraints = (SculptClothBendConstraint *)
+                                                          cloth_sim->constraints[CON_BEND];
 
-  for (int i = 0; !no_boundary && i < task->tot_constraints[CON_BEND]; i++) {
-    SculptClothBendConstraint *constraint = bend_constraints[i];
+  for (int i = block->start; i < block->end; i++) {
+    const SculptClothBendConstraint *constraint = &bend_constraints[solver->bend[i]];
+    const float *w = solver->bend_w[i];
     float gradients[4][3];
 
-    if (cloth_sim->node_state[constraint->node] != SCULPT_CLOTH_NODE_ACTIVE) {
-      /* Skip all constraints that were created for inactive nodes. */
+    if (w[0] == 0.0f && w[1] == 0.0f && w[2] == 0.0f && w[3] == 0.0f) {
       continue;
     }
 
-#  ifndef CLOTH_NO_POS_PTR
-    for (int j = 0; j < 4; j++) {
-      constraint->elems[j].position = cloth_sim->pos[constraint->elems[j].index];
-    }
-#  endif
-
     if (!calc_bending_gradients(cloth_sim, constraint, gradients)) {
       continue;
     }
 
-    float sim_location[3];
-    cloth_brush_simulation_location_get(ss, brush, sim_location);
-
     for (int j = 0; j < 4; j++) {
-      int vi = UNPACK_POS_INDEX(constraint->elems[j].index);
-
-#  ifndef CLOTH_NO_POS_PTR
-      float *pos = constraint->elems[j].position;
-#  else
-      float *pos = GET_POS_PTR(constraint->elems[j].index);
-#  endif
+      const int v = UNPACK_POS_INDEX(constraint->elems[j].index);
+      madd_v3_v3fl(cloth_sim->pos[v], gradients[j], w[j]);
 
-      float sim_factor = ss->cache ? cloth_brush_simulation_falloff_get(cloth_sim,
-                                                                        brush,
-                                                                        ss->cache->radius,
-                                                                        sim_location,
-                                                                        cloth_sim->init_pos[vi]) :
-                                     1.0f;
+      if (USE_SOLVER_RIPPLE_CONSTRAINT) {
+        cloth_brush_constraint_pos_to_line(cloth_sim, v);
+      }
+    }
+  }
+}
+#endif
 
-      /* increase strength of bending constraints */
-      sim_factor = sqrtf(sim_factor);
+static void cloth_solver_solve_block_cb(void *__restrict userdata,
+                                        const int n,
+                                        const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ClothSolverTaskData *data = (ClothSolverTaskData *)userdata;
+  SculptClothSimulation *cloth_sim = data->cloth_sim;
+  const SculptClothSolver *solver = data->solver;
+  const SculptClothSolverBlock *block = solver->blocks + n;
+  const bool use_simd = data->use_simd && !block->serial;
 
-      if (sim_factor == 0.0f) {
-        continue;
+  switch (block->batch) {
+    case CLOTH_BATCH_STRUCTURAL:
+      cloth_solver_solve_length(solver, block, cloth_sim->pos, cloth_sim->pos, true, use_simd);
+      break;
+    case CLOTH_BATCH_SOFTBODY:
+      cloth_solver_solve_length(
+          solver, block, cloth_sim->pos, cloth_sim->softbody_pos, true, use_simd);
+      break;
+    case CLOTH_BATCH_PIN:
+      cloth_solver_solve_length(
+          solver, block, cloth_sim->pos, cloth_sim->init_pos, false, use_simd);
+      break;
+    case CLOTH_BATCH_DEFORMATION:
+      cloth_solver_solve_length(
+          solver, block, cloth_sim->pos, cloth_sim->deformation_pos, false, use_simd);
+      break;
+    case CLOTH_BATCH_BEND:
+#ifdef BENDING_CONSTRAINTS
+      if (data->solve_bend) {
+        cloth_solver_solve_bend(cloth_sim, solver, block);
       }
+#endif
+      break;
+  }
 
-      SculptVertRef vref = BKE_pbvh_table_index_to_vertex(ss->pbvh, vi);
+  if (USE_SOLVER_RIPPLE_CONSTRAINT && block->batch != CLOTH_BATCH_BEND) {
+    for (int i = block->start; i < block->end; i++) {
+      cloth_brush_constraint_pos_to_line(cloth_sim, solver->length_v1[i]);
+      cloth_brush_constraint_pos_to_line(cloth_sim, solver->length_v2[i]);
+    }
+  }
+}
 
-      sim_factor *= SCULPT_automasking_factor_get(automasking, ss, vref) * 1.0f -
-                    SCULPT_vertex_mask_get(ss, vref);
+/* Runs the constraint iterations. Colors are solved one after another, the blocks of a color
+ * in parallel unless `use_threading` is false. */
+static void cloth_solver_solve(ClothSolverTaskData *data,
+                               const int iterations,
+                               const int totpass,
+                               const bool use_threading)
+{
+  const SculptClothSolver *solver = data->solver;
+  TaskParallelSettings settings;
 
-      madd_v3_v3fl(pos, gradients[j], sim_factor);
+  for (int constraint_it = 0; constraint_it < iterations; constraint_it++) {
+    for (int pass = 0; pass < totpass; pass++) {
+      data->solve_bend = pass == 0;
 
-      if (USE_SOLVER_RIPPLE_CONSTRAINT) {
-        cloth_brush_constraint_pos_to_line(cloth_sim, vi);
+      for (int c = 0; c < solver->totcolor; c++) {
+        const int start = solver->color_blocks[c];
+        const int end = solver->color_blocks[c + 1];
+        const bool is_serial = solver->has_serial_color && c == solver->totcolor - 1;
+
+        BKE_pbvh_parallel_range_settings(&settings, use_threading && !is_serial, end - start);
+        BLI_task_parallel_range(start, end, data, cloth_solver_solve_block_cb, &settings);
       }
     }
   }
-#endif
-  // return;
-  for (int i = 0; i < task->tot_constraints[CON_LENGTH]; i++) {
-    const SculptClothLengthConstraint *constraint = constraints[i];
+}
 
-    if (cloth_sim->node_state[constraint->node] != SCULPT_CLOTH_NODE_ACTIVE) {
-      /* Skip all constraints that were created for inactive nodes. */
-      continue;
+static void cloth_brush_satisfy_constraints(SculptSession *ss,
+                                            Brush *brush,
+                                            SculptClothSimulation *cloth_sim)
+{
+  SculptClothSolver *solver = cloth_sim->solver;
+
+  /* Constraints are only ever appended, rebuild the colors when new ones were created. */
+  if (!solver || memcmp(solver->tot_constraints,
+                        cloth_sim->tot_constraints,
+                        sizeof(solver->tot_constraints)) != 0) {
+    if (solver) {
+      cloth_solver_free(solver);
     }
+    solver = cloth_sim->solver = cloth_solver_build(SCULPT_vertex_count_get(ss), cloth_sim);
+  }
 
-#ifndef CLOTH_NO_POS_PTR
-    float *pos1 = constraint->elems[0].position;
-    float *pos2 = constraint->elems[1].position;
-#else
-    float *pos1 = GET_POS_PTR(constraint->elems[0].index);
-    float *pos2 = GET_POS_PTR(constraint->elems[1].index);
+  if (!solver->totblock) {
+    return;
+  }
+
+#ifdef DEBUG_TIME
+  TIMEIT_START_AVERAGED(cloth_satisfy_constraints);
 #endif
 
-    const int v1 = UNPACK_POS_INDEX(constraint->elems[0].index);
-    const int v2 = UNPACK_POS_INDEX(constraint->elems[1].index);
+  ClothSolverTaskData data = {
+      .ss = ss,
+      .brush = brush,
+      .cloth_sim = cloth_sim,
+      .solver = solver,
+      .automasking = SCULPT_automasking_active_cache_get(ss),
+      .use_simd = true,
+  };
+  cloth_brush_simulation_location_get(ss, brush, data.sim_location);
 
-    const SculptVertRef v1ref = BKE_pbvh_table_index_to_vertex(ss->pbvh, v1);
-    const SculptVertRef v2ref = BKE_pbvh_table_index_to_vertex(ss->pbvh, v2);
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, solver->totblock);
+  BLI_task_parallel_range(0, solver->totblock, &data, cloth_solver_update_weights_cb, &settings);
 
-    float v1_to_v2[3];
-    sub_v3_v3v3(v1_to_v2, pos2, pos1);
+  const int iterations = cloth_sim->use_bending ? 2 : 5;
+  /* With bending enabled the length constraints run a second time without the bend ones. */
+  const int totpass = cloth_sim->use_bending ? 2 : 1;
 
-    const float current_distance = len_v3(v1_to_v2);
-    float correction_vector[3];
-    float correction_vector_half[3];
+  cloth_solver_solve(&data, iterations, totpass, true);
 
-    const float constraint_distance = constraint->length +
-                                      (cloth_sim->length_constraint_tweak[v1] * 0.5f) +
-                                      (cloth_sim->length_constraint_tweak[v2] * 0.5f);
+#ifdef DEBUG_TIME
+  TIMEIT_END_AVERAGED(cloth_satisfy_constraints);
+#endif
+}
 
-    if (current_distance > 0.0f) {
-      mul_v3_v3fl(correction_vector,
-                  v1_to_v2,
-                  CLOTH_SOLVER_DISPLACEMENT_FACTOR *
-                      (1.0f - (constraint_distance / current_distance)));
-    }
-    else {
-      mul_v3_v3fl(correction_vector, v1_to_v2, CLOTH_SOLVER_DISPLACEMENT_FACTOR);
-    }
+/** \} */
 
-    mul_v3_v3fl(correction_vector_half, correction_vector, 0.5f);
+/* -------------------------------------------------------------------- */
+/** \name Solver Benchmark
+ *
+ * Solves the structural and soft-body constraints of a randomly perturbed cloth grid, built
+ * from a fixed seed so runs can be compared between builds. The constraints are solved
+ * serially, in parallel and in parallel with the SIMD kernel. Constraints of a color don't
+ * share vertices, so all three runs must end with bit identical positions.
+ * \{ */
 
-    const float mask_v1 = (1.0f - SCULPT_vertex_mask_get(ss, v1ref)) *
-                          SCULPT_automasking_factor_get(automasking, ss, v1ref);
-    const float mask_v2 = (1.0f - SCULPT_vertex_mask_get(ss, v2ref)) *
-                          SCULPT_automasking_factor_get(automasking, ss, v2ref);
+static SculptClothSimulation *cloth_solver_benchmark_sim_create(const int size, const uint seed)
+{
+  SculptClothSimulation *cloth_sim = MEM_callocN(sizeof(SculptClothSimulation), __func__);
+  const int totvert = size * size;
+  const float spacing = 1.0f / (float)size;
+  const int offsets[3][2] = {{1, 0}, {0, 1}, {1, 1}};
 
-    float sim_location[3];
-    cloth_brush_simulation_location_get(ss, brush, sim_location);
+  cloth_sim->pos = MEM_malloc_arrayN(totvert, sizeof(float[3]), __func__);
+  cloth_sim->softbody_pos = MEM_malloc_arrayN(totvert, sizeof(float[3]), __func__);
 
-    const float sim_factor_v1 = ss->cache ?
-                                    cloth_brush_simulation_falloff_get(cloth_sim,
-                                                                       brush,
-                                                                       ss->cache->radius,
-                                                                       sim_location,
-                                                                       cloth_sim->init_pos[v1]) :
-                                    1.0f;
-    const float sim_factor_v2 = ss->cache ?
-                                    cloth_brush_simulation_falloff_get(cloth_sim,
-                                                                       brush,
-                                                                       ss->cache->radius,
-                                                                       sim_location,
-                                                                       cloth_sim->init_pos[v2]) :
-                                    1.0f;
-
-    float deformation_strength = 1.0f;
-    if (constraint->type == SCULPT_CLOTH_CONSTRAINT_DEFORMATION) {
-      deformation_strength = (cloth_sim->deformation_strength[v1] +
-                              cloth_sim->deformation_strength[v2]) *
-                             0.5f;
-    }
+  RNG *rng = BLI_rng_new(seed);
 
-    if (constraint->type == SCULPT_CLOTH_CONSTRAINT_SOFTBODY) {
-      const float softbody_plasticity = brush ? brush->cloth_constraint_softbody_strength : 0.0f;
-      madd_v3_v3fl(cloth_sim->pos[v1],
-                   correction_vector_half,
-                   1.0f * mask_v1 * sim_factor_v1 * constraint->strength * softbody_plasticity);
-      madd_v3_v3fl(cloth_sim->softbody_pos[v1],
-                   correction_vector_half,
-                   -1.0f * mask_v1 * sim_factor_v1 * constraint->strength *
-                       (1.0f - softbody_plasticity));
-    }
-    else {
-      madd_v3_v3fl(cloth_sim->pos[v1],
-                   correction_vector_half,
-                   1.0f * mask_v1 * sim_factor_v1 * constraint->strength * deformation_strength);
-      if (v1 != v2) {
-        madd_v3_v3fl(cloth_sim->pos[v2],
-                     correction_vector_half,
-                     -1.0f * mask_v2 * sim_factor_v2 * constraint->strength *
-                         deformation_strength);
-      }
-    }
-    if (USE_SOLVER_RIPPLE_CONSTRAINT) {
-      cloth_brush_constraint_pos_to_line(cloth_sim, v1);
-      cloth_brush_constraint_pos_to_line(cloth_sim, v2);
-    }
+  for (int i = 0; i < totvert; i++) {
+    float offset[3];
+
+    BLI_rng_get_float_unit_v3(rng, offset);
+    mul_v3_fl(offset, spacing * 0.5f * BLI_rng_get_float(rng));
+
+    cloth_sim->softbody_pos[i][0] = (float)(i % size) * spacing;
+    cloth_sim->softbody_pos[i][1] = (float)(i / size) * spacing;
+    cloth_sim->softbody_pos[i][2] = 0.0f;
+    add_v3_v3v3(cloth_sim->pos[i], cloth_sim->softbody_pos[i], offset);
   }
-}
 
-typedef struct ConstraintThreadData {
-  SculptClothSimulation *cloth_sim;
-  SculptSession *ss;
-  Brush *brush;
-} ConstraintThreadData;
+  BLI_rng_free(rng);
 
-static void cloth_brush_satisfy_constraints_task_cb(void *__restrict userdata,
-                                                    const int n,
-                                                    const TaskParallelTLS *__restrict UNUSED(tls))
-{
-  ConstraintThreadData *data = (ConstraintThreadData *)userdata;
+  /* Up to three structural constraints and one soft-body constraint per vertex. */
+  SculptClothLengthConstraint *constraints = MEM_calloc_arrayN(
+      totvert * 4, sizeof(SculptClothLengthConstraint), __func__);
+  int totconstraint = 0;
 
-  cloth_brush_satisfy_constraints_intern(
-      data->ss, data->brush, data->cloth_sim, data->cloth_sim->constraint_tasks + n, false);
+  for (int i = 0; i < totvert; i++) {
+    const int x = i % size, y = i / size;
 
-  if (data->cloth_sim->use_bending) {  // run again without bend constraints
-    cloth_brush_satisfy_constraints_intern(
-        data->ss, data->brush, data->cloth_sim, data->cloth_sim->constraint_tasks + n, true);
-  }
-}
+    for (int j = 0; j < 3; j++) {
+      if (x + offsets[j][0] >= size || y + offsets[j][1] >= size) {
+        continue;
+      }
 
-void cloth_brush_satisfy_constraints(SculptSession *ss,
-                                     Brush *brush,
-                                     SculptClothSimulation *cloth_sim)
-{
-  ConstraintThreadData data = {.cloth_sim = cloth_sim, .ss = ss, .brush = brush};
+      const int v2 = (y + offsets[j][1]) * size + x + offsets[j][0];
+      SculptClothLengthConstraint *constraint = &constraints[totconstraint++];
 
-  int totthread = BLI_system_thread_count();
+      constraint->ctype = CON_LENGTH;
+      constraint->strength = 1.0f;
+      constraint->elems[0].index = i;
+      constraint->elems[1].index = v2;
+      constraint->length = len_v3v3(cloth_sim->softbody_pos[i], cloth_sim->softbody_pos[v2]);
+      constraint->type = SCULPT_CLOTH_CONSTRAINT_STRUCTURAL;
+    }
 
-  if (!cloth_sim->constraint_tasks) {
-    cloth_sort_constraints_for_tasks(ss, brush, cloth_sim, totthread);
-  }
+    SculptClothLengthConstraint *constraint = &constraints[totconstraint++];
 
-  if (!cloth_sim->tot_constraint_tasks) {
-    return;
+    constraint->ctype = CON_LENGTH;
+    constraint->strength = 0.3f;
+    constraint->elems[0].index = i;
+    constraint->elems[1].index = i;
+    constraint->type = SCULPT_CLOTH_CONSTRAINT_SOFTBODY;
   }
 
-  int iterations = cloth_sim->use_bending ? 2 : 5;
+  cloth_sim->constraints[CON_LENGTH] = (SculptClothConstraint *)constraints;
+  cloth_sim->tot_constraints[CON_LENGTH] = totconstraint;
 
-  for (int constraint_it = 0; constraint_it < iterations; constraint_it++) {
-    TaskParallelSettings settings;
-    BKE_pbvh_parallel_range_settings(&settings, true, cloth_sim->tot_constraint_tasks - 1);
+  return cloth_sim;
+}
 
-    BLI_task_parallel_range(0,
-                            cloth_sim->tot_constraint_tasks - 1,
-                            &data,
-                            cloth_brush_satisfy_constraints_task_cb,
-                            &settings);
+char *SCULPT_cloth_solver_benchmark(const int totvert, const int seed, const int iterations)
+{
+  const int size = max_ii((int)sqrtf((float)totvert), 2);
+  SculptClothSimulation *cloth_sim = cloth_solver_benchmark_sim_create(size, (uint)seed);
+  const size_t pos_size = sizeof(float[3]) * (size_t)(size * size);
+
+  SculptClothSolver *solver = cloth_solver_build(size * size, cloth_sim);
+
+  /* Stand in for #cloth_solver_update_weights_cb, there is no brush or mask. */
+  for (int i = 0; i < solver->totlength; i++) {
+    solver->length_rest[i] = solver->length[i];
+    solver->length_w1[i] = solver->length_strength[i];
+    solver->length_w2[i] = solver->length_strength[i];
+  }
+
+  float(*start_pos)[3] = MEM_dupallocN(cloth_sim->pos);
+  float(*start_softbody_pos)[3] = MEM_dupallocN(cloth_sim->softbody_pos);
+
+  const char *run_names[3] = {"serial", "parallel", "parallel_simd"};
+  double run_time[3];
+  uint run_hash[3];
+
+  for (int run = 0; run < ARRAY_SIZE(run_names); run++) {
+    memcpy(cloth_sim->pos, start_pos, pos_size);
+    memcpy(cloth_sim->softbody_pos, start_softbody_pos, pos_size);
+
+    ClothSolverTaskData data = {
+        .cloth_sim = cloth_sim,
+        .solver = solver,
+        .use_simd = run == 2,
+    };
+
+    const double start_time = PIL_check_seconds_timer();
+    cloth_solver_solve(&data, iterations, 1, run != 0);
+    run_time[run] = PIL_check_seconds_timer() - start_time;
+
+    BLI_HashMurmur2A mm2;
+    BLI_hash_mm2a_init(&mm2, 0);
+    BLI_hash_mm2a_add(&mm2, (const unsigned char *)cloth_sim->pos, pos_size);
+    BLI_hash_mm2a_add(&mm2, (const unsigned char *)cloth_sim->softbody_pos, pos_size);
+    run_hash[run] = BLI_hash_mm2a_end(&mm2);
+  }
+
+  DynStr *out = BLI_dynstr_new();
+
+  BLI_dynstr_appendf(out,
+                     "{\n  \"verts\": %d,\n  \"constraints\": %d,\n  \"colors\": %d,\n",
+                     size * size,
+                     solver->totlength,
+                     solver->totcolor);
+  BLI_dynstr_appendf(out,
+                     "  \"seed\": %d,\n  \"iterations\": %d,\n  \"threads\": %d,\n",
+                     seed,
+                     iterations,
+                     BLI_task_scheduler_num_threads());
+#ifdef BLI_HAVE_SSE2
+  BLI_dynstr_append(out, "  \"simd\": true,\n");
+#else
+  BLI_dynstr_append(out, "  \"simd\": false,\n");
+#endif
+  BLI_dynstr_appendf(out,
+                     "  \"matches\": %s,\n  \"runs\": {",
+                     run_hash[0] == run_hash[1] && run_hash[0] == run_hash[2] ? "true" : "false");
 
-    // do thread boundary constraints in main thread
-    cloth_brush_satisfy_constraints_task_cb(&data, cloth_sim->tot_constraint_tasks - 1, NULL);
+  for (int run = 0; run < ARRAY_SIZE(run_names); run++) {
+    BLI_dynstr_appendf(out,
+                       "%s\n    \"%s\": {\"seconds\": %.6f, \"hash\": \"%08x\"}",
+                       run ? "," : "",
+                       run_names[run],
+                       run_time[run],
+                       run_hash[run]);
   }
+
+  BLI_dynstr_append(out, "\n  }\n}\n");
+
+  char *ret = BLI_dynstr_get_cstring(out);
+  BLI_dynstr_free(out);
+
+  MEM_freeN(start_pos);
+  MEM_freeN(start_softbody_pos);
+  cloth_solver_free(solver);
+  MEM_freeN(cloth_sim->constraints[CON_LENGTH]);
+  MEM_freeN(cloth_sim->pos);
+  MEM_freeN(cloth_sim->softbody_pos);
+  MEM_freeN(cloth_sim);
+
+  return ret;
 }
 
+/** \} */
+
 void SCULPT_cloth_brush_do_simulation_step(
     Sculpt *sd, Object *ob, SculptClothSimulation *cloth_sim, PBVHNode **nodes, int totnode)
 {
@@ -2402,12 +2785,6 @@ void SCULPT_do_cloth_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode
   /* Ensure the constraints for the nodes. */
   sculpt_cloth_ensure_constraints_in_simulation_area(sd, ob, nodes, totnode);
 
-  // reassign constraints to threads if in dynamic mode
-  if (SCULPT_get_int(ss, cloth_simulation_area_type, sd, brush) ==
-      BRUSH_CLOTH_SIMULATION_AREA_DYNAMIC) {
-    cloth_free_tasks(ss->cache->cloth_sim);
-  }
-
   /* Store the initial state in the simulation. */
   SCULPT_cloth_brush_store_simulation_state(ss, ss->cache->cloth_sim);
 
@@ -2436,7 +2813,9 @@ void SCULPT_cloth_simulation_free(struct SculptClothSimulation *cloth_sim)
   MEM_SAFE_FREE(cloth_sim->init_pos);
   MEM_SAFE_FREE(cloth_sim->deformation_strength);
   MEM_SAFE_FREE(cloth_sim->node_state);
-  cloth_free_tasks(cloth_sim);
+  if (cloth_sim->solver) {
+    cloth_solver_free(cloth_sim->solver);
+  }
   MEM_SAFE_FREE(cloth_sim->init_normal);
   BLI_ghash_free(cloth_sim->node_state_index, NULL, NULL);
   if (cloth_sim->collider_list) {
@@ -230,9 +230,9 @@ void SCULPT_curvature_dir_get(SculptSession *ss,
   }
 
   BMVert *bv = (BMVert *)v.i;
-  MSculptVert *mv = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, bv);
+  MSculptVertCold *mv_cold = BKE_PBVH_SCULPTVERT_COLD(ss->cd_sculpt_vert_cold, bv);
 
-  copy_v3_v3(dir, mv->curvature_dir);
+  copy_v3_v3(dir, mv_cold->curvature_dir);
 }
 
 void SCULPT_curvature_begin(SculptSession *ss, struct PBVHNode *node, bool useAccurateSolver)
@@ -249,12 +249,12 @@ void SCULPT_curvature_begin(SculptSession *ss, struct PBVHNode *node, bool useAc
 
     BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vi, PBVH_ITER_UNIQUE) {
       BMVert *v = (BMVert *)vi.vertex.i;
-      MSculptVert *mv = BKE_PBVH_SCULPTVERT(ss->cd_sculpt_vert, v);
+      MSculptVertCold *mv_cold = BKE_PBVH_SCULPTVERT_COLD(ss->cd_sculpt_vert_cold, v);
 
       SculptCurvatureData curv;
       SCULPT_calc_principle_curvatures(ss, vi.vertex, &curv, useAccurateSolver);
 
-      copy_v3_v3(mv->curvature_dir, curv.principle[0]);
+      copy_v3_v3(mv_cold->curvature_dir, curv.principle[0]);
     }
     BKE_pbvh_vertex_iter_end;
   }
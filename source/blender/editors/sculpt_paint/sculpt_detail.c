@@ -80,34 +80,29 @@ static bool sculpt_and_dynamic_topology_poll(bContext *C)
 /** \name Detail Flood Fill
  * \{ */
 
+static void sculpt_detail_flood_fill_progress_cb(float progress, void *userdata)
+{
+  WM_progress_set((wmWindow *)userdata, progress);
+}
+
 static int sculpt_detail_flood_fill_exec(bContext *C, wmOperator *UNUSED(op))
 {
   Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
   Object *ob = CTX_data_active_object(C);
   Brush *brush = BKE_paint_brush(&sd->paint);
+  wmWindow *win = CTX_wm_window(C);
 
   SculptSession *ss = ob->sculpt;
-  float size;
-  float bb_min[3], bb_max[3], center[3], dim[3];
   int totnodes;
   PBVHNode **nodes;
 
   BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnodes);
+  MEM_SAFE_FREE(nodes);
 
   if (!totnodes) {
     return OPERATOR_CANCELLED;
   }
 
-  for (int i = 0; i < totnodes; i++) {
-    BKE_pbvh_node_mark_topology_update(nodes[i]);
-  }
-  /* Get the bounding box, its center and size. */
-  BKE_pbvh_bounding_box(ob->sculpt->pbvh, bb_min, bb_max);
-  add_v3_v3v3(center, bb_min, bb_max);
-  mul_v3_fl(center, 0.5f);
-  sub_v3_v3v3(dim, bb_max, bb_min);
-  size = max_fff(dim[0], dim[1], dim[2]);
-
   float constant_detail = BRUSHSET_GET_FINAL_FLOAT(
       brush ? brush->channels : NULL, sd->channels, dyntopo_constant_detail, NULL);
   float detail_range = BRUSHSET_GET_FINAL_FLOAT(
@@ -117,9 +112,6 @@ static int sculpt_detail_flood_fill_exec(bContext *C, wmOperator *UNUSED(op))
   float object_space_constant_detail = 1.0f / (constant_detail * mat4_to_scale(ob->obmat));
   BKE_pbvh_bmesh_detail_size_set(ss->pbvh, object_space_constant_detail, detail_range);
 
-  bool enable_surface_relax = BRUSHSET_GET_FINAL_INT(
-      brush ? brush->channels : NULL, sd->channels, dyntopo_disable_smooth, NULL);
-
   SCULPT_undo_push_begin(ob, "Dynamic topology flood fill");
   SCULPT_undo_push_node(ob, NULL, SCULPT_UNDO_COORDS);
 
@@ -128,81 +120,23 @@ static int sculpt_detail_flood_fill_exec(bContext *C, wmOperator *UNUSED(op))
 
   SCULPT_dyntopo_automasking_init(ss, sd, NULL, ob, &mask_cb, &mask_cb_data);
 
-  const int max_steps = 2;
-  const int max_dyntopo_steps_coll = 1 << 13;
-  const int max_dyntopo_steps_subd = 1 << 15;
-
-  int i = 0;
-  bool modified = true;
-
-  while (modified) {
-    modified = BKE_pbvh_bmesh_update_topology(ss->pbvh,
-                                              PBVH_Collapse,
-                                              center,
-                                              NULL,
-                                              size,
-                                              false,
-                                              false,
-                                              -1,
-                                              false,
-                                              mask_cb,
-                                              mask_cb_data,
-                                              max_dyntopo_steps_coll,
-                                              enable_surface_relax,
-                                              false);
-
-    for (int j = 0; j < totnodes; j++) {
-      BKE_pbvh_node_mark_topology_update(nodes[j]);
-    }
-
-    modified |= BKE_pbvh_bmesh_update_topology(ss->pbvh,
-                                               PBVH_Subdivide,
-                                               center,
-                                               NULL,
-                                               size,
-                                               false,
-                                               false,
-                                               -1,
-                                               false,
-                                               mask_cb,
-                                               mask_cb_data,
-                                               max_dyntopo_steps_subd,
-                                               enable_surface_relax,
-                                               false);
-    for (int j = 0; j < totnodes; j++) {
-      BKE_pbvh_node_mark_topology_update(nodes[j]);
-    }
-
-    if (i++ > max_steps) {
-      break;
-    }
-  }
+  /* Every pass roughly halves the longest edges, so this covers large detail changes. */
+  const int max_passes = 8;
 
-  /* one more time, but with cleanup valence 3/4 verts enabled */
-  for (i = 0; i < 2; i++) {
-    for (int j = 0; j < totnodes; j++) {
-      BKE_pbvh_node_mark_topology_update(nodes[j]);
-    }
+  BKE_pbvh_bmesh_remesh_all(ss->pbvh,
+                            mask_cb,
+                            mask_cb_data,
+                            max_passes,
+                            false,
+                            win ? sculpt_detail_flood_fill_progress_cb : NULL,
+                            win);
 
-    BKE_pbvh_bmesh_update_topology(ss->pbvh,
-                                   PBVH_Cleanup,
-                                   center,
-                                   NULL,
-                                   size,
-                                   false,
-                                   false,
-                                   -1,
-                                   false,
-                                   mask_cb,
-                                   mask_cb_data,
-                                   max_dyntopo_steps_coll,
-                                   enable_surface_relax,
-                                   false);
+  if (win) {
+    WM_progress_clear(win);
   }
 
   SCULPT_dyntopo_automasking_end(mask_cb_data);
 
-  MEM_SAFE_FREE(nodes);
   SCULPT_undo_push_end(ob);
 
   /* Force rebuild of PBVH for better BB placement. */
@@ -507,8 +507,10 @@ void SCULPT_dyntopo_save_origverts(SculptSession *ss)
     }
 
     if (ss->vcol_type != -1) {
+      MSculptVertCold *mv_cold = BKE_PBVH_SCULPTVERT_COLD(ss->cd_sculpt_vert_cold, v);
+
       BKE_pbvh_bmesh_get_vcol(
-          v, mv->origcolor, ss->vcol_type, ss->vcol_domain, ss->cd_vcol_offset);
+          v, mv_cold->origcolor, ss->vcol_type, ss->vcol_domain, ss->cd_vcol_offset);
     }
   }
 }
@@ -573,11 +575,6 @@ void SCULPT_dynamic_topology_sync_layers(Object *ob, Mesh *me)
   BKE_sculptsession_sync_attributes(ob, me);
 }
 
-BMesh *BM_mesh_bm_from_me_threaded(BMesh *bm,
-                                   Object *ob,
-                                   const Mesh *me,
-                                   const struct BMeshFromMeshParams *params);
-
 void SCULPT_dynamic_topology_enable_ex(Main *bmain, Depsgraph *depsgraph, Scene *scene, Object *ob)
 {
   SculptSession *ss = ob->sculpt;
@@ -623,12 +620,11 @@ void SCULPT_dynamic_topology_enable_ex(Main *bmain, Depsgraph *depsgraph, Scene
     MEM_freeN(ss->mdyntopo_verts);
     ss->mdyntopo_verts = NULL;
   }
+  MEM_SAFE_FREE(ss->mdyntopo_verts_cold);
 
   /* Dynamic topology doesn't ensure selection state is valid, so remove T36280. */
   BKE_mesh_mselect_clear(me);
 
-#if 1
-
   if (!ss->bm) {
     ss->bm = BM_mesh_create(
         &allocsize,
@@ -649,16 +645,6 @@ void SCULPT_dynamic_topology_enable_ex(Main *bmain, Depsgraph *depsgraph, Scene
                            .active_shapekey = ob->shapenr,
                        }));
   }
-#else
-  ss->bm = BM_mesh_bm_from_me_threaded(NULL,
-                                       NULL,
-                                       me,
-                                       (&(struct BMeshFromMeshParams){
-                                           .calc_face_normal = true,
-                                           .use_shapekey = true,
-                                           .active_shapekey = ob->shapenr,
-                                       }));
-#endif
 
 #ifndef DYNTOPO_DYNAMIC_TESS
   SCULPT_dynamic_topology_triangulate(ss, ss->bm);
@@ -55,6 +55,8 @@
 #include "IMB_colormanagement.h"
 #include "IMB_imbuf.h"
 
+#include "PIL_time.h"
+
 #include "bmesh.h"
 
 #include <math.h>
@@ -107,6 +109,21 @@
  */
 #define SCULPT_EXPAND_NORMALS_FALLOFF_EDGE_SENSITIVITY 300
 
+/**
+ * Size of the first wave of the progressive geodesic and topology falloffs, as a fraction of the
+ * bounding box diagonal and as a number of topology rings. Each following wave doubles it.
+ */
+#define SCULPT_EXPAND_WAVE_GEODESIC_DIVISIONS 32.0f
+#define SCULPT_EXPAND_WAVE_TOPOLOGY_RINGS 32.0f
+
+/**
+ * Time in seconds a modal update can spend computing falloff waves before updating the preview
+ * with the partial falloff.
+ */
+#define SCULPT_EXPAND_WAVE_TIME_BUDGET 0.04
+
+#define SCULPT_EXPAND_WAVE_MIN_ITER_PER_THREAD 4096
+
 /* Expand Modal Key-map. */
 enum {
   SCULPT_EXPAND_MODAL_CONFIRM = 1,
@@ -249,6 +266,10 @@ static bool sculpt_expand_state_get(SculptSession *ss,
     const int face_set = SCULPT_vertex_face_set_get(ss, v);
     enabled = BLI_gset_haskey(expand_cache->snap_enabled_face_sets, POINTER_FROM_INT(face_set));
   }
+  else if (expand_cache->vert_falloff[BKE_pbvh_vertex_index_to_table(ss->pbvh, v)] == FLT_MAX) {
+    /* Not reached by the falloff waves yet. */
+    enabled = false;
+  }
   else {
     const float max_falloff_factor = sculpt_expand_max_vertex_falloff_get(expand_cache);
     const float loop_len = (max_falloff_factor / expand_cache->loop_count) +
@@ -296,6 +317,9 @@ static bool sculpt_expand_face_state_get(SculptSession *ss,
     const int face_set = expand_cache->original_face_sets[f_i];
     enabled = BLI_gset_haskey(expand_cache->snap_enabled_face_sets, POINTER_FROM_INT(face_set));
   }
+  else if (expand_cache->face_falloff[f_i] == FLT_MAX) {
+    enabled = false;
+  }
   else {
     const float loop_len = (expand_cache->max_face_falloff / expand_cache->loop_count) +
                            SCULPT_EXPAND_LOOP_THRESHOLD;
@@ -340,7 +364,11 @@ static float sculpt_expand_gradient_value_get(SculptSession *ss,
 
   float linear_falloff;
 
-  if (expand_cache->invert) {
+  if (expand_cache->vert_falloff[BKE_pbvh_vertex_index_to_table(ss->pbvh, v)] == FLT_MAX) {
+    /* Only enabled when inverted, as the furthest vertex from the active one. */
+    linear_falloff = 1.0f;
+  }
+  else if (expand_cache->invert) {
     /* Active factor is the result of a modulus operation using loop_len, so they will never be
      * equal and loop_len - active_factor should never be 0. */
     BLI_assert((loop_len - active_factor) != 0.0f);
@@ -435,15 +463,6 @@ static SculptVertRef sculpt_expand_get_vertex_index_for_symmetry_pass(
   return symm_vertex;
 }
 
-/**
- * Geodesic: Initializes the falloff with geodesic distances from the given active vertex, taking
- * symmetry into account.
- */
-static float *sculpt_expand_geodesic_falloff_create(Sculpt *sd, Object *ob, const SculptVertRef v)
-{
-  return SCULPT_geodesic_from_vertex_and_symm(sd, ob, v, FLT_MAX);
-}
-
 /**
  * Topology: Initializes the falloff using a flood-fill operation,
  * increasing the falloff value by 1 when visiting a new vertex.
@@ -453,6 +472,8 @@ typedef struct ExpandFloodFillData {
   float edge_sensitivity;
   float *dists;
   float *edge_factor;
+  float limit;
+  bool limit_reached;
 } ExpandFloodFillData;
 
 static bool expand_topology_floodfill_cb(
@@ -469,25 +490,56 @@ static bool expand_topology_floodfill_cb(
   else {
     data->dists[to_v_i] = data->dists[from_v_i];
   }
+
+  if (data->dists[to_v_i] > data->limit) {
+    data->limit_reached = true;
+    return false;
+  }
   return true;
 }
 
-static float *sculpt_expand_topology_falloff_create(Sculpt *sd, Object *ob, const SculptVertRef v)
+/**
+ * Stops propagating once the falloff gets past `limit`, vertices that were not reached are left
+ * at FLT_MAX. `r_limit_reached` is set when there are vertices left past the limit.
+ */
+static float *sculpt_expand_topology_falloff_create(
+    Sculpt *sd, Object *ob, const SculptVertRef v, const float limit, bool *r_limit_reached)
 {
   SculptSession *ss = ob->sculpt;
   const int totvert = SCULPT_vertex_count_get(ss);
-  float *dists = MEM_calloc_arrayN(totvert, sizeof(float), "topology dist");
+  float *dists = MEM_malloc_arrayN(totvert, sizeof(float), "topology dist");
+  copy_vn_fl(dists, totvert, FLT_MAX);
 
   SculptFloodFill flood;
   SCULPT_floodfill_init(ss, &flood);
-  SCULPT_floodfill_add_initial_with_symmetry(sd, ob, ss, &flood, v, FLT_MAX);
+
+  const char symm = SCULPT_mesh_symmetry_xyz_get(ob);
+  for (char symm_it = 0; symm_it <= symm; symm_it++) {
+    if (!SCULPT_is_symmetry_iteration_valid(symm_it, symm)) {
+      continue;
+    }
+
+    const SculptVertRef symm_vertex = sculpt_expand_get_vertex_index_for_symmetry_pass(
+        ob, symm_it, v);
+    if (symm_vertex.i == SCULPT_EXPAND_VERTEX_NONE) {
+      continue;
+    }
+
+    SCULPT_floodfill_add_and_skip_initial(ss, &flood, symm_vertex);
+    dists[BKE_pbvh_vertex_index_to_table(ss->pbvh, symm_vertex)] = 0.0f;
+  }
 
   ExpandFloodFillData fdata;
   fdata.dists = dists;
+  fdata.limit = limit;
+  fdata.limit_reached = false;
 
   SCULPT_floodfill_execute(ss, &flood, expand_topology_floodfill_cb, &fdata);
   SCULPT_floodfill_free(&flood);
 
+  if (r_limit_reached) {
+    *r_limit_reached = fdata.limit_reached;
+  }
   return dists;
 }
 
@@ -903,13 +955,18 @@ static void sculpt_expand_grids_to_faces_falloff(SculptSession *ss,
   for (int p = 0; p < mesh->totpoly; p++) {
     MPoly *poly = &mesh->mpoly[p];
     float accum = 0.0f;
-    for (int l = 0; l < poly->totloop; l++) {
+    for (int l = 0; l < poly->totloop && accum != FLT_MAX; l++) {
       const int grid_loop_index = (poly->loopstart + l) * key->grid_area;
       for (int g = 0; g < key->grid_area; g++) {
+        if (expand_cache->vert_falloff[grid_loop_index + g] == FLT_MAX) {
+          accum = FLT_MAX;
+          break;
+        }
         accum += expand_cache->vert_falloff[grid_loop_index + g];
       }
     }
-    expand_cache->face_falloff[p] = accum / (poly->totloop * key->grid_area);
+    expand_cache->face_falloff[p] = accum == FLT_MAX ? FLT_MAX :
+                                                       accum / (poly->totloop * key->grid_area);
   }
 }
 
@@ -920,9 +977,13 @@ static void sculpt_expand_vertex_to_faces_falloff(Mesh *mesh, ExpandCache *expan
     float accum = 0.0f;
     for (int l = 0; l < poly->totloop; l++) {
       MLoop *loop = &mesh->mloop[l + poly->loopstart];
+      if (expand_cache->vert_falloff[loop->v] == FLT_MAX) {
+        accum = FLT_MAX;
+        break;
+      }
       accum += expand_cache->vert_falloff[loop->v];
     }
-    expand_cache->face_falloff[p] = accum / poly->totloop;
+    expand_cache->face_falloff[p] = accum == FLT_MAX ? FLT_MAX : accum / poly->totloop;
   }
 }
 
@@ -936,11 +997,16 @@ static void sculpt_expand_vertex_to_faces_falloff_bmesh(BMesh *bm, ExpandCache *
     float accum = 0.0f;
 
     do {
+      if (expand_cache->vert_falloff[BM_elem_index_get(l->v)] == FLT_MAX) {
+        accum = FLT_MAX;
+        break;
+      }
       accum += expand_cache->vert_falloff[BM_elem_index_get(l->v)];
       l = l->next;
     } while (l != f->l_first);
 
-    expand_cache->face_falloff[BM_elem_index_get(f)] = accum / f->len;
+    expand_cache->face_falloff[BM_elem_index_get(f)] = accum == FLT_MAX ? FLT_MAX :
+                                                                          accum / f->len;
   }
 }
 /**
@@ -1058,6 +1124,9 @@ static void sculpt_expand_resursion_step_add(Object *ob,
    * from the beginning. */
   expand_cache->texture_distortion_strength = 0.0f;
 
+  /* The recursion replaces the falloff of the whole mesh. */
+  expand_cache->falloff_pending = false;
+
   switch (recursion_type) {
     case SCULPT_EXPAND_RECURSION_GEODESICS:
       sculpt_expand_geodesics_from_state_boundary(ob, expand_cache, enabled_vertices);
@@ -1146,6 +1215,169 @@ static void sculpt_expand_initialize_from_face_set_boundary(Object *ob,
   }
 }
 
+/* Progressive falloff. Geodesic and topology falloffs are computed in waves of increasing
+ * distance from the origin. After each wave, all values up to the wave limit are final and the
+ * vertices further away are left at FLT_MAX, so the preview can already use them. The modal
+ * callback only computes new waves until the falloff reaches the vertex under the cursor. */
+
+typedef struct ExpandWaveTLSData {
+  float max_falloff;
+  bool limit_reached;
+} ExpandWaveTLSData;
+
+static void sculpt_expand_falloff_wave_clamp_task_cb(void *__restrict userdata,
+                                                     const int i,
+                                                     const TaskParallelTLS *__restrict tls)
+{
+  ExpandCache *expand_cache = userdata;
+  ExpandWaveTLSData *wtd = tls->userdata_chunk;
+  float *falloff = &expand_cache->vert_falloff[i];
+
+  if (*falloff == FLT_MAX) {
+    return;
+  }
+
+  /* Values past the limit may still decrease, the next wave computes them again. */
+  if (*falloff > expand_cache->falloff_wave_limit) {
+    *falloff = FLT_MAX;
+    wtd->limit_reached = true;
+    return;
+  }
+
+  wtd->max_falloff = max_ff(wtd->max_falloff, *falloff);
+}
+
+static void sculpt_expand_falloff_wave_clamp_reduce(const void *__restrict UNUSED(userdata),
+                                                    void *__restrict chunk_join,
+                                                    void *__restrict chunk)
+{
+  ExpandWaveTLSData *join = chunk_join;
+  ExpandWaveTLSData *wtd = chunk;
+  join->max_falloff = max_ff(join->max_falloff, wtd->max_falloff);
+  join->limit_reached |= wtd->limit_reached;
+}
+
+/**
+ * Computes the next wave of a progressive falloff, doubling the limit of the previous one, and
+ * updates the max falloff values and the face falloff with the result.
+ */
+static void sculpt_expand_falloff_wave_step(Sculpt *sd, Object *ob, ExpandCache *expand_cache)
+{
+  SculptSession *ss = ob->sculpt;
+  const SculptVertRef v = expand_cache->falloff_wave_origin;
+  const bool is_first_wave = expand_cache->falloff_wave_limit == 0.0f;
+  float *falloff = NULL;
+  bool limit_reached = false;
+
+  switch (expand_cache->falloff_type) {
+    case SCULPT_EXPAND_FALLOFF_GEODESIC: {
+      float bb_min[3], bb_max[3];
+      BKE_pbvh_bounding_box(ss->pbvh, bb_min, bb_max);
+      const float bb_diagonal = len_v3v3(bb_min, bb_max);
+
+      float limit = is_first_wave ? bb_diagonal / SCULPT_EXPAND_WAVE_GEODESIC_DIVISIONS :
+                                    expand_cache->falloff_wave_limit * 2.0f;
+
+      /* Once the limit sphere contains the whole mesh it can't clip the propagation anymore, so
+       * the last wave computes the remaining distances without a limit. */
+      if (limit >= bb_diagonal) {
+        limit = FLT_MAX;
+      }
+
+      falloff = SCULPT_geodesic_from_vertex_and_symm(sd, ob, v, limit);
+      expand_cache->falloff_wave_limit = limit;
+      limit_reached = limit != FLT_MAX;
+      break;
+    }
+    case SCULPT_EXPAND_FALLOFF_TOPOLOGY: {
+      const float limit = is_first_wave ? SCULPT_EXPAND_WAVE_TOPOLOGY_RINGS :
+                                          expand_cache->falloff_wave_limit * 2.0f;
+      falloff = sculpt_expand_topology_falloff_create(sd, ob, v, limit, &limit_reached);
+      expand_cache->falloff_wave_limit = limit;
+      break;
+    }
+    default:
+      BLI_assert_unreachable();
+      return;
+  }
+
+  MEM_SAFE_FREE(expand_cache->vert_falloff);
+  expand_cache->vert_falloff = falloff;
+
+  ExpandWaveTLSData wtd = {
+      .max_falloff = -FLT_MAX,
+      .limit_reached = false,
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = SCULPT_EXPAND_WAVE_MIN_ITER_PER_THREAD;
+  settings.func_reduce = sculpt_expand_falloff_wave_clamp_reduce;
+  settings.userdata_chunk = &wtd;
+  settings.userdata_chunk_size = sizeof(ExpandWaveTLSData);
+  BLI_task_parallel_range(0,
+                          SCULPT_vertex_count_get(ss),
+                          expand_cache,
+                          sculpt_expand_falloff_wave_clamp_task_cb,
+                          &settings);
+
+  expand_cache->falloff_pending = limit_reached || wtd.limit_reached;
+
+  /* Vertices outside of the active components are never reached, so their falloff is already
+   * skipped as FLT_MAX. */
+  expand_cache->max_vert_falloff = wtd.max_falloff;
+  if (expand_cache->target == SCULPT_EXPAND_TARGET_FACE_SETS) {
+    sculpt_expand_mesh_face_falloff_from_vertex_falloff(ss, ob->data, expand_cache);
+    sculpt_expand_update_max_face_falloff_factor(ss, expand_cache);
+  }
+}
+
+/**
+ * Checks if the current #ExpandCache options need the falloff of the whole mesh. The looping,
+ * texture distortion and inverted gradients depend on the max falloff value, and without an active
+ * vertex all elements are enabled.
+ */
+static bool sculpt_expand_falloff_needs_all_waves(ExpandCache *expand_cache,
+                                                  const SculptVertRef target_v)
+{
+  return target_v.i == SCULPT_EXPAND_VERTEX_NONE || expand_cache->loop_count > 1 ||
+         expand_cache->texture_distortion_strength != 0.0f ||
+         (expand_cache->invert && expand_cache->falloff_gradient);
+}
+
+/**
+ * Computes new falloff waves until the falloff reaches `target_v`, or when `use_time_budget` is
+ * set, until the time budget of a modal update runs out. At least one wave is computed per call.
+ * Returns false when the falloff is not final for the current state yet.
+ */
+static bool sculpt_expand_falloff_refine(Sculpt *sd,
+                                         Object *ob,
+                                         ExpandCache *expand_cache,
+                                         const SculptVertRef target_v,
+                                         const bool use_time_budget)
+{
+  SculptSession *ss = ob->sculpt;
+  const double time_start = PIL_check_seconds_timer();
+
+  while (expand_cache->falloff_pending) {
+    if (!sculpt_expand_falloff_needs_all_waves(expand_cache, target_v)) {
+      const int target_v_i = BKE_pbvh_vertex_index_to_table(ss->pbvh, target_v);
+      if (expand_cache->vert_falloff[target_v_i] != FLT_MAX) {
+        return true;
+      }
+    }
+
+    if (use_time_budget &&
+        PIL_check_seconds_timer() - time_start > SCULPT_EXPAND_WAVE_TIME_BUDGET) {
+      return false;
+    }
+
+    sculpt_expand_falloff_wave_step(sd, ob, expand_cache);
+  }
+
+  return true;
+}
+
 /**
  * Main function to initialize new falloff values in a #ExpandCache given an initial vertex and a
  * falloff type.
@@ -1159,26 +1391,24 @@ static void sculpt_expand_falloff_factors_from_vertex_and_symm_create(
 {
   MEM_SAFE_FREE(expand_cache->vert_falloff);
   expand_cache->falloff_type = falloff_type;
+  expand_cache->falloff_pending = false;
 
   SculptSession *ss = ob->sculpt;
   const bool has_topology_info = ELEM(BKE_pbvh_type(ss->pbvh), PBVH_FACES, PBVH_BMESH);
 
   switch (falloff_type) {
     case SCULPT_EXPAND_FALLOFF_GEODESIC:
-      expand_cache->vert_falloff = sculpt_expand_geodesic_falloff_create(sd, ob, v);
-      /*
-      expand_cache->vert_falloff = has_topology_info ?
-                                       sculpt_expand_geodesic_falloff_create(sd, ob, v) :
-                                       sculpt_expand_spherical_falloff_create(ob, v);
-                                       */
-      break;
     case SCULPT_EXPAND_FALLOFF_TOPOLOGY:
-      expand_cache->vert_falloff = sculpt_expand_topology_falloff_create(sd, ob, v);
-      break;
+      /* Only the first wave is computed here, see #sculpt_expand_falloff_refine. */
+      expand_cache->falloff_wave_origin = v;
+      expand_cache->falloff_wave_limit = 0.0f;
+      sculpt_expand_falloff_wave_step(sd, ob, expand_cache);
+      return;
     case SCULPT_EXPAND_FALLOFF_TOPOLOGY_DIAGONALS:
       expand_cache->vert_falloff = has_topology_info ?
                                        sculpt_expand_diagonals_falloff_create(ob, v) :
-                                       sculpt_expand_topology_falloff_create(sd, ob, v);
+                                       sculpt_expand_topology_falloff_create(
+                                           sd, ob, v, FLT_MAX, NULL);
       break;
     case SCULPT_EXPAND_FALLOFF_NORMALS:
       expand_cache->vert_falloff = sculpt_expand_normal_falloff_create(
@@ -1370,6 +1600,14 @@ static void sculpt_expand_restore_original_state(bContext *C,
   }
 }
 
+static void sculpt_expand_falloff_timer_remove(bContext *C, ExpandCache *expand_cache)
+{
+  if (expand_cache->falloff_timer) {
+    WM_event_remove_timer(CTX_wm_manager(C), CTX_wm_window(C), expand_cache->falloff_timer);
+    expand_cache->falloff_timer = NULL;
+  }
+}
+
 /**
  * Cancel operator callback.
  */
@@ -1378,6 +1616,7 @@ static void sculpt_expand_cancel(bContext *C, wmOperator *UNUSED(op))
   Object *ob = CTX_data_active_object(C);
   SculptSession *ss = ob->sculpt;
 
+  sculpt_expand_falloff_timer_remove(C, ss->expand_cache);
   sculpt_expand_restore_original_state(C, ob, ss->expand_cache);
 
   SCULPT_undo_push_end(ob);
@@ -1620,6 +1859,11 @@ static void sculpt_expand_update_for_vertex(bContext *C, Object *ob, const Sculp
     expand_cache->active_falloff = expand_cache->max_vert_falloff;
     expand_cache->all_enabled = true;
   }
+  else if (expand_cache->falloff_pending && expand_cache->vert_falloff[vertex_i] == FLT_MAX) {
+    /* The falloff waves did not reach the cursor yet, preview everything computed so far. */
+    expand_cache->active_falloff = expand_cache->max_vert_falloff;
+    expand_cache->all_enabled = false;
+  }
   else {
     expand_cache->active_falloff = expand_cache->vert_falloff[vertex_i];
     expand_cache->all_enabled = false;
@@ -1743,6 +1987,7 @@ static void sculpt_expand_finish(bContext *C)
 {
   Object *ob = CTX_data_active_object(C);
   SculptSession *ss = ob->sculpt;
+  sculpt_expand_falloff_timer_remove(C, ss->expand_cache);
   SCULPT_undo_push_end(ob);
 
   /* Tag all nodes to redraw to avoid artifacts after the fast partial updates. */
@@ -1901,8 +2146,11 @@ static int sculpt_expand_modal(bContext *C, wmOperator *op, const wmEvent *event
   SculptSession *ss = ob->sculpt;
   Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
 
-  /* Skips INBETWEEN_MOUSEMOVE events and other events that may cause unnecessary updates. */
-  if (!ELEM(event->type, MOUSEMOVE, EVT_MODAL_MAP)) {
+  /* Skips INBETWEEN_MOUSEMOVE events and other events that may cause unnecessary updates. The
+   * falloff timer keeps computing falloff waves while the cursor is not moving. */
+  const bool is_falloff_timer = event->type == TIMER && ss->expand_cache->falloff_timer &&
+                                event->customdata == ss->expand_cache->falloff_timer;
+  if (!ELEM(event->type, MOUSEMOVE, EVT_MODAL_MAP) && !is_falloff_timer) {
     return OPERATOR_RUNNING_MODAL;
   }
 
@@ -1992,6 +2240,7 @@ static int sculpt_expand_modal(bContext *C, wmOperator *op, const wmEvent *event
         break;
       }
       case SCULPT_EXPAND_MODAL_CONFIRM: {
+        sculpt_expand_falloff_refine(sd, ob, expand_cache, target_expand_vertex, false);
         sculpt_expand_update_for_vertex(C, ob, target_expand_vertex);
 
         if (expand_cache->reposition_pivot) {
@@ -2086,6 +2335,16 @@ static int sculpt_expand_modal(bContext *C, wmOperator *op, const wmEvent *event
     }
   }
 
+  /* Compute the falloff as far as the cursor reaches. When that takes longer than a modal update,
+   * preview the partial falloff and continue on the next timer events. */
+  if (sculpt_expand_falloff_refine(sd, ob, expand_cache, target_expand_vertex, true)) {
+    sculpt_expand_falloff_timer_remove(C, expand_cache);
+  }
+  else if (!expand_cache->falloff_timer) {
+    expand_cache->falloff_timer = WM_event_add_timer(
+        CTX_wm_manager(C), CTX_wm_window(C), TIMER, 0.01f);
+  }
+
   /* Update the sculpt data with the current state of the #ExpandCache. */
   sculpt_expand_update_for_vertex(C, ob, target_expand_vertex);
 
@@ -111,6 +111,7 @@ static void color_filter_task_cb(void *__restrict userdata,
   BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[n], vd, PBVH_ITER_UNIQUE) {
     SCULPT_vertex_check_origdata(ss, vd.vertex);
     MSculptVert *mv = SCULPT_vertex_get_sculptvert(ss, vd.vertex);
+    const MSculptVertCold *mv_cold = SCULPT_vertex_get_sculptvert_cold(ss, vd.vertex);
 
     float orig_color[3], final_color[4], hsv_color[3];
     int hue;
@@ -125,7 +126,7 @@ static void color_filter_task_cb(void *__restrict userdata,
 
     float random_factor = 0.0f;
 
-    copy_v3_v3(orig_color, mv->origcolor);
+    copy_v3_v3(orig_color, mv_cold->origcolor);
 
     /* Index is not unique for multires, so hash by vertex coordinates. */
     if (COLOR_FILTER_NEEDS_RANDOM(mode)) {
@@ -145,7 +146,7 @@ static void color_filter_task_cb(void *__restrict userdata,
         fill_color_rgba[3] = 1.0f;
         fade = clamp_f(fade, 0.0f, 1.0f);
         mul_v4_fl(fill_color_rgba, fade);
-        blend_color_mix_float(final_color, mv->origcolor, fill_color_rgba);
+        blend_color_mix_float(final_color, mv_cold->origcolor, fill_color_rgba);
         break;
       }
       case COLOR_FILTER_HUE:
@@ -296,6 +296,21 @@ static bool sculpt_mesh_filter_needs_pmap(eSculptMeshFilterType filter_type)
               MESH_FILTER_SHARPEN);
 }
 
+/**
+ * Filters that compute the new coordinates from the original ones, as opposed to iterating on the
+ * current coordinates. Their result only changes with the strength.
+ */
+static bool sculpt_mesh_filter_is_from_original(eSculptMeshFilterType filter_type)
+{
+  return ELEM(filter_type,
+              MESH_FILTER_SCALE,
+              MESH_FILTER_INFLATE,
+              MESH_FILTER_SPHERE,
+              MESH_FILTER_RANDOM,
+              MESH_FILTER_ENHANCE_DETAILS,
+              MESH_FILTER_ERASE_DISPLACEMENT);
+}
+
 static void mesh_filter_task_cb(void *__restrict userdata,
                                 const int i,
                                 const TaskParallelTLS *__restrict UNUSED(tls))
@@ -306,6 +321,7 @@ static void mesh_filter_task_cb(void *__restrict userdata,
   FilterCache *filter_cache = ss->filter_cache;
 
   const eSculptMeshFilterType filter_type = data->filter_type;
+  const bool from_original = sculpt_mesh_filter_is_from_original(filter_type);
 
   SculptOrigVertData orig_data;
   SCULPT_orig_vert_data_init(&orig_data, data->ob, data->nodes[i], SCULPT_UNDO_COORDS);
@@ -332,6 +348,7 @@ static void mesh_filter_task_cb(void *__restrict userdata,
   }
 
   bool do_reproject = SCULPT_need_reproject(ss);
+  bool modified = false;
 
   PBVHVertexIter vd;
   BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vd, PBVH_ITER_UNIQUE) {
@@ -339,12 +356,13 @@ static void mesh_filter_task_cb(void *__restrict userdata,
     float orig_co[3], oldco[3], oldno[3], val[3], avg[3], disp[3];
     float disp2[3], transform[3][3], final_pos[3];
 
-    float fade = vd.mask ? *vd.mask : 0.0f;
-    fade = 1.0f - fade;
-    fade *= data->filter_strength;
-    fade *= SCULPT_automasking_factor_get(ss->filter_cache->automasking, ss, vd.vertex);
+    float weight = vd.mask ? 1.0f - *vd.mask : 1.0f;
+    weight *= SCULPT_automasking_factor_get(ss->filter_cache->automasking, ss, vd.vertex);
+    float fade = weight * data->filter_strength;
 
-    if (fade == 0.0f && filter_type != MESH_FILTER_SURFACE_SMOOTH) {
+    /* Filters from the original coordinates still need to restore the vertices when the strength
+     * goes back to zero. */
+    if ((from_original ? weight : fade) == 0.0f && filter_type != MESH_FILTER_SURFACE_SMOOTH) {
       /* Surface Smooth can't skip the loop for this vertex as it needs to calculate its
        * laplacian_disp. This value is accessed from the vertex neighbors when deforming the
        * vertices, so it is needed for all vertices even if they are not going to be displaced.
@@ -537,7 +555,11 @@ static void mesh_filter_task_cb(void *__restrict userdata,
     else {
       add_v3_v3v3(final_pos, orig_co, disp);
     }
+    if (equals_v3v3(vd.co, final_pos)) {
+      continue;
+    }
     copy_v3_v3(vd.co, final_pos);
+    modified = true;
     if (vd.mvert) {
       BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
     }
@@ -554,8 +576,11 @@ static void mesh_filter_task_cb(void *__restrict userdata,
   }
   BKE_pbvh_vertex_iter_end;
 
-  BKE_pbvh_node_mark_update_tri_area(node);
-  BKE_pbvh_node_mark_update(node);
+  /* Only redraw what moved, most of the mesh can be masked out or already in place. */
+  if (modified) {
+    BKE_pbvh_node_mark_update_tri_area(node);
+    BKE_pbvh_node_mark_update(node);
+  }
 }
 
 static void mesh_filter_enhance_details_init_directions(SculptSession *ss)
@@ -708,6 +733,7 @@ static void mesh_filter_surface_smooth_displace_task_cb(
   SculptSession *ss = data->ob->sculpt;
   PBVHNode *node = data->nodes[i];
   PBVHVertexIter vd;
+  bool modified = false;
 
   BKE_pbvh_vertex_iter_begin (ss->pbvh, node, vd, PBVH_ITER_UNIQUE) {
     float fade = vd.mask ? *vd.mask : 0.0f;
@@ -725,16 +751,85 @@ static void mesh_filter_surface_smooth_displace_task_cb(
                              .is_cdlayer = false,
                              .layer = NULL};
 
+    float co_prev[3];
+    copy_v3_v3(co_prev, vd.co);
+
     SCULPT_surface_smooth_displace_step(ss,
                                         vd.co,
                                         &scl,
                                         vd.vertex,
                                         ss->filter_cache->surface_smooth_current_vertex,
                                         clamp_f(fade, 0.0f, 1.0f));
+
+    if (!equals_v3v3(co_prev, vd.co)) {
+      modified = true;
+      if (vd.mvert) {
+        BKE_pbvh_vert_mark_update(ss->pbvh, vd.vertex);
+      }
+    }
+  }
+  BKE_pbvh_vertex_iter_end;
+
+  if (modified) {
+    BKE_pbvh_node_mark_update_tri_area(node);
+    BKE_pbvh_node_mark_update(node);
+  }
+}
+
+static void mesh_filter_node_active_task_cb(void *__restrict userdata,
+                                            const int i,
+                                            const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  SculptThreadedTaskData *data = userdata;
+  SculptSession *ss = data->ob->sculpt;
+  bool *node_active = data->custom_data;
+  PBVHVertexIter vd;
+
+  node_active[i] = false;
+  BKE_pbvh_vertex_iter_begin (ss->pbvh, data->nodes[i], vd, PBVH_ITER_UNIQUE) {
+    const float mask = vd.mask ? 1.0f - *vd.mask : 1.0f;
+    if (mask * SCULPT_automasking_factor_get(ss->filter_cache->automasking, ss, vd.vertex) !=
+        0.0f) {
+      node_active[i] = true;
+      break;
+    }
   }
   BKE_pbvh_vertex_iter_end;
 }
 
+/**
+ * Drop the nodes auto-masking excludes entirely, the filter can't move any of their vertices.
+ * Fully masked nodes are already left out when gathering the nodes.
+ */
+static void mesh_filter_nodes_remove_inactive(Sculpt *sd, Object *ob)
+{
+  SculptSession *ss = ob->sculpt;
+  FilterCache *filter_cache = ss->filter_cache;
+  bool *node_active = MEM_malloc_arrayN(filter_cache->totnode, sizeof(bool), __func__);
+
+  SculptThreadedTaskData data = {
+      .sd = sd,
+      .ob = ob,
+      .nodes = filter_cache->nodes,
+      .custom_data = node_active,
+  };
+
+  TaskParallelSettings settings;
+  BKE_pbvh_parallel_range_settings(&settings, true, filter_cache->totnode);
+  BLI_task_parallel_range(
+      0, filter_cache->totnode, &data, mesh_filter_node_active_task_cb, &settings);
+
+  int totnode = 0;
+  for (int i = 0; i < filter_cache->totnode; i++) {
+    if (node_active[i]) {
+      filter_cache->nodes[totnode++] = filter_cache->nodes[i];
+    }
+  }
+  filter_cache->totnode = totnode;
+
+  MEM_freeN(node_active);
+}
+
 static int sculpt_mesh_filter_modal(bContext *C, wmOperator *op, const wmEvent *event)
 {
   Object *ob = CTX_data_active_object(C);
@@ -758,6 +853,14 @@ static int sculpt_mesh_filter_modal(bContext *C, wmOperator *op, const wmEvent *
   const float len = event->prev_click_xy[0] - event->xy[0];
   filter_strength = filter_strength * -len * 0.001f * UI_DPI_FAC;
 
+  if (sculpt_mesh_filter_is_from_original(filter_type)) {
+    /* The mouse moved without changing the strength, the mesh is already up to date. */
+    if (filter_strength == ss->filter_cache->last_strength) {
+      return OPERATOR_RUNNING_MODAL;
+    }
+    ss->filter_cache->last_strength = filter_strength;
+  }
+
   SCULPT_vertex_random_access_ensure(ss);
 
   bool needs_pmap = sculpt_mesh_filter_needs_pmap(filter_type);
@@ -847,6 +950,14 @@ static int sculpt_mesh_filter_invoke(bContext *C, wmOperator *op, const wmEvent
   filter_cache->active_face_set = SCULPT_FACE_SET_NONE;
   filter_cache->automasking = SCULPT_automasking_cache_init(sd, NULL, ob);
 
+  /* Surface Smooth needs the laplacian of every vertex, including the auto-masked ones. */
+  if (filter_cache->automasking && filter_type != MESH_FILTER_SURFACE_SMOOTH) {
+    mesh_filter_nodes_remove_inactive(sd, ob);
+  }
+
+  /* The coordinates start out as the original ones, which is what a strength of zero gives. */
+  filter_cache->last_strength = 0.0f;
+
   switch (filter_type) {
     case MESH_FILTER_SURFACE_SMOOTH: {
       const float shape_preservation = RNA_float_get(op->ptr, "surface_smooth_shape_preservation");
@@ -10,12 +10,14 @@
 #include "BLI_alloca.h"
 #include "BLI_array.h"
 #include "BLI_blenlib.h"
+#include "BLI_kdtree.h"
 #include "BLI_linklist_stack.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
 #include "BLI_sort_utils.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.h"
@@ -62,605 +64,839 @@
 
 #include "bmesh.h"
 
+#include "atomic_ops.h"
+
 #include <math.h>
 #include <stdlib.h>
 #define SCULPT_GEODESIC_VERTEX_NONE -1
 
-/* Propagate distance from v1 and v2 to v0. */
-static bool sculpt_geodesic_mesh_test_dist_add(MVert *mvert,
-                                               const int v0,
-                                               const int v1,
-                                               const int v2,
-                                               float *dists,
-                                               GSet *initial_vertices,
-                                               SculptVertRef *r_closest_verts,
-                                               float (*cos)[3])
+/* -------------------------------------------------------------------- */
+/** \name Parallel Front Propagation
+ *
+ * Distances are propagated from the initial vertices over a front of edges. Each pass relaxes the
+ * edges of the front in parallel and collects the edges around vertices that got closer into the
+ * next front, until no distance changes anymore.
+ *
+ * Distances only ever decrease, so concurrent updates of the same vertex are resolved with a
+ * compare and swap. The distance is packed together with the closest initial vertex to keep both
+ * consistent.
+ * \{ */
+
+#define GEODESIC_FRONT_BUFFER_SIZE 256
+#define GEODESIC_FRONT_MIN_ITER_PER_THREAD 256
+
+/* Per-vertex solver data is stored in pages of consecutive vertices, allocated when the front
+ * first reaches one of their vertices. With a limit radius only the pages around the initial
+ * vertices are allocated and initialized, instead of arrays for the entire mesh. */
+#define GEODESIC_PAGE_SHIFT 10
+#define GEODESIC_PAGE_SIZE (1 << GEODESIC_PAGE_SHIFT)
+#define GEODESIC_PAGE_MASK (GEODESIC_PAGE_SIZE - 1)
+
+typedef struct GeodesicPage {
+  /* Bits of the distance in the upper half, table index of the closest initial vertex in the
+   * lower half. Distances are never negative, so packed values compare like the distances. */
+  uint64_t dists[GEODESIC_PAGE_SIZE];
+
+  /* Vertices that are further than limit radius from an initial vertex. As there is no need to
+   * define a distance to them the propagation can stop earlier by skipping them. */
+  BLI_bitmap affected_vertex[GEODESIC_PAGE_SIZE >> 5];
+  BLI_bitmap initial_vertex[GEODESIC_PAGE_SIZE >> 5];
+} GeodesicPage;
+
+typedef struct GeodesicFrontTLS {
+  int len;
+  int edges[GEODESIC_FRONT_BUFFER_SIZE];
+} GeodesicFrontTLS;
+
+typedef struct GeodesicSolver GeodesicSolver;
+
+typedef void (*GeodesicRelaxEdgeFn)(GeodesicSolver *solver, int e, GeodesicFrontTLS *tls);
+
+struct GeodesicSolver {
+  SculptSession *ss;
+  int totvert, totedge;
+
+  /* Coordinates, in order of precedence. */
+  float (*cos)[3];
+  const MVert *mvert;
+
+  float limit_radius;
+  bool use_closest;
+
+  /* Created on demand, see #geodesic_page_ensure. */
+  GeodesicPage **pages;
+  int totpage;
+
+  int *initial_verts;
+  int totinitial;
+  /* Initial vertex positions to find the affected vertices, NULL without a limit radius. */
+  KDTree_3d *initial_tree;
+
+  /* Edges that are in the next front already. Set atomically. */
+  BLI_bitmap *edge_tag;
+
+  /* Both grow with the front, #front_next under #front_lock. */
+  int *front, front_len, front_size;
+  int *front_next, front_next_len, front_next_size;
+  SpinLock front_lock;
+
+  GeodesicRelaxEdgeFn relax_edge;
+  /* Topology of the PBVH type, used by #relax_edge. */
+  void *userdata;
+};
+
+BLI_INLINE uint64_t geodesic_pack(const float dist, const int closest)
 {
-  if (BLI_gset_haskey(initial_vertices, POINTER_FROM_INT(v0))) {
-    return false;
+  uint32_t dist_bits;
+  memcpy(&dist_bits, &dist, sizeof(dist_bits));
+  return ((uint64_t)dist_bits << 32) | (uint32_t)closest;
+}
+
+BLI_INLINE float geodesic_unpack_dist(const uint64_t value)
+{
+  const uint32_t dist_bits = (uint32_t)(value >> 32);
+  float dist;
+  memcpy(&dist, &dist_bits, sizeof(dist));
+  return dist;
+}
+
+BLI_INLINE const float *geodesic_vert_co(const GeodesicSolver *solver, const int v)
+{
+  if (solver->cos) {
+    return solver->cos[v];
+  }
+  if (solver->mvert) {
+    return solver->mvert[v].co;
   }
+  return SCULPT_vertex_co_get(solver->ss, BKE_pbvh_table_index_to_vertex(solver->ss->pbvh, v));
+}
 
-  BLI_assert(dists[v1] != FLT_MAX);
-  if (dists[v0] <= dists[v1]) {
-    return false;
+static GeodesicPage *geodesic_page_create(const GeodesicSolver *solver, const int page_index)
+{
+  GeodesicPage *page = MEM_mallocN(sizeof(*page), __func__);
+  const uint64_t unreached = geodesic_pack(FLT_MAX, SCULPT_GEODESIC_VERTEX_NONE);
+  const int start = page_index << GEODESIC_PAGE_SHIFT;
+  const int end = min_ii(start + GEODESIC_PAGE_SIZE, solver->totvert);
+
+  for (int i = 0; i < GEODESIC_PAGE_SIZE; i++) {
+    page->dists[i] = unreached;
   }
+  memset(page->initial_vertex, 0, sizeof(page->initial_vertex));
 
-  float *co0 = cos ? cos[v0] : mvert[v0].co;
-  float *co1 = cos ? cos[v1] : mvert[v1].co;
-  float *co2 = v2 != SCULPT_GEODESIC_VERTEX_NONE ? (cos ? cos[v2] : mvert[v2].co) : NULL;
+  if (!solver->initial_tree) {
+    memset(page->affected_vertex, 0xff, sizeof(page->affected_vertex));
+    return page;
+  }
 
-  float dist0;
-  if (v2 != SCULPT_GEODESIC_VERTEX_NONE) {
-    BLI_assert(dists[v2] != FLT_MAX);
-    if (dists[v0] <= dists[v2]) {
-      return false;
+  memset(page->affected_vertex, 0, sizeof(page->affected_vertex));
+  for (int v = start; v < end; v++) {
+    KDTreeNearest_3d nearest;
+    if (BLI_kdtree_3d_find_nearest(solver->initial_tree, geodesic_vert_co(solver, v), &nearest) !=
+            -1 &&
+        nearest.dist <= solver->limit_radius) {
+      BLI_BITMAP_ENABLE(page->affected_vertex, v & GEODESIC_PAGE_MASK);
     }
-    dist0 = geodesic_distance_propagate_across_triangle(co0, co1, co2, dists[v1], dists[v2]);
   }
-  else {
-    float vec[3];
-    sub_v3_v3v3(vec, co1, co0);
-    dist0 = dists[v1] + len_v3(vec);
+
+  return page;
+}
+
+/* Page of `v`, created if the front didn't get there yet. Safe to call from multiple threads. */
+static GeodesicPage *geodesic_page_ensure(GeodesicSolver *solver, const int v)
+{
+  GeodesicPage **page_p = &solver->pages[v >> GEODESIC_PAGE_SHIFT];
+  GeodesicPage *page = *page_p;
+
+  if (page) {
+    return page;
   }
 
-  if (dist0 < dists[v0]) {
-    dists[v0] = dist0;
+  page = geodesic_page_create(solver, v >> GEODESIC_PAGE_SHIFT);
 
-    if (r_closest_verts) {
-      bool tag1 = r_closest_verts[v1].i != -1LL;
-      bool tag2 = v2 != SCULPT_GEODESIC_VERTEX_NONE && r_closest_verts[v2].i != -1LL;
+  GeodesicPage *prev_page = atomic_cas_ptr((void **)page_p, NULL, page);
+  if (prev_page) {
+    /* Another thread created it first. */
+    MEM_freeN(page);
+    return prev_page;
+  }
 
-      float l1 = len_v3v3(co0, co1);
-      float l2 = v2 != SCULPT_GEODESIC_VERTEX_NONE ? len_v3v3(co0, co2) : 0.0f;
+  return page;
+}
 
-      if (tag1 && tag2) {
-        if (l1 < l2) {
-          r_closest_verts[v0] = r_closest_verts[v1];
-        }
-        else {
-          r_closest_verts[v0] = r_closest_verts[v2];
-        }
-      }
-      else if (tag2) {
-        r_closest_verts[v0] = r_closest_verts[v2];
-      }
-      else if (tag1) {
-        r_closest_verts[v0] = r_closest_verts[v1];
-      }
+BLI_INLINE uint64_t geodesic_packed_get(const GeodesicSolver *solver, const int v)
+{
+  const GeodesicPage *page = solver->pages[v >> GEODESIC_PAGE_SHIFT];
+  return page ? page->dists[v & GEODESIC_PAGE_MASK] :
+                geodesic_pack(FLT_MAX, SCULPT_GEODESIC_VERTEX_NONE);
+}
+
+BLI_INLINE float geodesic_dist_get(const GeodesicSolver *solver, const int v)
+{
+  return geodesic_unpack_dist(geodesic_packed_get(solver, v));
+}
+
+BLI_INLINE int geodesic_closest_get(const GeodesicSolver *solver, const int v)
+{
+  return (int)(uint32_t)geodesic_packed_get(solver, v);
+}
+
+BLI_INLINE bool geodesic_vertex_is_initial(const GeodesicSolver *solver, const int v)
+{
+  /* The pages of all initial vertices are created with the solver. */
+  const GeodesicPage *page = solver->pages[v >> GEODESIC_PAGE_SHIFT];
+  return page && BLI_BITMAP_TEST(page->initial_vertex, v & GEODESIC_PAGE_MASK);
+}
+
+BLI_INLINE bool geodesic_vertex_is_affected(GeodesicSolver *solver, const int v)
+{
+  const GeodesicPage *page = geodesic_page_ensure(solver, v);
+  return BLI_BITMAP_TEST(page->affected_vertex, v & GEODESIC_PAGE_MASK);
+}
+
+/* Lower the distance of `v` to `dist`, returns false when another thread got it closer first. */
+static bool geodesic_dist_min(GeodesicSolver *solver,
+                              const int v,
+                              const float dist,
+                              const int closest)
+{
+  uint64_t *value_p = &geodesic_page_ensure(solver, v)->dists[v & GEODESIC_PAGE_MASK];
+  const uint64_t new_value = geodesic_pack(dist, closest);
+  uint64_t old_value = *value_p;
+
+  while (dist < geodesic_unpack_dist(old_value)) {
+    const uint64_t prev_value = atomic_cas_uint64(value_p, old_value, new_value);
+
+    if (prev_value == old_value) {
+      return true;
     }
-    return true;
+    old_value = prev_value;
   }
 
   return false;
 }
 
-/* Propagate distance from v1 and v2 to v0. */
-static bool sculpt_geodesic_grids_test_dist_add(SculptSession *ss,
-                                                const int v0,
-                                                const int v1,
-                                                const int v2,
-                                                float *dists,
-                                                GSet *initial_vertices,
-                                                SculptVertRef *r_closest_verts,
-                                                float (*cos)[3])
+/* Propagate distance from v1 and v2 to v0. Returns true when v0 got closer and is within the
+ * limit radius, so the distance has to be propagated further from it. */
+static bool geodesic_dist_add(GeodesicSolver *solver,
+                              const int v0,
+                              const int v1,
+                              const int v2,
+                              const float *co0,
+                              const float *co1,
+                              const float *co2)
 {
-  if (BLI_gset_haskey(initial_vertices, POINTER_FROM_INT(v0))) {
+  if (geodesic_vertex_is_initial(solver, v0)) {
     return false;
   }
 
-  BLI_assert(dists[v1] != FLT_MAX);
-  if (dists[v0] <= dists[v1]) {
+  const float dist_v0 = geodesic_dist_get(solver, v0);
+  const float dist_v1 = geodesic_dist_get(solver, v1);
+
+  BLI_assert(dist_v1 != FLT_MAX);
+  if (dist_v0 <= dist_v1) {
     return false;
   }
 
-  const float *co0 = cos ? cos[v0] :
-                           SCULPT_vertex_co_get(ss, BKE_pbvh_table_index_to_vertex(ss->pbvh, v0));
-  const float *co1 = cos ? cos[v1] :
-                           SCULPT_vertex_co_get(ss, BKE_pbvh_table_index_to_vertex(ss->pbvh, v1));
-  const float *co2 = v2 != SCULPT_GEODESIC_VERTEX_NONE ?
-                         (cos ? cos[v2] :
-                                SCULPT_vertex_co_get(
-                                    ss, BKE_pbvh_table_index_to_vertex(ss->pbvh, v2))) :
-                         NULL;
-
   float dist0;
   if (v2 != SCULPT_GEODESIC_VERTEX_NONE) {
-    BLI_assert(dists[v2] != FLT_MAX);
-    if (dists[v0] <= dists[v2]) {
+    const float dist_v2 = geodesic_dist_get(solver, v2);
+
+    BLI_assert(dist_v2 != FLT_MAX);
+    if (dist_v0 <= dist_v2) {
       return false;
     }
-    dist0 = geodesic_distance_propagate_across_triangle(co0, co1, co2, dists[v1], dists[v2]);
+    dist0 = geodesic_distance_propagate_across_triangle(co0, co1, co2, dist_v1, dist_v2);
   }
   else {
-    float vec[3];
-    sub_v3_v3v3(vec, co1, co0);
-    dist0 = dists[v1] + len_v3(vec);
+    dist0 = dist_v1 + len_v3v3(co1, co0);
   }
 
-  if (dist0 < dists[v0]) {
-    dists[v0] = dist0;
+  if (dist0 >= dist_v0) {
+    return false;
+  }
 
-    if (r_closest_verts) {
-      bool tag1 = r_closest_verts[v1].i != -1LL;
-      bool tag2 = v2 != SCULPT_GEODESIC_VERTEX_NONE && r_closest_verts[v2].i != -1LL;
+  int closest = geodesic_closest_get(solver, v0);
 
-      float l1 = len_v3v3(co0, co1);
-      float l2 = v2 != SCULPT_GEODESIC_VERTEX_NONE ? len_v3v3(co0, co2) : 0.0f;
+  if (solver->use_closest) {
+    const int closest1 = geodesic_closest_get(solver, v1);
+    const int closest2 = v2 != SCULPT_GEODESIC_VERTEX_NONE ? geodesic_closest_get(solver, v2) :
+                                                             SCULPT_GEODESIC_VERTEX_NONE;
+    const bool tag1 = closest1 != SCULPT_GEODESIC_VERTEX_NONE;
+    const bool tag2 = closest2 != SCULPT_GEODESIC_VERTEX_NONE;
 
-      if (tag1 && tag2) {
-        if (l1 < l2) {
-          r_closest_verts[v0] = r_closest_verts[v1];
-        }
-        else {
-          r_closest_verts[v0] = r_closest_verts[v2];
-        }
-      }
-      else if (tag2) {
-        r_closest_verts[v0] = r_closest_verts[v2];
-      }
-      else if (tag1) {
-        r_closest_verts[v0] = r_closest_verts[v1];
-      }
+    if (tag1 && tag2) {
+      closest = len_v3v3(co0, co1) < len_v3v3(co0, co2) ? closest1 : closest2;
+    }
+    else if (tag2) {
+      closest = closest2;
+    }
+    else if (tag1) {
+      closest = closest1;
     }
-    return true;
   }
 
-  return false;
+  return geodesic_dist_min(solver, v0, dist0, closest) && dist0 <= solver->limit_radius;
 }
 
-#define BMESH_INITIAL_VERT_TAG BM_ELEM_TAG_ALT
-
-static bool sculpt_geodesic_mesh_test_dist_add_bmesh(BMVert *v0,
-                                                     BMVert *v1,
-                                                     BMVert *v2,
-                                                     float *dists,
-                                                     GSet *initial_vertices,
-                                                     SculptVertRef *r_closest_verts,
-                                                     float (*cos)[3])
+static void geodesic_front_flush(GeodesicSolver *solver, GeodesicFrontTLS *tls)
 {
-  const int v0_i = BM_elem_index_get(v0);
-  const int v1_i = BM_elem_index_get(v1);
-  const int v2_i = v2 ? BM_elem_index_get(v2) : SCULPT_GEODESIC_VERTEX_NONE;
+  if (tls->len == 0) {
+    return;
+  }
 
-  const float *v0co = cos ? cos[BM_elem_index_get(v0)] : v0->co;
-  const float *v1co = cos ? cos[BM_elem_index_get(v1)] : v1->co;
-  const float *v2co = v2 ? (cos ? cos[BM_elem_index_get(v2)] : v2->co) : NULL;
+  BLI_spin_lock(&solver->front_lock);
 
-  if (BM_elem_flag_test(v0, BMESH_INITIAL_VERT_TAG)) {
-    return false;
+  const int len = solver->front_next_len + tls->len;
+  if (len > solver->front_next_size) {
+    solver->front_next_size = max_ii(len, solver->front_next_size * 2);
+    solver->front_next = MEM_reallocN(solver->front_next,
+                                      sizeof(int) * (size_t)solver->front_next_size);
   }
+  memcpy(solver->front_next + solver->front_next_len, tls->edges, sizeof(int) * (size_t)tls->len);
+  solver->front_next_len = len;
 
-  BLI_assert(dists[v1_i] != FLT_MAX);
-  if (dists[v0_i] <= dists[v1_i]) {
-    return false;
+  BLI_spin_unlock(&solver->front_lock);
+
+  tls->len = 0;
+}
+
+/* Add an edge to the next front, unless it is in there already. */
+static void geodesic_front_push(GeodesicSolver *solver, GeodesicFrontTLS *tls, const int e)
+{
+  const uint32_t bit = 1u << (e & 31);
+  if (atomic_fetch_and_or_uint32(&solver->edge_tag[e >> 5], bit) & bit) {
+    return;
   }
 
-  float dist0;
-  if (v2_i != SCULPT_GEODESIC_VERTEX_NONE) {
-    BLI_assert(dists[v2_i] != FLT_MAX);
-    if (dists[v0_i] <= dists[v2_i]) {
-      return false;
-    }
+  tls->edges[tls->len++] = e;
+  if (tls->len == GEODESIC_FRONT_BUFFER_SIZE) {
+    geodesic_front_flush(solver, tls);
+  }
+}
 
-    dist0 = geodesic_distance_propagate_across_triangle(
-        v0co, v1co, v2co, dists[v1_i], dists[v2_i]);
+/* Add an edge around an initial vertex to the first front. */
+static void geodesic_front_init_add(GeodesicSolver *solver, const int e)
+{
+  if (BLI_BITMAP_TEST(solver->edge_tag, e)) {
+    return;
   }
-  else {
-    float vec[3];
-    sub_v3_v3v3(vec, v1co, v0co);
-    dist0 = dists[v1_i] + len_v3(vec);
+  BLI_BITMAP_ENABLE(solver->edge_tag, e);
+
+  if (solver->front_len == solver->front_size) {
+    solver->front_size *= 2;
+    solver->front = MEM_reallocN(solver->front, sizeof(int) * (size_t)solver->front_size);
   }
+  solver->front[solver->front_len++] = e;
+}
 
-  if (dist0 < dists[v0_i]) {
-    dists[v0_i] = dist0;
+static void geodesic_front_relax_task_cb(void *__restrict userdata,
+                                         const int i,
+                                         const TaskParallelTLS *__restrict tls)
+{
+  GeodesicSolver *solver = userdata;
+  solver->relax_edge(solver, solver->front[i], tls->userdata_chunk);
+}
 
-    if (r_closest_verts) {
-      bool tag1 = r_closest_verts[v1_i].i != -1LL;
-      bool tag2 = v2 && r_closest_verts[v2_i].i != -1LL;
+static void geodesic_front_flush_task_cb(const void *__restrict userdata,
+                                         void *__restrict chunk)
+{
+  geodesic_front_flush((GeodesicSolver *)userdata, chunk);
+}
 
-      float l1 = len_v3v3(v0co, v1co);
-      float l2 = v2 ? len_v3v3(v0co, v2co) : 0.0f;
+static void geodesic_solver_init(GeodesicSolver *solver,
+                                 SculptSession *ss,
+                                 const int totvert,
+                                 const int totedge,
+                                 GSet *initial_vertices,
+                                 const float limit_radius,
+                                 const bool use_closest,
+                                 float (*cos)[3])
+{
+  memset(solver, 0, sizeof(*solver));
 
-      if (!tag1 && !tag2) {
-        printf("bad\n");
-      }
+  solver->ss = ss;
+  solver->totvert = totvert;
+  solver->totedge = totedge;
+  solver->cos = cos;
+  solver->limit_radius = limit_radius;
+  solver->use_closest = use_closest;
 
-      if (tag1 && tag2) {
-        if (l1 < l2) {  // dists[v1_i] < dists[v2_i]) {
-          r_closest_verts[v0_i] = r_closest_verts[v1_i];
-        }
-        else {
-          r_closest_verts[v0_i] = r_closest_verts[v2_i];
-        }
-      }
-      else if (tag2) {
-        r_closest_verts[v0_i] = r_closest_verts[v2_i];
-      }
-      else if (tag1) {
-        r_closest_verts[v0_i] = r_closest_verts[v1_i];
-      }
+  solver->totpage = (totvert + GEODESIC_PAGE_MASK) >> GEODESIC_PAGE_SHIFT;
+  solver->pages = MEM_calloc_arrayN(max_ii(solver->totpage, 1), sizeof(*solver->pages), __func__);
+
+  solver->initial_verts = MEM_malloc_arrayN(
+      max_ii(BLI_gset_len(initial_vertices), 1), sizeof(int), __func__);
+
+  GSetIterator gs_iter;
+  GSET_ITER (gs_iter, initial_vertices) {
+    const int v = POINTER_AS_INT(BLI_gsetIterator_getKey(&gs_iter));
+
+    if (v < 0 || v >= totvert) {
+      continue;
     }
 
-    return true;
+    solver->initial_verts[solver->totinitial++] = v;
   }
 
-  return false;
+  solver->edge_tag = BLI_BITMAP_NEW(totedge, __func__);
+
+  solver->front_size = solver->front_next_size = GEODESIC_FRONT_BUFFER_SIZE;
+  solver->front = MEM_malloc_arrayN(solver->front_size, sizeof(int), __func__);
+  solver->front_next = MEM_malloc_arrayN(solver->front_next_size, sizeof(int), __func__);
+  BLI_spin_init(&solver->front_lock);
 }
 
-static float *SCULPT_geodesic_mesh_create(Object *ob,
-                                          GSet *initial_vertices,
-                                          const float limit_radius,
-                                          SculptVertRef *r_closest_verts,
-                                          float (*cos)[3])
+/* Set up the initial vertices. Called once the PBVH type specific coordinates are set. */
+static void geodesic_solver_initial_init(GeodesicSolver *solver)
 {
-  SculptSession *ss = ob->sculpt;
-  Mesh *mesh = BKE_object_get_original_mesh(ob);
+  if (solver->limit_radius != FLT_MAX) {
+    solver->initial_tree = BLI_kdtree_3d_new((uint)solver->totinitial);
+    for (int i = 0; i < solver->totinitial; i++) {
+      BLI_kdtree_3d_insert(
+          solver->initial_tree, i, geodesic_vert_co(solver, solver->initial_verts[i]));
+    }
+    BLI_kdtree_3d_balance(solver->initial_tree);
+  }
 
-  const int totvert = mesh->totvert;
-  const int totedge = mesh->totedge;
+  for (int i = 0; i < solver->totinitial; i++) {
+    const int v = solver->initial_verts[i];
+    GeodesicPage *page = geodesic_page_ensure(solver, v);
 
-  const float limit_radius_sq = limit_radius * limit_radius;
+    page->dists[v & GEODESIC_PAGE_MASK] = geodesic_pack(0.0f, v);
+    BLI_BITMAP_ENABLE(page->initial_vertex, v & GEODESIC_PAGE_MASK);
+  }
+}
 
-  MEdge *edges = mesh->medge;
-  MVert *verts = SCULPT_mesh_deformed_mverts_get(ss);
+/* Clear the tags of the first front, once all of its edges are added. */
+static void geodesic_solver_front_init_end(GeodesicSolver *solver)
+{
+  for (int i = 0; i < solver->front_len; i++) {
+    BLI_BITMAP_DISABLE(solver->edge_tag, solver->front[i]);
+  }
+}
 
-  float *dists = MEM_malloc_arrayN(totvert, sizeof(float), "distances");
-  BLI_bitmap *edge_tag = BLI_BITMAP_NEW(totedge, "edge tag");
+static void geodesic_solver_run(GeodesicSolver *solver)
+{
+  while (solver->front_len) {
+    GeodesicFrontTLS tls = {0};
+    solver->front_next_len = 0;
+
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.min_iter_per_thread = GEODESIC_FRONT_MIN_ITER_PER_THREAD;
+    settings.userdata_chunk = &tls;
+    settings.userdata_chunk_size = sizeof(tls);
+    settings.func_free = geodesic_front_flush_task_cb;
+    BLI_task_parallel_range(0, solver->front_len, solver, geodesic_front_relax_task_cb, &settings);
+
+    /* Edges of the next front can be pushed again once it is processed. */
+    for (int i = 0; i < solver->front_next_len; i++) {
+      BLI_BITMAP_DISABLE(solver->edge_tag, solver->front_next[i]);
+    }
 
-  if (!ss->epmap) {
-    BKE_mesh_edge_poly_map_create(&ss->epmap,
-                                  &ss->epmap_mem,
-                                  mesh->medge,
-                                  mesh->totedge,
-                                  mesh->mpoly,
-                                  mesh->totpoly,
-                                  mesh->mloop,
-                                  mesh->totloop);
+    SWAP(int *, solver->front, solver->front_next);
+    SWAP(int, solver->front_size, solver->front_next_size);
+    solver->front_len = solver->front_next_len;
   }
-  if (!ss->vemap) {
-    BKE_mesh_vert_edge_map_create(
-        &ss->vemap, &ss->vemap_mem, mesh->mvert, mesh->medge, mesh->totvert, mesh->totedge, true);
+}
+
+static void geodesic_solver_free(GeodesicSolver *solver)
+{
+  for (int i = 0; i < solver->totpage; i++) {
+    MEM_SAFE_FREE(solver->pages[i]);
+  }
+  MEM_freeN(solver->pages);
+  MEM_freeN(solver->initial_verts);
+  if (solver->initial_tree) {
+    BLI_kdtree_3d_free(solver->initial_tree);
   }
+  MEM_freeN(solver->edge_tag);
+  MEM_freeN(solver->front);
+  MEM_freeN(solver->front_next);
+  BLI_spin_end(&solver->front_lock);
+}
 
-  /* Both contain edge indices encoded as *void. */
-  BLI_LINKSTACK_DECLARE(queue, void *);
-  BLI_LINKSTACK_DECLARE(queue_next, void *);
+BLI_INLINE SculptVertRef geodesic_closest_vertex_get(const GeodesicSolver *solver, const int v)
+{
+  const int closest = geodesic_closest_get(solver, v);
 
-  BLI_LINKSTACK_INIT(queue);
-  BLI_LINKSTACK_INIT(queue_next);
+  if (closest == SCULPT_GEODESIC_VERTEX_NONE) {
+    return (SculptVertRef){-1LL};
+  }
+  return BKE_pbvh_table_index_to_vertex(solver->ss->pbvh, closest);
+}
 
-  for (int i = 0; i < totvert; i++) {
-    if (BLI_gset_haskey(initial_vertices, POINTER_FROM_INT(i))) {
-      if (r_closest_verts) {
-        r_closest_verts[i] = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
-      }
+static void geodesic_solver_finish_task_cb(void *__restrict userdata,
+                                           const int i,
+                                           const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  void **data = userdata;
+  GeodesicSolver *solver = data[0];
+  float *dists = data[1];
+  SculptVertRef *r_closest_verts = data[2];
 
-      dists[i] = 0.0f;
-    }
-    else {
-      if (r_closest_verts) {
-        r_closest_verts[i].i = -1LL;
-      }
+  dists[i] = geodesic_dist_get(solver, i);
 
-      dists[i] = FLT_MAX;
-    }
+  if (r_closest_verts) {
+    r_closest_verts[i] = geodesic_closest_vertex_get(solver, i);
   }
+}
 
-  /* Masks vertices that are further than limit radius from an initial vertex. As there is no need
-   * to define a distance to them the algorithm can stop earlier by skipping them. */
-  BLI_bitmap *affected_vertex = BLI_BITMAP_NEW(totvert, "affected vertex");
-  GSetIterator gs_iter;
+/* Write the distances and closest vertices out and free the solver. */
+static float *geodesic_solver_finish(GeodesicSolver *solver, SculptVertRef *r_closest_verts)
+{
+  float *dists = MEM_malloc_arrayN(solver->totvert, sizeof(float), "distances");
+  void *data[3] = {solver, dists, r_closest_verts};
 
-  if (limit_radius == FLT_MAX) {
-    /* In this case, no need to loop through all initial vertices to check distances as they are
-     * all going to be affected. */
-    BLI_bitmap_set_all(affected_vertex, true, totvert);
-  }
-  else {
-    /* This is an O(n^2) loop used to limit the geodesic distance calculation to a radius. When
-     * this optimization is needed, it is expected for the tool to request the distance to a low
-     * number of vertices (usually just 1 or 2). */
-    GSET_ITER (gs_iter, initial_vertices) {
-      const int v = POINTER_AS_INT(BLI_gsetIterator_getKey(&gs_iter));
-      float *v_co = cos ? cos[v] : verts[v].co;
-
-      for (int i = 0; i < totvert; i++) {
-        if (len_squared_v3v3(v_co, cos ? cos[i] : verts[i].co) <= limit_radius_sq) {
-          BLI_BITMAP_ENABLE(affected_vertex, i);
-        }
-      }
-    }
-  }
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = GEODESIC_FRONT_MIN_ITER_PER_THREAD;
+  BLI_task_parallel_range(0, solver->totvert, data, geodesic_solver_finish_task_cb, &settings);
+
+  geodesic_solver_free(solver);
 
-  /* Add edges adjacent to an initial vertex to the queue. */
-  for (int i = 0; i < totedge; i++) {
-    const int v1 = edges[i].v1;
-    const int v2 = edges[i].v2;
-    if (!BLI_BITMAP_TEST(affected_vertex, v1) && !BLI_BITMAP_TEST(affected_vertex, v2)) {
+  return dists;
+}
+
+/* Write the reached vertices out and free the solver, only the created pages are visited. */
+static int geodesic_solver_finish_sparse(GeodesicSolver *solver,
+                                         int **r_indices,
+                                         float **r_dists,
+                                         SculptVertRef **r_closest_verts)
+{
+  int totreached = 0;
+  for (int i = 0; i < solver->totpage; i++) {
+    const GeodesicPage *page = solver->pages[i];
+    if (!page) {
       continue;
     }
-    if (dists[v1] != FLT_MAX || dists[v2] != FLT_MAX) {
-      BLI_LINKSTACK_PUSH(queue, POINTER_FROM_INT(i));
+    for (int j = 0; j < GEODESIC_PAGE_SIZE; j++) {
+      if (geodesic_unpack_dist(page->dists[j]) != FLT_MAX) {
+        totreached++;
+      }
     }
   }
 
-  do {
-    while (BLI_LINKSTACK_SIZE(queue)) {
-      const int e = POINTER_AS_INT(BLI_LINKSTACK_POP(queue));
-      int v1 = edges[e].v1;
-      int v2 = edges[e].v2;
-
-      if (dists[v1] == FLT_MAX || dists[v2] == FLT_MAX) {
-        if (dists[v1] > dists[v2]) {
-          SWAP(int, v1, v2);
-        }
-        sculpt_geodesic_mesh_test_dist_add(verts,
-                                           v2,
-                                           v1,
-                                           SCULPT_GEODESIC_VERTEX_NONE,
-                                           dists,
-                                           initial_vertices,
-                                           r_closest_verts,
-                                           cos);
+  int *indices = MEM_malloc_arrayN(max_ii(totreached, 1), sizeof(int), "geodesic indices");
+  float *dists = MEM_malloc_arrayN(max_ii(totreached, 1), sizeof(float), "distances");
+  SculptVertRef *closest_verts = r_closest_verts ?
+                                     MEM_malloc_arrayN(max_ii(totreached, 1),
+                                                       sizeof(SculptVertRef),
+                                                       "geodesic closest vertices") :
+                                     NULL;
+
+  int reached = 0;
+  for (int i = 0; i < solver->totpage; i++) {
+    const GeodesicPage *page = solver->pages[i];
+    if (!page) {
+      continue;
+    }
+    for (int j = 0; j < GEODESIC_PAGE_SIZE; j++) {
+      const float dist = geodesic_unpack_dist(page->dists[j]);
+      if (dist == FLT_MAX) {
+        continue;
       }
 
-      if (ss->epmap[e].count != 0) {
-        for (int poly_map_index = 0; poly_map_index < ss->epmap[e].count; poly_map_index++) {
-          const int poly = ss->epmap[e].indices[poly_map_index];
-          if (ss->face_sets[poly] <= 0) {
-            continue;
-          }
-          const MPoly *mpoly = &mesh->mpoly[poly];
-
-          for (int loop_index = 0; loop_index < mpoly->totloop; loop_index++) {
-            const MLoop *mloop = &mesh->mloop[loop_index + mpoly->loopstart];
-            const int v_other = mloop->v;
-            if (ELEM(v_other, v1, v2)) {
-              continue;
-            }
-            if (sculpt_geodesic_mesh_test_dist_add(
-                    verts, v_other, v1, v2, dists, initial_vertices, r_closest_verts, cos)) {
-              for (int edge_map_index = 0; edge_map_index < ss->vemap[v_other].count;
-                   edge_map_index++) {
-                const int e_other = ss->vemap[v_other].indices[edge_map_index];
-                int ev_other;
-                if (edges[e_other].v1 == (uint)v_other) {
-                  ev_other = edges[e_other].v2;
-                }
-                else {
-                  ev_other = edges[e_other].v1;
-                }
-
-                if (e_other != e && !BLI_BITMAP_TEST(edge_tag, e_other) &&
-                    (ss->epmap[e_other].count == 0 || dists[ev_other] != FLT_MAX)) {
-                  if (BLI_BITMAP_TEST(affected_vertex, v_other) ||
-                      BLI_BITMAP_TEST(affected_vertex, ev_other)) {
-                    BLI_BITMAP_ENABLE(edge_tag, e_other);
-                    BLI_LINKSTACK_PUSH(queue_next, POINTER_FROM_INT(e_other));
-                  }
-                }
-              }
-            }
-          }
-        }
+      const int v = (i << GEODESIC_PAGE_SHIFT) | j;
+      indices[reached] = v;
+      dists[reached] = dist;
+      if (closest_verts) {
+        closest_verts[reached] = geodesic_closest_vertex_get(solver, v);
       }
+      reached++;
     }
+  }
 
-    for (LinkNode *lnk = queue_next; lnk; lnk = lnk->next) {
-      const int e = POINTER_AS_INT(lnk->link);
-      BLI_BITMAP_DISABLE(edge_tag, e);
-    }
-
-    BLI_LINKSTACK_SWAP(queue, queue_next);
-
-  } while (BLI_LINKSTACK_SIZE(queue));
+  geodesic_solver_free(solver);
 
-  BLI_LINKSTACK_FREE(queue);
-  BLI_LINKSTACK_FREE(queue_next);
-  MEM_SAFE_FREE(edge_tag);
-  MEM_SAFE_FREE(affected_vertex);
+  *r_indices = indices;
+  *r_dists = dists;
+  if (r_closest_verts) {
+    *r_closest_verts = closest_verts;
+  }
 
-  return dists;
+  return totreached;
 }
 
-static float *SCULPT_geodesic_bmesh_create(Object *ob,
-                                           GSet *initial_vertices,
-                                           const float limit_radius,
-                                           SculptVertRef *r_closest_verts,
-                                           float (*cos)[3])
-{
-  SculptSession *ss = ob->sculpt;
-
-  if (!ss->bm) {
-    return NULL;
-  }
+/** \} */
 
-  BM_mesh_elem_index_ensure(ss->bm, BM_VERT | BM_EDGE | BM_FACE);
+/* -------------------------------------------------------------------- */
+/** \name Mesh Geodesic Distances
+ * \{ */
 
-  const int totvert = ss->bm->totvert;
-  const int totedge = ss->bm->totedge;
+typedef struct GeodesicMeshData {
+  const Mesh *mesh;
+  const MEdge *edges;
+  const MeshElemMap *epmap;
+  const MeshElemMap *vemap;
+  const int *face_sets;
+} GeodesicMeshData;
 
-  if (r_closest_verts) {
-    for (int i = 0; i < totvert; i++) {
-      r_closest_verts[i].i = -1LL;
+static void geodesic_mesh_relax_edge(GeodesicSolver *solver, const int e, GeodesicFrontTLS *tls)
+{
+  const GeodesicMeshData *md = solver->userdata;
+  const MEdge *edges = md->edges;
+  int v1 = edges[e].v1;
+  int v2 = edges[e].v2;
+
+  if (geodesic_dist_get(solver, v1) == FLT_MAX || geodesic_dist_get(solver, v2) == FLT_MAX) {
+    if (geodesic_dist_get(solver, v1) > geodesic_dist_get(solver, v2)) {
+      SWAP(int, v1, v2);
     }
+    geodesic_dist_add(solver,
+                      v2,
+                      v1,
+                      SCULPT_GEODESIC_VERTEX_NONE,
+                      geodesic_vert_co(solver, v2),
+                      geodesic_vert_co(solver, v1),
+                      NULL);
   }
 
-  const float limit_radius_sq = limit_radius * limit_radius;
-
-  float *dists = MEM_malloc_arrayN(totvert, sizeof(float), "distances");
-  BLI_bitmap *edge_tag = BLI_BITMAP_NEW(totedge, "edge tag");
+  const float *co1 = geodesic_vert_co(solver, v1);
+  const float *co2 = geodesic_vert_co(solver, v2);
 
-  BLI_LINKSTACK_DECLARE(queue, BMEdge *);
-  BLI_LINKSTACK_DECLARE(queue_next, BMEdge *);
+  for (int poly_map_index = 0; poly_map_index < md->epmap[e].count; poly_map_index++) {
+    const int poly = md->epmap[e].indices[poly_map_index];
+    if (md->face_sets[poly] <= 0) {
+      continue;
+    }
+    const MPoly *mpoly = &md->mesh->mpoly[poly];
 
-  BLI_LINKSTACK_INIT(queue);
-  BLI_LINKSTACK_INIT(queue_next);
+    for (int loop_index = 0; loop_index < mpoly->totloop; loop_index++) {
+      const MLoop *mloop = &md->mesh->mloop[loop_index + mpoly->loopstart];
+      const int v_other = mloop->v;
+      if (ELEM(v_other, v1, v2)) {
+        continue;
+      }
+      if (!geodesic_dist_add(
+              solver, v_other, v1, v2, geodesic_vert_co(solver, v_other), co1, co2)) {
+        continue;
+      }
 
-  for (int i = 0; i < totvert; i++) {
-    if (BLI_gset_haskey(initial_vertices, POINTER_FROM_INT(i))) {
-      dists[i] = 0.0f;
+      for (int edge_map_index = 0; edge_map_index < md->vemap[v_other].count; edge_map_index++) {
+        const int e_other = md->vemap[v_other].indices[edge_map_index];
+        int ev_other;
+        if (edges[e_other].v1 == (uint)v_other) {
+          ev_other = edges[e_other].v2;
+        }
+        else {
+          ev_other = edges[e_other].v1;
+        }
 
-      if (r_closest_verts) {
-        r_closest_verts[i] = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
+        if (e_other != e &&
+            (md->epmap[e_other].count == 0 || geodesic_dist_get(solver, ev_other) != FLT_MAX)) {
+          if (geodesic_vertex_is_affected(solver, v_other) ||
+              geodesic_vertex_is_affected(solver, ev_other)) {
+            geodesic_front_push(solver, tls, e_other);
+          }
+        }
       }
     }
-    else {
-      dists[i] = FLT_MAX;
-    }
   }
+}
 
-  /* Masks vertices that are further than limit radius from an initial vertex. As there is no need
-   * to define a distance to them the algorithm can stop earlier by skipping them. */
-  BLI_bitmap *affected_vertex = BLI_BITMAP_NEW(totvert, "affected vertex");
-  GSetIterator gs_iter;
+static void geodesic_mesh_solve(GeodesicSolver *solver,
+                                Object *ob,
+                                GSet *initial_vertices,
+                                const float limit_radius,
+                                const bool use_closest,
+                                float (*cos)[3])
+{
+  SculptSession *ss = ob->sculpt;
+  Mesh *mesh = BKE_object_get_original_mesh(ob);
 
-  BMVert *v;
-  BMIter iter;
+  const int totvert = mesh->totvert;
+  const int totedge = mesh->totedge;
 
-  BM_ITER_MESH (v, &iter, ss->bm, BM_VERTS_OF_MESH) {
-    BM_elem_flag_disable(v, BMESH_INITIAL_VERT_TAG);
-  }
+  MEdge *edges = mesh->medge;
 
-  if (limit_radius == FLT_MAX) {
-    /* In this case, no need to loop through all initial vertices to check distances as they are
-     * all going to be affected. */
-    BLI_bitmap_set_all(affected_vertex, true, totvert);
+  if (!ss->epmap) {
+    BKE_mesh_edge_poly_map_create(&ss->epmap,
+                                  &ss->epmap_mem,
+                                  mesh->medge,
+                                  mesh->totedge,
+                                  mesh->mpoly,
+                                  mesh->totpoly,
+                                  mesh->mloop,
+                                  mesh->totloop);
   }
-  else {
-    /* This is an O(n^2) loop used to limit the geodesic distance calculation to a radius. When
-     * this optimization is needed, it is expected for the tool to request the distance to a low
-     * number of vertices (usually just 1 or 2). */
-    GSET_ITER (gs_iter, initial_vertices) {
-      const int v_i = POINTER_AS_INT(BLI_gsetIterator_getKey(&gs_iter));
-      BMVert *v = (BMVert *)BKE_pbvh_table_index_to_vertex(ss->pbvh, v_i).i;
-      float *co1 = cos ? cos[BM_elem_index_get(v)] : v->co;
-
-      BM_elem_flag_enable(v, BMESH_INITIAL_VERT_TAG);
-
-      for (int i = 0; i < totvert; i++) {
-        BMVert *v2 = (BMVert *)BKE_pbvh_table_index_to_vertex(ss->pbvh, i).i;
-        float *co2 = cos ? cos[BM_elem_index_get(v2)] : v2->co;
-
-        if (len_squared_v3v3(co1, co2) <= limit_radius_sq) {
-          BLI_BITMAP_ENABLE(affected_vertex, i);
-        }
-      }
+  if (!ss->vemap) {
+    BKE_mesh_vert_edge_map_create(
+        &ss->vemap, &ss->vemap_mem, mesh->mvert, mesh->medge, mesh->totvert, mesh->totedge, true);
+  }
+
+  GeodesicMeshData md = {
+      .mesh = mesh,
+      .edges = edges,
+      .epmap = ss->epmap,
+      .vemap = ss->vemap,
+      .face_sets = ss->face_sets,
+  };
+
+  geodesic_solver_init(
+      solver, ss, totvert, totedge, initial_vertices, limit_radius, use_closest, cos);
+  solver->mvert = SCULPT_mesh_deformed_mverts_get(ss);
+  solver->relax_edge = geodesic_mesh_relax_edge;
+  solver->userdata = &md;
+
+  geodesic_solver_initial_init(solver);
+
+  /* Add edges adjacent to an initial vertex to the front. */
+  for (int i = 0; i < solver->totinitial; i++) {
+    const MeshElemMap *map = &ss->vemap[solver->initial_verts[i]];
+    for (int j = 0; j < map->count; j++) {
+      geodesic_front_init_add(solver, map->indices[j]);
     }
   }
+  geodesic_solver_front_init_end(solver);
 
-  BMEdge *e;
-  int i = 0;
+  geodesic_solver_run(solver);
+  solver->userdata = NULL;
+}
 
-  BM_ITER_MESH (e, &iter, ss->bm, BM_EDGES_OF_MESH) {
-    const int v1_i = BM_elem_index_get(e->v1);
-    const int v2_i = BM_elem_index_get(e->v2);
+/** \} */
 
-    if (!BLI_BITMAP_TEST(affected_vertex, v1_i) && !BLI_BITMAP_TEST(affected_vertex, v2_i)) {
-      i++;
-      continue;
-    }
-    if (dists[v1_i] != FLT_MAX || dists[v2_i] != FLT_MAX) {
-      BLI_LINKSTACK_PUSH(queue, e);
+/* -------------------------------------------------------------------- */
+/** \name BMesh Geodesic Distances
+ * \{ */
+
+BLI_INLINE const float *geodesic_bmesh_vert_co(const GeodesicSolver *solver,
+                                               BMVert *v,
+                                               const int v_i)
+{
+  return solver->cos ? solver->cos[v_i] : v->co;
+}
+
+static void geodesic_bmesh_relax_edge(GeodesicSolver *solver,
+                                      const int e_i,
+                                      GeodesicFrontTLS *tls)
+{
+  SculptSession *ss = solver->ss;
+  BMEdge *e = ss->bm->etable[e_i];
+
+  BMVert *v1 = e->v1, *v2 = e->v2;
+  int v1_i = BM_elem_index_get(e->v1);
+  int v2_i = BM_elem_index_get(e->v2);
+
+  if (geodesic_dist_get(solver, v1_i) == FLT_MAX || geodesic_dist_get(solver, v2_i) == FLT_MAX) {
+    if (geodesic_dist_get(solver, v1_i) > geodesic_dist_get(solver, v2_i)) {
+      SWAP(BMVert *, v1, v2);
+      SWAP(int, v1_i, v2_i);
     }
+    geodesic_dist_add(solver,
+                      v2_i,
+                      v1_i,
+                      SCULPT_GEODESIC_VERTEX_NONE,
+                      geodesic_bmesh_vert_co(solver, v2, v2_i),
+                      geodesic_bmesh_vert_co(solver, v1, v1_i),
+                      NULL);
+  }
 
-    i++;
+  BMLoop *l = e->l;
+  if (!l) {
+    return;
   }
 
+  const float *co1 = geodesic_bmesh_vert_co(solver, v1, v1_i);
+  const float *co2 = geodesic_bmesh_vert_co(solver, v2, v2_i);
+
   do {
-    while (BLI_LINKSTACK_SIZE(queue)) {
-      BMEdge *e = BLI_LINKSTACK_POP(queue);
+    BMFace *f = l->f;
+    BMLoop *l2 = f->l_first;
 
-      BMVert *v1 = e->v1, *v2 = e->v2;
-      int v1_i = BM_elem_index_get(e->v1);
-      int v2_i = BM_elem_index_get(e->v2);
+    if (BM_ELEM_CD_GET_INT(f, ss->cd_faceset_offset) < 0) {
+      l = l->radial_next;
+      continue;
+    }
 
-      if (dists[v1_i] == FLT_MAX || dists[v2_i] == FLT_MAX) {
-        if (dists[v1_i] > dists[v2_i]) {
-          SWAP(BMVert *, v1, v2);
-          SWAP(int, v1_i, v2_i);
-        }
-        sculpt_geodesic_mesh_test_dist_add_bmesh(
-            v2, v1, NULL, dists, initial_vertices, r_closest_verts, cos);
-      }
+    do {
+      BMVert *v_other = l2->v;
 
-      BMLoop *l = e->l;
-      if (l) {
-        do {
-          BMFace *f = l->f;
-          BMLoop *l2 = f->l_first;
+      if (ELEM(v_other, v1, v2)) {
+        l2 = l2->next;
+        continue;
+      }
 
-          if (BM_ELEM_CD_GET_INT(f, ss->cd_faceset_offset) < 0) {
-            l = l->radial_next;
-            continue;
+      const int v_other_i = BM_elem_index_get(v_other);
+
+      if (geodesic_dist_add(solver,
+                            v_other_i,
+                            v1_i,
+                            v2_i,
+                            geodesic_bmesh_vert_co(solver, v_other, v_other_i),
+                            co1,
+                            co2)) {
+        BMIter eiter;
+        BMEdge *e_other;
+
+        BM_ITER_ELEM (e_other, &eiter, v_other, BM_EDGES_OF_VERT) {
+          BMVert *ev_other = BM_edge_other_vert(e_other, v_other);
+          const int ev_other_i = BM_elem_index_get(ev_other);
+
+          bool ok = e_other != e;
+          ok = ok && (!e_other->l || geodesic_dist_get(solver, ev_other_i) != FLT_MAX);
+          ok = ok && (geodesic_vertex_is_affected(solver, v_other_i) ||
+                      geodesic_vertex_is_affected(solver, ev_other_i));
+
+          if (ok) {
+            geodesic_front_push(solver, tls, BM_elem_index_get(e_other));
           }
+        }
+      }
 
-          do {
-            BMVert *v_other = l2->v;
-
-            if (ELEM(v_other, v1, v2)) {
-              l2 = l2->next;
-              continue;
-            }
-
-            const int v_other_i = BM_elem_index_get(v_other);
-
-            if (sculpt_geodesic_mesh_test_dist_add_bmesh(
-                    v_other, v1, v2, dists, initial_vertices, r_closest_verts, cos)) {
-              BMIter eiter;
-              BMEdge *e_other;
+      l2 = l2->next;
+    } while (l2 != f->l_first);
 
-              BM_ITER_ELEM (e_other, &eiter, v_other, BM_EDGES_OF_VERT) {
-                BMVert *ev_other;
+    l = l->radial_next;
+  } while (l != e->l);
+}
 
-                if (e_other->v1 == v_other) {
-                  ev_other = e_other->v2;
-                }
-                else {
-                  ev_other = e_other->v1;
-                }
+static bool geodesic_bmesh_solve(GeodesicSolver *solver,
+                                 Object *ob,
+                                 GSet *initial_vertices,
+                                 const float limit_radius,
+                                 const bool use_closest,
+                                 float (*cos)[3])
+{
+  SculptSession *ss = ob->sculpt;
 
-                const int ev_other_i = BM_elem_index_get(ev_other);
-                const int e_other_i = BM_elem_index_get(e_other);
+  if (!ss->bm) {
+    return false;
+  }
 
-                bool ok = e_other != e && !BLI_BITMAP_TEST(edge_tag, e_other_i);
-                ok = ok && (!e_other->l || dists[ev_other_i] != FLT_MAX);
-                ok = ok && (BLI_BITMAP_TEST(affected_vertex, v_other_i) ||
-                            BLI_BITMAP_TEST(affected_vertex, ev_other_i));
+  BM_mesh_elem_index_ensure(ss->bm, BM_VERT | BM_EDGE | BM_FACE);
+  BM_mesh_elem_table_ensure(ss->bm, BM_VERT | BM_EDGE);
 
-                if (ok) {
-                  BLI_BITMAP_ENABLE(edge_tag, e_other_i);
-                  BLI_LINKSTACK_PUSH(queue_next, e_other);
-                }
-              }
-            }
+  const int totvert = ss->bm->totvert;
+  const int totedge = ss->bm->totedge;
 
-            l2 = l2->next;
-          } while (l2 != f->l_first);
+  geodesic_solver_init(
+      solver, ss, totvert, totedge, initial_vertices, limit_radius, use_closest, cos);
+  solver->relax_edge = geodesic_bmesh_relax_edge;
 
-          l = l->radial_next;
-        } while (l != e->l);
-      }
-    }
+  geodesic_solver_initial_init(solver);
 
-    for (LinkNode *lnk = queue_next; lnk; lnk = lnk->next) {
-      BMEdge *e = (BMEdge *)lnk->link;
-      const int e_i = BM_elem_index_get(e);
+  /* Add edges adjacent to an initial vertex to the front. */
+  for (int i = 0; i < solver->totinitial; i++) {
+    BMIter iter;
+    BMEdge *e;
 
-      BLI_BITMAP_DISABLE(edge_tag, e_i);
+    BM_ITER_ELEM (e, &iter, ss->bm->vtable[solver->initial_verts[i]], BM_EDGES_OF_VERT) {
+      geodesic_front_init_add(solver, BM_elem_index_get(e));
     }
+  }
+  geodesic_solver_front_init_end(solver);
 
-    BLI_LINKSTACK_SWAP(queue, queue_next);
+  geodesic_solver_run(solver);
 
-  } while (BLI_LINKSTACK_SIZE(queue));
+  return true;
+}
 
-  BLI_LINKSTACK_FREE(queue);
-  BLI_LINKSTACK_FREE(queue_next);
-  MEM_SAFE_FREE(edge_tag);
-  MEM_SAFE_FREE(affected_vertex);
+/** \} */
 
-  return dists;
-}
+/* -------------------------------------------------------------------- */
+/** \name Multires Grids Geodesic Distances
+ * \{ */
 
 BLI_INLINE void *hash_edge(int v1, int v2, int totvert)
 {
@@ -699,73 +935,140 @@ int find_quad(TempEdge *edges, MeshElemMap *vmap, int v1, int v2, int v3)
   return -1;
 }
 
-static float *SCULPT_geodesic_grids_create(Object *ob,
-                                           GSet *initial_vertices,
-                                           const float limit_radius,
-                                           SculptVertRef *r_closest_verts,
-                                           float (*cos)[3])
+
+typedef struct GeodesicGridsData {
+  TempEdge *edges;
+  MeshElemMap *vmap;
+  /* Opposite edge verts in (up to 2) adjacent faces. */
+  int (*e_otherv_map)[4];
+} GeodesicGridsData;
+
+static void geodesic_grids_otherv_map_task_cb(void *__restrict userdata,
+                                              const int i,
+                                              const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  SculptSession *ss = ob->sculpt;
+  GeodesicGridsData *gd = userdata;
+  TempEdge *edges = gd->edges;
+  MeshElemMap *vmap = gd->vmap;
 
-  const int totvert = SCULPT_vertex_count_get(ss);
+  int v1a = -1, v2a = -1;
+  int v1b = -1, v2b = -1;
 
-  const float limit_radius_sq = limit_radius * limit_radius;
+  TempEdge *te = edges + i;
 
-  float *dists = MEM_malloc_arrayN(totvert, sizeof(float), "distances");
+  for (int j = 0; j < vmap[te->v1].count; j++) {
+    TempEdge *te2 = edges + vmap[te->v1].indices[j];
+    int v3 = te->v1 == te2->v1 ? te2->v2 : te2->v1;
 
-  /* Both contain edge indices encoded as *void. */
-  BLI_LINKSTACK_DECLARE(queue, void *);
-  BLI_LINKSTACK_DECLARE(queue_next, void *);
+    if (v3 == te->v2) {
+      continue;
+    }
 
-  BLI_LINKSTACK_INIT(queue);
-  BLI_LINKSTACK_INIT(queue_next);
+    int p = find_quad(edges, vmap, te->v1, te->v2, v3);
 
-  for (int i = 0; i < totvert; i++) {
-    if (BLI_gset_haskey(initial_vertices, POINTER_FROM_INT(i))) {
-      if (r_closest_verts) {
-        r_closest_verts[i] = BKE_pbvh_table_index_to_vertex(ss->pbvh, i);
-      }
+    if (p != -1) {
+      v1a = p;
+      v1b = v3;
+    }
+  }
 
-      dists[i] = 0.0f;
+  for (int j = 0; j < vmap[te->v2].count; j++) {
+    TempEdge *te2 = edges + vmap[te->v2].indices[j];
+    int v3 = te->v2 == te2->v1 ? te2->v2 : te2->v1;
+
+    if (v3 == te->v1) {
+      continue;
     }
-    else {
-      if (r_closest_verts) {
-        r_closest_verts[i].i = -1LL;
-      }
 
-      dists[i] = FLT_MAX;
+    int p = find_quad(edges, vmap, te->v1, te->v2, v3);
+
+    if (p != -1) {
+      if (v1a != -1) {
+        v2a = p;
+        v2b = v3;
+      }
+      else {
+        v1a = p;
+        v1b = v3;
+      }
     }
   }
 
-  /* Masks vertices that are further than limit radius from an initial vertex. As there is no need
-   * to define a distance to them the algorithm can stop earlier by skipping them. */
-  BLI_bitmap *affected_vertex = BLI_BITMAP_NEW(totvert, "affected vertex");
-  GSetIterator gs_iter;
+  gd->e_otherv_map[i][0] = v1a;
+  gd->e_otherv_map[i][1] = v1b;
+  gd->e_otherv_map[i][2] = v2a;
+  gd->e_otherv_map[i][3] = v2b;
+}
 
-  if (limit_radius == FLT_MAX) {
-    /* In this case, no need to loop through all initial vertices to check distances as they are
-     * all going to be affected. */
-    BLI_bitmap_set_all(affected_vertex, true, totvert);
+static void geodesic_grids_relax_edge(GeodesicSolver *solver, const int e, GeodesicFrontTLS *tls)
+{
+  const GeodesicGridsData *gd = solver->userdata;
+  const TempEdge *edges = gd->edges;
+  int v1 = edges[e].v1;
+  int v2 = edges[e].v2;
+
+  if (geodesic_dist_get(solver, v1) == FLT_MAX || geodesic_dist_get(solver, v2) == FLT_MAX) {
+    if (geodesic_dist_get(solver, v1) > geodesic_dist_get(solver, v2)) {
+      SWAP(int, v1, v2);
+    }
+    geodesic_dist_add(solver,
+                      v2,
+                      v1,
+                      SCULPT_GEODESIC_VERTEX_NONE,
+                      geodesic_vert_co(solver, v2),
+                      geodesic_vert_co(solver, v1),
+                      NULL);
   }
-  else {
-    /* This is an O(n^2) loop used to limit the geodesic distance calculation to a radius. When
-     * this optimization is needed, it is expected for the tool to request the distance to a low
-     * number of vertices (usually just 1 or 2). */
-    GSET_ITER (gs_iter, initial_vertices) {
-      const int v = POINTER_AS_INT(BLI_gsetIterator_getKey(&gs_iter));
-      SculptVertRef vertex = BKE_pbvh_table_index_to_vertex(ss->pbvh, v);
-      const float *v_co = cos ? cos[v] : SCULPT_vertex_co_get(ss, vertex);
-
-      for (int i = 0; i < totvert; i++) {
-        const float *v_co2 = cos ? cos[i] :
-                                   SCULPT_vertex_co_get(
-                                       ss, BKE_pbvh_table_index_to_vertex(ss->pbvh, i));
-        if (len_squared_v3v3(v_co, v_co2) <= limit_radius_sq) {
-          BLI_BITMAP_ENABLE(affected_vertex, i);
+
+  const float *co1 = geodesic_vert_co(solver, v1);
+  const float *co2 = geodesic_vert_co(solver, v2);
+
+  for (int pi = 0; pi < 4; pi++) {
+    int v_other = gd->e_otherv_map[e][pi];
+
+    if (v_other == -1) {
+      continue;
+    }
+
+    // XXX not sure how to handle face sets here - joeedh
+    // if (ss->face_sets[poly] <= 0) {
+    //  continue;
+    //}
+
+    if (!geodesic_dist_add(solver, v_other, v1, v2, geodesic_vert_co(solver, v_other), co1, co2)) {
+      continue;
+    }
+
+    for (int edge_map_index = 0; edge_map_index < gd->vmap[v_other].count; edge_map_index++) {
+      const int e_other = gd->vmap[v_other].indices[edge_map_index];
+      int ev_other;
+      if (edges[e_other].v1 == v_other) {
+        ev_other = edges[e_other].v2;
+      }
+      else {
+        ev_other = edges[e_other].v1;
+      }
+
+      if (e_other != e && geodesic_dist_get(solver, ev_other) != FLT_MAX) {
+        if (geodesic_vertex_is_affected(solver, v_other) ||
+            geodesic_vertex_is_affected(solver, ev_other)) {
+          geodesic_front_push(solver, tls, e_other);
         }
       }
     }
   }
+}
+
+static void geodesic_grids_solve(GeodesicSolver *solver,
+                                 Object *ob,
+                                 GSet *initial_vertices,
+                                 const float limit_radius,
+                                 const bool use_closest,
+                                 float (*cos)[3])
+{
+  SculptSession *ss = ob->sculpt;
+
+  const int totvert = SCULPT_vertex_count_get(ss);
 
   SculptVertexNeighborIter ni;
 
@@ -806,154 +1109,45 @@ static float *SCULPT_geodesic_grids_create(Object *ob,
     SCULPT_VERTEX_NEIGHBORS_ITER_END(ni);
   }
 
-  int(*e_otherv_map)[4] = MEM_malloc_arrayN(totedge, sizeof(*e_otherv_map), "e_otherv_map");
-
-  // create an edge map of opposite edge verts in (up to 2) adjacent faces
-  for (int i = 0; i < totedge; i++) {
-    int v1a = -1, v2a = -1;
-    int v1b = -1, v2b = -1;
-
-    TempEdge *te = edges + i;
-
-    for (int j = 0; j < vmap[te->v1].count; j++) {
-      TempEdge *te2 = edges + vmap[te->v1].indices[j];
-      int v3 = te->v1 == te2->v1 ? te2->v2 : te2->v1;
-
-      if (v3 == te->v2) {
-        continue;
-      }
-
-      int p = find_quad(edges, vmap, te->v1, te->v2, v3);
-
-      if (p != -1) {
-        v1a = p;
-        v1b = v3;
-      }
-    }
-
-    for (int j = 0; j < vmap[te->v2].count; j++) {
-      TempEdge *te2 = edges + vmap[te->v2].indices[j];
-      int v3 = te->v2 == te2->v1 ? te2->v2 : te2->v1;
-
-      if (v3 == te->v1) {
-        continue;
-      }
-
-      int p = find_quad(edges, vmap, te->v1, te->v2, v3);
-
-      if (p != -1) {
-        if (v1a != -1) {
-          v2a = p;
-          v2b = v3;
-        }
-        else {
-          v1a = p;
-          v1b = v3;
-        }
-      }
-    }
-
-    e_otherv_map[i][0] = v1a;
-    e_otherv_map[i][1] = v1b;
-    e_otherv_map[i][2] = v2a;
-    e_otherv_map[i][3] = v2b;
-  }
-
-  BLI_bitmap *edge_tag = BLI_BITMAP_NEW(totedge, "edge tag");
-
-  /* Add edges adjacent to an initial vertex to the queue. */
-  for (int i = 0; i < totedge; i++) {
-    const int v1 = edges[i].v1;
-    const int v2 = edges[i].v2;
-
-    if (!BLI_BITMAP_TEST(affected_vertex, v1) && !BLI_BITMAP_TEST(affected_vertex, v2)) {
-      continue;
-    }
-    if (dists[v1] != FLT_MAX || dists[v2] != FLT_MAX) {
-      BLI_LINKSTACK_PUSH(queue, POINTER_FROM_INT(i));
+  GeodesicGridsData gd = {
+      .edges = edges,
+      .vmap = vmap,
+      .e_otherv_map = MEM_malloc_arrayN(totedge, sizeof(*gd.e_otherv_map), "e_otherv_map"),
+  };
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = GEODESIC_FRONT_MIN_ITER_PER_THREAD;
+  BLI_task_parallel_range(0, totedge, &gd, geodesic_grids_otherv_map_task_cb, &settings);
+
+  geodesic_solver_init(
+      solver, ss, totvert, totedge, initial_vertices, limit_radius, use_closest, cos);
+  solver->relax_edge = geodesic_grids_relax_edge;
+  solver->userdata = &gd;
+
+  geodesic_solver_initial_init(solver);
+
+  /* Add edges adjacent to an initial vertex to the front. */
+  for (int i = 0; i < solver->totinitial; i++) {
+    const MeshElemMap *map = &vmap[solver->initial_verts[i]];
+    for (int j = 0; j < map->count; j++) {
+      geodesic_front_init_add(solver, map->indices[j]);
     }
   }
+  geodesic_solver_front_init_end(solver);
 
-  do {
-    while (BLI_LINKSTACK_SIZE(queue)) {
-      const int e = POINTER_AS_INT(BLI_LINKSTACK_POP(queue));
-      int v1 = edges[e].v1;
-      int v2 = edges[e].v2;
-
-      if (dists[v1] == FLT_MAX || dists[v2] == FLT_MAX) {
-        if (dists[v1] > dists[v2]) {
-          SWAP(int, v1, v2);
-        }
-        sculpt_geodesic_grids_test_dist_add(ss,
-                                            v2,
-                                            v1,
-                                            SCULPT_GEODESIC_VERTEX_NONE,
-                                            dists,
-                                            initial_vertices,
-                                            r_closest_verts,
-                                            cos);
-      }
-
-      for (int pi = 0; pi < 4; pi++) {
-        int v_other = e_otherv_map[e][pi];
-
-        if (v_other == -1) {
-          continue;
-        }
-
-        // XXX not sure how to handle face sets here - joeedh
-        // if (ss->face_sets[poly] <= 0) {
-        //  continue;
-        //}
-
-        if (sculpt_geodesic_grids_test_dist_add(
-                ss, v_other, v1, v2, dists, initial_vertices, r_closest_verts, cos)) {
-          for (int edge_map_index = 0; edge_map_index < vmap[v_other].count; edge_map_index++) {
-            const int e_other = vmap[v_other].indices[edge_map_index];
-            int ev_other;
-            if (edges[e_other].v1 == (uint)v_other) {
-              ev_other = edges[e_other].v2;
-            }
-            else {
-              ev_other = edges[e_other].v1;
-            }
-
-            if (e_other != e && !BLI_BITMAP_TEST(edge_tag, e_other) &&
-                (dists[ev_other] != FLT_MAX)) {
-              if (BLI_BITMAP_TEST(affected_vertex, v_other) ||
-                  BLI_BITMAP_TEST(affected_vertex, ev_other)) {
-                BLI_BITMAP_ENABLE(edge_tag, e_other);
-                BLI_LINKSTACK_PUSH(queue_next, POINTER_FROM_INT(e_other));
-              }
-            }
-          }
-        }
-      }
-    }
-
-    for (LinkNode *lnk = queue_next; lnk; lnk = lnk->next) {
-      const int e = POINTER_AS_INT(lnk->link);
-      BLI_BITMAP_DISABLE(edge_tag, e);
-    }
-
-    BLI_LINKSTACK_SWAP(queue, queue_next);
-
-  } while (BLI_LINKSTACK_SIZE(queue));
-
-  BLI_LINKSTACK_FREE(queue);
-  BLI_LINKSTACK_FREE(queue_next);
-  MEM_SAFE_FREE(edge_tag);
-  MEM_SAFE_FREE(affected_vertex);
+  geodesic_solver_run(solver);
+  solver->userdata = NULL;
 
   BLI_memarena_free(ma);
   BLI_ghash_free(ehash, NULL, NULL);
   MEM_SAFE_FREE(edges);
   MEM_SAFE_FREE(vmap);
-  MEM_SAFE_FREE(e_otherv_map);
-
-  return dists;
+  MEM_SAFE_FREE(gd.e_otherv_map);
 }
 
+/** \} */
+
 /* For sculpt mesh data that does not support a geodesic distances algorithm, fallback to the
  * distance to each vertex. In this case, only one of the initial vertices will be used to
  * calculate the distance. */
@@ -987,27 +1181,69 @@ static float *SCULPT_geodesic_fallback_create(Object *ob, GSet *initial_vertices
   return dists;
 }
 
-float *SCULPT_geodesic_distances_create(Object *ob,
-                                        GSet *initial_vertices,
-                                        const float limit_radius,
-                                        SculptVertRef *r_closest_verts,
-                                        float (*vertco_override)[3])
+/* Run the solver of the PBVH type, returns false if there is nothing to solve on. */
+static bool geodesic_solve(GeodesicSolver *solver,
+                           Object *ob,
+                           GSet *initial_vertices,
+                           const float limit_radius,
+                           const bool use_closest,
+                           float (*vertco_override)[3])
 {
   SculptSession *ss = ob->sculpt;
   switch (BKE_pbvh_type(ss->pbvh)) {
     case PBVH_FACES:
-      return SCULPT_geodesic_mesh_create(
-          ob, initial_vertices, limit_radius, r_closest_verts, vertco_override);
+      geodesic_mesh_solve(
+          solver, ob, initial_vertices, limit_radius, use_closest, vertco_override);
+      return true;
     case PBVH_BMESH:
-      return SCULPT_geodesic_bmesh_create(
-          ob, initial_vertices, limit_radius, r_closest_verts, vertco_override);
+      return geodesic_bmesh_solve(
+          solver, ob, initial_vertices, limit_radius, use_closest, vertco_override);
     case PBVH_GRIDS:
-      return SCULPT_geodesic_grids_create(
-          ob, initial_vertices, limit_radius, r_closest_verts, vertco_override);
+      geodesic_grids_solve(
+          solver, ob, initial_vertices, limit_radius, use_closest, vertco_override);
       // return SCULPT_geodesic_fallback_create(ob, initial_vertices);
+      return true;
   }
   BLI_assert(false);
-  return NULL;
+  return false;
+}
+
+float *SCULPT_geodesic_distances_create(Object *ob,
+                                        GSet *initial_vertices,
+                                        const float limit_radius,
+                                        SculptVertRef *r_closest_verts,
+                                        float (*vertco_override)[3])
+{
+  GeodesicSolver solver;
+  if (!geodesic_solve(&solver,
+                      ob,
+                      initial_vertices,
+                      limit_radius,
+                      r_closest_verts != NULL,
+                      vertco_override)) {
+    return NULL;
+  }
+  return geodesic_solver_finish(&solver, r_closest_verts);
+}
+
+int SCULPT_geodesic_distances_create_sparse(Object *ob,
+                                            GSet *initial_vertices,
+                                            const float limit_radius,
+                                            int **r_indices,
+                                            float **r_dists,
+                                            SculptVertRef **r_closest_verts)
+{
+  GeodesicSolver solver;
+  if (!geodesic_solve(
+          &solver, ob, initial_vertices, limit_radius, r_closest_verts != NULL, NULL)) {
+    *r_indices = NULL;
+    *r_dists = NULL;
+    if (r_closest_verts) {
+      *r_closest_verts = NULL;
+    }
+    return 0;
+  }
+  return geodesic_solver_finish_sparse(&solver, r_indices, r_dists, r_closest_verts);
 }
 
 float *SCULPT_geodesic_from_vertex_and_symm(Sculpt *sd,
@@ -1062,3 +1298,21 @@ float *SCULPT_geodesic_from_vertex(Object *ob,
   BLI_gset_free(initial_vertices, NULL);
   return dists;
 }
+
+float *SCULPT_geodesic_from_vertex_symm_pass(Object *ob,
+                                            StrokeCache *cache,
+                                            const SculptVertRef vertex,
+                                            const float limit_radius)
+{
+  const int symm_pass = cache->mirror_symmetry_pass;
+
+  cache->geodesic_verts[symm_pass] = vertex;
+
+  for (int i = 0; i < PAINT_SYMM_AREAS; i++) {
+    if (i != symm_pass && cache->geodesic_dists[i] && cache->geodesic_verts[i].i == vertex.i) {
+      return MEM_dupallocN(cache->geodesic_dists[i]);
+    }
+  }
+
+  return SCULPT_geodesic_from_vertex(ob, vertex, limit_radius);
+}
@@ -556,8 +556,9 @@ typedef struct StrokeCache {
   bool is_rake_rotation_valid;
   struct SculptRakeData rake_data;
 
-  /* Geodesic distances. */
+  /* Geodesic distances, and the vertex each symmetry pass measures them from. */
   float *geodesic_dists[PAINT_SYMM_AREAS];
+  SculptVertRef geodesic_verts[PAINT_SYMM_AREAS];
 
   /* Face Sets */
   int paint_face_set;
@@ -682,6 +683,8 @@ typedef struct StrokeCache {
   bool use_plane_trim;
 
   struct NeighborCache *ncache;
+  /* A neighbor query ran without cache, #ncache is created on the next brush step. */
+  bool ncache_requested;
   float speed_avg[SCULPT_SPEED_MA_SIZE];  // moving average for speed
   int speed_avg_cur;
   double last_speed_time;
@@ -753,6 +756,15 @@ typedef struct ExpandCache {
   /* Falloff value of the active element (vertex or base mesh face) that Expand will expand to. */
   float active_falloff;
 
+  /* Progressive falloff data. While more waves are pending, only the falloff values up to
+   * falloff_wave_limit are computed and the rest of the vertices are set to FLT_MAX. */
+  bool falloff_pending;
+  float falloff_wave_limit;
+  SculptVertRef falloff_wave_origin;
+
+  /* Timer used to keep computing falloff waves when the cursor is not moving. */
+  struct wmTimer *falloff_timer;
+
   /* When set to true, expand skips all falloff computations and considers all elements as enabled.
    */
   bool all_enabled;
@@ -946,6 +958,9 @@ typedef struct FilterCache {
   PBVHNode **nodes;
   int totnode;
 
+  /* Mesh filter, strength the coordinates were last computed with. */
+  float last_strength;
+
   /* Cloth filter. */
   SculptClothSimulation *cloth_sim;
   float cloth_sim_pinch_point[3];
@@ -1303,6 +1318,11 @@ int SCULPT_face_set_flag_set(SculptSession *ss, SculptFaceRef face, char flag, b
  * \{ */
 
 MSculptVert *SCULPT_vertex_get_sculptvert(const SculptSession *ss, SculptVertRef vertex);
+/**
+ * Original color and curvature direction, stored apart from #MSculptVert since most brushes
+ * only read the original coordinates, normals and flags.
+ */
+MSculptVertCold *SCULPT_vertex_get_sculptvert_cold(const SculptSession *ss, SculptVertRef vertex);
 
 /**
  * DEPRECATED: use SCULPT_vertex_check_origdata and SCULPT_vertex_get_sculptvert
@@ -1476,6 +1496,61 @@ float SCULPT_brush_strength_factor(struct SculptSession *ss,
                                    const float mask,
                                    const SculptVertRef vertex_index,
                                    const int thread_id);
+#define SCULPT_BRUSH_BATCH_SIZE 64
+
+/**
+ * Vertices inside the brush gathered from a #PBVHVertexIter, so the brush strength can be
+ * evaluated for several of them at once with #SCULPT_brush_strength_factor_batch.
+ */
+typedef struct SculptBrushBatch {
+  int totvert;
+
+  SculptVertRef vertex[SCULPT_BRUSH_BATCH_SIZE];
+  /* #PBVHVertexIter.i, the index into node proxies. */
+  int index[SCULPT_BRUSH_BATCH_SIZE];
+  float *co[SCULPT_BRUSH_BATCH_SIZE];
+  const float *no[SCULPT_BRUSH_BATCH_SIZE];
+  const float *fno[SCULPT_BRUSH_BATCH_SIZE];
+  bool is_mvert[SCULPT_BRUSH_BATCH_SIZE];
+
+  float dist_sq[SCULPT_BRUSH_BATCH_SIZE];
+  float mask[SCULPT_BRUSH_BATCH_SIZE];
+
+  /* Output of #SCULPT_brush_strength_factor_batch. */
+  float fade[SCULPT_BRUSH_BATCH_SIZE];
+} SculptBrushBatch;
+
+/**
+ * Add the current vertex of \a vd with its squared distance from the brush test.
+ * \return true when the batch is full and has to be evaluated.
+ */
+BLI_INLINE bool SCULPT_brush_batch_add(SculptBrushBatch *batch,
+                                       const PBVHVertexIter *vd,
+                                       const float dist_sq)
+{
+  const int i = batch->totvert++;
+
+  batch->vertex[i] = vd->vertex;
+  batch->index[i] = vd->i;
+  batch->co[i] = vd->co;
+  batch->no[i] = vd->no;
+  batch->fno[i] = vd->fno;
+  batch->is_mvert[i] = vd->mvert != NULL;
+  batch->dist_sq[i] = dist_sq;
+  batch->mask[i] = vd->mask ? *vd->mask : 0.0f;
+
+  return batch->totvert == SCULPT_BRUSH_BATCH_SIZE;
+}
+
+/**
+ * #SCULPT_brush_strength_factor for every vertex of \a batch, written to `batch->fade`.
+ * Falloff and masking run several vertices at a time and give bit identical results.
+ */
+void SCULPT_brush_strength_factor_batch(struct SculptSession *ss,
+                                        const struct Brush *br,
+                                        SculptBrushBatch *batch,
+                                        int thread_id);
+
 /**
  * Returns a multiplier for brush strength on a particular vertex, and gets the albedo, emission,
  * roughness, and metallic maps from the brush texture nodes
@@ -1620,14 +1695,26 @@ void SCULPT_boundary_automasking_init(Object *ob,
 /**
  * Returns an array indexed by vertex index containing the geodesic distance to the closest vertex
  * in the initial vertex set. The caller is responsible for freeing the array.
- * Geodesic distances will only work when used with PBVH_FACES, for other types of PBVH it will
- * fallback to euclidean distances to one of the initial vertices in the set.
+ * The front is propagated in parallel and stops at `limit_radius`, vertices further away than
+ * that may be left at FLT_MAX.
  */
 float *SCULPT_geodesic_distances_create(struct Object *ob,
                                         struct GSet *initial_vertices,
                                         const float limit_radius,
                                         SculptVertRef *r_closest_verts,
                                         float (*vertco_override)[3]);
+/**
+ * Same as #SCULPT_geodesic_distances_create, but only the vertices the front reached are
+ * returned, as arrays of their table indices, distances and optionally closest initial vertex.
+ * The work and memory depend on the area around the initial vertices instead of the mesh size.
+ * Returns the number of reached vertices, the caller is responsible for freeing the arrays.
+ */
+int SCULPT_geodesic_distances_create_sparse(struct Object *ob,
+                                            struct GSet *initial_vertices,
+                                            float limit_radius,
+                                            int **r_indices,
+                                            float **r_dists,
+                                            SculptVertRef **r_closest_verts);
 float *SCULPT_geodesic_from_vertex_and_symm(struct Sculpt *sd,
                                             struct Object *ob,
                                             const SculptVertRef vertex,
@@ -1635,6 +1722,14 @@ float *SCULPT_geodesic_from_vertex_and_symm(struct Sculpt *sd,
 float *SCULPT_geodesic_from_vertex(Object *ob,
                                    const SculptVertRef vertex,
                                    const float limit_radius);
+/**
+ * Geodesic distances for the current symmetry pass of the stroke. Passes starting from the same
+ * vertex, e.g. when the brush is on the symmetry plane, reuse the distances of the earlier pass.
+ */
+float *SCULPT_geodesic_from_vertex_symm_pass(Object *ob,
+                                            struct StrokeCache *cache,
+                                            const SculptVertRef vertex,
+                                            const float limit_radius);
 
 /** \} */
 
@@ -1670,6 +1765,11 @@ void SCULPT_do_cloth_brush(struct Sculpt *sd,
 
 void SCULPT_cloth_simulation_free(struct SculptClothSimulation *cloth_sim);
 
+/* Solves a randomly perturbed cloth grid built from `seed` serially, in parallel and with the
+ * SIMD kernel. Returns a JSON report with the timings and a hash of the result of every run, free
+ * with MEM_freeN. */
+char *SCULPT_cloth_solver_benchmark(int totvert, int seed, int iterations);
+
 /* Public functions. */
 
 struct SculptClothSimulation *SCULPT_cloth_brush_simulation_create(
@@ -2248,6 +2348,28 @@ void SCULPT_replay_log_start();
 char *SCULPT_replay_serialize();
 void SCULPT_replay_log_append(struct Sculpt *sd, struct SculptSession *ss, struct Object *ob);
 void SCULPT_replay_test(void);
+void SCULPT_replay_parse(const char *buf);
+void SCULPT_replay_log_cache_free(struct StrokeCache *cache);
+
+/* Replays the current log on ob without a window manager. Returns a JSON report with
+ * throughput, per brush cost and a hash of the final coordinates, free with MEM_freeN. */
+char *SCULPT_replay_batch(struct Main *bmain,
+                          struct Depsgraph *depsgraph,
+                          struct Scene *scene,
+                          struct Object *ob);
+
+/* Headless stroke stepping used by batch replay. */
+StrokeCache *SCULPT_stroke_cache_headless_create(struct Sculpt *sd,
+                                                 struct Object *ob,
+                                                 struct Brush *brush,
+                                                 struct ViewContext *vc);
+void SCULPT_stroke_step_headless(struct Main *bmain,
+                                 struct Depsgraph *depsgraph,
+                                 struct Scene *scene,
+                                 struct Sculpt *sd,
+                                 struct Object *ob,
+                                 struct UnifiedPaintSettings *ups,
+                                 struct PaintStroke *stroke);
 
 #endif
 
@@ -222,8 +222,8 @@ static void do_paint_brush_task_cb_ex(void *__restrict userdata,
       vcolor[3] = 1.0f;
     }
     else {
-      MSculptVert *mv = SCULPT_vertex_get_sculptvert(ss, vd.vertex);
-      IMB_blend_color_float(vcolor, mv->origcolor, buffer_color, brush->blend);
+      MSculptVertCold *mv_cold = SCULPT_vertex_get_sculptvert_cold(ss, vd.vertex);
+      IMB_blend_color_float(vcolor, mv_cold->origcolor, buffer_color, brush->blend);
     }
 
     CLAMP4(vcolor, 0.0f, 1.0f);
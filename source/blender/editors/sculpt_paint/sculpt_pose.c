@@ -233,29 +233,29 @@ static void do_pose_brush_task_cb_ex(void *__restrict userdata,
     float total_disp[3];
     zero_v3(total_disp);
 
-    ePaintSymmetryAreas symm_area = SCULPT_get_vertex_symm_area(orig_data.co);
+    /* The vertex mask applies to the displacement of every segment. */
+    const float mask = vd.mask ? 1.0f - *vd.mask : 1.0f;
+    const float fade = mask *
+                       SCULPT_automasking_factor_get(ss->cache->automasking, ss, vd.vertex);
 
-    /* Calculate the displacement of each vertex for all the segments in the chain. */
-    for (int ik = 0; ik < ik_chain->tot_segments; ik++) {
-      copy_v3_v3(new_co, orig_data.co);
+    if (fade != 0.0f) {
+      ePaintSymmetryAreas symm_area = SCULPT_get_vertex_symm_area(orig_data.co);
 
-      /* Get the transform matrix for the vertex symmetry area to calculate a displacement in the
-       * vertex. */
-      mul_m4_v3(segments[ik].pivot_mat_inv[(int)symm_area], new_co);
-      mul_m4_v3(segments[ik].trans_mat[(int)symm_area], new_co);
-      mul_m4_v3(segments[ik].pivot_mat[(int)symm_area], new_co);
+      /* Blend the displacements of all the segments in the chain. */
+      for (int ik = 0; ik < ik_chain->tot_segments; ik++) {
+        const float weight = segments[ik].weights[vd.index];
 
-      /* Apply the segment weight of the vertex to the displacement. */
-      sub_v3_v3v3(disp, new_co, orig_data.co);
-      mul_v3_fl(disp, segments[ik].weights[vd.index]);
+        if (weight == 0.0f) {
+          continue;
+        }
 
-      /* Apply the vertex mask to the displacement. */
-      const float mask = vd.mask ? 1.0f - *vd.mask : 1.0f;
-      const float automask = SCULPT_automasking_factor_get(ss->cache->automasking, ss, vd.vertex);
-      mul_v3_fl(disp, mask * automask);
+        /* Use the transform matrix for the vertex symmetry area. */
+        mul_v3_m4v3(new_co, segments[ik].deform_mat[(int)symm_area], orig_data.co);
+        sub_v3_v3v3(disp, new_co, orig_data.co);
+        madd_v3_v3fl(total_disp, disp, weight);
+      }
 
-      /* Accumulate the displacement. */
-      add_v3_v3(total_disp, disp);
+      mul_v3_fl(total_disp, fade);
     }
 
     /* Apply the accumulated displacement to the vertex. */
@@ -1021,12 +1021,42 @@ static SculptPoseIKChain *pose_ik_chain_init_face_sets_fk(
   return ik_chain;
 }
 
-SculptPoseIKChain *SCULPT_pose_ik_chain_init(Sculpt *sd,
-                                             Object *ob,
-                                             SculptSession *ss,
-                                             Brush *br,
-                                             const float initial_location[3],
-                                             const float radius)
+/* Smooth the weights of each segment for cleaner deformation. */
+static void pose_ik_chain_weights_smooth(Sculpt *sd,
+                                         Object *ob,
+                                         Brush *br,
+                                         SculptPoseIKChain *ik_chain)
+{
+  PBVHNode **nodes;
+  int totnode;
+
+  BKE_pbvh_search_gather(ob->sculpt->pbvh, NULL, NULL, &nodes, &totnode);
+
+  SculptThreadedTaskData data = {
+      .sd = sd,
+      .ob = ob,
+      .brush = br,
+      .nodes = nodes,
+  };
+
+  for (int ik = 0; ik < ik_chain->tot_segments; ik++) {
+    data.pose_factor = ik_chain->segments[ik].weights;
+    for (int i = 0; i < br->pose_smooth_iterations; i++) {
+      TaskParallelSettings settings;
+      BKE_pbvh_parallel_range_settings(&settings, true, totnode);
+      BLI_task_parallel_range(0, totnode, &data, pose_brush_init_task_cb_ex, &settings);
+    }
+  }
+
+  MEM_SAFE_FREE(nodes);
+}
+
+static SculptPoseIKChain *pose_ik_chain_build(Sculpt *sd,
+                                              Object *ob,
+                                              SculptSession *ss,
+                                              Brush *br,
+                                              const float initial_location[3],
+                                              const float radius)
 {
   SculptPoseIKChain *ik_chain = NULL;
 
@@ -1055,39 +1085,171 @@ SculptPoseIKChain *SCULPT_pose_ik_chain_init(Sculpt *sd,
     SCULPT_fake_neighbors_disable(ob);
   }
 
+  if (ik_chain) {
+    pose_ik_chain_weights_smooth(sd, ob, br, ik_chain);
+  }
+
   return ik_chain;
 }
 
-void SCULPT_pose_brush_init(Sculpt *sd, Object *ob, SculptSession *ss, Brush *br)
+static void pose_ik_chain_key_get(SculptSession *ss,
+                                  const Brush *br,
+                                  const float radius,
+                                  SculptPoseIKChainKey *r_key)
+{
+  memset(r_key, 0, sizeof(*r_key));
+
+  r_key->origin_type = br->pose_origin_type;
+  r_key->active_vertex = SCULPT_active_vertex_get(ss);
+  r_key->tot_segments = pose_brush_num_effective_segments(br);
+  r_key->smooth_iterations = br->pose_smooth_iterations;
+  r_key->radius = radius;
+  r_key->use_fake_neighbors = !(br->flag2 & BRUSH_USE_CONNECTED_ONLY);
+  if (r_key->use_fake_neighbors) {
+    r_key->disconnected_distance_max = br->disconnected_distance_max;
+  }
+  r_key->topology_generation = ss->topology_generation;
+
+  switch (br->pose_origin_type) {
+    case BRUSH_POSE_ORIGIN_TOPOLOGY:
+      r_key->pose_offset = br->pose_offset;
+      break;
+    case BRUSH_POSE_ORIGIN_FACE_SETS:
+    case BRUSH_POSE_ORIGIN_FACE_SETS_FK:
+      r_key->face_set = SCULPT_active_face_set_get(ss);
+      r_key->face_sets_stamp = ss->face_sets_stamp;
+      break;
+  }
+
+  r_key->valid = true;
+}
+
+static bool pose_ik_chain_key_matches(const SculptPoseIKChainKey *a,
+                                      const SculptPoseIKChainKey *b)
+{
+  /* The cursor and the stroke get the radius from slightly different locations. */
+  const float radius_eps = max_ff(a->radius, b->radius) * 0.01f;
+
+  return a->valid && b->valid && a->origin_type == b->origin_type &&
+         a->active_vertex.i == b->active_vertex.i && a->face_set == b->face_set &&
+         a->tot_segments == b->tot_segments &&
+         a->smooth_iterations == b->smooth_iterations &&
+         fabsf(a->radius - b->radius) <= radius_eps && a->pose_offset == b->pose_offset &&
+         a->use_fake_neighbors == b->use_fake_neighbors &&
+         a->disconnected_distance_max == b->disconnected_distance_max &&
+         a->topology_generation == b->topology_generation &&
+         a->face_sets_stamp == b->face_sets_stamp;
+}
+
+/* Vertex coordinates changed since the cached chain was built. */
+static bool pose_ik_chain_cache_is_dirty(SculptSession *ss)
 {
   PBVHNode **nodes;
-  PBVH *pbvh = ob->sculpt->pbvh;
   int totnode;
 
-  BKE_pbvh_search_gather(pbvh, NULL, NULL, &nodes, &totnode);
+  BKE_pbvh_get_nodes(ss->pbvh, PBVH_UpdatePoseIKChain, &nodes, &totnode);
+  MEM_SAFE_FREE(nodes);
 
-  SculptThreadedTaskData data = {
-      .sd = sd,
-      .ob = ob,
-      .brush = br,
-      .nodes = nodes,
-  };
+  return totnode > 0;
+}
 
-  /* Init the IK chain that is going to be used to deform the vertices. */
-  ss->cache->pose_ik_chain = SCULPT_pose_ik_chain_init(
-      sd, ob, ss, br, ss->cache->true_location, ss->cache->radius);
+static void pose_ik_chain_cache_clear_dirty(SculptSession *ss)
+{
+  PBVHNode **nodes;
+  int totnode;
 
-  /* Smooth the weights of each segment for cleaner deformation. */
-  for (int ik = 0; ik < ss->cache->pose_ik_chain->tot_segments; ik++) {
-    data.pose_factor = ss->cache->pose_ik_chain->segments[ik].weights;
-    for (int i = 0; i < br->pose_smooth_iterations; i++) {
-      TaskParallelSettings settings;
-      BKE_pbvh_parallel_range_settings(&settings, true, totnode);
-      BLI_task_parallel_range(0, totnode, &data, pose_brush_init_task_cb_ex, &settings);
+  BKE_pbvh_search_gather(ss->pbvh, NULL, NULL, &nodes, &totnode);
+  for (int n = 0; n < totnode; n++) {
+    BKE_pbvh_pose_ik_chain_update_set(nodes[n], false);
+  }
+  MEM_SAFE_FREE(nodes);
+}
+
+static SculptPoseIKChain *pose_ik_chain_copy(const SculptPoseIKChain *ik_chain)
+{
+  SculptPoseIKChain *ik_chain_copy = MEM_dupallocN(ik_chain);
+
+  ik_chain_copy->segments = MEM_dupallocN(ik_chain->segments);
+  for (int i = 0; i < ik_chain->tot_segments; i++) {
+    ik_chain_copy->segments[i].weights = MEM_dupallocN(ik_chain->segments[i].weights);
+  }
+
+  return ik_chain_copy;
+}
+
+/* A cached chain can be reused for a slightly different location under the same vertex, move
+ * the parts that follow the location. */
+static void pose_ik_chain_relocate(SculptPoseIKChain *ik_chain,
+                                   SculptSession *ss,
+                                   const Brush *br,
+                                   const float initial_location[3])
+{
+  switch (br->pose_origin_type) {
+    case BRUSH_POSE_ORIGIN_TOPOLOGY:
+      pose_ik_chain_origin_heads_init(ik_chain, initial_location);
+      break;
+    case BRUSH_POSE_ORIGIN_FACE_SETS:
+      pose_ik_chain_origin_heads_init(ik_chain, SCULPT_active_vertex_co_get(ss));
+      break;
+    case BRUSH_POSE_ORIGIN_FACE_SETS_FK:
+      /* The head is either the target face set or the location itself. */
+      if (is_zero_v3(ik_chain->grab_delta_offset)) {
+        copy_v3_v3(ik_chain->segments[0].head, initial_location);
+      }
+      else {
+        sub_v3_v3v3(ik_chain->grab_delta_offset, ik_chain->segments[0].head, initial_location);
+      }
+      pose_ik_chain_origin_heads_init(ik_chain, ik_chain->segments[0].head);
+      break;
+  }
+}
+
+SculptPoseIKChain *SCULPT_pose_ik_chain_init(Sculpt *sd,
+                                             Object *ob,
+                                             SculptSession *ss,
+                                             Brush *br,
+                                             const float initial_location[3],
+                                             const float radius)
+{
+  /* Dynamic topology changes the mesh without rebuilding the PBVH. */
+  if (BKE_pbvh_type(ss->pbvh) == PBVH_BMESH) {
+    return pose_ik_chain_build(sd, ob, ss, br, initial_location, radius);
+  }
+
+  SculptPoseIKChainKey key;
+  pose_ik_chain_key_get(ss, br, radius, &key);
+
+  if (!ss->pose_ik_chain_cache ||
+      !pose_ik_chain_key_matches(&ss->pose_ik_chain_cache_key, &key) ||
+      pose_ik_chain_cache_is_dirty(ss)) {
+    SculptPoseIKChain *ik_chain = pose_ik_chain_build(sd, ob, ss, br, initial_location, radius);
+
+    if (ss->pose_ik_chain_cache) {
+      SCULPT_pose_ik_chain_free(ss->pose_ik_chain_cache);
+      ss->pose_ik_chain_cache = NULL;
+    }
+    if (!ik_chain) {
+      return NULL;
     }
+
+    ss->pose_ik_chain_cache = ik_chain;
+    ss->pose_ik_chain_cache_key = key;
+    pose_ik_chain_cache_clear_dirty(ss);
+
+    return pose_ik_chain_copy(ik_chain);
   }
 
-  MEM_SAFE_FREE(nodes);
+  SculptPoseIKChain *ik_chain = pose_ik_chain_copy(ss->pose_ik_chain_cache);
+  pose_ik_chain_relocate(ik_chain, ss, br, initial_location);
+
+  return ik_chain;
+}
+
+void SCULPT_pose_brush_init(Sculpt *sd, Object *ob, SculptSession *ss, Brush *br)
+{
+  /* Init the IK chain that is going to be used to deform the vertices. */
+  ss->cache->pose_ik_chain = SCULPT_pose_ik_chain_init(
+      sd, ob, ss, br, ss->cache->true_location, ss->cache->radius);
 }
 
 static void sculpt_pose_do_translate_deform(SculptSession *ss, Brush *brush)
@@ -1353,6 +1515,11 @@ void SCULPT_do_pose_brush(Sculpt *sd, Object *ob, PBVHNode **nodes, int totnode)
 
       invert_m4_m4(ik_chain->segments[i].pivot_mat_inv[symm_it],
                    ik_chain->segments[i].pivot_mat[symm_it]);
+
+      mul_m4_series(ik_chain->segments[i].deform_mat[symm_it],
+                    ik_chain->segments[i].pivot_mat[symm_it],
+                    ik_chain->segments[i].trans_mat[symm_it],
+                    ik_chain->segments[i].pivot_mat_inv[symm_it]);
     }
   }
 
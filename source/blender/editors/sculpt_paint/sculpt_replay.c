@@ -5,7 +5,9 @@
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_screen_types.h"
 #include "DNA_texture_types.h"
+#include "DNA_view3d_types.h"
 
 #include "BKE_context.h"
 #include "BKE_main.h"
@@ -16,6 +18,7 @@
 #include "BKE_screen.h"
 
 #include "DEG_depsgraph.h"
+#include "DEG_depsgraph_query.h"
 #include "ED_view3d.h"
 
 #include "BLI_array.h"
@@ -24,12 +27,15 @@
 #include "BLI_compiler_compat.h"
 #include "BLI_dynstr.h"
 #include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
+#include "BLI_listbase.h"
 #include "BLI_math.h"
 #include "BLI_memarena.h"
 #include "BLI_mempool.h"
 #include "BLI_rand.h"
 #include "BLI_smallhash.h"
 #include "BLI_string.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "PIL_time.h"
@@ -42,12 +48,18 @@
 #include "paint_intern.h"
 #include "sculpt_intern.h"
 
+#include "RNA_access.h"
+#include "RNA_enum_types.h"
+
 #include "WM_api.h"
 #include "WM_types.h"
 
 #include "bmesh.h"
 #include <string.h>
 
+/* Version 2 records stroke/step numbers, pixel size and brush input mapping per sample. */
+#define SCULPT_REPLAY_VERSION 2
+
 typedef struct SculptBrushSample {
   Sculpt sd;  // copy of sd settings
 
@@ -57,6 +69,13 @@ typedef struct SculptBrushSample {
   bool have_active_vertex;
   bool have_active_face;
 
+  /* Stroke and step this sample belongs to, a step has one sample per symmetry pass
+   * (and per brush command). */
+  int stroke_nr, step_nr;
+  /* Object space size of one pixel at the brush location, used to rebuild a view when
+   * replaying headless. */
+  float pixel_size;
+
   StrokeCache cache;
   UnifiedPaintSettings ups;
   PaintStroke stroke;
@@ -72,6 +91,13 @@ typedef struct SculptReplayLog {
   MemArena *arena;
   SmallHash texmap;
 
+  int version;
+
+  /* Recording state used to number strokes and steps. */
+  StrokeCache *record_cache;
+  int record_iteration;
+  int totstroke, totstep;
+
   bool is_playing;
 } SculptReplayLog;
 
@@ -92,6 +118,7 @@ SculptReplayLog *SCULPT_replay_log_create()
   SculptReplayLog *log = MEM_callocN(sizeof(*log), "SculptReplayLog");
 
   log->arena = BLI_memarena_new(1024, __func__);
+  log->version = SCULPT_REPLAY_VERSION;
   BLI_smallhash_init(&log->texmap);
 
   return log;
@@ -114,8 +141,7 @@ void SCULPT_replay_log_start()
     return;
   }
 
-  current_log = MEM_callocN(sizeof(*current_log), "sculpt replay log");
-  current_log->arena = BLI_memarena_new(8192, "sculpt replay log");
+  current_log = SCULPT_replay_log_create();
 }
 
 #if 0
@@ -266,6 +292,19 @@ static ReplaySerialDef brush_def[] = {
 
 static ReplaySerialStruct BrushDef = {"Brush", brush_def};
 
+static ReplaySerialDef brush_mapping_def[] = {
+  DEF(pressure, REPLAY_FLOAT, BrushMappingData),
+  DEF(xtilt, REPLAY_FLOAT, BrushMappingData),
+  DEF(ytilt, REPLAY_FLOAT, BrushMappingData),
+  DEF(angle, REPLAY_FLOAT, BrushMappingData),
+  DEF(speed, REPLAY_FLOAT, BrushMappingData),
+  DEF(random, REPLAY_FLOAT, BrushMappingData),
+  DEF(stroke_t, REPLAY_FLOAT, BrushMappingData),
+  {"", -1, -1}
+};
+
+static ReplaySerialStruct BrushMappingDataDef = {"BrushMappingData", brush_mapping_def};
+
 static ReplaySerialDef stroke_cache_def[] = {
   DEF(bstrength, REPLAY_FLOAT, StrokeCache),
   DEF(radius, REPLAY_FLOAT, StrokeCache),
@@ -312,6 +351,16 @@ static ReplaySerialDef stroke_cache_def[] = {
   DEF(stroke_distance_t, REPLAY_FLOAT, StrokeCache),
   DEF(last_dyntopo_t, REPLAY_FLOAT, StrokeCache),
   DEF(scale, REPLAY_VEC3, StrokeCache),
+  DEF(input_mapping, REPLAY_STRUCT, StrokeCache, &BrushMappingDataDef),
+  DEF(first_time, REPLAY_BOOL, StrokeCache),
+  DEF(tile_pass, REPLAY_INT, StrokeCache),
+  DEF(invert, REPLAY_BOOL, StrokeCache),
+  DEF(pen_flip, REPLAY_BOOL, StrokeCache),
+  DEF(normal_weight, REPLAY_FLOAT, StrokeCache),
+  DEF(x_tilt, REPLAY_FLOAT, StrokeCache),
+  DEF(y_tilt, REPLAY_FLOAT, StrokeCache),
+  DEF(mouse, REPLAY_VEC2, StrokeCache),
+  DEF(mouse_event, REPLAY_VEC2, StrokeCache),
   {"", -1, -1}
 };
 
@@ -377,6 +426,9 @@ static ReplaySerialDef sample_def[] = {
     {"active_face_co", REPLAY_VEC3, offsetof(SculptBrushSample, active_face_co)},
     {"have_active_vertex", REPLAY_BOOL, offsetof(SculptBrushSample, have_active_vertex)},
     {"have_active_face", REPLAY_BOOL, offsetof(SculptBrushSample, have_active_face)},
+    DEF(stroke_nr, REPLAY_INT, SculptBrushSample),
+    DEF(step_nr, REPLAY_INT, SculptBrushSample),
+    DEF(pixel_size, REPLAY_FLOAT, SculptBrushSample),
     {"cache", REPLAY_STRUCT, offsetof(SculptBrushSample, cache), &StrokeCacheDef},
     //    {"brush", REPLAY_STRUCT, offsetof(SculptBrushSample, brush), &BrushDef},
     {"sd", REPLAY_STRUCT, offsetof(SculptBrushSample, sd), &SculptDef},
@@ -646,7 +698,8 @@ static void replay_load(ReplaySerialStruct *st, void *data1, void *data2)
 void do_brush_action(struct Sculpt *sd,
                      struct Object *ob,
                      struct Brush *brush,
-                     struct UnifiedPaintSettings *ups);
+                     struct UnifiedPaintSettings *ups,
+                     void *userdata);
 void sculpt_combine_proxies(Sculpt *sd, Object *ob);
 bool sculpt_tool_is_proxy_used(const char sculpt_tool);
 void sculpt_stroke_update_step(bContext *C, struct PaintStroke *stroke, PointerRNA *itemptr);
@@ -887,7 +940,7 @@ void SCULPT_replay(struct bContext *C)
     //sculpt_stroke_update_step(C, ss->cache->stroke, NULL);
     last_dyntopo_t = ss->cache->last_dyntopo_t;
     continue;
-    do_brush_action(sd, ob, brush, &scene->toolsettings->unified_paint_settings);
+    do_brush_action(sd, ob, brush, &scene->toolsettings->unified_paint_settings, NULL);
     sculpt_combine_proxies(sd, ob);
 
     /* Hack to fix noise texture tearing mesh. */
@@ -937,6 +990,361 @@ void SCULPT_replay(struct bContext *C)
   log->is_playing = false;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Headless Batch Replay
+ *
+ * Replays the current log without a window manager, e.g. from
+ * `blender -b file.blend --python-expr ...`. Samples are grouped back into the brush steps
+ * they were recorded in and every step runs through the same code as the stroke operator,
+ * using the brushes from the loaded file and an orthographic view rebuilt from the recorded
+ * view normal and pixel size.
+ * \{ */
+
+/* Region size of the headless view, only its ratio to the recorded pixel size matters. */
+#define REPLAY_VIEW_SIZE 1024
+
+typedef struct ReplayHeadlessView {
+  ViewContext vc;
+  ARegion region;
+  RegionView3D rv3d;
+  View3D v3d;
+} ReplayHeadlessView;
+
+typedef struct ReplayToolStats {
+  int totstep, totsample;
+  double time;
+} ReplayToolStats;
+
+static void replay_view_init(
+    ReplayHeadlessView *view, Main *bmain, Depsgraph *depsgraph, Scene *scene, Object *ob)
+{
+  memset(view, 0, sizeof(*view));
+
+  view->region.regiontype = RGN_TYPE_WINDOW;
+  view->region.winx = view->region.winy = REPLAY_VIEW_SIZE;
+  view->region.regiondata = &view->rv3d;
+
+  view->rv3d.persp = RV3D_ORTHO;
+  view->rv3d.is_persp = false;
+
+  view->vc.bmain = bmain;
+  view->vc.depsgraph = depsgraph;
+  view->vc.scene = scene;
+  view->vc.view_layer = DEG_get_input_view_layer(depsgraph);
+  view->vc.obact = ob;
+  view->vc.region = &view->region;
+  view->vc.v3d = &view->v3d;
+  view->vc.rv3d = &view->rv3d;
+}
+
+/* Orients the view along an object space view normal and scales it so that one pixel covers
+ * pixel_size object space units. */
+static void replay_view_update(ReplayHeadlessView *view,
+                               Object *ob,
+                               const float view_normal[3],
+                               float pixel_size)
+{
+  RegionView3D *rv3d = &view->rv3d;
+  float scale = fabsf(mat4_to_scale(ob->obmat));
+
+  scale = (scale == 0.0f) ? 1.0f : scale;
+
+  unit_m4(rv3d->viewinv);
+  mul_v3_mat3_m4v3(rv3d->viewinv[2], ob->obmat, view_normal);
+
+  if (normalize_v3(rv3d->viewinv[2]) == 0.0f) {
+    rv3d->viewinv[2][2] = 1.0f;
+  }
+
+  ortho_basis_v3v3_v3(rv3d->viewinv[0], rv3d->viewinv[1], rv3d->viewinv[2]);
+  invert_m4_m4(rv3d->viewmat, rv3d->viewinv);
+
+  /* ED_view3d_win_to_delta maps a pixel to 2 / (winx * s) units for a uniform window scale s. */
+  scale_m4_fl(rv3d->winmat, 2.0f / ((float)REPLAY_VIEW_SIZE * pixel_size * scale));
+
+  mul_m4_m4m4(rv3d->persmat, rv3d->winmat, rv3d->viewmat);
+  invert_m4_m4(rv3d->persinv, rv3d->persmat);
+}
+
+static float replay_sample_pixel_size(const SculptBrushSample *samp)
+{
+  if (samp->pixel_size > 0.0f) {
+    return samp->pixel_size;
+  }
+
+  /* Older logs don't store the pixel size, estimate it from the brush radius. */
+  if (samp->ups.pixel_radius > 0.0f && samp->cache.radius > 0.0f) {
+    return samp->cache.radius / samp->ups.pixel_radius;
+  }
+
+  return 0.001f;
+}
+
+/* Numbers strokes and steps for logs written before they were recorded. */
+static void replay_log_ensure_step_numbers(SculptReplayLog *log)
+{
+  if (log->version >= 2) {
+    return;
+  }
+
+  int stroke_nr = -1, step_nr = -1;
+  int last_iteration = 0;
+
+  for (int i = 0; i < log->totsample; i++) {
+    SculptBrushSample *samp = log->samples + i;
+    const int iteration = samp->cache.iteration_count;
+
+    if (i == 0 || iteration < last_iteration) {
+      stroke_nr++;
+      step_nr++;
+    }
+    else if (iteration != last_iteration) {
+      step_nr++;
+    }
+
+    last_iteration = iteration;
+    samp->stroke_nr = stroke_nr;
+    samp->step_nr = step_nr;
+  }
+}
+
+/* Use the active brush if it matches the recorded tool, otherwise the first sculpt brush
+ * in the file using that tool. */
+static Brush *replay_brush_for_tool(Main *bmain, Sculpt *sd, int tool)
+{
+  Brush *brush = BKE_paint_brush(&sd->paint);
+
+  if (brush && brush->sculpt_tool == tool) {
+    return brush;
+  }
+
+  LISTBASE_FOREACH (Brush *, br, &bmain->brushes) {
+    if ((br->ob_mode & OB_MODE_SCULPT) && br->sculpt_tool == tool) {
+      return br;
+    }
+  }
+
+  return NULL;
+}
+
+static void replay_step_load(SculptSession *ss,
+                             PaintStroke *stroke,
+                             SculptBrushSample *samp,
+                             Brush *brush,
+                             bool first_step)
+{
+  StrokeCache *cache = ss->cache;
+  Brush scratch;
+
+  /* Recorded brush settings are only informative, the channels of the file's brush drive the
+   * step just like in an interactive stroke. */
+  memset(&scratch, 0, sizeof(scratch));
+  cache->brush = &scratch;
+  replay_load(&StrokeCacheDef, cache, &samp->cache);
+  cache->brush = brush;
+
+  cache->first_time = first_step;
+  cache->mirror_symmetry_pass = 0;
+  cache->radial_symmetry_pass = 0;
+  cache->tile_pass = 0;
+
+  replay_load(&PaintStrokeDef, stroke, &samp->stroke);
+  stroke->brush = brush;
+}
+
+static void replay_stroke_end(Object *ob)
+{
+  SculptSession *ss = ob->sculpt;
+
+  SCULPT_automasking_cache_free(ss, ob, ss->cache->automasking);
+  BKE_pbvh_node_color_buffer_free(ss->pbvh);
+
+  SCULPT_cache_free(ss, ob, ss->cache);
+  ss->cache = NULL;
+
+  SCULPT_undo_push_end(ob);
+}
+
+static uint replay_coords_hash(SculptSession *ss)
+{
+  BLI_HashMurmur2A mm2;
+  const int totvert = SCULPT_vertex_count_get(ss);
+
+  SCULPT_vertex_random_access_ensure(ss);
+
+  BLI_hash_mm2a_init(&mm2, 0);
+  BLI_hash_mm2a_add_int(&mm2, totvert);
+
+  for (int i = 0; i < totvert; i++) {
+    const float *co = SCULPT_vertex_co_get(ss, BKE_pbvh_table_index_to_vertex(ss->pbvh, i));
+    BLI_hash_mm2a_add(&mm2, (const unsigned char *)co, sizeof(float[3]));
+  }
+
+  return BLI_hash_mm2a_end(&mm2);
+}
+
+char *SCULPT_replay_batch(Main *bmain, Depsgraph *depsgraph, Scene *scene, Object *ob)
+{
+  SculptReplayLog *log = current_log;
+  Sculpt *sd = scene->toolsettings ? scene->toolsettings->sculpt : NULL;
+
+  if (!log || !log->totsample) {
+    printf("%s: no replay data\n", __func__);
+    return NULL;
+  }
+
+  if (!sd || !ob || !ob->sculpt) {
+    printf("%s: object must be in sculpt mode\n", __func__);
+    return NULL;
+  }
+
+  SculptSession *ss = ob->sculpt;
+
+  if (ss->cache) {
+    printf("%s: a stroke is already in progress\n", __func__);
+    return NULL;
+  }
+
+  UnifiedPaintSettings *ups = &scene->toolsettings->unified_paint_settings;
+  Brush *active_brush = BKE_paint_brush(&sd->paint);
+  ReplayToolStats tools[256];
+  ReplayHeadlessView view;
+  PaintStroke stroke;
+
+  memset(tools, 0, sizeof(tools));
+  memset(&stroke, 0, sizeof(stroke));
+
+  BKE_sculpt_update_object_for_edit(depsgraph, ob, true, false, false);
+
+  replay_log_ensure_step_numbers(log);
+  replay_view_init(&view, bmain, depsgraph, scene, ob);
+
+  log->is_playing = true;
+
+  int totstep = 0, totsample = 0, totskipped = 0;
+  int stroke_nr = -1;
+  Brush *stroke_brush = NULL;
+
+  const double start_time = PIL_check_seconds_timer();
+
+  for (int i = 0; i < log->totsample;) {
+    SculptBrushSample *samp = log->samples + i;
+    int end = i + 1;
+
+    while (end < log->totsample && log->samples[end].step_nr == samp->step_nr) {
+      end++;
+    }
+
+    const int tool = samp->cache.brush ? samp->cache.brush->sculpt_tool : -1;
+    Brush *brush = tool >= 0 ? replay_brush_for_tool(bmain, sd, tool) : NULL;
+
+    if (ss->cache && (samp->stroke_nr != stroke_nr || brush != stroke_brush)) {
+      replay_stroke_end(ob);
+    }
+
+    /* These need an interactive context to rebuild the PBVH or snap to other objects. */
+    if (!brush || ELEM(tool, SCULPT_TOOL_ARRAY, SCULPT_TOOL_SCENE_PROJECT)) {
+      totskipped += end - i;
+      i = end;
+      continue;
+    }
+
+    replay_load(&SculptDef, sd, &samp->sd);
+    replay_load(&UnifiedPaintSettingsDef, ups, &samp->ups);
+    replay_view_update(&view, ob, samp->cache.true_view_normal, replay_sample_pixel_size(samp));
+
+    const bool first_step = !ss->cache;
+
+    if (first_step) {
+      BKE_paint_brush_set(&sd->paint, brush);
+      SCULPT_undo_push_begin(ob, "Replay");
+      SCULPT_stroke_cache_headless_create(sd, ob, brush, &view.vc);
+
+      stroke_nr = samp->stroke_nr;
+      stroke_brush = brush;
+    }
+
+    replay_step_load(ss, &stroke, samp, brush, first_step);
+    stroke.ups = ups;
+    stroke.vc = view.vc;
+    ED_view3d_ob_project_mat_get(&view.rv3d, ob, ss->cache->projection_mat);
+
+    const double step_start = PIL_check_seconds_timer();
+    SCULPT_stroke_step_headless(bmain, depsgraph, scene, sd, ob, ups, &stroke);
+
+    tools[tool].time += PIL_check_seconds_timer() - step_start;
+    tools[tool].totstep++;
+    tools[tool].totsample += end - i;
+
+    totstep++;
+    totsample += end - i;
+    i = end;
+  }
+
+  if (ss->cache) {
+    replay_stroke_end(ob);
+  }
+
+  const double total_time = PIL_check_seconds_timer() - start_time;
+
+  log->is_playing = false;
+  BKE_paint_brush_set(&sd->paint, active_brush);
+
+  DEG_id_tag_update(&ob->id, ID_RECALC_GEOMETRY);
+
+  DynStr *out = BLI_dynstr_new();
+
+  BLI_dynstr_appendf(out,
+                     "{\n  \"pbvh_type\": %d,\n  \"threads\": %d,\n",
+                     (int)BKE_pbvh_type(ss->pbvh),
+                     BLI_task_scheduler_num_threads());
+  BLI_dynstr_appendf(out,
+                     "  \"samples\": %d,\n  \"steps\": %d,\n  \"skipped\": %d,\n",
+                     totsample,
+                     totstep,
+                     totskipped);
+  BLI_dynstr_appendf(out,
+                     "  \"seconds\": %.6f,\n  \"samples_per_second\": %.3f,\n",
+                     total_time,
+                     total_time > 0.0 ? (double)totsample / total_time : 0.0);
+  BLI_dynstr_appendf(out, "  \"coords_hash\": \"%08x\",\n", replay_coords_hash(ss));
+  BLI_dynstr_append(out, "  \"brushes\": {");
+
+  bool first = true;
+
+  for (int tool = 0; tool < ARRAY_SIZE(tools); tool++) {
+    if (!tools[tool].totstep) {
+      continue;
+    }
+
+    const char *name = NULL;
+
+    if (!RNA_enum_identifier(rna_enum_brush_sculpt_tool_items, tool, &name)) {
+      name = "UNKNOWN";
+    }
+
+    BLI_dynstr_appendf(out,
+                       "%s\n    \"%s\": {\"steps\": %d, \"samples\": %d, \"seconds\": %.6f, "
+                       "\"ms_per_step\": %.4f}",
+                       first ? "" : ",",
+                       name,
+                       tools[tool].totstep,
+                       tools[tool].totsample,
+                       tools[tool].time,
+                       tools[tool].time * 1000.0 / (double)tools[tool].totstep);
+    first = false;
+  }
+
+  BLI_dynstr_append(out, "\n  }\n}\n");
+
+  char *ret = BLI_dynstr_get_cstring(out);
+  BLI_dynstr_free(out);
+
+  return ret;
+}
+
+/** \} */
+
 void SCULPT_replay_parse(const char *buf)
 {
   if (current_log) {
@@ -956,6 +1364,8 @@ void SCULPT_replay_parse(const char *buf)
   sscanf(buf + i, "version:%d\n%n", &version, &n);
   i += n;
 
+  log->version = version;
+
   SKIP_ALL_WS;
 
   while (i < len) {
@@ -1088,7 +1498,7 @@ char *SCULPT_replay_serialize()
 
   ReplaySerializer state;
 
-  BLI_dynstr_append(out, "version:1\n");
+  BLI_dynstr_append(out, "version:" STRINGIFY(SCULPT_REPLAY_VERSION) "\n");
 
   replay_state_init(&state);
   state.out = out;
@@ -1208,6 +1618,23 @@ void SCULPT_replay_log_append(Sculpt *sd, SculptSession *ss, Object *ob)
     return;
   }
 
+  if (ss->cache != log->record_cache) {
+    log->record_cache = ss->cache;
+    log->record_iteration = ss->cache->iteration_count;
+    log->totstroke++;
+    log->totstep++;
+  }
+  else if (ss->cache->iteration_count != log->record_iteration) {
+    log->record_iteration = ss->cache->iteration_count;
+    log->totstep++;
+  }
+
+  samp->stroke_nr = log->totstroke - 1;
+  samp->step_nr = log->totstep - 1;
+  samp->pixel_size = ss->cache->vc ? paint_calc_object_space_radius(
+                                         ss->cache->vc, ss->cache->true_location, 1.0f) :
+                                     0.0f;
+
   samp->time = PIL_check_seconds_timer();
   samp->stroke = *ss->cache->stroke;
 
@@ -1228,3 +1655,12 @@ void SCULPT_replay_log_append(Sculpt *sd, SculptSession *ss, Object *ob)
   // TODO: active face
   samp->have_active_face = false;
 }
+
+/* Called when a stroke cache is freed so a new stroke reusing its address isn't merged with
+ * the previous one. */
+void SCULPT_replay_log_cache_free(StrokeCache *cache)
+{
+  if (current_log && current_log->record_cache == cache) {
+    current_log->record_cache = NULL;
+  }
+}
@@ -6,14 +6,26 @@
  * Implements the Sculpt Mode tools.
  */
 
+#include <fcntl.h>
 #include <stddef.h>
 #include <string.h>
 
+#ifdef WIN32
+#  include "BLI_winstuff.h"
+#  include <io.h>
+#else
+#  include <unistd.h>
+#endif
+
 #include "MEM_guardedalloc.h"
 
+#include "BLI_bitmap.h"
+#include "BLI_fileops.h"
 #include "BLI_ghash.h"
 #include "BLI_listbase.h"
 #include "BLI_math.h"
+#include "BLI_mmap.h"
+#include "BLI_path_util.h"
 #include "BLI_string.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
@@ -24,7 +36,9 @@
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
 #include "DNA_screen_types.h"
+#include "DNA_userdef_types.h"
 
+#include "BKE_appdir.h"
 #include "BKE_attribute.h"
 #include "BKE_ccg.h"
 #include "BKE_context.h"
@@ -97,7 +111,12 @@
  * does modifications on it.
  *
  * End of dynamic topology and symmetrize in this mode are handled in a special
- * manner as well. */
+ * manner as well.
+ *
+ * With a sculpt undo memory limit set in the preferences, the per-vertex arrays of older steps
+ * are moved out to a file in the session temp directory once the newer steps use up the limit.
+ * They are read back from a memory map of that file when the step is undone or redone. BMLog
+ * entries and geometry nodes always stay in memory. */
 
 #define NO_ACTIVE_LAYER ATTR_DOMAIN_AUTO
 
@@ -127,10 +146,16 @@ typedef struct SculptUndoStep {
   SculptAttrRef active_attr_end;
   SculptAttrRef active_vcol_attr_end;
 
+  /* Temp file holding the node arrays while the step is spilled, NULL when resident. */
+  char *spill_filepath;
+  /* Bytes of node arrays in the temp file. */
+  size_t spill_size;
+
   bContext *C;
 } SculptUndoStep;
 
 static UndoSculpt *sculpt_undo_get_nodes(void);
+static bool sculpt_undo_step_page_in(SculptUndoStep *us);
 static bool sculpt_attr_ref_equals(SculptAttrRef *a, SculptAttrRef *b);
 static void sculpt_save_active_attr(Object *ob, SculptAttrRef *attr);
 static void sculpt_save_active_vcol_attr(Object *ob, SculptAttrRef *attr);
@@ -1122,6 +1147,35 @@ static void sculpt_undo_refine_subdiv(Depsgraph *depsgraph,
   MEM_freeN(deformed_verts);
 }
 
+/* Re-evaluate grids around the base vertices which were moved by restoring the geometry, so that
+ * grids which are not stored in the undo step follow the new base mesh. Grids restored from the
+ * undo step are left as-is. Returns true when any grids were re-evaluated. */
+static bool sculpt_undo_update_moved_grids(SculptSession *ss,
+                                           Object *object,
+                                           const float (*prev_base_cos)[3],
+                                           const int prev_base_totvert,
+                                           const char *restored_grids)
+{
+  Mesh *mesh = object->data;
+  if (prev_base_cos == NULL || prev_base_totvert != mesh->totvert) {
+    return false;
+  }
+
+  BLI_bitmap *moved_verts = BLI_BITMAP_NEW(mesh->totvert, __func__);
+  for (int i = 0; i < mesh->totvert; i++) {
+    /* Deform modifiers prior to the multires can move vertices which did not move in the base. */
+    if (ss->deform_modifiers_active || !equals_v3v3(prev_base_cos[i], mesh->mvert[i].co)) {
+      BLI_BITMAP_ENABLE(moved_verts, i);
+    }
+  }
+
+  const bool updated = multires_update_grids_from_base_verts(object, moved_verts, restored_grids);
+
+  MEM_freeN(moved_verts);
+
+  return updated;
+}
+
 static void sculpt_undo_restore_list(bContext *C, Depsgraph *depsgraph, ListBase *lb, int dir)
 {
   Scene *scene = CTX_data_scene(C);
@@ -1134,6 +1188,8 @@ static void sculpt_undo_restore_list(bContext *C, Depsgraph *depsgraph, ListBase
   bool update = false, rebuild = false, update_mask = false, update_visibility = false;
   bool need_mask = false;
   bool need_refine_subdiv = false;
+  float(*prev_base_cos)[3] = NULL;
+  int prev_base_totvert = 0;
   //  bool did_first_hack = false;
 
   for (unode = lb->first; unode; unode = unode->next) {
@@ -1187,6 +1243,7 @@ static void sculpt_undo_restore_list(bContext *C, Depsgraph *depsgraph, ListBase
     unode = lb->first;
     if (unode->type == SCULPT_UNDO_FACE_SETS) {
       sculpt_undo_restore_face_sets(C, unode);
+      ss->face_sets_stamp++;
 
       rebuild = true;
       BKE_pbvh_search_callback(ss->pbvh, NULL, NULL, update_cb, &rebuild);
@@ -1280,6 +1337,9 @@ static void sculpt_undo_restore_list(bContext *C, Depsgraph *depsgraph, ListBase
 
       case SCULPT_UNDO_GEOMETRY:
         need_refine_subdiv = true;
+        if (subdiv_ccg != NULL && prev_base_cos == NULL) {
+          prev_base_cos = BKE_mesh_vert_coords_alloc(ob->data, &prev_base_totvert);
+        }
         sculpt_undo_geometry_restore(unode, ob);
         BKE_sculpt_update_object_for_edit(depsgraph, ob, false, need_mask, false);
         break;
@@ -1313,7 +1373,15 @@ static void sculpt_undo_restore_list(bContext *C, Depsgraph *depsgraph, ListBase
 
   if (subdiv_ccg != NULL && need_refine_subdiv) {
     sculpt_undo_refine_subdiv(depsgraph, ss, ob, subdiv_ccg->subdiv);
+    if (sculpt_undo_update_moved_grids(
+            ss, ob, (const float(*)[3])prev_base_cos, prev_base_totvert, undo_modified_grids) &&
+        ss->pbvh != NULL) {
+      /* The re-evaluated grids are not covered by the undo nodes, update all nodes. */
+      BKE_pbvh_search_callback(ss->pbvh, NULL, NULL, update_cb, &rebuild);
+      BKE_pbvh_update_bounds(ss->pbvh, PBVH_UpdateBB | PBVH_UpdateOriginalBB | PBVH_UpdateRedraw);
+    }
   }
+  MEM_SAFE_FREE(prev_base_cos);
 
   if (update || rebuild) {
     bool tag_update = false;
@@ -2110,6 +2178,7 @@ SculptUndoNode *SCULPT_undo_push_node(Object *ob, PBVHNode *node, SculptUndoType
     return unode;
   }
   if (type == SCULPT_UNDO_FACE_SETS) {
+    ss->face_sets_stamp++;
     unode = sculpt_undo_face_sets_push(ob, type);
     sculpt_undo_print_nodes(NULL);
     BLI_thread_unlock(LOCK_CUSTOM1);
@@ -2282,6 +2351,215 @@ void SCULPT_undo_push_begin(Object *ob, const char *name)
   sculpt_undo_push_begin_ex(ob, name, false);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Out-of-core Undo Steps
+ * \{ */
+
+#define SCULPT_UNDO_SPILL_ARRAYS 9
+
+static const char *sculpt_undo_spill_array_names[SCULPT_UNDO_SPILL_ARRAYS] = {
+    "SculptUndoNode.co",
+    "undoSculpt orig_cos",
+    "SculptUndoNode.col",
+    "SculptUndoNode.mask",
+    "SculptUndoNode.index",
+    "SculptUndoNode.grids",
+    "SculptUndoNode.vert_hidden",
+    "sculpt face sets",
+    "unode->nodemap",
+};
+
+/* Node arrays that are moved to the temp file, in file order. */
+static void sculpt_undo_node_spill_arrays(SculptUndoNode *unode,
+                                          void **r_arrays[SCULPT_UNDO_SPILL_ARRAYS])
+{
+  r_arrays[0] = (void **)&unode->co;
+  r_arrays[1] = (void **)&unode->orig_co;
+  r_arrays[2] = (void **)&unode->col;
+  r_arrays[3] = (void **)&unode->mask;
+  r_arrays[4] = (void **)&unode->index;
+  r_arrays[5] = (void **)&unode->grids;
+  r_arrays[6] = (void **)&unode->vert_hidden;
+  r_arrays[7] = (void **)&unode->face_sets;
+  r_arrays[8] = (void **)&unode->nodemap;
+}
+
+static void sculpt_undo_step_spill_arrays_free(SculptUndoStep *us)
+{
+  LISTBASE_FOREACH (SculptUndoNode *, unode, &us->data.nodes) {
+    void **arrays[SCULPT_UNDO_SPILL_ARRAYS];
+    sculpt_undo_node_spill_arrays(unode, arrays);
+    for (int i = 0; i < SCULPT_UNDO_SPILL_ARRAYS; i++) {
+      MEM_SAFE_FREE(*arrays[i]);
+    }
+  }
+}
+
+static bool sculpt_undo_spill_write(int fd, const void *data, size_t len)
+{
+  const char *ptr = data;
+  while (len > 0) {
+    const int written = write(fd, ptr, (uint)MIN2(len, (size_t)INT_MAX));
+    if (written <= 0) {
+      return false;
+    }
+    ptr += written;
+    len -= (size_t)written;
+  }
+  return true;
+}
+
+/* Write the node arrays of the step to a temp file and free them. Every array is stored as its
+ * length followed by its data, a zero length stands for a NULL array. */
+static bool sculpt_undo_step_spill(SculptUndoStep *us)
+{
+  static uint spill_counter = 0;
+  char filename[64], filepath[FILE_MAX];
+
+  BLI_assert(us->spill_filepath == NULL);
+
+  BLI_snprintf(filename, sizeof(filename), "sculpt_undo_%u.tmp", ++spill_counter);
+  BLI_join_dirfile(filepath, sizeof(filepath), BKE_tempdir_session(), filename);
+
+  const int fd = BLI_open(filepath, O_BINARY | O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1) {
+    return false;
+  }
+
+  size_t spill_size = 0;
+  bool ok = true;
+
+  LISTBASE_FOREACH (SculptUndoNode *, unode, &us->data.nodes) {
+    void **arrays[SCULPT_UNDO_SPILL_ARRAYS];
+    sculpt_undo_node_spill_arrays(unode, arrays);
+
+    for (int i = 0; i < SCULPT_UNDO_SPILL_ARRAYS && ok; i++) {
+      const size_t len = *arrays[i] ? MEM_allocN_len(*arrays[i]) : 0;
+      ok = sculpt_undo_spill_write(fd, &len, sizeof(len)) &&
+           sculpt_undo_spill_write(fd, *arrays[i], len);
+      spill_size += len;
+    }
+  }
+
+  close(fd);
+
+  if (!ok || spill_size == 0) {
+    BLI_delete(filepath, false, false);
+    return false;
+  }
+
+  /* Only free the arrays once the whole step made it to the file. */
+  sculpt_undo_step_spill_arrays_free(us);
+
+  us->spill_filepath = BLI_strdup(filepath);
+  us->spill_size = spill_size;
+  us->step.data_size -= MIN2(us->step.data_size, spill_size);
+
+  return true;
+}
+
+/* Read back the node arrays of a spilled step, does nothing for resident steps. */
+static bool sculpt_undo_step_page_in(SculptUndoStep *us)
+{
+  if (us->spill_filepath == NULL) {
+    return true;
+  }
+
+  const int fd = BLI_open(us->spill_filepath, O_BINARY | O_RDONLY, 0);
+  if (fd == -1) {
+    return false;
+  }
+
+  BLI_mmap_file *mmap_file = BLI_mmap_open(fd);
+  bool ok = mmap_file != NULL;
+  size_t offset = 0;
+
+  LISTBASE_FOREACH (SculptUndoNode *, unode, &us->data.nodes) {
+    void **arrays[SCULPT_UNDO_SPILL_ARRAYS];
+    sculpt_undo_node_spill_arrays(unode, arrays);
+
+    for (int i = 0; i < SCULPT_UNDO_SPILL_ARRAYS && ok; i++) {
+      size_t len;
+      ok = BLI_mmap_read(mmap_file, &len, offset, sizeof(len));
+      offset += sizeof(len);
+
+      if (ok && len) {
+        *arrays[i] = MEM_mallocN(len, sculpt_undo_spill_array_names[i]);
+        ok = BLI_mmap_read(mmap_file, *arrays[i], offset, len);
+        offset += len;
+      }
+    }
+  }
+
+  if (mmap_file) {
+    BLI_mmap_free(mmap_file);
+  }
+  close(fd);
+
+  if (!ok) {
+    sculpt_undo_step_spill_arrays_free(us);
+    return false;
+  }
+
+  BLI_delete(us->spill_filepath, false, false);
+  MEM_SAFE_FREE(us->spill_filepath);
+  us->step.data_size += us->spill_size;
+  us->spill_size = 0;
+
+  return true;
+}
+
+/* Spill the oldest sculpt steps once the newer ones use up the resident memory limit. The active
+ * step always stays in memory. */
+static void sculpt_undo_spill_cold_steps(UndoStack *ustack)
+{
+  if (U.sculpt_undo_memory == 0) {
+    return;
+  }
+
+  const size_t memory_limit = (size_t)U.sculpt_undo_memory * 1024 * 1024;
+  size_t resident_size = 0;
+
+  for (UndoStep *us = ustack->steps.last; us; us = us->prev) {
+    if (us->type != BKE_UNDOSYS_TYPE_SCULPT) {
+      continue;
+    }
+
+    SculptUndoStep *sus = (SculptUndoStep *)us;
+    if (sus->spill_filepath) {
+      continue;
+    }
+
+    resident_size += us->data_size;
+    if (resident_size > memory_limit && us != ustack->step_active) {
+      if (sculpt_undo_step_spill(sus)) {
+        resident_size -= MIN2(resident_size, sus->spill_size);
+      }
+    }
+  }
+}
+
+void ED_sculpt_undo_memory_stats(size_t *r_resident, size_t *r_spilled)
+{
+  UndoStack *ustack = ED_undo_stack_get();
+
+  *r_resident = 0;
+  *r_spilled = 0;
+
+  if (!ustack) {
+    return;
+  }
+
+  LISTBASE_FOREACH (UndoStep *, us, &ustack->steps) {
+    if (us->type == BKE_UNDOSYS_TYPE_SCULPT) {
+      *r_resident += us->data_size;
+      *r_spilled += ((SculptUndoStep *)us)->spill_size;
+    }
+  }
+}
+
+/** \} */
+
 void SCULPT_undo_push_end(Object *ob)
 {
   SCULPT_undo_push_end_ex(ob, false);
@@ -2298,6 +2576,11 @@ void SCULPT_undo_push_end_ex(struct Object *ob, const bool use_nested_undo)
       update_unode_bmesh_memsize(unode);
     }
 
+    /* The face sets were written after the node was pushed. */
+    if (unode->type == SCULPT_UNDO_FACE_SETS) {
+      ob->sculpt->face_sets_stamp++;
+    }
+
     if (unode->no) {
       usculpt->undo_size -= MEM_allocN_len(unode->no);
       MEM_freeN(unode->no);
@@ -2310,6 +2593,7 @@ void SCULPT_undo_push_end_ex(struct Object *ob, const bool use_nested_undo)
   if (wm->op_undo_depth == 0 || use_nested_undo) {
     UndoStack *ustack = ED_undo_stack_get();
     BKE_undosys_step_push(ustack, NULL, NULL);
+    sculpt_undo_spill_cold_steps(ustack);
     if (wm->op_undo_depth == 0) {
       BKE_undosys_stack_limit_steps_and_memory_defaults(ustack);
     }
@@ -2409,26 +2693,37 @@ static bool sculpt_undosys_step_encode(struct bContext *C, struct Main *bmain, U
   return true;
 }
 
-static void sculpt_undosys_step_decode_undo_impl(struct bContext *C,
+/* Returns false when a spilled step can't be read back, the step is then left as it was. */
+static bool sculpt_undosys_step_decode_undo_impl(struct bContext *C,
                                                  Depsgraph *depsgraph,
                                                  SculptUndoStep *us)
 {
   BLI_assert(us->step.is_applied == true);
+  if (!sculpt_undo_step_page_in(us)) {
+    WM_reportf(RPT_ERROR, "Sculpt undo: failed to read back undo step \"%s\"", us->step.name);
+    return false;
+  }
   sculpt_undo_restore_list(C, depsgraph, &us->data.nodes, -1);
   us->step.is_applied = false;
 
   sculpt_undo_print_nodes(us);
+  return true;
 }
 
-static void sculpt_undosys_step_decode_redo_impl(struct bContext *C,
+static bool sculpt_undosys_step_decode_redo_impl(struct bContext *C,
                                                  Depsgraph *depsgraph,
                                                  SculptUndoStep *us)
 {
   BLI_assert(us->step.is_applied == false);
+  if (!sculpt_undo_step_page_in(us)) {
+    WM_reportf(RPT_ERROR, "Sculpt undo: failed to read back undo step \"%s\"", us->step.name);
+    return false;
+  }
   sculpt_undo_restore_list(C, depsgraph, &us->data.nodes, 1);
   us->step.is_applied = true;
 
   sculpt_undo_print_nodes(us);
+  return true;
 }
 
 static void sculpt_undosys_step_decode_undo(struct bContext *C,
@@ -2452,7 +2747,10 @@ static void sculpt_undosys_step_decode_undo(struct bContext *C,
     sculpt_undo_set_active_layer(C, &((SculptUndoStep *)us_iter)->active_attr_start);
     sculpt_undo_set_active_vcol_layer(C, &((SculptUndoStep *)us_iter)->active_vcol_attr_start);
 
-    sculpt_undosys_step_decode_undo_impl(C, depsgraph, us_iter);
+    if (!sculpt_undosys_step_decode_undo_impl(C, depsgraph, us_iter)) {
+      /* Older steps build on this one, stop here. */
+      break;
+    }
     // sculpt_undo_set_active_layer(C, &((SculptUndoStep *)us_iter)->active_attr_start);
 
     if (us_iter == us) {
@@ -2482,7 +2780,10 @@ static void sculpt_undosys_step_decode_redo(struct bContext *C,
   while (us_iter && (us_iter->step.is_applied == false)) {
     sculpt_undo_set_active_layer(C, &((SculptUndoStep *)us_iter)->active_attr_start);
     sculpt_undo_set_active_vcol_layer(C, &((SculptUndoStep *)us_iter)->active_vcol_attr_start);
-    sculpt_undosys_step_decode_redo_impl(C, depsgraph, us_iter);
+    if (!sculpt_undosys_step_decode_redo_impl(C, depsgraph, us_iter)) {
+      /* Newer steps build on this one, stop here. */
+      break;
+    }
 
     if (us_iter == us) {
       sculpt_undo_set_active_layer(C, &((SculptUndoStep *)us_iter)->active_attr_end);
@@ -2550,6 +2851,11 @@ static void sculpt_undosys_step_free(UndoStep *us_p)
 {
   SculptUndoStep *us = (SculptUndoStep *)us_p;
   sculpt_undo_free_list(&us->data.nodes);
+
+  if (us->spill_filepath) {
+    BLI_delete(us->spill_filepath, false, false);
+    MEM_freeN(us->spill_filepath);
+  }
 }
 
 void ED_sculpt_undo_geometry_begin(struct Object *ob, const char *name)
@@ -2599,6 +2905,7 @@ static UndoSculpt *sculpt_undo_get_nodes(void)
   }
 
   UndoStep *us = BKE_undosys_stack_init_or_active_with_type(ustack, BKE_UNDOSYS_TYPE_SCULPT);
+  sculpt_undo_step_page_in((SculptUndoStep *)us);
   return sculpt_undosys_step_get_nodes(us);
 }
 
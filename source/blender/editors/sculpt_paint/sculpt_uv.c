@@ -10,6 +10,7 @@
 
 #include "BLI_ghash.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "DNA_brush_types.h"
@@ -44,6 +45,8 @@
 
 #define MARK_BOUNDARY 1
 
+#define UV_RELAX_MIN_ITER_PER_THREAD 1024
+
 typedef struct UvAdjacencyElement {
   /* pointer to original uvelement */
   UvElement *element;
@@ -83,6 +86,10 @@ typedef struct UVInitialStroke {
   float init_coord[2];
 } UVInitialStroke;
 
+typedef struct Temp_UvData {
+  float p[2], b[2], sum_b[2];
+} Temp_UVData;
+
 /* custom data for uv smoothing brush */
 typedef struct UvSculptData {
   /* Contains the first of each set of coincident UV's.
@@ -99,6 +106,16 @@ typedef struct UvSculptData {
   /* need I say more? */
   int totalUvEdges;
 
+  /* Flat adjacency built from the edges. The neighbors of unique UV `i` are stored in
+   * uv_adjacency from uv_adjacency_offset[i] to uv_adjacency_offset[i + 1]. */
+  int *uv_adjacency_offset;
+  int *uv_adjacency;
+
+  /* Relaxation reads the unique UVs from uv_co and writes the new positions to the mesh, so all
+   * unique UVs can be relaxed in parallel. */
+  float (*uv_co)[2];
+  Temp_UVData *tmp_uvdata;
+
   /* data for initial stroke, used by tools like grab */
   UVInitialStroke *initial_stroke;
 
@@ -123,95 +140,150 @@ typedef struct UvSculptData {
  * adapted to uv smoothing by Antony Riakiatakis                           *
  ***************************************************************************/
 
-typedef struct Temp_UvData {
-  float sum_co[2], p[2], b[2], sum_b[2];
-  int ncounter;
-} Temp_UVData;
+typedef struct UvRelaxTaskData {
+  BMEditMesh *em;
+  UvSculptData *sculptdata;
+  Brush *brush;
+  const float *mouse_coord;
+  float alpha;
+  float radius;
+  float radius_root;
+  float aspectRatio;
+  bool use_hc;
+} UvRelaxTaskData;
 
-static void HC_relaxation_iteration_uv(BMEditMesh *em,
-                                       UvSculptData *sculptdata,
-                                       const float mouse_coord[2],
-                                       float alpha,
-                                       float radius,
-                                       float aspectRatio)
+static void uv_relax_read_task_cb(void *__restrict userdata,
+                                  const int i,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
 {
-  Temp_UVData *tmp_uvdata;
-  float diff[2];
-  int i;
-  float radius_root = sqrtf(radius);
-  Brush *brush = BKE_paint_brush(sculptdata->uvsculpt);
-
-  tmp_uvdata = (Temp_UVData *)MEM_callocN(sculptdata->totalUniqueUvs * sizeof(Temp_UVData),
-                                          "Temporal data");
+  UvRelaxTaskData *data = userdata;
+  UvSculptData *sculptdata = data->sculptdata;
+  copy_v2_v2(sculptdata->uv_co[i], sculptdata->uv[i].uv);
+}
 
-  /* counting neighbors */
-  for (i = 0; i < sculptdata->totalUvEdges; i++) {
-    UvEdge *tmpedge = sculptdata->uvedges + i;
-    tmp_uvdata[tmpedge->uv1].ncounter++;
-    tmp_uvdata[tmpedge->uv2].ncounter++;
+static void uv_relax_average_task_cb(void *__restrict userdata,
+                                     const int i,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  UvRelaxTaskData *data = userdata;
+  UvSculptData *sculptdata = data->sculptdata;
+  Temp_UVData *tmp = &sculptdata->tmp_uvdata[i];
+  const int start = sculptdata->uv_adjacency_offset[i];
+  const int end = sculptdata->uv_adjacency_offset[i + 1];
+
+  zero_v2(tmp->p);
+  for (int j = start; j < end; j++) {
+    add_v2_v2(tmp->p, sculptdata->uv_co[sculptdata->uv_adjacency[j]]);
+  }
+  mul_v2_fl(tmp->p, 1.0f / (end - start));
+  sub_v2_v2v2(tmp->b, tmp->p, sculptdata->uv_co[i]);
+}
 
-    add_v2_v2(tmp_uvdata[tmpedge->uv2].sum_co, sculptdata->uv[tmpedge->uv1].uv);
-    add_v2_v2(tmp_uvdata[tmpedge->uv1].sum_co, sculptdata->uv[tmpedge->uv2].uv);
+static void uv_relax_hc_sum_task_cb(void *__restrict userdata,
+                                    const int i,
+                                    const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  UvRelaxTaskData *data = userdata;
+  UvSculptData *sculptdata = data->sculptdata;
+  Temp_UVData *tmp = &sculptdata->tmp_uvdata[i];
+
+  zero_v2(tmp->sum_b);
+  for (int j = sculptdata->uv_adjacency_offset[i]; j < sculptdata->uv_adjacency_offset[i + 1];
+       j++) {
+    add_v2_v2(tmp->sum_b, sculptdata->tmp_uvdata[sculptdata->uv_adjacency[j]].b);
   }
+}
 
-  for (i = 0; i < sculptdata->totalUniqueUvs; i++) {
-    copy_v2_v2(diff, tmp_uvdata[i].sum_co);
-    mul_v2_fl(diff, 1.0f / tmp_uvdata[i].ncounter);
-    copy_v2_v2(tmp_uvdata[i].p, diff);
+static void uv_relax_apply_task_cb(void *__restrict userdata,
+                                   const int i,
+                                   const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  UvRelaxTaskData *data = userdata;
+  UvSculptData *sculptdata = data->sculptdata;
+  Temp_UVData *tmp = &sculptdata->tmp_uvdata[i];
+  float diff[2], dist;
+
+  /* This is supposed to happen only if "Pin Edges" is on,
+   * since we have initialization on stroke start.
+   * If ever uv brushes get their own mode we should check for toolsettings option too. */
+  if (sculptdata->uv[i].flag & MARK_BOUNDARY) {
+    return;
+  }
 
-    tmp_uvdata[i].b[0] = diff[0] - sculptdata->uv[i].uv[0];
-    tmp_uvdata[i].b[1] = diff[1] - sculptdata->uv[i].uv[1];
+  sub_v2_v2v2(diff, sculptdata->uv_co[i], data->mouse_coord);
+  diff[1] /= data->aspectRatio;
+  if ((dist = dot_v2v2(diff, diff)) > data->radius) {
+    return;
   }
 
-  for (i = 0; i < sculptdata->totalUvEdges; i++) {
-    UvEdge *tmpedge = sculptdata->uvedges + i;
-    add_v2_v2(tmp_uvdata[tmpedge->uv1].sum_b, tmp_uvdata[tmpedge->uv2].b);
-    add_v2_v2(tmp_uvdata[tmpedge->uv2].sum_b, tmp_uvdata[tmpedge->uv1].b);
+  const float strength = data->alpha * BKE_brush_curve_strength_clamped(
+                                           data->brush, sqrtf(dist), data->radius_root);
+
+  float target[2];
+  if (data->use_hc) {
+    const int ncounter = sculptdata->uv_adjacency_offset[i + 1] -
+                         sculptdata->uv_adjacency_offset[i];
+    target[0] = tmp->p[0] - 0.5f * (tmp->b[0] + tmp->sum_b[0] / ncounter);
+    target[1] = tmp->p[1] - 0.5f * (tmp->b[1] + tmp->sum_b[1] / ncounter);
+  }
+  else {
+    copy_v2_v2(target, tmp->p);
   }
 
-  for (i = 0; i < sculptdata->totalUniqueUvs; i++) {
-    float dist;
-    /* This is supposed to happen only if "Pin Edges" is on,
-     * since we have initialization on stroke start.
-     * If ever uv brushes get their own mode we should check for toolsettings option too. */
-    if (sculptdata->uv[i].flag & MARK_BOUNDARY) {
-      continue;
+  interp_v2_v2v2(sculptdata->uv[i].uv, sculptdata->uv_co[i], target, strength);
+
+  for (UvElement *element = sculptdata->uv[i].element; element; element = element->next) {
+    if (element->separate && element != sculptdata->uv[i].element) {
+      break;
     }
 
-    sub_v2_v2v2(diff, sculptdata->uv[i].uv, mouse_coord);
-    diff[1] /= aspectRatio;
-    if ((dist = dot_v2v2(diff, diff)) <= radius) {
-      UvElement *element;
-      float strength;
-      strength = alpha * BKE_brush_curve_strength_clamped(brush, sqrtf(dist), radius_root);
-
-      sculptdata->uv[i].uv[0] = (1.0f - strength) * sculptdata->uv[i].uv[0] +
-                                strength *
-                                    (tmp_uvdata[i].p[0] -
-                                     0.5f * (tmp_uvdata[i].b[0] +
-                                             tmp_uvdata[i].sum_b[0] / tmp_uvdata[i].ncounter));
-      sculptdata->uv[i].uv[1] = (1.0f - strength) * sculptdata->uv[i].uv[1] +
-                                strength *
-                                    (tmp_uvdata[i].p[1] -
-                                     0.5f * (tmp_uvdata[i].b[1] +
-                                             tmp_uvdata[i].sum_b[1] / tmp_uvdata[i].ncounter));
-
-      for (element = sculptdata->uv[i].element; element; element = element->next) {
-        MLoopUV *luv;
-        BMLoop *l;
+    BMLoop *l = element->l;
+    MLoopUV *luv = CustomData_bmesh_get(&data->em->bm->ldata, l->head.data, CD_MLOOPUV);
+    copy_v2_v2(luv->uv, sculptdata->uv[i].uv);
+  }
+}
 
-        if (element->separate && element != sculptdata->uv[i].element) {
-          break;
-        }
+static void uv_relaxation_iteration(BMEditMesh *em,
+                                    UvSculptData *sculptdata,
+                                    const float mouse_coord[2],
+                                    float alpha,
+                                    float radius,
+                                    float aspectRatio,
+                                    const bool use_hc)
+{
+  UvRelaxTaskData data = {
+      .em = em,
+      .sculptdata = sculptdata,
+      .brush = BKE_paint_brush(sculptdata->uvsculpt),
+      .mouse_coord = mouse_coord,
+      .alpha = alpha,
+      .radius = radius,
+      .radius_root = sqrtf(radius),
+      .aspectRatio = aspectRatio,
+      .use_hc = use_hc,
+  };
 
-        l = element->l;
-        luv = CustomData_bmesh_get(&em->bm->ldata, l->head.data, CD_MLOOPUV);
-        copy_v2_v2(luv->uv, sculptdata->uv[i].uv);
-      }
-    }
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.min_iter_per_thread = UV_RELAX_MIN_ITER_PER_THREAD;
+
+  const int totuv = sculptdata->totalUniqueUvs;
+  BLI_task_parallel_range(0, totuv, &data, uv_relax_read_task_cb, &settings);
+  BLI_task_parallel_range(0, totuv, &data, uv_relax_average_task_cb, &settings);
+  if (use_hc) {
+    BLI_task_parallel_range(0, totuv, &data, uv_relax_hc_sum_task_cb, &settings);
   }
+  BLI_task_parallel_range(0, totuv, &data, uv_relax_apply_task_cb, &settings);
+}
 
-  MEM_freeN(tmp_uvdata);
+static void HC_relaxation_iteration_uv(BMEditMesh *em,
+                                       UvSculptData *sculptdata,
+                                       const float mouse_coord[2],
+                                       float alpha,
+                                       float radius,
+                                       float aspectRatio)
+{
+  uv_relaxation_iteration(em, sculptdata, mouse_coord, alpha, radius, aspectRatio, true);
 }
 
 static void laplacian_relaxation_iteration_uv(BMEditMesh *em,
@@ -221,69 +293,9 @@ static void laplacian_relaxation_iteration_uv(BMEditMesh *em,
                                               float radius,
                                               float aspectRatio)
 {
-  Temp_UVData *tmp_uvdata;
-  float diff[2];
-  int i;
-  float radius_root = sqrtf(radius);
-  Brush *brush = BKE_paint_brush(sculptdata->uvsculpt);
-
-  tmp_uvdata = (Temp_UVData *)MEM_callocN(sculptdata->totalUniqueUvs * sizeof(Temp_UVData),
-                                          "Temporal data");
-
-  /* counting neighbors */
-  for (i = 0; i < sculptdata->totalUvEdges; i++) {
-    UvEdge *tmpedge = sculptdata->uvedges + i;
-    tmp_uvdata[tmpedge->uv1].ncounter++;
-    tmp_uvdata[tmpedge->uv2].ncounter++;
-
-    add_v2_v2(tmp_uvdata[tmpedge->uv2].sum_co, sculptdata->uv[tmpedge->uv1].uv);
-    add_v2_v2(tmp_uvdata[tmpedge->uv1].sum_co, sculptdata->uv[tmpedge->uv2].uv);
-  }
-
   /* Original Lacplacian algorithm included removal of normal component of translation.
    * here it is not needed since we translate along the UV plane always. */
-  for (i = 0; i < sculptdata->totalUniqueUvs; i++) {
-    copy_v2_v2(tmp_uvdata[i].p, tmp_uvdata[i].sum_co);
-    mul_v2_fl(tmp_uvdata[i].p, 1.0f / tmp_uvdata[i].ncounter);
-  }
-
-  for (i = 0; i < sculptdata->totalUniqueUvs; i++) {
-    float dist;
-    /* This is supposed to happen only if "Pin Edges" is on,
-     * since we have initialization on stroke start.
-     * If ever uv brushes get their own mode we should check for toolsettings option too. */
-    if (sculptdata->uv[i].flag & MARK_BOUNDARY) {
-      continue;
-    }
-
-    sub_v2_v2v2(diff, sculptdata->uv[i].uv, mouse_coord);
-    diff[1] /= aspectRatio;
-    if ((dist = dot_v2v2(diff, diff)) <= radius) {
-      UvElement *element;
-      float strength;
-      strength = alpha * BKE_brush_curve_strength_clamped(brush, sqrtf(dist), radius_root);
-
-      sculptdata->uv[i].uv[0] = (1.0f - strength) * sculptdata->uv[i].uv[0] +
-                                strength * tmp_uvdata[i].p[0];
-      sculptdata->uv[i].uv[1] = (1.0f - strength) * sculptdata->uv[i].uv[1] +
-                                strength * tmp_uvdata[i].p[1];
-
-      for (element = sculptdata->uv[i].element; element; element = element->next) {
-        MLoopUV *luv;
-        BMLoop *l;
-
-        if (element->separate && element != sculptdata->uv[i].element) {
-          break;
-        }
-
-        l = element->l;
-        luv = CustomData_bmesh_get(&em->bm->ldata, l->head.data, CD_MLOOPUV);
-        copy_v2_v2(luv->uv, sculptdata->uv[i].uv);
-      }
-    }
-  }
-
-  MEM_freeN(tmp_uvdata);
+  uv_relaxation_iteration(em, sculptdata, mouse_coord, alpha, radius, aspectRatio, false);
 }
 
 static void uv_sculpt_stroke_apply(bContext *C,
@@ -423,6 +435,10 @@ static void uv_sculpt_stroke_exit(bContext *C, wmOperator *op)
   if (data->uvedges) {
     MEM_freeN(data->uvedges);
   }
+  MEM_SAFE_FREE(data->uv_adjacency_offset);
+  MEM_SAFE_FREE(data->uv_adjacency);
+  MEM_SAFE_FREE(data->uv_co);
+  MEM_SAFE_FREE(data->tmp_uvdata);
   if (data->initial_stroke) {
     if (data->initial_stroke->initialSelection) {
       MEM_freeN(data->initial_stroke->initialSelection);
@@ -658,6 +674,32 @@ static UvSculptData *uv_sculpt_stroke_init(bContext *C, wmOperator *op, const wm
     BLI_ghash_free(edgeHash, NULL, NULL);
     MEM_freeN(edges);
 
+    /* Build the flat adjacency and the buffers used by relaxation. */
+    data->uv_adjacency_offset = MEM_calloc_arrayN(
+        data->totalUniqueUvs + 1, sizeof(int), "uv_brush_adjacency_offset");
+    data->uv_adjacency = MEM_malloc_arrayN(
+        data->totalUvEdges * 2, sizeof(int), "uv_brush_adjacency");
+    for (i = 0; i < data->totalUvEdges; i++) {
+      data->uv_adjacency_offset[data->uvedges[i].uv1 + 1]++;
+      data->uv_adjacency_offset[data->uvedges[i].uv2 + 1]++;
+    }
+    for (i = 0; i < data->totalUniqueUvs; i++) {
+      data->uv_adjacency_offset[i + 1] += data->uv_adjacency_offset[i];
+    }
+    int *adjacency_len = MEM_calloc_arrayN(
+        data->totalUniqueUvs, sizeof(int), "uv_brush_adjacency_len");
+    for (i = 0; i < data->totalUvEdges; i++) {
+      const int uv1 = data->uvedges[i].uv1;
+      const int uv2 = data->uvedges[i].uv2;
+      data->uv_adjacency[data->uv_adjacency_offset[uv1] + adjacency_len[uv1]++] = uv2;
+      data->uv_adjacency[data->uv_adjacency_offset[uv2] + adjacency_len[uv2]++] = uv1;
+    }
+    MEM_freeN(adjacency_len);
+
+    data->uv_co = MEM_malloc_arrayN(data->totalUniqueUvs, sizeof(float[2]), "uv_brush_uv_co");
+    data->tmp_uvdata = MEM_malloc_arrayN(
+        data->totalUniqueUvs, sizeof(Temp_UVData), "uv_brush_relax_data");
+
     /* transfer boundary edge property to UV's */
     if (ts->uv_sculpt_settings & UV_SCULPT_LOCK_BORDERS) {
       for (i = 0; i < data->totalUvEdges; i++) {
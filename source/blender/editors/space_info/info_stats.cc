@@ -50,6 +50,7 @@
 #include "DEG_depsgraph_query.h"
 
 #include "ED_info.h"
+#include "ED_sculpt.h"
 
 #include "WM_api.h"
 
@@ -638,6 +639,20 @@ static const char *info_statusbar_string(Main *bmain,
     uintptr_t mem_in_use = MEM_get_memory_in_use();
     BLI_str_format_byte_unit(formatted_mem, mem_in_use, false);
     ofs += BLI_snprintf_rlen(info + ofs, len, TIP_("Memory: %s"), formatted_mem);
+
+    /* Sculpt undo steps moved out of memory. */
+    size_t sculpt_undo_resident, sculpt_undo_spilled;
+    ED_sculpt_undo_memory_stats(&sculpt_undo_resident, &sculpt_undo_spilled);
+    if (sculpt_undo_spilled) {
+      char formatted_spilled[15];
+      BLI_str_format_byte_unit(formatted_mem, sculpt_undo_resident, false);
+      BLI_str_format_byte_unit(formatted_spilled, sculpt_undo_spilled, false);
+      ofs += BLI_snprintf_rlen(info + ofs,
+                               len - ofs,
+                               TIP_(" (Sculpt Undo: %s, %s on Disk)"),
+                               formatted_mem,
+                               formatted_spilled);
+    }
   }
 
   /* GPU VRAM status. */
@@ -151,8 +151,9 @@ void GPU_pbvh_grid_buffers_update(GPU_PBVH_Buffers *buffers,
                                   int update_flags);
 
 /**
- * Finish update. Not thread safe, must run in OpenGL main
- * thread.
+ * Finish update: upload the vertex data packed by the update functions. The buffers must not be
+ * drawn while an update is still packing into them, so callers draw updated nodes only after this.
+ * Not thread safe, must run in OpenGL main thread.
  */
 void GPU_pbvh_buffers_update_flush(GPU_PBVH_Buffers *buffers);
 
@@ -0,0 +1,146 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_bitmap.h"
+#include "BLI_task.h"
+
+#include "BKE_DerivedMesh.h"
+#include "BKE_ccg.h"
+
+#include "DNA_meshdata_types.h"
+
+#include "GPU_batch.h"
+#include "GPU_buffers.h"
+#include "GPU_vertex_buffer.h"
+
+#include "gpu_testing.hh"
+
+namespace blender::gpu::tests {
+
+#define TOTGRID 4
+#define GRID_SIZE 5
+
+struct PBVHTestGrids {
+  CCGKey key;
+  CCGElem *grids[TOTGRID];
+  DMFlagMat flag_mats[TOTGRID];
+  BLI_bitmap *grid_hidden[TOTGRID];
+  int grid_indices[TOTGRID];
+};
+
+static void test_grids_create(PBVHTestGrids *tg)
+{
+  CCGKey *key = &tg->key;
+
+  key->level = 3;
+  key->grid_size = GRID_SIZE;
+  key->grid_area = GRID_SIZE * GRID_SIZE;
+  key->has_normals = true;
+  key->has_mask = true;
+  key->normal_offset = sizeof(float[3]);
+  key->mask_offset = sizeof(float[6]);
+  key->elem_size = sizeof(float[7]);
+  key->grid_bytes = key->grid_area * key->elem_size;
+
+  for (int i = 0; i < TOTGRID; i++) {
+    tg->grids[i] = static_cast<CCGElem *>(MEM_mallocN(key->grid_bytes, __func__));
+    tg->flag_mats[i].mat_nr = 0;
+    tg->flag_mats[i].flag = ME_SMOOTH;
+    tg->grid_hidden[i] = nullptr;
+    tg->grid_indices[i] = i;
+
+    for (int y = 0; y < GRID_SIZE; y++) {
+      for (int x = 0; x < GRID_SIZE; x++) {
+        CCGElem *elem = CCG_grid_elem(key, tg->grids[i], x, y);
+        float *co = CCG_elem_co(key, elem);
+        float *no = CCG_elem_no(key, elem);
+
+        co[0] = (float)(i * GRID_SIZE + x);
+        co[1] = (float)y;
+        co[2] = 0.1f * (float)(x * y);
+        no[0] = 0.0f;
+        no[1] = 0.0f;
+        no[2] = 1.0f;
+        *CCG_elem_mask(key, elem) = (float)x / (float)GRID_SIZE;
+      }
+    }
+  }
+}
+
+static void test_grids_free(PBVHTestGrids *tg)
+{
+  for (int i = 0; i < TOTGRID; i++) {
+    MEM_freeN(tg->grids[i]);
+  }
+}
+
+static void test_grid_buffers_update(PBVHTestGrids *tg, GPU_PBVH_Buffers *buffers)
+{
+  GPU_pbvh_grid_buffers_update(buffers,
+                               nullptr,
+                               tg->grids,
+                               tg->flag_mats,
+                               tg->grid_indices,
+                               TOTGRID,
+                               nullptr,
+                               0,
+                               0,
+                               &tg->key,
+                               GPU_PBVH_BUFFERS_SHOW_MASK);
+}
+
+static void test_grid_buffers_update_task(TaskPool *__restrict pool, void *taskdata)
+{
+  PBVHTestGrids *tg = static_cast<PBVHTestGrids *>(BLI_task_pool_user_data(pool));
+  test_grid_buffers_update(tg, static_cast<GPU_PBVH_Buffers *>(taskdata));
+}
+
+/* Local copy of the vertex data the buffers currently draw with. */
+static void *test_buffers_drawn_data(GPU_PBVH_Buffers *buffers, size_t *r_size)
+{
+  GPUVertBuf *vbo = GPU_pbvh_buffers_batch_get(buffers, false, false)->verts[0];
+
+  *r_size = GPU_vertbuf_get_vertex_len(vbo) * GPU_vertbuf_get_format(vbo)->stride;
+
+  GPU_vertbuf_use(vbo);
+  return GPU_vertbuf_unmap(vbo, GPU_vertbuf_read(vbo));
+}
+
+static void test_gpu_pbvh_grid_buffers_threaded_update()
+{
+  PBVHTestGrids tg;
+  test_grids_create(&tg);
+
+  GPU_PBVH_Buffers *buffers_sync = GPU_pbvh_grid_buffers_build(TOTGRID, tg.grid_hidden);
+  GPU_PBVH_Buffers *buffers_async = GPU_pbvh_grid_buffers_build(TOTGRID, tg.grid_hidden);
+
+  /* Pack one set of buffers in a task while the other one is packed and uploaded here. */
+  TaskPool *pool = BLI_task_pool_create(&tg, TASK_PRIORITY_HIGH);
+  BLI_task_pool_push(pool, test_grid_buffers_update_task, buffers_async, false, nullptr);
+
+  test_grid_buffers_update(&tg, buffers_sync);
+  GPU_pbvh_buffers_update_flush(buffers_sync);
+
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+  GPU_pbvh_buffers_update_flush(buffers_async);
+
+  size_t size_sync, size_async;
+  void *data_sync = test_buffers_drawn_data(buffers_sync, &size_sync);
+  void *data_async = test_buffers_drawn_data(buffers_async, &size_async);
+
+  ASSERT_EQ(size_sync, size_async);
+  EXPECT_EQ(memcmp(data_sync, data_async, size_sync), 0);
+
+  MEM_freeN(data_sync);
+  MEM_freeN(data_async);
+  GPU_pbvh_buffers_free(buffers_sync);
+  GPU_pbvh_buffers_free(buffers_async);
+  test_grids_free(&tg);
+}
+GPU_TEST(gpu_pbvh_grid_buffers_threaded_update)
+
+}  // namespace blender::gpu::tests
@@ -68,12 +68,13 @@ typedef struct CustomData {
    * MUST be >= CD_NUMTYPES, but we can't use a define here.
    * Correct size is ensured in CustomData_update_typemap assert().
    */
-  int typemap[55];
+  int typemap[56];
 
   /** Number of layers, size of layers array. */
   int totlayer, maxlayer;
   /** In editmode, total size of all data layers. */
   int totsize;
+  char _pad0[4];
   /** (BMesh Only): Memory pool for allocation of blocks. */
   struct BLI_mempool *pool;
   /** External file storing customdata layers. */
@@ -165,7 +166,8 @@ typedef enum CustomDataType {
   CD_MESH_ID = 52,
   CD_DYNTOPO_VERT = 53,
   CD_TOOLFLAGS = 54,
-  CD_NUMTYPES = 55,
+  CD_DYNTOPO_VERT_COLD = 55,
+  CD_NUMTYPES = 56,
 } CustomDataType;
 
 /* Bits for CustomDataMask */
@@ -222,6 +224,7 @@ typedef enum CustomDataType {
 #define CD_MASK_MESH_ID (1ULL << CD_MESH_ID)
 #define CD_MASK_HAIRLENGTH (1ULL << CD_HAIRLENGTH)
 #define CD_MASK_TOOLFLAGS (1ULL << CD_TOOLFLAGS)
+#define CD_MASK_DYNTOPO_VERT_COLD (1ULL << CD_DYNTOPO_VERT_COLD)
 
 /** Multires loop data. */
 #define CD_MASK_MULTIRES_GRIDS (CD_MASK_MDISPS | CD_GRID_PAINT_MASK)
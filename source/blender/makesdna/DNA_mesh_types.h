@@ -341,7 +341,9 @@ typedef struct Mesh {
    * default and Face Sets can be used without affecting the color of the mesh. */
   int face_sets_color_default;
 
-  char _pad1[4];
+  /** Where the voxel remesher keeps detail when adaptivity is used. */
+  char remesh_voxel_detail;
+  char _pad1[3];
 
   Mesh_Runtime runtime;
   void *_pad2;
@@ -433,6 +435,13 @@ enum {
   REMESH_QUAD = 1,
 };
 
+/** #Mesh.remesh_voxel_detail */
+enum {
+  REMESH_VOXEL_DETAIL_UNIFORM = 0,
+  REMESH_VOXEL_DETAIL_CURVATURE = 1,
+  REMESH_VOXEL_DETAIL_MASK = 2,
+};
+
 /** #SubsurfModifierData.subdivType */
 enum {
   ME_CC_SUBSURF = 0,
@@ -528,18 +528,22 @@ typedef struct MSculptVert {
   /**original coordinates*/
   float origco[3], origno[3];
 
-  /**original color*/
-  float origcolor[4];
-
   unsigned short origmask;
 
   /* curv is a fast curvature approximation used by dyntopo
     adaptive curvature. */
   unsigned short curv;
+} MSculptVert;
+
+/* Sculpt vertex data that only a few brushes read, kept out of #MSculptVert
+ * so the per sample data of the common brushes fits in fewer cache lines. */
+typedef struct MSculptVertCold {
+  /**original color*/
+  float origcolor[4];
 
   /* curvature_dir parallels a principle curvature direction */
   float curvature_dir[3];
-} MSculptVert;
+} MSculptVertCold;
 
 /* MSculptVert->flag */
 enum {
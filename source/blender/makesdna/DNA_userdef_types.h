@@ -777,7 +777,8 @@ typedef struct UserDef {
   char keyconfigstr[64];
 
   short undosteps;
-  char _pad1[2];
+  /** Sculpt undo memory kept resident in megabytes, older steps go to a temp file. */
+  short sculpt_undo_memory;
   int undomemory;
   float gpu_viewport_quality DNA_DEPRECATED;
   short gp_manhattandist, gp_euclideandist, gp_eraser;
@@ -2362,7 +2362,13 @@ static void rna_def_struct_function_prototype_cpp(FILE *f,
     pout = (flag_parameter & PARM_OUTPUT);
 
     if (flag & PROP_DYNAMIC) {
-      ptrstr = pout ? "**" : "*";
+      if (type == PROP_STRING) {
+        /* The string type already is a pointer. */
+        ptrstr = pout ? "*" : "";
+      }
+      else {
+        ptrstr = pout ? "**" : "*";
+      }
     }
     else if (type == PROP_POINTER) {
       ptrstr = pout ? "*" : "";
@@ -2852,6 +2858,10 @@ static void rna_def_function_funcs(FILE *f, StructDefRNA *dsrna, FunctionDefRNA
       ptrstr = cptr || dparm->prop->arraydimension ? "*" : "";
       /* XXX only arrays and strings are allowed to be dynamic, is this checked anywhere? */
     }
+    else if (type == PROP_STRING && (flag & PROP_DYNAMIC)) {
+      /* The string type already is a pointer. */
+      ptrstr = pout ? "*" : "";
+    }
     else if (cptr || (flag & PROP_DYNAMIC)) {
       ptrstr = pout ? "**" : "*";
       /* Fixed size arrays and RNA pointers are pre-allocated on the ParameterList stack,
@@ -2932,7 +2942,11 @@ static void rna_def_function_funcs(FILE *f, StructDefRNA *dsrna, FunctionDefRNA
     }
     else {
       const char *data_str;
-      if (cptr || (flag & PROP_DYNAMIC)) {
+      if (type == PROP_STRING && (flag & PROP_DYNAMIC)) {
+        ptrstr = "*";
+        valstr = "*";
+      }
+      else if (cptr || (flag & PROP_DYNAMIC)) {
         ptrstr = "**";
         valstr = "*";
       }
@@ -3530,7 +3544,11 @@ static void rna_generate_static_parameter_prototypes(FILE *f,
       continue;
     }
 
-    if (cptr || (flag & PROP_DYNAMIC)) {
+    if (type == PROP_STRING && (flag & PROP_DYNAMIC)) {
+      /* The string type already is a pointer. */
+      ptrstr = pout ? "*" : "";
+    }
+    else if (cptr || (flag & PROP_DYNAMIC)) {
       ptrstr = pout ? "**" : "*";
     }
     else if (type == PROP_POINTER || dparm->prop->arraydimension) {
@@ -47,6 +47,25 @@ static const EnumPropertyItem rna_enum_mesh_remesh_mode_items[] = {
     {0, NULL, 0, NULL, NULL},
 };
 
+static const EnumPropertyItem rna_enum_mesh_remesh_voxel_detail_items[] = {
+    {REMESH_VOXEL_DETAIL_UNIFORM,
+     "UNIFORM",
+     0,
+     "Uniform",
+     "Simplify the same amount everywhere on the surface"},
+    {REMESH_VOXEL_DETAIL_CURVATURE,
+     "CURVATURE",
+     0,
+     "Curvature",
+     "Keep the full voxel resolution in curved areas and simplify flat ones"},
+    {REMESH_VOXEL_DETAIL_MASK,
+     "MASK",
+     0,
+     "Mask",
+     "Keep the full voxel resolution in masked areas and simplify the rest"},
+    {0, NULL, 0, NULL, NULL},
+};
+
 #ifdef RNA_RUNTIME
 
 #  include "DNA_scene_types.h"
@@ -3446,6 +3465,13 @@ static void rna_def_mesh(BlenderRNA *brna)
       "generating triangles. A value greater than 0 disables Fix Poles");
   RNA_def_property_update(prop, 0, "rna_Mesh_update_draw");
 
+  prop = RNA_def_property(srna, "remesh_voxel_detail", PROP_ENUM, PROP_NONE);
+  RNA_def_property_enum_sdna(prop, NULL, "remesh_voxel_detail");
+  RNA_def_property_enum_items(prop, rna_enum_mesh_remesh_voxel_detail_items);
+  RNA_def_property_ui_text(
+      prop, "Adaptive Detail", "Areas of the surface that are not simplified by Adaptivity");
+  RNA_def_property_update(prop, 0, "rna_Mesh_update_draw");
+
   prop = RNA_def_property(srna, "use_remesh_fix_poles", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_boolean_sdna(prop, NULL, "flag", ME_REMESH_FIX_POLES);
   RNA_def_property_ui_text(prop, "Fix Poles", "Produces less poles and a better topology flow");
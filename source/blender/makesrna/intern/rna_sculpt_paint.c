@@ -5,6 +5,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
@@ -99,6 +100,8 @@ const EnumPropertyItem rna_enum_symmetrize_direction_items[] = {
 #ifdef RNA_RUNTIME
 #  include "MEM_guardedalloc.h"
 
+#  include "BLI_string.h"
+
 #  include "BKE_collection.h"
 #  include "BKE_context.h"
 #  include "BKE_gpencil.h"
@@ -556,6 +559,10 @@ void SCULPT_replay_log_append(struct Sculpt *sd, struct SculptSession *ss, struc
 void SCULPT_replay_test(void);
 void SCULPT_replay_parse(const char *buf);
 void SCULPT_replay(bContext *ctx);
+char *SCULPT_replay_batch(struct Main *bmain,
+                          struct Depsgraph *depsgraph,
+                          struct Scene *scene,
+                          struct Object *ob);
 
 static void rna_SCULPT_replay_test(Sculpt *sculpt)
 {
@@ -587,6 +594,26 @@ static void rna_SCULPT_replay_replay(bContext *ctx)
   SCULPT_replay(ctx);
 }
 
+static void rna_SCULPT_replay_batch(bContext *C, int *result_len, const char **result)
+{
+  /* The report grows with the number of replays, it's handed over as is and freed by RNA. */
+  char *report = SCULPT_replay_batch(CTX_data_main(C),
+                                     CTX_data_ensure_evaluated_depsgraph(C),
+                                     CTX_data_scene(C),
+                                     CTX_data_active_object(C));
+  *result = report;
+  *result_len = report ? (int)strlen(report) : 0;
+}
+
+char *SCULPT_cloth_solver_benchmark(int totvert, int seed, int iterations);
+static void rna_SCULPT_cloth_solver_benchmark(
+    int totvert, int seed, int iterations, int *result_len, const char **result)
+{
+  char *report = SCULPT_cloth_solver_benchmark(totvert, seed, iterations);
+  *result = report;
+  *result_len = report ? (int)strlen(report) : 0;
+}
+
 void SCULPT_replay_make_cube(struct bContext *C, int steps);
 static void rna_SCULPT_replay_make_cube(bContext *ctx, int steps)
 {
@@ -1074,6 +1101,7 @@ static void rna_def_sculpt(BlenderRNA *brna)
 
   /* functions */
   FunctionRNA *func;
+  PropertyRNA *parm;
 
   func = RNA_def_function(srna, "has_persistent_base", "rna_Sculpt_has_persistent_base");
   RNA_def_function_ui_description(func, "Test if sculpt has persistent base (sculpt mode only)");
@@ -1093,6 +1121,29 @@ static void rna_def_sculpt(BlenderRNA *brna)
   RNA_def_function_ui_description(func, "Test sculpt replay serialization");
   RNA_def_function_flag(func, FUNC_NO_SELF | FUNC_USE_CONTEXT);
 
+  func = RNA_def_function(srna, "replay_batch", "rna_SCULPT_replay_batch");
+  RNA_def_function_ui_description(
+      func,
+      "Replay the recorded strokes on the active object without a window manager, "
+      "returns a JSON report with timings and a hash of the final coordinates");
+  RNA_def_function_flag(func, FUNC_NO_SELF | FUNC_USE_CONTEXT);
+  parm = RNA_def_string(func, "result", NULL, 0, "result", "");
+  RNA_def_parameter_flags(parm, PROP_DYNAMIC, 0);
+  RNA_def_function_output(func, parm);
+
+  func = RNA_def_function(srna, "cloth_solver_benchmark", "rna_SCULPT_cloth_solver_benchmark");
+  RNA_def_function_ui_description(
+      func,
+      "Solve the constraints of a cloth grid built from a fixed seed, returns a JSON report "
+      "comparing the serial, parallel and SIMD solvers");
+  RNA_def_function_flag(func, FUNC_NO_SELF);
+  RNA_def_int(func, "verts", 1000000, 4, INT_MAX, "Vertices", "", 4, 4000000);
+  RNA_def_int(func, "seed", 0, 0, INT_MAX, "Seed", "", 0, 10000);
+  RNA_def_int(func, "iterations", 5, 1, 1000, "Iterations", "", 1, 100);
+  parm = RNA_def_string(func, "result", NULL, 0, "result", "");
+  RNA_def_parameter_flags(parm, PROP_DYNAMIC, 0);
+  RNA_def_function_output(func, parm);
+
   func = RNA_def_function(srna, "replay_make_cube", "rna_SCULPT_replay_make_cube");
   RNA_def_function_ui_description(func, "Test sculpt replay serialization");
   RNA_def_function_flag(func, FUNC_NO_SELF | FUNC_USE_CONTEXT);
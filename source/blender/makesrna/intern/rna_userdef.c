@@ -5055,6 +5055,14 @@ static void rna_def_userdef_edit(BlenderRNA *brna)
   RNA_def_property_ui_text(
       prop, "Undo Memory Size", "Maximum memory usage in megabytes (0 means unlimited)");
 
+  prop = RNA_def_property(srna, "sculpt_undo_memory_limit", PROP_INT, PROP_NONE);
+  RNA_def_property_int_sdna(prop, NULL, "sculpt_undo_memory");
+  RNA_def_property_range(prop, 0, SHRT_MAX);
+  RNA_def_property_ui_text(prop,
+                           "Sculpt Undo Memory Limit",
+                           "Memory in megabytes that sculpt undo steps may keep resident, older "
+                           "steps are moved to a temporary file (0 means unlimited)");
+
   prop = RNA_def_property(srna, "use_global_undo", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_boolean_sdna(prop, NULL, "uiflag", USER_GLOBALUNDO);
   RNA_def_property_ui_text(
@@ -5900,7 +5900,12 @@ static PyObject *pyrna_param_to_py(PointerRNA *ptr, PropertyRNA *prop, void *dat
         PyObject *value_coerce = NULL;
         const int subtype = RNA_property_subtype(prop);
 
-        if (flag & PROP_THICK_WRAP) {
+        if (flag & PROP_DYNAMIC) {
+          /* Dynamic strings are allocated by the function, see #RNA_parameter_list_free. */
+          ParameterDynAlloc *data_alloc = data;
+          data_ch = data_alloc->array ? data_alloc->array : "";
+        }
+        else if (flag & PROP_THICK_WRAP) {
           data_ch = (char *)data;
         }
         else {